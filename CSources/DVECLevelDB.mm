@@ -349,6 +349,26 @@ void copyDataToString(NSData *data, std::string &string) {
     return [self removeValueForKey:key options:[DVECLevelDBWriteOptions new] error:error];
 }
 
+- (BOOL)removeValuesFromKey:(NSData *)startKey toKey:(NSData *)limitKey options:(DVECLevelDBWriteOptions *)options error:(NSError **)error {
+    leveldb::Slice levelDbStartKey = sliceForData(startKey);
+    leveldb::Slice levelDbLimitKey = sliceForData(limitKey);
+
+    leveldb::Status status = self.db->DeleteRange(*(options.options), levelDbStartKey, levelDbLimitKey);
+
+    NSError *levelDBError = [NSError createFromLevelDBStatus:status];
+    if (levelDBError != nil) {
+        if (error != nil) {
+            *error = levelDBError;
+        }
+        return NO;
+    }
+    return YES;
+}
+
+- (BOOL)removeValuesFromKey:(NSData *)startKey toKey:(NSData *)limitKey error:(NSError **)error {
+    return [self removeValuesFromKey:startKey toKey:limitKey options:[DVECLevelDBWriteOptions new] error:error];
+}
+
 - (NSData *)objectForKeyedSubscript:(NSData *)key {
     NSError *error = nil;
     NSData *data = [self dataForKey:key error:&error];
@@ -14,6 +14,10 @@ static size_t _defaultBlockSize = 4 * 1024;
 static int _defaultBlockRestartInterval = 16;
 static size_t _defaultMaxFileSize = 2 * 1024 * 1024;
 static DVECLevelDBOptionsCompression _defaultCompression = DVECLevelDBOptionsCompressionSnappy;
+static DVECLevelDBOptionsChecksum _defaultChecksum = DVECLevelDBOptionsChecksumCRC32C;
+static size_t _defaultCompactionReadaheadSize = 2 * 1024 * 1024;
+static int _defaultPreloadTableThreadsCount = 4;
+static size_t _defaultMaxWriteGroupBytes = 1024 * 1024;
 
 + (size_t)defaultWriteBufferSize {
     return _defaultWriteBufferSize;
@@ -39,6 +43,22 @@ static DVECLevelDBOptionsCompression _defaultCompression = DVECLevelDBOptionsCom
     return _defaultCompression;
 }
 
++ (DVECLevelDBOptionsChecksum)defaultChecksum {
+    return _defaultChecksum;
+}
+
++ (size_t)defaultCompactionReadaheadSize {
+    return _defaultCompactionReadaheadSize;
+}
+
++ (int)defaultPreloadTableThreadsCount {
+    return _defaultPreloadTableThreadsCount;
+}
+
++ (size_t)defaultMaxWriteGroupBytes {
+    return _defaultMaxWriteGroupBytes;
+}
+
 + (leveldb::Logger *)createSimpleLoggerFacade:(id<DVECLevelDBSimpleLogger>)logger {
     // Optimization to prevent creation and use of unnecessary logger instance.
     if (logger == nil || [logger isKindOfClass:[DVECLevelDBVoidLogger class]]) {
@@ -77,6 +97,10 @@ static DVECLevelDBOptionsCompression _defaultCompression = DVECLevelDBOptionsCom
         _maxFileSize = maxFileSize;
         _reuseLogs = reuseLogs;
         _compression = compression;
+        _checksum = DVECLevelDBOptions.defaultChecksum;
+        _compactionReadaheadSize = DVECLevelDBOptions.defaultCompactionReadaheadSize;
+        _preloadTableThreadsCount = DVECLevelDBOptions.defaultPreloadTableThreadsCount;
+        _maxWriteGroupBytes = DVECLevelDBOptions.defaultMaxWriteGroupBytes;
     }
     return self;
 }
@@ -114,7 +138,19 @@ static DVECLevelDBOptionsCompression _defaultCompression = DVECLevelDBOptionsCom
     options.block_restart_interval = _blockRestartInterval;
     options.max_file_size = _maxFileSize;
     options.compression = (leveldb::CompressionType)_compression;
+    options.checksum_type = (leveldb::ChecksumType)_checksum;
     options.reuse_logs = _reuseLogs;
+    options.recycle_log_file_num = _recycleLogFileCount;
+    options.wal_compression = (leveldb::CompressionType)_walCompression;
+    options.avoid_flush_during_recovery = _avoidFlushDuringRecovery;
+    options.preload_tables_on_open = _preloadTablesOnOpen;
+    options.preload_table_threads = _preloadTableThreadsCount;
+    options.compaction_readahead_size = _compactionReadaheadSize;
+    options.bytes_per_sync = _bytesPerSync;
+    options.max_write_group_bytes = _maxWriteGroupBytes;
+    options.sync_write_group_wait_micros = _syncWriteGroupWaitMicros;
+    options.use_direct_reads = _useDirectReads;
+    options.use_direct_io_for_flush_and_compaction = _useDirectIOForFlushAndCompaction;
 
     if (keyComparator != nil) {
         options.comparator = keyComparator;
@@ -39,6 +39,14 @@
     _options->fill_cache = fillCache;
 }
 
+- (size_t)readaheadSize {
+    return _options->readahead_size;
+}
+
+- (void)setReadaheadSize:(size_t)readaheadSize {
+    _options->readahead_size = readaheadSize;
+}
+
 - (void)setSnapshot:(DVECLevelDBSnapshot *)snapshot {
     _snapshot = snapshot;
 
@@ -63,6 +63,9 @@ __attribute__((objc_subclassing_restricted))
 - (BOOL)removeValueForKey:(NSData *)key options:(DVECLevelDBWriteOptions *)options error:(NSError *_Nullable *_Nullable)error;
 - (BOOL)removeValueForKey:(NSData *)key error:(NSError *_Nullable *_Nullable)error;
 
+- (BOOL)removeValuesFromKey:(NSData *)startKey toKey:(NSData *)limitKey options:(DVECLevelDBWriteOptions *)options error:(NSError *_Nullable *_Nullable)error;
+- (BOOL)removeValuesFromKey:(NSData *)startKey toKey:(NSData *)limitKey error:(NSError *_Nullable *_Nullable)error;
+
 - (nullable NSData *)objectForKeyedSubscript:(NSData *)key;
 - (void)setObject:(NSData *)obj forKeyedSubscript:(NSData *)key;
 
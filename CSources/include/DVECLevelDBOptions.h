@@ -10,8 +10,14 @@ NS_ASSUME_NONNULL_BEGIN
 typedef NS_ENUM(NSInteger, DVECLevelDBOptionsCompression) {
     DVECLevelDBOptionsCompressionNone = 0x0,
     DVECLevelDBOptionsCompressionSnappy = 0x1,
+    DVECLevelDBOptionsCompressionZlib = 0x2,
 } NS_SWIFT_NAME(CLevelDB.CompressionOption);
 
+typedef NS_ENUM(NSInteger, DVECLevelDBOptionsChecksum) {
+    DVECLevelDBOptionsChecksumCRC32C NS_SWIFT_NAME(crc32c) = 0x0,
+    DVECLevelDBOptionsChecksumXXH3 NS_SWIFT_NAME(xxh3) = 0x1,
+} NS_SWIFT_NAME(CLevelDB.ChecksumOption);
+
 NS_SWIFT_NAME(CLevelDB.Options)
 @interface DVECLevelDBOptions: NSObject
 @property (class, nonatomic, readonly) size_t defaultWriteBufferSize;
@@ -20,6 +26,10 @@ NS_SWIFT_NAME(CLevelDB.Options)
 @property (class, nonatomic, readonly) int defaultBlockRestartInterval;
 @property (class, nonatomic, readonly) size_t defaultMaxFileSize;
 @property (class, nonatomic, readonly) DVECLevelDBOptionsCompression defaultCompression;
+@property (class, nonatomic, readonly) DVECLevelDBOptionsChecksum defaultChecksum;
+@property (class, nonatomic, readonly) size_t defaultCompactionReadaheadSize;
+@property (class, nonatomic, readonly) int defaultPreloadTableThreadsCount;
+@property (class, nonatomic, readonly) size_t defaultMaxWriteGroupBytes;
 
 @property (nonatomic) BOOL createDBIfMissing;
 @property (nonatomic) BOOL throwErrorIfDBExists;
@@ -30,8 +40,20 @@ NS_SWIFT_NAME(CLevelDB.Options)
 @property (nonatomic) int blockRestartInterval;
 @property (nonatomic) size_t maxFileSize;
 @property (nonatomic) BOOL reuseLogs;
+@property (nonatomic) size_t recycleLogFileCount;
+@property (nonatomic) DVECLevelDBOptionsCompression walCompression;
+@property (nonatomic) BOOL avoidFlushDuringRecovery;
+@property (nonatomic) BOOL preloadTablesOnOpen;
+@property (nonatomic) int preloadTableThreadsCount;
+@property (nonatomic) size_t compactionReadaheadSize;
+@property (nonatomic) size_t bytesPerSync;
+@property (nonatomic) size_t maxWriteGroupBytes;
+@property (nonatomic) uint64_t syncWriteGroupWaitMicros;
+@property (nonatomic) BOOL useDirectReads;
+@property (nonatomic) BOOL useDirectIOForFlushAndCompaction;
 
 @property (nonatomic) DVECLevelDBOptionsCompression compression;
+@property (nonatomic) DVECLevelDBOptionsChecksum checksum;
 
 - (instancetype)initWithCreateDBIfMissing:(BOOL)createDBIfMissing
                      throwErrorIfDBExists:(BOOL)throwErrorIfDBExists
@@ -51,6 +73,7 @@ NS_SWIFT_NAME(CLevelDB.ReadOptions)
 @interface DVECLevelDBReadOptions: NSObject
 @property (nonatomic) BOOL verifyChecksums;
 @property (nonatomic) BOOL fillCache;
+@property (nonatomic) size_t readaheadSize;
 @property (nonatomic, strong, nullable) DVECLevelDBSnapshot *snapshot;
 @end
 
@@ -0,0 +1,229 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "db/builder.h"
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+// Checksum, key size and value size
+static const size_t kMaxBlobHeaderSize = 4 + 5 + 10;
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+bool BlobIndex::DecodeFrom(Slice input) {
+  return GetVarint64(&input, &file_number) && GetVarint64(&input, &offset) &&
+         GetVarint64(&input, &size) && input.empty() && file_number != 0;
+}
+
+BlobFileBuilder::BlobFileBuilder(const std::string& dbname,
+                                 const Options& options, uint64_t number)
+    : fname_(BlobFileName(dbname, number)),
+      options_(options),
+      number_(number),
+      file_(nullptr),
+      num_blobs_(0),
+      offset_(0),
+      closed_(false) {}
+
+BlobFileBuilder::~BlobFileBuilder() {
+  if (!closed_) {
+    Abandon();
+  }
+}
+
+Status BlobFileBuilder::Add(const Slice& user_key, const Slice& value,
+                            std::string* index) {
+  assert(!closed_);
+  Status s;
+  if (file_ == nullptr) {
+    s = NewTableFileForWrite(options_.env, options_, fname_, &file_);
+    if (!s.ok()) {
+      file_ = nullptr;
+      return s;
+    }
+  }
+
+  // The value is appended separately to save a copy of it.
+  record_.assign(4, '\0');
+  PutVarint32(&record_, static_cast<uint32_t>(user_key.size()));
+  PutVarint64(&record_, value.size());
+  record_.append(user_key.data(), user_key.size());
+  uint32_t crc = crc32c::Value(record_.data() + 4, record_.size() - 4);
+  crc = crc32c::Extend(crc, value.data(), value.size());
+  EncodeFixed32(&record_[0], crc32c::Mask(crc));
+  s = file_->Append(record_);
+  if (s.ok()) {
+    s = file_->Append(value);
+  }
+  if (s.ok()) {
+    BlobIndex blob_index;
+    blob_index.file_number = number_;
+    blob_index.offset = offset_;
+    blob_index.size = record_.size() + value.size();
+    index->clear();
+    blob_index.EncodeTo(index);
+    offset_ += blob_index.size;
+    num_blobs_++;
+  }
+  return s;
+}
+
+Status BlobFileBuilder::Finish() {
+  assert(!closed_);
+  closed_ = true;
+  Status s;
+  if (file_ != nullptr) {
+    s = file_->Sync();
+    if (s.ok()) {
+      s = file_->Close();
+    }
+    delete file_;
+    file_ = nullptr;
+  }
+  return s;
+}
+
+void BlobFileBuilder::Abandon() {
+  closed_ = true;
+  if (file_ != nullptr) {
+    delete file_;
+    file_ = nullptr;
+    options_.env->RemoveFile(fname_);
+  }
+}
+
+namespace {
+
+// Parse blob record "input" and check its checksum if "verify_checksum".
+// On success, leaves its key and value in *key and *value.
+Status ParseBlobRecord(Slice input, bool verify_checksum, Slice* key,
+                       Slice* value) {
+  uint32_t key_size;
+  uint64_t value_size;
+  if (input.size() < 4) {
+    return Status::Corruption("truncated blob record");
+  }
+  const uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(input.data()));
+  const Slice body(input.data() + 4, input.size() - 4);
+  input = body;
+  if (!GetVarint32(&input, &key_size) || !GetVarint64(&input, &value_size) ||
+      key_size > input.size() || value_size != input.size() - key_size) {
+    return Status::Corruption("bad blob record");
+  }
+  if (verify_checksum &&
+      crc32c::Value(body.data(), body.size()) != expected_crc) {
+    return Status::Corruption("blob record checksum mismatch");
+  }
+  *key = Slice(input.data(), key_size);
+  *value = Slice(input.data() + key_size, value_size);
+  return Status::OK();
+}
+
+}  // namespace
+
+Status ReadBlob(RandomAccessFile* file, const ReadOptions& options,
+                const Slice& user_key, const BlobIndex& index,
+                std::string* value) {
+  // Read the record straight into *value and move the value to the front.
+  value->resize(index.size);
+  Slice contents;
+  Status s = file->Read(index.offset, index.size, &contents, &(*value)[0]);
+  if (!s.ok()) {
+    value->clear();
+    return s;
+  }
+  if (contents.size() != index.size) {
+    value->clear();
+    return Status::Corruption("truncated blob record read");
+  }
+  Slice key, blob;
+  s = ParseBlobRecord(contents, options.verify_checksums, &key, &blob);
+  if (s.ok() && key != user_key) {
+    s = Status::Corruption("blob record of another key");
+  }
+  if (!s.ok()) {
+    value->clear();
+    return s;
+  }
+  if (contents.data() == value->data()) {
+    std::memmove(&(*value)[0], blob.data(), blob.size());
+    value->resize(blob.size());
+  } else {
+    // The file returned a pointer into its own memory.
+    value->assign(blob.data(), blob.size());
+  }
+  return Status::OK();
+}
+
+Status ScanBlobFile(Env* env, const std::string& fname, uint64_t* num_blobs,
+                    uint64_t* blob_bytes) {
+  *num_blobs = 0;
+  *blob_bytes = 0;
+  uint64_t file_size;
+  Status s = env->GetFileSize(fname, &file_size);
+  RandomAccessFile* file = nullptr;
+  if (s.ok()) {
+    s = env->NewRandomAccessFile(fname, &file);
+  }
+  char header[kMaxBlobHeaderSize];
+  std::string record;
+  uint64_t offset = 0;
+  while (s.ok() && offset < file_size) {
+    const size_t n = static_cast<size_t>(
+        std::min<uint64_t>(kMaxBlobHeaderSize, file_size - offset));
+    Slice input;
+    s = file->Read(offset, n, &input, header);
+    if (!s.ok()) {
+      break;
+    }
+    uint32_t key_size;
+    uint64_t value_size;
+    if (input.size() < 4) {
+      s = Status::Corruption("truncated blob record", fname);
+      break;
+    }
+    input.remove_prefix(4);
+    const size_t available = input.size();
+    if (!GetVarint32(&input, &key_size) || !GetVarint64(&input, &value_size) ||
+        value_size > file_size) {
+      s = Status::Corruption("bad blob record", fname);
+      break;
+    }
+    const uint64_t size =
+        4 + (available - input.size()) + key_size + value_size;
+    if (size > file_size - offset) {
+      s = Status::Corruption("truncated blob record", fname);
+      break;
+    }
+    Slice key, value;
+    record.resize(size);
+    s = file->Read(offset, size, &input, &record[0]);
+    if (s.ok()) {
+      s = ParseBlobRecord(input, true, &key, &value);
+    }
+    if (!s.ok()) {
+      break;
+    }
+    offset += size;
+    (*num_blobs)++;
+    *blob_bytes += size;
+  }
+  delete file;
+  return s;
+}
+
+}  // namespace leveldb
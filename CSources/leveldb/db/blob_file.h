@@ -0,0 +1,102 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A blob file holds values of at least Options::min_blob_size bytes apart
+// from the tables, so that compactions do not copy them again and again.
+// Tables refer to such a value by a kTypeBlobIndex entry whose value is
+// the blob index of the record holding it.
+//
+// A blob file is written once, by a memtable flush or a compaction, and is
+// a sequence of records:
+//    checksum: fixed32      // masked crc32c of the rest of the record
+//    key_size: varint32
+//    value_size: varint64
+//    key: char[key_size]    // user key, for sanity checks
+//    value: char[value_size]
+//
+// A blob index is encoded as:
+//    file_number: varint64
+//    offset: varint64       // of the record in the file
+//    size: varint64         // of the record
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+class RandomAccessFile;
+class WritableFile;
+
+struct BlobIndex {
+  BlobIndex() : file_number(0), offset(0), size(0) {}
+
+  void EncodeTo(std::string* dst) const;
+  bool DecodeFrom(Slice input);
+
+  uint64_t file_number;
+  uint64_t offset;
+  uint64_t size;
+};
+
+// Writes the blob file "number" of a database.  The file is only created
+// once the first blob is added to it.
+class BlobFileBuilder {
+ public:
+  BlobFileBuilder(const std::string& dbname, const Options& options,
+                  uint64_t number);
+
+  BlobFileBuilder(const BlobFileBuilder&) = delete;
+  BlobFileBuilder& operator=(const BlobFileBuilder&) = delete;
+
+  // Abandons the file if Finish() has not been called.
+  ~BlobFileBuilder();
+
+  // Append the record for value "value" of "user_key" and store its blob
+  // index in *index.
+  Status Add(const Slice& user_key, const Slice& value, std::string* index);
+
+  // Sync and close the file, if any blob was added.
+  Status Finish();
+
+  // Remove the file, if any blob was added.
+  void Abandon();
+
+  uint64_t number() const { return number_; }
+
+  // Number and combined record size of the blobs added so far.
+  uint64_t NumBlobs() const { return num_blobs_; }
+  uint64_t BlobBytes() const { return offset_; }
+
+ private:
+  const std::string fname_;
+  const Options& options_;
+  const uint64_t number_;
+  WritableFile* file_;
+  uint64_t num_blobs_;
+  uint64_t offset_;
+  bool closed_;
+  std::string record_;
+};
+
+// Read the value of "user_key" stored in the record at "index" of "file"
+// into *value.
+Status ReadBlob(RandomAccessFile* file, const ReadOptions& options,
+                const Slice& user_key, const BlobIndex& index,
+                std::string* value);
+
+// Count the records of blob file "fname" and their combined size.
+Status ScanBlobFile(Env* env, const std::string& fname, uint64_t* num_blobs,
+                    uint64_t* blob_bytes);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
@@ -0,0 +1,73 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file_cache.h"
+
+#include "db/blob_file.h"
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static void DeleteEntry(const Slice& key, void* value) {
+  delete reinterpret_cast<RandomAccessFile*>(value);
+}
+
+BlobFileCache::BlobFileCache(const std::string& dbname,
+                             const Options& options, int entries)
+    : env_(options.env),
+      dbname_(dbname),
+      options_(options),
+      cache_(NewLRUCache(entries)) {}
+
+BlobFileCache::~BlobFileCache() { delete cache_; }
+
+Status BlobFileCache::FindFile(uint64_t file_number, Cache::Handle** handle) {
+  Status s;
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  Slice key(buf, sizeof(buf));
+  *handle = cache_->Lookup(key);
+  if (*handle == nullptr) {
+    const std::string fname = BlobFileName(dbname_, file_number);
+    RandomAccessFile* file = nullptr;
+    if (options_.use_direct_reads) {
+      s = env_->NewDirectRandomAccessFile(fname, &file);
+    } else {
+      s = env_->NewRandomAccessFile(fname, &file);
+    }
+    if (s.ok()) {
+      *handle = cache_->Insert(key, file, 1, &DeleteEntry);
+    }
+    // We do not cache error results so that if the error is transient,
+    // or somebody repairs the file, we recover automatically.
+  }
+  return s;
+}
+
+Status BlobFileCache::Get(const ReadOptions& options, const Slice& user_key,
+                          const Slice& blob_index, std::string* value) {
+  BlobIndex index;
+  if (!index.DecodeFrom(blob_index)) {
+    return Status::Corruption("bad blob index for", user_key);
+  }
+  Cache::Handle* handle = nullptr;
+  Status s = FindFile(index.file_number, &handle);
+  if (s.ok()) {
+    RandomAccessFile* file =
+        reinterpret_cast<RandomAccessFile*>(cache_->Value(handle));
+    s = ReadBlob(file, options, user_key, index, value);
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+void BlobFileCache::Evict(uint64_t file_number) {
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  cache_->Erase(Slice(buf, sizeof(buf)));
+}
+
+}  // namespace leveldb
@@ -0,0 +1,48 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Thread-safe (provides internal synchronization)
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_CACHE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_CACHE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/cache.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+
+// Keeps the blob files of a database open for reading.
+class BlobFileCache {
+ public:
+  BlobFileCache(const std::string& dbname, const Options& options,
+                int entries);
+  ~BlobFileCache();
+
+  // Read the value of "user_key" that blob index "blob_index" refers to
+  // into *value.
+  Status Get(const ReadOptions& options, const Slice& user_key,
+             const Slice& blob_index, std::string* value);
+
+  // Evict any entry for the specified file number
+  void Evict(uint64_t file_number);
+
+ private:
+  Status FindFile(uint64_t file_number, Cache::Handle**);
+
+  Env* const env_;
+  const std::string dbname_;
+  const Options& options_;
+  Cache* cache_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_CACHE_H_
@@ -4,43 +4,226 @@
 
 #include "db/builder.h"
 
+#include <algorithm>
+
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "leveldb/rate_limiter.h"
 
 namespace leveldb {
 
+namespace {
+
+// Passes writes on to a table file once the rate limiter grants them.
+class RateLimitedWritableFile : public WritableFile {
+ public:
+  // Takes ownership of "file".
+  RateLimitedWritableFile(WritableFile* file, RateLimiter* rate_limiter)
+      : file_(file), rate_limiter_(rate_limiter) {}
+
+  ~RateLimitedWritableFile() override { delete file_; }
+
+  Status Append(const Slice& data) override {
+    rate_limiter_->Request(data.size());
+    return file_->Append(data);
+  }
+  Status Close() override { return file_->Close(); }
+  Status Flush() override { return file_->Flush(); }
+  Status Sync() override { return file_->Sync(); }
+
+ private:
+  WritableFile* const file_;
+  RateLimiter* const rate_limiter_;
+};
+
+// Writes data back to disk every bytes_per_sync bytes.
+class IncrementalSyncWritableFile : public WritableFile {
+ public:
+  // Takes ownership of "file".
+  IncrementalSyncWritableFile(WritableFile* file, uint64_t bytes_per_sync)
+      : file_(file),
+        bytes_per_sync_(bytes_per_sync),
+        offset_(0),
+        synced_offset_(0) {}
+
+  ~IncrementalSyncWritableFile() override { delete file_; }
+
+  Status Append(const Slice& data) override {
+    Status s = file_->Append(data);
+    offset_ += data.size();
+    if (s.ok() && offset_ - synced_offset_ >= bytes_per_sync_) {
+      s = file_->Flush();
+      if (s.ok()) {
+        s = file_->RangeSync(synced_offset_, offset_ - synced_offset_);
+      }
+      if (s.ok()) {
+        synced_offset_ = offset_;
+      }
+    }
+    return s;
+  }
+  Status Close() override { return file_->Close(); }
+  Status Flush() override { return file_->Flush(); }
+  Status Sync() override {
+    Status s = file_->Sync();
+    if (s.ok()) {
+      synced_offset_ = offset_;
+    }
+    return s;
+  }
+  Status RangeSync(uint64_t offset, uint64_t nbytes) override {
+    return file_->RangeSync(offset, nbytes);
+  }
+  Status Preallocate(uint64_t size) override {
+    return file_->Preallocate(size);
+  }
+
+ private:
+  WritableFile* const file_;
+  const uint64_t bytes_per_sync_;
+  uint64_t offset_;         // Bytes appended so far
+  uint64_t synced_offset_;  // Bytes written back by RangeSync() or Sync()
+};
+
+}  // namespace
+
+// If options.bytes_per_sync is non-zero, replace "*file" by a file that
+// passes writes on to it and writes data back to disk every
+// options.bytes_per_sync bytes.  The new file owns the old one.
+static void MaybeSyncIncrementally(const Options& options,
+                                   WritableFile** file) {
+  if (options.bytes_per_sync > 0) {
+    *file = new IncrementalSyncWritableFile(*file, options.bytes_per_sync);
+  }
+}
+
+Status NewTableFileForWrite(Env* env, const Options& options,
+                            const std::string& fname, WritableFile** result) {
+  Status s;
+  if (options.use_direct_io_for_flush_and_compaction) {
+    s = env->NewDirectWritableFile(fname, result);
+  } else {
+    s = env->NewWritableFile(fname, result);
+    if (s.ok()) {
+      MaybeSyncIncrementally(options, result);
+    }
+  }
+  if (s.ok() && options.rate_limiter != nullptr) {
+    *result = new RateLimitedWritableFile(*result, options.rate_limiter);
+  }
+  return s;
+}
+
+TableTimestampTracker::TableTimestampTracker(const Options& options)
+    : tracking_(options.ttl_seconds > 0), newest_(0) {}
+
+void TableTimestampTracker::Add(const Slice& internal_key,
+                                const Slice& value) {
+  ParsedInternalKey ikey;
+  uint32_t timestamp;
+  if (tracking_ && ParseInternalKey(internal_key, &ikey) &&
+      ikey.type == kTypeValue && ExtractValueTimestamp(value, &timestamp)) {
+    newest_ = std::max(newest_, timestamp);
+  } else {
+    tracking_ = false;
+  }
+}
+
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, BlobFileBuilder* blobs,
+                  FileMetaData* meta) {
   Status s;
   meta->file_size = 0;
+  meta->oldest_blob_file = 0;
+  meta->num_entries = 0;
+  meta->num_deletions = 0;
   iter->SeekToFirst();
+  range_del_iter->SeekToFirst();
 
   std::string fname = TableFileName(dbname, meta->number);
-  if (iter->Valid()) {
+  if (iter->Valid() || range_del_iter->Valid()) {
     WritableFile* file;
-    s = env->NewWritableFile(fname, &file);
+    s = NewTableFileForWrite(env, options, fname, &file);
     if (!s.ok()) {
       return s;
     }
 
     TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
+    TableTimestampTracker timestamps(options);
+    bool empty = !iter->Valid();
+    bool first = true;
     Slice key;
+    std::string blob_key, blob_index;
+    ParsedInternalKey ikey;
+    uint64_t num_deletions = 0;
     for (; iter->Valid(); iter->Next()) {
       key = iter->key();
-      builder->Add(key, iter->value());
+      const bool parsed = ParseInternalKey(key, &ikey);
+      if (parsed && ikey.type == kTypeDeletion) {
+        num_deletions++;
+      }
+      if (blobs != nullptr && iter->value().size() >= options.min_blob_size &&
+          parsed && ikey.type == kTypeValue) {
+        s = blobs->Add(ikey.user_key, iter->value(), &blob_index);
+        if (!s.ok()) {
+          break;
+        }
+        blob_key.clear();
+        AppendInternalKey(&blob_key, ParsedInternalKey(ikey.user_key,
+                                                       ikey.sequence,
+                                                       kTypeBlobIndex));
+        key = blob_key;
+        builder->Add(key, blob_index);
+      } else {
+        builder->Add(key, iter->value());
+        timestamps.Add(key, iter->value());
+      }
+      if (first) {
+        meta->smallest.DecodeFrom(key);
+        first = false;
+      }
     }
     if (!key.empty()) {
       meta->largest.DecodeFrom(key);
     }
 
-    // Finish and check for builder errors
-    s = builder->Finish();
+    // Range deletions widen the key range of the table.
+    for (; range_del_iter->Valid(); range_del_iter->Next()) {
+      builder->AddRangeTombstone(range_del_iter->key(),
+                                 range_del_iter->value());
+      timestamps.AddRangeTombstone();
+      AddTombstoneToFileRange(options.comparator, range_del_iter->key(),
+                              range_del_iter->value(), &empty,
+                              &meta->smallest, &meta->largest);
+    }
+    meta->has_range_deletions = builder->NumRangeTombstones() > 0;
+    if (options.deletion_compaction_ratio > 0) {
+      meta->num_entries = builder->NumEntries();
+      meta->num_deletions = num_deletions;
+    }
+    meta->newest_timestamp = timestamps.NewestTimestamp();
+    if (blobs != nullptr && blobs->NumBlobs() > 0) {
+      meta->oldest_blob_file = blobs->number();
+    }
+
+    // Finish and check for builder errors.  The blob file must be durable
+    // before the table referring to it.
+    if (s.ok() && meta->oldest_blob_file != 0) {
+      s = blobs->Finish();
+    }
+    if (s.ok()) {
+      s = builder->Finish();
+    } else {
+      builder->Abandon();
+    }
     if (s.ok()) {
       meta->file_size = builder->FileSize();
       assert(meta->file_size > 0);
@@ -69,6 +252,8 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
   // Check for input iterator errors
   if (!iter->status().ok()) {
     s = iter->status();
+  } else if (!range_del_iter->status().ok()) {
+    s = range_del_iter->status();
   }
 
   if (s.ok() && meta->file_size > 0) {
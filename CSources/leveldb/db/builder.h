@@ -5,6 +5,8 @@
 #ifndef STORAGE_LEVELDB_DB_BUILDER_H_
 #define STORAGE_LEVELDB_DB_BUILDER_H_
 
+#include <cstdint>
+
 #include "leveldb/status.h"
 
 namespace leveldb {
@@ -12,18 +14,54 @@ namespace leveldb {
 struct Options;
 struct FileMetaData;
 
+class BlobFileBuilder;
 class Env;
 class Iterator;
+class Slice;
 class TableCache;
 class VersionEdit;
+class WritableFile;
+
+// Create the file for a table written by a memtable flush or a compaction.
+// Honors options.use_direct_io_for_flush_and_compaction and
+// options.bytes_per_sync, and if options.rate_limiter is set, every write
+// to the returned file first requests tokens from it.
+Status NewTableFileForWrite(Env* env, const Options& options,
+                            const std::string& fname, WritableFile** result);
+
+// Computes FileMetaData::newest_timestamp for the entries added to a
+// table.
+class TableTimestampTracker {
+ public:
+  TableTimestampTracker() : tracking_(false), newest_(0) {}
+  explicit TableTimestampTracker(const Options& options);
+
+  // Entry "internal_key" => "value" was added to the table.
+  void Add(const Slice& internal_key, const Slice& value);
+
+  // A range deletion was added to the table.
+  void AddRangeTombstone() { tracking_ = false; }
+
+  uint32_t NewestTimestamp() const { return tracking_ ? newest_ : 0; }
+
+ private:
+  bool tracking_;  // Only values so far?
+  uint32_t newest_;
+};
 
-// Build a Table file from the contents of *iter.  The generated file
-// will be named according to meta->number.  On success, the rest of
-// *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// Build a Table file from the contents of *iter and the range deletions
+// yielded by *range_del_iter.  The generated file will be named according
+// to meta->number.  On success, the rest of *meta will be filled with
+// metadata about the generated table.  If no data is present in *iter and
+// *range_del_iter, meta->file_size will be set to zero, and no Table file
+// will be produced.
+//
+// If "blobs" is non-null, values of at least options.min_blob_size bytes
+// are moved to it, and it is finished along with the table.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, BlobFileBuilder* blobs,
+                  FileMetaData* meta);
 
 }  // namespace leveldb
 
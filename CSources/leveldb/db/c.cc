@@ -16,10 +16,12 @@
 #include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/rate_limiter.h"
 #include "leveldb/status.h"
 #include "leveldb/write_batch.h"
 
 using leveldb::Cache;
+using leveldb::ChecksumType;
 using leveldb::Comparator;
 using leveldb::CompressionType;
 using leveldb::DB;
@@ -34,6 +36,7 @@ using leveldb::NewBloomFilterPolicy;
 using leveldb::NewLRUCache;
 using leveldb::Options;
 using leveldb::RandomAccessFile;
+using leveldb::RateLimiter;
 using leveldb::Range;
 using leveldb::ReadOptions;
 using leveldb::SequentialFile;
@@ -70,6 +73,9 @@ struct leveldb_options_t {
 struct leveldb_cache_t {
   Cache* rep;
 };
+struct leveldb_ratelimiter_t {
+  RateLimiter* rep;
+};
 struct leveldb_seqfile_t {
   SequentialFile* rep;
 };
@@ -414,6 +420,11 @@ void leveldb_options_set_cache(leveldb_options_t* opt, leveldb_cache_t* c) {
   opt->rep.block_cache = c->rep;
 }
 
+void leveldb_options_set_rate_limiter(leveldb_options_t* opt,
+                                      leveldb_ratelimiter_t* r) {
+  opt->rep.rate_limiter = (r ? r->rep : nullptr);
+}
+
 void leveldb_options_set_block_size(leveldb_options_t* opt, size_t s) {
   opt->rep.block_size = s;
 }
@@ -426,10 +437,71 @@ void leveldb_options_set_max_file_size(leveldb_options_t* opt, size_t s) {
   opt->rep.max_file_size = s;
 }
 
+void leveldb_options_set_max_manifest_file_size(leveldb_options_t* opt,
+                                                size_t s) {
+  opt->rep.max_manifest_file_size = s;
+}
+
 void leveldb_options_set_compression(leveldb_options_t* opt, int t) {
   opt->rep.compression = static_cast<CompressionType>(t);
 }
 
+void leveldb_options_set_wal_compression(leveldb_options_t* opt, int t) {
+  opt->rep.wal_compression = static_cast<CompressionType>(t);
+}
+
+void leveldb_options_set_checksum_type(leveldb_options_t* opt, int t) {
+  opt->rep.checksum_type = static_cast<ChecksumType>(t);
+}
+
+void leveldb_options_set_avoid_flush_during_recovery(leveldb_options_t* opt,
+                                                    uint8_t v) {
+  opt->rep.avoid_flush_during_recovery = v;
+}
+
+void leveldb_options_set_recycle_log_file_num(leveldb_options_t* opt,
+                                              size_t n) {
+  opt->rep.recycle_log_file_num = n;
+}
+
+void leveldb_options_set_bytes_per_sync(leveldb_options_t* opt, size_t n) {
+  opt->rep.bytes_per_sync = n;
+}
+
+void leveldb_options_set_preload_tables_on_open(leveldb_options_t* opt,
+                                               uint8_t v) {
+  opt->rep.preload_tables_on_open = v;
+}
+
+void leveldb_options_set_preload_table_threads(leveldb_options_t* opt,
+                                               int n) {
+  opt->rep.preload_table_threads = n;
+}
+
+void leveldb_options_set_max_write_group_bytes(leveldb_options_t* opt,
+                                               size_t s) {
+  opt->rep.max_write_group_bytes = s;
+}
+
+void leveldb_options_set_sync_write_group_wait_micros(leveldb_options_t* opt,
+                                                      uint64_t micros) {
+  opt->rep.sync_write_group_wait_micros = micros;
+}
+
+void leveldb_options_set_compaction_readahead_size(leveldb_options_t* opt,
+                                                   size_t s) {
+  opt->rep.compaction_readahead_size = s;
+}
+
+void leveldb_options_set_use_direct_reads(leveldb_options_t* opt, uint8_t v) {
+  opt->rep.use_direct_reads = v;
+}
+
+void leveldb_options_set_use_direct_io_for_flush_and_compaction(
+    leveldb_options_t* opt, uint8_t v) {
+  opt->rep.use_direct_io_for_flush_and_compaction = v;
+}
+
 leveldb_comparator_t* leveldb_comparator_create(
     void* state, void (*destructor)(void*),
     int (*compare)(void*, const char* a, size_t alen, const char* b,
@@ -511,6 +583,11 @@ void leveldb_readoptions_set_snapshot(leveldb_readoptions_t* opt,
   opt->rep.snapshot = (snap ? snap->rep : nullptr);
 }
 
+void leveldb_readoptions_set_readahead_size(leveldb_readoptions_t* opt,
+                                            size_t s) {
+  opt->rep.readahead_size = s;
+}
+
 leveldb_writeoptions_t* leveldb_writeoptions_create() {
   return new leveldb_writeoptions_t;
 }
@@ -532,6 +609,23 @@ void leveldb_cache_destroy(leveldb_cache_t* cache) {
   delete cache;
 }
 
+leveldb_ratelimiter_t* leveldb_ratelimiter_create_generic(
+    int64_t bytes_per_second, uint8_t auto_tuned) {
+  leveldb_ratelimiter_t* r = new leveldb_ratelimiter_t;
+  r->rep = leveldb::NewGenericRateLimiter(bytes_per_second, auto_tuned);
+  return r;
+}
+
+void leveldb_ratelimiter_destroy(leveldb_ratelimiter_t* r) {
+  delete r->rep;
+  delete r;
+}
+
+uint64_t leveldb_ratelimiter_get_total_throttled_micros(
+    leveldb_ratelimiter_t* r) {
+  return r->rep->GetTotalThrottledMicros();
+}
+
 leveldb_env_t* leveldb_create_default_env() {
   leveldb_env_t* result = new leveldb_env_t;
   result->rep = Env::Default();
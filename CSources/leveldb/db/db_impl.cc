@@ -10,8 +10,12 @@
 #include <cstdio>
 #include <set>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "db/blob_file.h"
+#include "db/blob_file_cache.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -19,11 +23,16 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/merge_helper.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/merge_operator.h"
+#include "leveldb/rate_limiter.h"
 #include "leveldb/status.h"
 #include "leveldb/table.h"
 #include "leveldb/table_builder.h"
@@ -42,13 +51,28 @@ const int kNumNonTableCacheFiles = 10;
 // Information kept for every waiting writer
 struct DBImpl::Writer {
   explicit Writer(port::Mutex* mu)
-      : batch(nullptr), sync(false), done(false), cv(mu) {}
+      : batch(nullptr),
+        sync(false),
+        done(false),
+        exclusive(false),
+        cv(mu),
+        callback(nullptr),
+        callback_arg(nullptr) {}
 
   Status status;
   WriteBatch* batch;
   bool sync;
   bool done;
+  bool exclusive;  // Must lead the write queue by itself
   port::CondVar cv;
+
+  // Set for writers queued by WriteAsync().  No thread waits for them, so
+  // they are committed by the async writer thread, or by a thread in
+  // Write() whose group they join, and deleted once their callback has
+  // been called.
+  WriteCallback callback;
+  void* callback_arg;
+  WriteBatch async_batch;  // Copy of the caller's updates
 };
 
 struct DBImpl::CompactionState {
@@ -57,6 +81,19 @@ struct DBImpl::CompactionState {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    bool has_range_deletions;
+    TableTimestampTracker timestamps;
+    uint64_t oldest_blob_file;
+    uint64_t num_entries;
+    uint64_t num_deletions;
+  };
+
+  // References to the blobs of a blob file
+  struct BlobRefs {
+    BlobRefs() : count(0), bytes(0) {}
+
+    uint64_t count;
+    uint64_t bytes;  // Combined record size
   };
 
   Output* current_output() { return &outputs[outputs.size() - 1]; }
@@ -64,10 +101,37 @@ struct DBImpl::CompactionState {
   explicit CompactionState(Compaction* c)
       : compaction(c),
         smallest_snapshot(0),
+        newest_snapshot(0),
+        range_del(nullptr),
+        has_output_lower_bound(false),
         outfile(nullptr),
         builder(nullptr),
+        blobs(nullptr),
+        reserved_output_number(0),
         total_bytes(0) {}
 
+  ~CompactionState() {
+    delete range_del;
+    delete blobs;
+  }
+
+  // Count a reference to blob index "blob_index" by an input entry, or
+  // release one for an output entry that keeps it.  The blobs that are
+  // left referenced have become garbage.
+  void CountBlob(const Slice& blob_index, bool input) {
+    BlobIndex index;
+    if (index.DecodeFrom(blob_index)) {
+      BlobRefs* refs = &blob_refs[index.file_number];
+      if (input) {
+        refs->count++;
+        refs->bytes += index.size;
+      } else {
+        refs->count--;
+        refs->bytes -= index.size;
+      }
+    }
+  }
+
   Compaction* const compaction;
 
   // Sequence numbers < smallest_snapshot are not significant since we
@@ -76,12 +140,39 @@ struct DBImpl::CompactionState {
   // we can drop all entries for the same key with sequence numbers < S.
   SequenceNumber smallest_snapshot;
 
+  // Sequence number of the newest snapshot, or zero if there is none.  No
+  // snapshot reads entries with larger sequence numbers, so the compaction
+  // filter may change them.
+  SequenceNumber newest_snapshot;
+
+  // The range tombstones of the inputs that every snapshot sees.  The
+  // entries they cover are dropped.
+  RangeDelAggregator* range_del;
+
+  // The range tombstones of the inputs that are carried over to the
+  // outputs, sorted by start key.  Each output stores their pieces between
+  // its own first user key and that of the next output.
+  std::vector<RangeTombstone> range_tombstones;
+  std::string output_lower_bound;
+  bool has_output_lower_bound;  // False for the first output
+
   std::vector<Output> outputs;
 
   // State kept for output being generated
   WritableFile* outfile;
   TableBuilder* builder;
 
+  // Blob file for the large values of all outputs, created on demand
+  BlobFileBuilder* blobs;
+  std::map<uint64_t, BlobRefs> blob_refs;
+  std::string blob_key;    // Scratch space for rewritten keys
+  std::string blob_value;  // Scratch space for blobs read back
+  std::string blob_index;  // Scratch space for new blob indexes
+
+  // File number set aside for the output of a compaction into level 0,
+  // or zero.
+  uint64_t reserved_output_number;
+
   uint64_t total_bytes;
 };
 
@@ -102,6 +193,11 @@ Options SanitizeOptions(const std::string& dbname,
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+  ClipToRange(&result.preload_table_threads, 1, 64);
+  ClipToRange(&result.max_write_group_bytes, 64 << 10, 64 << 20);
+  ClipToRange(&result.max_pending_async_writes, 1, 1 << 20);
+  ClipToRange(&result.tiered_size_ratio, 0, 1000);
+  ClipToRange(&result.tiered_max_size_amplification_percent, 1, 100000);
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -118,9 +214,22 @@ Options SanitizeOptions(const std::string& dbname,
   return result;
 }
 
+static int BlobFileCacheSize(const Options& sanitized_options) {
+  // Blob files are only read for large values, so an eighth of the files
+  // is plenty.  Without new blobs only older blob files may be left.
+  if (sanitized_options.min_blob_size == 0) {
+    return kNumNonTableCacheFiles;
+  }
+  return (sanitized_options.max_open_files - kNumNonTableCacheFiles) / 8;
+}
+
 static int TableCacheSize(const Options& sanitized_options) {
   // Reserve ten files or so for other uses and give the rest to TableCache.
-  return sanitized_options.max_open_files - kNumNonTableCacheFiles;
+  int size = sanitized_options.max_open_files - kNumNonTableCacheFiles;
+  if (sanitized_options.min_blob_size != 0) {
+    size -= BlobFileCacheSize(sanitized_options);
+  }
+  return size;
 }
 
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
@@ -133,6 +242,8 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
       table_cache_(new TableCache(dbname_, options_, TableCacheSize(options_))),
+      blob_cache_(
+          new BlobFileCache(dbname_, options_, BlobFileCacheSize(options_))),
       db_lock_(nullptr),
       shutting_down_(false),
       background_work_finished_signal_(&mutex_),
@@ -143,15 +254,30 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       logfile_number_(0),
       log_(nullptr),
       seed_(0),
+      first_recyclable_log_(0),
+      pending_async_writes_(0),
+      async_writes_cv_(&mutex_),
+      async_writer_running_(false),
+      stop_async_writer_(false),
+      last_sync_group_size_(0),
       tmp_batch_(new WriteBatch),
       background_compaction_scheduled_(false),
+      ingesting_files_(false),
       manual_compaction_(nullptr),
-      versions_(new VersionSet(dbname_, &options_, table_cache_,
+      versions_(new VersionSet(dbname_, &options_, table_cache_, blob_cache_,
                                &internal_comparator_)) {}
 
 DBImpl::~DBImpl() {
-  // Wait for background work to finish.
   mutex_.Lock();
+  // Commit the writes still queued by WriteAsync() and call their callbacks
+  // while compactions can still make room for them.
+  stop_async_writer_ = true;
+  async_writes_cv_.SignalAll();
+  while (async_writer_running_) {
+    async_writes_cv_.Wait();
+  }
+
+  // Wait for background work to finish.
   shutting_down_.store(true, std::memory_order_release);
   while (background_compaction_scheduled_) {
     background_work_finished_signal_.Wait();
@@ -169,6 +295,7 @@ DBImpl::~DBImpl() {
   delete log_;
   delete logfile_;
   delete table_cache_;
+  delete blob_cache_;
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -181,6 +308,9 @@ DBImpl::~DBImpl() {
 Status DBImpl::NewDB() {
   VersionEdit new_db;
   new_db.SetComparatorName(user_comparator()->Name());
+  if (options_.ttl_seconds > 0) {
+    new_db.SetTimestampedValues();
+  }
   new_db.SetLogNumber(0);
   new_db.SetNextFile(2);
   new_db.SetLastSequence(0);
@@ -246,7 +376,17 @@ void DBImpl::RemoveObsoleteFiles() {
       switch (type) {
         case kLogFile:
           keep = ((number >= versions_->LogNumber()) ||
-                  (number == versions_->PrevLogNumber()));
+                  (number == versions_->PrevLogNumber()) ||
+                  (std::find(recycled_logs_.begin(), recycled_logs_.end(),
+                             number) != recycled_logs_.end()));
+          if (!keep && first_recyclable_log_ != 0 &&
+              number >= first_recyclable_log_ &&
+              recycled_logs_.size() < options_.recycle_log_file_num) {
+            Log(options_.info_log, "Recycle log #%llu\n",
+                static_cast<unsigned long long>(number));
+            recycled_logs_.push_back(number);
+            keep = true;
+          }
           break;
         case kDescriptorFile:
           // Keep my manifest file, and any newer incarnations'
@@ -254,6 +394,7 @@ void DBImpl::RemoveObsoleteFiles() {
           keep = (number >= versions_->ManifestFileNumber());
           break;
         case kTableFile:
+        case kBlobFile:
           keep = (live.find(number) != live.end());
           break;
         case kTempFile:
@@ -272,6 +413,8 @@ void DBImpl::RemoveObsoleteFiles() {
         files_to_delete.push_back(std::move(filename));
         if (type == kTableFile) {
           table_cache_->Evict(number);
+        } else if (type == kBlobFile) {
+          blob_cache_->Evict(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n", static_cast<int>(type),
             static_cast<unsigned long long>(number));
@@ -292,6 +435,15 @@ void DBImpl::RemoveObsoleteFiles() {
 Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
   mutex_.AssertHeld();
 
+  if (options_.ttl_seconds > 0 && options_.merge_operator != nullptr) {
+    return Status::InvalidArgument(
+        dbname_, "ttl_seconds cannot be combined with a merge operator");
+  }
+  if (options_.ttl_seconds > 0 && options_.min_blob_size > 0) {
+    return Status::InvalidArgument(
+        dbname_, "ttl_seconds cannot be combined with min_blob_size");
+  }
+
   // Ignore error from CreateDir since the creation of the DB is
   // committed only when the descriptor is created, and this directory
   // may already exist from a previous failed creation attempt.
@@ -362,17 +514,9 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
 
   // Recover in the order in which the logs were generated
   std::sort(logs.begin(), logs.end());
-  for (size_t i = 0; i < logs.size(); i++) {
-    s = RecoverLogFile(logs[i], (i == logs.size() - 1), save_manifest, edit,
-                       &max_sequence);
-    if (!s.ok()) {
-      return s;
-    }
-
-    // The previous incarnation may not have written any MANIFEST
-    // records after allocating this log number.  So we manually
-    // update the file number allocation counter in VersionSet.
-    versions_->MarkFileNumberUsed(logs[i]);
+  s = RecoverLogFiles(logs, save_manifest, edit, &max_sequence);
+  if (!s.ok()) {
+    return s;
   }
 
   if (versions_->LastSequence() < max_sequence) {
@@ -382,126 +526,478 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
   return Status::OK();
 }
 
-Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
-                              bool* save_manifest, VersionEdit* edit,
-                              SequenceNumber* max_sequence) {
-  struct LogReporter : public log::Reader::Reporter {
-    Env* env;
-    Logger* info_log;
-    const char* fname;
-    Status* status;  // null if options_.paranoid_checks==false
-    void Corruption(size_t bytes, const Status& s) override {
-      Log(info_log, "%s%s: dropping %d bytes; %s",
-          (this->status == nullptr ? "(ignoring error) " : ""), fname,
-          static_cast<int>(bytes), s.ToString().c_str());
-      if (this->status != nullptr && this->status->ok()) *this->status = s;
-    }
-  };
+namespace {
 
-  mutex_.AssertHeld();
+// Number of threads that read and decode log files during recovery.
+constexpr const size_t kMaxLogReaderThreads = 4;
+
+// Recovery holds the decoded records of at most this many times
+// write_buffer_size bytes of log files, or of a single log file if that is
+// larger.
+constexpr const size_t kLogReadAheadBuffers = 4;
+
+struct LogReporter : public log::Reader::Reporter {
+  Logger* info_log;
+  const char* fname;
+  Status* status;  // null if options_.paranoid_checks==false
+  void Corruption(size_t bytes, const Status& s) override {
+    Log(info_log, "%s%s: dropping %d bytes; %s",
+        (this->status == nullptr ? "(ignoring error) " : ""), fname,
+        static_cast<int>(bytes), s.ToString().c_str());
+    if (this->status != nullptr && this->status->ok()) *this->status = s;
+  }
+};
+
+// A log file read, checksummed and split into records by a reader thread.
+struct RecoveredLog {
+  uint64_t number;
+  std::string fname;
+  uint64_t file_size;  // Bounds the size of the decoded records.
+  bool opened;    // False if the file could not be opened.
+  bool done;      // Set once the reader thread has finished with the file.
+  Status status;  // Open error, or corruption if paranoid_checks is set.
+
+  // Record i is data[record_ends[i - 1], record_ends[i]).
+  std::string data;
+  std::vector<size_t> record_ends;
+};
 
-  // Open the log file
-  std::string fname = LogFileName(dbname_, log_number);
+// State shared between DBImpl::RecoverLogFiles() and its reader threads.
+struct LogReaderState {
+  LogReaderState(Env* env, Logger* info_log, bool paranoid_checks,
+                 uint64_t max_buffered_bytes)
+      : env(env),
+        info_log(info_log),
+        paranoid_checks(paranoid_checks),
+        max_buffered_bytes(max_buffered_bytes),
+        cv(&mu),
+        next_to_read(0),
+        next_to_replay(0),
+        buffered_bytes(0),
+        running_threads(0),
+        stop(false) {}
+
+  Env* const env;
+  Logger* const info_log;
+  const bool paranoid_checks;
+  const uint64_t max_buffered_bytes;
+
+  port::Mutex mu;
+  port::CondVar cv;  // Signalled whenever any of the fields below changes.
+
+  // A reader thread owns the log it claimed until it sets its done field
+  // under mu.
+  std::vector<RecoveredLog> logs;
+  size_t next_to_read GUARDED_BY(mu);    // Next log a reader should claim.
+  size_t next_to_replay GUARDED_BY(mu);  // Log after the one being replayed.
+  // Combined file size of the logs claimed by a reader whose records have
+  // not been released by the replay yet.
+  uint64_t buffered_bytes GUARDED_BY(mu);
+  int running_threads GUARDED_BY(mu);
+  bool stop GUARDED_BY(mu);  // Set when replay ends early.
+};
+
+void ReadLogFile(LogReaderState* state, RecoveredLog* log) {
   SequentialFile* file;
-  Status status = env_->NewSequentialFile(fname, &file);
-  if (!status.ok()) {
-    MaybeIgnoreError(&status);
-    return status;
+  log->status = state->env->NewSequentialFile(log->fname, &file);
+  log->opened = log->status.ok();
+  if (!log->opened) {
+    return;
   }
 
-  // Create the log reader.
   LogReporter reporter;
-  reporter.env = env_;
-  reporter.info_log = options_.info_log;
-  reporter.fname = fname.c_str();
-  reporter.status = (options_.paranoid_checks ? &status : nullptr);
+  reporter.info_log = state->info_log;
+  reporter.fname = log->fname.c_str();
+  reporter.status = (state->paranoid_checks ? &log->status : nullptr);
   // We intentionally make log::Reader do checksumming even if
   // paranoid_checks==false so that corruptions cause entire commits
   // to be skipped instead of propagating bad information (like overly
   // large sequence numbers).
-  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/);
-  Log(options_.info_log, "Recovering log #%llu",
-      (unsigned long long)log_number);
+  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/,
+                     log->number);
+  Log(state->info_log, "Recovering log #%llu",
+      (unsigned long long)log->number);
 
-  // Read all the records and add to a memtable
   std::string scratch;
   Slice record;
-  WriteBatch batch;
-  int compactions = 0;
-  MemTable* mem = nullptr;
-  while (reader.ReadRecord(&record, &scratch) && status.ok()) {
+  while (reader.ReadRecord(&record, &scratch) && log->status.ok()) {
     if (record.size() < 12) {
       reporter.Corruption(record.size(),
                           Status::Corruption("log record too small"));
       continue;
     }
-    WriteBatchInternal::SetContents(&batch, record);
+    log->data.append(record.data(), record.size());
+    log->record_ends.push_back(log->data.size());
+  }
+  delete file;
+}
 
-    if (mem == nullptr) {
-      mem = new MemTable(internal_comparator_);
-      mem->Ref();
+void LogReaderThread(void* arg) {
+  LogReaderState* state = reinterpret_cast<LogReaderState*>(arg);
+  MutexLock l(&state->mu);
+  while (true) {
+    // The next log may be read if no other log is buffered, since the
+    // replay waits for it otherwise.
+    while (!state->stop && state->next_to_read < state->logs.size() &&
+           state->buffered_bytes > 0 &&
+           state->buffered_bytes + state->logs[state->next_to_read].file_size >
+               state->max_buffered_bytes) {
+      state->cv.Wait();
     }
-    status = WriteBatchInternal::InsertInto(&batch, mem);
-    MaybeIgnoreError(&status);
-    if (!status.ok()) {
+    if (state->stop || state->next_to_read == state->logs.size()) {
       break;
     }
-    const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
-                                    WriteBatchInternal::Count(&batch) - 1;
-    if (last_seq > *max_sequence) {
-      *max_sequence = last_seq;
+    RecoveredLog* log = &state->logs[state->next_to_read++];
+    state->buffered_bytes += log->file_size;
+    state->mu.Unlock();
+    ReadLogFile(state, log);
+    state->mu.Lock();
+    log->done = true;
+    state->cv.SignalAll();
+  }
+  state->running_threads--;
+  state->cv.SignalAll();
+}
+
+}  // namespace
+
+// Memtable that recovery writes to a level-0 table in the background while
+// it keeps replaying the logs.
+struct DBImpl::RecoveryFlush {
+  explicit RecoveryFlush(DBImpl* db, VersionEdit* edit)
+      : db(db), edit(edit), cv(&db->mutex_), mem(nullptr), running(false) {}
+
+  DBImpl* const db;
+  VersionEdit* const edit;
+  port::CondVar cv;  // Signalled when a flush finishes.
+  MemTable* mem;     // Being flushed if running is true.
+  bool running;
+  Status status;  // First error of any flush.
+};
+
+void DBImpl::BGRecoveryFlush(void* arg) {
+  RecoveryFlush* flush = reinterpret_cast<RecoveryFlush*>(arg);
+  DBImpl* db = flush->db;
+  MutexLock l(&db->mutex_);
+  Status s = db->WriteLevel0Table(flush->mem, flush->edit, nullptr);
+  flush->mem->Unref();
+  flush->mem = nullptr;
+  if (flush->status.ok()) {
+    flush->status = s;
+  }
+  flush->running = false;
+  flush->cv.SignalAll();
+}
+
+Status DBImpl::WaitForRecoveryFlush(RecoveryFlush* flush) {
+  mutex_.AssertHeld();
+  while (flush->running) {
+    flush->cv.Wait();
+  }
+  return flush->status;
+}
+
+Status DBImpl::StartRecoveryFlush(RecoveryFlush* flush, MemTable* mem) {
+  mutex_.AssertHeld();
+  Status s = WaitForRecoveryFlush(flush);
+  if (!s.ok()) {
+    mem->Unref();
+    return s;
+  }
+  flush->mem = mem;
+  flush->running = true;
+  env_->StartThread(&DBImpl::BGRecoveryFlush, flush);
+  return Status::OK();
+}
+
+Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& logs,
+                               bool* save_manifest, VersionEdit* edit,
+                               SequenceNumber* max_sequence) {
+  mutex_.AssertHeld();
+
+  // The previous incarnation may not have written any MANIFEST
+  // records after allocating these log numbers.  So we manually
+  // update the file number allocation counter in VersionSet before
+  // any table file is created.
+  for (uint64_t log_number : logs) {
+    versions_->MarkFileNumberUsed(log_number);
+  }
+
+  // Reader threads read, checksum and split logs ahead of the replay, as
+  // long as the logs they hold fit in kLogReadAheadBuffers memtables.  The
+  // records are inserted here, in log order, so memtables see them in
+  // sequence number order.  Full memtables are written to level-0 tables by
+  // another thread while replay continues.
+  LogReaderState readers(env_, options_.info_log, options_.paranoid_checks,
+                         kLogReadAheadBuffers * options_.write_buffer_size);
+  readers.logs.resize(logs.size());
+  for (size_t i = 0; i < logs.size(); i++) {
+    readers.logs[i].number = logs[i];
+    readers.logs[i].fname = LogFileName(dbname_, logs[i]);
+    if (!env_->GetFileSize(readers.logs[i].fname, &readers.logs[i].file_size)
+             .ok()) {
+      readers.logs[i].file_size = 0;  // Reported when it is opened.
+    }
+    readers.logs[i].opened = false;
+    readers.logs[i].done = false;
+  }
+  const int num_readers =
+      static_cast<int>(std::min(logs.size(), kMaxLogReaderThreads));
+  readers.running_threads = num_readers;
+  for (int i = 0; i < num_readers; i++) {
+    env_->StartThread(&LogReaderThread, &readers);
+  }
+
+  RecoveryFlush flush(this, edit);
+  Status status;
+  MemTable* mem = nullptr;
+  uint64_t mem_log_number = 0;  // The log mem was created for.
+  for (size_t i = 0; i < logs.size() && status.ok(); i++) {
+    const bool last_log = (i == logs.size() - 1);
+    RecoveredLog* log = &readers.logs[i];
+
+    // No one else can access the DB during recovery, so the records can be
+    // inserted without holding mutex_.  Releasing it lets the flush thread
+    // make progress.
+    mutex_.Unlock();
+    readers.mu.Lock();
+    while (!log->done) {
+      readers.cv.Wait();
+    }
+    readers.next_to_replay = i + 1;
+    readers.cv.SignalAll();
+    readers.mu.Unlock();
+
+    if (!log->opened) {
+      readers.mu.Lock();
+      readers.buffered_bytes -= log->file_size;
+      readers.cv.SignalAll();
+      readers.mu.Unlock();
+      mutex_.Lock();
+      status = log->status;
+      MaybeIgnoreError(&status);
+      continue;
     }
 
-    if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
-      compactions++;
-      *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
-      mem->Unref();
-      mem = nullptr;
+    WriteBatch batch;
+    int compactions = 0;
+    size_t record_start = 0;
+    for (size_t end : log->record_ends) {
+      WriteBatchInternal::SetContents(
+          &batch, Slice(log->data.data() + record_start, end - record_start));
+      record_start = end;
+
+      if (mem == nullptr) {
+        mem = new MemTable(internal_comparator_);
+        mem->Ref();
+        mem_log_number = log->number;
+      }
+      status = WriteBatchInternal::InsertInto(&batch, mem);
+      MaybeIgnoreError(&status);
       if (!status.ok()) {
-        // Reflect errors immediately so that conditions like full
-        // file-systems cause the DB::Open() to fail.
         break;
       }
+      const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
+                                      WriteBatchInternal::Count(&batch) - 1;
+      if (last_seq > *max_sequence) {
+        *max_sequence = last_seq;
+      }
+
+      if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
+        compactions++;
+        *save_manifest = true;
+        mutex_.Lock();
+        status = StartRecoveryFlush(&flush, mem);
+        mutex_.Unlock();
+        mem = nullptr;
+        if (!status.ok()) {
+          // Reflect errors immediately so that conditions like full
+          // file-systems cause the DB::Open() to fail.
+          break;
+        }
+      }
+    }
+    if (status.ok()) {
+      status = log->status;
     }
-  }
 
-  delete file;
+    // Release the decoded records, which lets the readers move on.
+    std::string().swap(log->data);
+    std::vector<size_t>().swap(log->record_ends);
+    readers.mu.Lock();
+    readers.buffered_bytes -= log->file_size;
+    readers.cv.SignalAll();
+    readers.mu.Unlock();
+    mutex_.Lock();
 
-  // See if we should keep reusing the last log file.
-  if (status.ok() && options_.reuse_logs && last_log && compactions == 0) {
-    assert(logfile_ == nullptr);
-    assert(log_ == nullptr);
-    assert(mem_ == nullptr);
-    uint64_t lfile_size;
-    if (env_->GetFileSize(fname, &lfile_size).ok() &&
-        env_->NewAppendableFile(fname, &logfile_).ok()) {
-      Log(options_.info_log, "Reusing old log %s \n", fname.c_str());
-      log_ = new log::Writer(logfile_, lfile_size);
-      logfile_number_ = log_number;
-      if (mem != nullptr) {
-        mem_ = mem;
-        mem = nullptr;
+    // See if we should keep reusing the last log file.
+    if (status.ok() && options_.reuse_logs &&
+        options_.recycle_log_file_num == 0 && last_log && compactions == 0 &&
+        (mem == nullptr || mem_log_number == log->number)) {
+      assert(logfile_ == nullptr);
+      assert(log_ == nullptr);
+      assert(mem_ == nullptr);
+      uint64_t lfile_size;
+      if (env_->GetFileSize(log->fname, &lfile_size).ok() &&
+          env_->NewAppendableFile(log->fname, &logfile_).ok()) {
+        Log(options_.info_log, "Reusing old log %s \n", log->fname.c_str());
+        log_ = new log::Writer(logfile_, lfile_size);
+        logfile_number_ = log->number;
+        if (mem != nullptr) {
+          mem_ = mem;
+          mem = nullptr;
+        } else {
+          // mem can be nullptr if lognum exists but was empty.
+          mem_ = new MemTable(internal_comparator_);
+          mem_->Ref();
+        }
+      }
+    }
+
+    if (mem != nullptr && status.ok() &&
+        options_.avoid_flush_during_recovery &&
+        mem_log_number >= versions_->LogNumber()) {
+      // Keep filling mem from the next log; it is handed to imm_ below.
+      continue;
+    }
+
+    if (mem != nullptr) {
+      // mem did not get reused; compact it.
+      if (status.ok()) {
+        *save_manifest = true;
+        status = StartRecoveryFlush(&flush, mem);
       } else {
-        // mem can be nullptr if lognum exists but was empty.
-        mem_ = new MemTable(internal_comparator_);
-        mem_->Ref();
+        mem->Unref();
       }
+      mem = nullptr;
     }
   }
 
   if (mem != nullptr) {
-    // mem did not get reused; compact it.
     if (status.ok()) {
-      *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      // The records stay in memory and are flushed by a background
+      // compaction once the DB is open.  Until then the logs they came from
+      // must be kept.
+      Log(options_.info_log, "Keeping recovered memtable from log #%llu\n",
+          static_cast<unsigned long long>(mem_log_number));
+      imm_ = mem;
+      has_imm_.store(true, std::memory_order_release);
+      edit->SetLogNumber(mem_log_number);
+    } else {
+      mem->Unref();
     }
-    mem->Unref();
   }
 
+  // Wait for the last flush and for the reader threads before their state
+  // goes out of scope.
+  Status flush_status = WaitForRecoveryFlush(&flush);
+  if (status.ok()) {
+    status = flush_status;
+  }
+  readers.mu.Lock();
+  readers.stop = true;
+  readers.cv.SignalAll();
+  while (readers.running_threads > 0) {
+    readers.cv.Wait();
+  }
+  readers.mu.Unlock();
+
   return status;
 }
 
+namespace {
+
+// State shared between DBImpl::PreloadTables() and its threads.
+struct PreloadState {
+  PreloadState(TableCache* table_cache, Logger* info_log)
+      : table_cache(table_cache),
+        info_log(info_log),
+        cv(&mu),
+        next(0),
+        opened(0),
+        failed(0),
+        running_threads(0) {}
+
+  TableCache* const table_cache;
+  Logger* const info_log;
+
+  // (number, size) of the tables to open.
+  std::vector<std::pair<uint64_t, uint64_t>> files;
+
+  port::Mutex mu;
+  port::CondVar cv;  // Signalled when a thread exits.
+  size_t next GUARDED_BY(mu);  // Next table a thread should open.
+  size_t opened GUARDED_BY(mu);
+  size_t failed GUARDED_BY(mu);
+  int running_threads GUARDED_BY(mu);
+};
+
+void PreloadTableThread(void* arg) {
+  PreloadState* state = reinterpret_cast<PreloadState*>(arg);
+  const size_t total = state->files.size();
+  MutexLock l(&state->mu);
+  while (state->next < total) {
+    const std::pair<uint64_t, uint64_t> file = state->files[state->next++];
+    state->mu.Unlock();
+    // Tables may disappear under a concurrent compaction, so failures are
+    // only counted.
+    Status s = state->table_cache->Preload(file.first, file.second);
+    state->mu.Lock();
+
+    if (s.ok()) {
+      state->opened++;
+    } else {
+      state->failed++;
+    }
+    const size_t done = state->opened + state->failed;
+    if (done * 10 / total != (done - 1) * 10 / total) {
+      Log(state->info_log, "Preloaded %d of %d tables\n",
+          static_cast<int>(done), static_cast<int>(total));
+    }
+  }
+  state->running_threads--;
+  state->cv.Signal();
+}
+
+}  // namespace
+
+void DBImpl::PreloadTables() {
+  const uint64_t start_micros = env_->NowMicros();
+  PreloadState state(table_cache_, options_.info_log);
+
+  mutex_.Lock();
+  Version* current = versions_->current();
+  const size_t max_tables = TableCacheSize(options_);
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (const FileMetaData* f : current->files(level)) {
+      if (state.files.size() < max_tables) {
+        state.files.emplace_back(f->number, f->file_size);
+      }
+    }
+  }
+  mutex_.Unlock();
+
+  if (state.files.empty()) {
+    return;
+  }
+  const int num_threads = static_cast<int>(std::min<size_t>(
+      state.files.size(), options_.preload_table_threads));
+  state.running_threads = num_threads;
+  for (int i = 0; i < num_threads; i++) {
+    env_->StartThread(&PreloadTableThread, &state);
+  }
+
+  MutexLock l(&state.mu);
+  while (state.running_threads > 0) {
+    state.cv.Wait();
+  }
+  Log(options_.info_log,
+      "Preloaded %d tables in %.3f seconds with %d threads, %d failed\n",
+      static_cast<int>(state.opened),
+      (env_->NowMicros() - start_micros) / 1e6, num_threads,
+      static_cast<int>(state.failed));
+}
+
 Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
                                 Version* base) {
   mutex_.AssertHeld();
@@ -509,14 +1005,21 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
+  BlobFileBuilder* blobs = nullptr;
+  if (options_.min_blob_size > 0) {
+    blobs = new BlobFileBuilder(dbname_, options_, versions_->NewFileNumber());
+    pending_outputs_.insert(blobs->number());
+  }
   Iterator* iter = mem->NewIterator();
+  Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long)meta.number);
 
   Status s;
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                   range_del_iter, blobs, &meta);
     mutex_.Lock();
   }
 
@@ -524,7 +1027,11 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
       (unsigned long long)meta.number, (unsigned long long)meta.file_size,
       s.ToString().c_str());
   delete iter;
+  delete range_del_iter;
   pending_outputs_.erase(meta.number);
+  if (blobs != nullptr) {
+    pending_outputs_.erase(blobs->number());
+  }
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
@@ -535,14 +1042,22 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     if (base != nullptr) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
-    edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                  meta.largest);
+    edit->AddFile(level, meta);
+    if (meta.oldest_blob_file != 0) {
+      edit->AddBlobFile(blobs->number(), blobs->NumBlobs(),
+                        blobs->BlobBytes());
+    }
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
   stats.bytes_written = meta.file_size;
+  if (blobs != nullptr) {
+    stats.bytes_written += blobs->BlobBytes();
+    delete blobs;
+  }
   stats_[level].Add(stats);
+  counters_.bytes_flushed += stats.bytes_written;
   return s;
 }
 
@@ -651,6 +1166,15 @@ Status DBImpl::TEST_CompactMemTable() {
   return s;
 }
 
+Status DBImpl::TEST_WaitForCompactions() {
+  // A finished compaction schedules the next one before signaling.
+  MutexLock l(&mutex_);
+  while (background_compaction_scheduled_ && bg_error_.ok()) {
+    background_work_finished_signal_.Wait();
+  }
+  return bg_error_;
+}
+
 void DBImpl::RecordBackgroundError(const Status& s) {
   mutex_.AssertHeld();
   if (bg_error_.ok()) {
@@ -667,8 +1191,11 @@ void DBImpl::MaybeScheduleCompaction() {
     // DB is being deleted; no more background compactions
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
+  } else if (ingesting_files_ && imm_ == nullptr) {
+    // IngestExternalFiles() waits for compactions to stop
   } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
-             !versions_->NeedsCompaction()) {
+             !versions_->NeedsCompaction() &&
+             !versions_->HasExpiredFiles(ExpiryCutoff())) {
     // No work to be done
   } else {
     background_compaction_scheduled_ = true;
@@ -707,6 +1234,18 @@ void DBImpl::BackgroundCompaction() {
     return;
   }
 
+  if (ingesting_files_) {
+    // Scheduled before IngestExternalFiles() started, which waits for no
+    // compaction to run.
+    return;
+  }
+
+  const uint32_t expiry_cutoff = ExpiryCutoff();
+  if (versions_->HasExpiredFiles(expiry_cutoff)) {
+    RemoveExpiredFiles(expiry_cutoff);
+    return;
+  }
+
   Compaction* c;
   bool is_manual = (manual_compaction_ != nullptr);
   InternalKey manual_end;
@@ -734,15 +1273,15 @@ void DBImpl::BackgroundCompaction() {
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->RemoveFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                       f->largest);
+    c->edit()->AddFile(c->output_level(), *f);
     status = versions_->LogAndApply(c->edit(), &mutex_);
     if (!status.ok()) {
       RecordBackgroundError(status);
     }
+    counters_.trivial_moves++;
     VersionSet::LevelSummaryStorage tmp;
     Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
-        static_cast<unsigned long long>(f->number), c->level() + 1,
+        static_cast<unsigned long long>(f->number), c->output_level(),
         static_cast<unsigned long long>(f->file_size),
         status.ToString().c_str(), versions_->LevelSummary(&tmp));
   } else {
@@ -794,6 +1333,12 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
   }
+  if (compact->blobs != nullptr) {
+    pending_outputs_.erase(compact->blobs->number());
+  }
+  if (compact->reserved_output_number != 0) {
+    pending_outputs_.erase(compact->reserved_output_number);
+  }
   delete compact;
 }
 
@@ -803,27 +1348,153 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   uint64_t file_number;
   {
     mutex_.Lock();
-    file_number = versions_->NewFileNumber();
-    pending_outputs_.insert(file_number);
+    if (compact->reserved_output_number != 0) {
+      file_number = compact->reserved_output_number;
+      compact->reserved_output_number = 0;
+    } else {
+      file_number = versions_->NewFileNumber();
+      pending_outputs_.insert(file_number);
+    }
     CompactionState::Output out;
     out.number = file_number;
     out.smallest.Clear();
     out.largest.Clear();
+    out.has_range_deletions = false;
+    out.timestamps = TableTimestampTracker(options_);
+    out.oldest_blob_file = 0;
+    out.num_entries = 0;
+    out.num_deletions = 0;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
 
   // Make the output file
   std::string fname = TableFileName(dbname_, file_number);
-  Status s = env_->NewWritableFile(fname, &compact->outfile);
+  Status s = NewTableFileForWrite(env_, options_, fname, &compact->outfile);
   if (s.ok()) {
     compact->builder = new TableBuilder(options_, compact->outfile);
   }
   return s;
 }
 
+Status DBImpl::LoadCompactionRangeTombstones(CompactionState* compact) {
+  mutex_.AssertHeld();
+  Compaction* const c = compact->compaction;
+  RangeDelAggregator all(user_comparator(), kMaxSequenceNumber);
+  compact->range_del =
+      new RangeDelAggregator(user_comparator(), compact->smallest_snapshot);
+  Status s;
+  for (int which = 0; which < 2 && s.ok(); which++) {
+    for (int i = 0; i < c->num_input_files(which) && s.ok(); i++) {
+      const FileMetaData* f = c->input(which, i);
+      if (!f->has_range_deletions) {
+        continue;
+      }
+      Iterator* iter =
+          table_cache_->NewRangeTombstoneIterator(f->number, f->file_size);
+      s = all.AddTombstones(iter);
+      if (s.ok()) {
+        s = compact->range_del->AddTombstones(iter);
+      }
+      delete iter;
+    }
+  }
+  if (!s.ok() || all.empty()) {
+    return s;
+  }
+
+  // A tombstone that every snapshot sees is obsolete once no deeper level
+  // holds keys in its range: the entries it covers here are dropped.
+  for (const RangeTombstone& t : all.tombstones()) {
+    if (t.sequence > compact->smallest_snapshot ||
+        !c->IsBaseLevelForRange(t.start, t.end)) {
+      compact->range_tombstones.push_back(t);
+    }
+  }
+
+  // The entries of "level+1" are older than the tombstones of "level" that
+  // overlap them, so a file inside the deleted ranges need not be read.
+  // Files referring to blob files are still read to count their blobs as
+  // garbage.
+  for (int i = 0; i < c->num_input_files(1);) {
+    const FileMetaData* f = c->input(1, i);
+    if (!f->has_range_deletions && f->oldest_blob_file == 0 &&
+        compact->range_del->CoversRange(f->smallest.user_key(),
+                                        f->largest.user_key())) {
+      Log(options_.info_log, "Dropping table #%llu@%d: range deleted",
+          static_cast<unsigned long long>(f->number), c->output_level());
+      c->DropInput(i);
+    } else {
+      i++;
+    }
+  }
+  return s;
+}
+
+void DBImpl::AddCompactionRangeTombstones(CompactionState* compact,
+                                          const Slice* limit) {
+  // Clip the tombstones to the user keys of this output so that a lookup
+  // finds the tombstones covering a key in the table that holds its
+  // entries.
+  const Comparator* const ucmp = user_comparator();
+  std::vector<std::pair<std::string, std::string>> pieces;  // (key, end)
+  for (const RangeTombstone& t : compact->range_tombstones) {
+    Slice start(t.start);
+    Slice end(t.end);
+    if (limit != nullptr && ucmp->Compare(start, *limit) >= 0) {
+      break;
+    }
+    if (compact->has_output_lower_bound &&
+        ucmp->Compare(start, compact->output_lower_bound) < 0) {
+      start = compact->output_lower_bound;
+    }
+    if (limit != nullptr && ucmp->Compare(*limit, end) < 0) {
+      end = *limit;
+    }
+    if (ucmp->Compare(start, end) < 0) {
+      std::string key;
+      AppendInternalKey(&key, ParsedInternalKey(start, t.sequence,
+                                                kTypeRangeDeletion));
+      pieces.emplace_back(std::move(key), end.ToString());
+    }
+  }
+  std::sort(pieces.begin(), pieces.end(),
+            [this](const std::pair<std::string, std::string>& a,
+                   const std::pair<std::string, std::string>& b) {
+              return internal_comparator_.Compare(a.first, b.first) < 0;
+            });
+  // Tombstones that started before this output all start at its lower bound
+  // now.  A table holds one tombstone per key, so of those with the same
+  // sequence number keep the one that reaches furthest.
+  size_t kept = 0;
+  for (size_t i = 0; i < pieces.size(); i++) {
+    if (kept > 0 && pieces[kept - 1].first == pieces[i].first) {
+      if (ucmp->Compare(pieces[kept - 1].second, pieces[i].second) < 0) {
+        pieces[kept - 1].second.swap(pieces[i].second);
+      }
+    } else {
+      if (kept != i) {
+        pieces[kept] = std::move(pieces[i]);
+      }
+      kept++;
+    }
+  }
+  pieces.resize(kept);
+
+  CompactionState::Output* out = compact->current_output();
+  bool empty = compact->builder->NumEntries() == 0;
+  for (const auto& piece : pieces) {
+    compact->builder->AddRangeTombstone(piece.first, piece.second);
+    AddTombstoneToFileRange(&internal_comparator_, piece.first, piece.second,
+                            &empty, &out->smallest, &out->largest);
+    out->has_range_deletions = true;
+    out->timestamps.AddRangeTombstone();
+  }
+}
+
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
-                                          Iterator* input) {
+                                          Iterator* input,
+                                          const Slice* limit) {
   assert(compact != nullptr);
   assert(compact->outfile != nullptr);
   assert(compact->builder != nullptr);
@@ -833,7 +1504,15 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 
   // Check for iterator errors
   Status s = input->status();
+  if (s.ok()) {
+    AddCompactionRangeTombstones(compact, limit);
+  }
+  if (limit != nullptr) {
+    compact->output_lower_bound.assign(limit->data(), limit->size());
+    compact->has_output_lower_bound = true;
+  }
   const uint64_t current_entries = compact->builder->NumEntries();
+  const uint64_t current_tombstones = compact->builder->NumRangeTombstones();
   if (s.ok()) {
     s = compact->builder->Finish();
   } else {
@@ -841,6 +1520,7 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   }
   const uint64_t current_bytes = compact->builder->FileSize();
   compact->current_output()->file_size = current_bytes;
+  compact->current_output()->num_entries = current_entries;
   compact->total_bytes += current_bytes;
   delete compact->builder;
   compact->builder = nullptr;
@@ -855,7 +1535,7 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   delete compact->outfile;
   compact->outfile = nullptr;
 
-  if (s.ok() && current_entries > 0) {
+  if (s.ok() && (current_entries > 0 || current_tombstones > 0)) {
     // Verify that the table is usable
     Iterator* iter =
         table_cache_->NewIterator(ReadOptions(), output_number, current_bytes);
@@ -863,7 +1543,8 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
     delete iter;
     if (s.ok()) {
       Log(options_.info_log, "Generated table #%llu@%d: %lld keys, %lld bytes",
-          (unsigned long long)output_number, compact->compaction->level(),
+          (unsigned long long)output_number,
+          compact->compaction->output_level(),
           (unsigned long long)current_entries,
           (unsigned long long)current_bytes);
     }
@@ -871,20 +1552,212 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   return s;
 }
 
+Status DBImpl::AddCompactionOutput(CompactionState* compact, Slice key,
+                                   Slice value) {
+  // Open output file if necessary
+  if (compact->builder == nullptr) {
+    Status s = OpenCompactionOutputFile(compact);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  CompactionState::Output* out = compact->current_output();
+  ParsedInternalKey ikey;
+  if (ParseInternalKey(key, &ikey)) {
+    Status s;
+    uint64_t blob_file = 0;
+    if (ikey.type == kTypeBlobIndex) {
+      BlobIndex index;
+      if (!index.DecodeFrom(value)) {
+        return Status::Corruption("bad blob index for", ikey.user_key);
+      }
+      if (compact->compaction->ShouldRelocateBlobs(index.file_number)) {
+        // Read the blob back so that it is written to the new blob file,
+        // or stored in the table if blob files are no longer used.
+        ReadOptions options;
+        options.verify_checksums = options_.paranoid_checks;
+        s = blob_cache_->Get(options, ikey.user_key, value,
+                             &compact->blob_value);
+        if (!s.ok()) {
+          return s;
+        }
+        ikey.type = kTypeValue;
+        value = compact->blob_value;
+        compact->blob_key.clear();
+        AppendInternalKey(&compact->blob_key, ikey);
+        key = compact->blob_key;
+      } else {
+        compact->CountBlob(value, false);
+        blob_file = index.file_number;
+      }
+    }
+    if (ikey.type == kTypeValue && options_.min_blob_size > 0 &&
+        value.size() >= options_.min_blob_size) {
+      if (compact->blobs == nullptr) {
+        mutex_.Lock();
+        compact->blobs = new BlobFileBuilder(dbname_, options_,
+                                             versions_->NewFileNumber());
+        pending_outputs_.insert(compact->blobs->number());
+        mutex_.Unlock();
+      }
+      s = compact->blobs->Add(ikey.user_key, value, &compact->blob_index);
+      if (!s.ok()) {
+        return s;
+      }
+      ikey.type = kTypeBlobIndex;
+      value = compact->blob_index;
+      compact->blob_key.clear();
+      AppendInternalKey(&compact->blob_key, ikey);
+      key = compact->blob_key;
+      blob_file = compact->blobs->number();
+    }
+    if (blob_file != 0 &&
+        (out->oldest_blob_file == 0 || blob_file < out->oldest_blob_file)) {
+      out->oldest_blob_file = blob_file;
+    }
+    if (ikey.type == kTypeDeletion) {
+      out->num_deletions++;
+    }
+  }
+  if (compact->builder->NumEntries() == 0) {
+    out->smallest.DecodeFrom(key);
+  }
+  out->largest.DecodeFrom(key);
+  out->timestamps.Add(key, value);
+  compact->builder->Add(key, value);
+  return Status::OK();
+}
+
+Status DBImpl::CompactMergeOperands(CompactionState* compact, Iterator* input,
+                                    const Slice& user_key,
+                                    SequenceNumber sequence) {
+  // "input" is at a merge operand for "user_key" that no snapshot can see
+  // past.  Consume it together with the older operands and the value or
+  // deletion below them, newest first.
+  std::vector<std::pair<std::string, std::string>> entries;
+  std::vector<std::string> operands;
+  bool found_base = false;
+  std::string existing_value;
+  bool has_existing_value = false;
+  for (; input->Valid(); input->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(input->key(), &ikey) ||
+        user_comparator()->Compare(ikey.user_key, user_key) != 0) {
+      break;
+    }
+    if (compact->range_del->ShouldDelete(ikey)) {
+      // The older entries are deleted by a range tombstone.
+      found_base = true;
+      break;
+    }
+    entries.emplace_back(input->key().ToString(), input->value().ToString());
+    if (ikey.type == kTypeMerge) {
+      operands.push_back(entries.back().second);
+      continue;
+    }
+    found_base = true;
+    if (ikey.type == kTypeValue) {
+      existing_value = entries.back().second;
+      has_existing_value = true;
+    } else if (ikey.type == kTypeBlobIndex) {
+      compact->CountBlob(entries.back().second, true);
+      ReadOptions options;
+      options.verify_checksums = options_.paranoid_checks;
+      Status s = blob_cache_->Get(options, user_key, entries.back().second,
+                                  &existing_value);
+      if (!s.ok()) {
+        return s;
+      }
+      has_existing_value = true;
+    }
+    input->Next();
+    break;
+  }
+
+  // Older entries for the key are hidden by the collapsed entry and are
+  // dropped by the caller.
+  const MergeOperator* merge_operator = options_.merge_operator;
+  std::string new_key;
+  std::string new_value;
+  bool collapsed = false;
+  if (found_base || compact->compaction->IsBaseLevelForKey(user_key)) {
+    // The full history of the key is known: replace it by a plain value.
+    const Slice existing(existing_value);
+    if (ApplyMergeOperands(merge_operator, user_key,
+                           has_existing_value ? &existing : nullptr, operands,
+                           &new_value)
+            .ok()) {
+      AppendInternalKey(&new_key,
+                        ParsedInternalKey(user_key, sequence, kTypeValue));
+      collapsed = true;
+    }
+  } else if (operands.size() > 1) {
+    // Older operands may live in deeper levels; combine what we have into
+    // a single operand if the operator supports it.
+    collapsed = true;
+    new_value = operands.back();
+    for (size_t i = operands.size() - 1; collapsed && i > 0; i--) {
+      std::string combined;
+      collapsed = merge_operator->PartialMerge(user_key, new_value,
+                                               operands[i - 1], &combined);
+      new_value.swap(combined);
+    }
+    if (collapsed) {
+      AppendInternalKey(&new_key,
+                        ParsedInternalKey(user_key, sequence, kTypeMerge));
+    }
+  }
+
+  if (collapsed) {
+    return AddCompactionOutput(compact, new_key, new_value);
+  }
+  // Keep the entries as they are.
+  Status s;
+  for (size_t i = 0; s.ok() && i < entries.size(); i++) {
+    s = AddCompactionOutput(compact, entries[i].first, entries[i].second);
+  }
+  return s;
+}
+
 Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
   Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
       compact->compaction->num_input_files(0), compact->compaction->level(),
-      compact->compaction->num_input_files(1), compact->compaction->level() + 1,
+      compact->compaction->num_input_files(1),
+      compact->compaction->output_level(),
       static_cast<long long>(compact->total_bytes));
 
   // Add compaction outputs
   compact->compaction->AddInputDeletions(compact->compaction->edit());
-  const int level = compact->compaction->level();
+  const int level = compact->compaction->output_level();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
-                                         out.smallest, out.largest);
+    FileMetaData f;
+    f.number = out.number;
+    f.file_size = out.file_size;
+    f.smallest = out.smallest;
+    f.largest = out.largest;
+    f.has_range_deletions = out.has_range_deletions;
+    f.newest_timestamp = out.timestamps.NewestTimestamp();
+    f.oldest_blob_file = out.oldest_blob_file;
+    if (options_.deletion_compaction_ratio > 0) {
+      f.num_entries = out.num_entries;
+      f.num_deletions = out.num_deletions;
+    }
+    compact->compaction->edit()->AddFile(level, f);
+  }
+
+  // Add the new blob file and the garbage left in older ones
+  if (compact->blobs != nullptr && compact->blobs->NumBlobs() > 0) {
+    compact->compaction->edit()->AddBlobFile(compact->blobs->number(),
+                                             compact->blobs->NumBlobs(),
+                                             compact->blobs->BlobBytes());
+  }
+  for (const auto& kvp : compact->blob_refs) {
+    if (kvp.second.count > 0) {
+      compact->compaction->edit()->AddBlobGarbage(
+          kvp.first, kvp.second.count, kvp.second.bytes);
+    }
   }
   return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
 }
@@ -896,29 +1769,45 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   Log(options_.info_log, "Compacting %d@%d + %d@%d files",
       compact->compaction->num_input_files(0), compact->compaction->level(),
       compact->compaction->num_input_files(1),
-      compact->compaction->level() + 1);
+      compact->compaction->output_level());
 
-  assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
+  assert(versions_->NumLevelFiles(compact->compaction->level()) > 0 ||
+         compact->compaction->num_input_files(0) == 0);
   assert(compact->builder == nullptr);
   assert(compact->outfile == nullptr);
   if (snapshots_.empty()) {
     compact->smallest_snapshot = versions_->LastSequence();
+    compact->newest_snapshot = 0;
   } else {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
+    compact->newest_snapshot = snapshots_.newest()->sequence_number();
   }
 
-  Iterator* input = versions_->MakeInputIterator(compact->compaction);
+  if (compact->compaction->output_level() == 0) {
+    // Level-0 files are ordered by file number, so the output has to be
+    // numbered before the memtables flushed while the compaction runs.
+    compact->reserved_output_number = versions_->NewFileNumber();
+    pending_outputs_.insert(compact->reserved_output_number);
+  }
+
+  Status status = LoadCompactionRangeTombstones(compact);
+  Iterator* input = versions_->MakeInputIterator(compact->compaction);
 
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
   input->SeekToFirst();
-  Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
-  while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
+  const CompactionFilter* const compaction_filter = options_.compaction_filter;
+  const bool has_timestamps = (options_.ttl_seconds > 0);
+  const uint32_t expiry_cutoff = ExpiryCutoff();
+  std::string filtered_key;
+  std::string filtered_value;
+  while (status.ok() && input->Valid() &&
+         !shutting_down_.load(std::memory_order_acquire)) {
     // Prioritize immutable compaction work
     if (has_imm_.load(std::memory_order_relaxed)) {
       const uint64_t imm_start = env_->NowMicros();
@@ -933,16 +1822,27 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     }
 
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
-        compact->builder != nullptr) {
-      status = FinishCompactionOutputFile(compact, input);
-      if (!status.ok()) {
-        break;
+    const bool stop_before = compact->compaction->ShouldStopBefore(key);
+    if (compact->builder != nullptr &&
+        (stop_before || compact->builder->FileSize() >=
+                            compact->compaction->MaxOutputFileSize())) {
+      // Outputs end between user keys so that the range tombstones covering
+      // a key can be stored with all of its entries.
+      ParsedInternalKey next;
+      if (ParseInternalKey(key, &next) &&
+          user_comparator()->Compare(
+              next.user_key, compact->current_output()->largest.user_key()) !=
+              0) {
+        status = FinishCompactionOutputFile(compact, input, &next.user_key);
+        if (!status.ok()) {
+          break;
+        }
       }
     }
 
     // Handle key/value, add to state, etc.
     bool drop = false;
+    bool filtered = false;  // Write filtered_key and filtered_value instead
     if (!ParseInternalKey(key, &ikey)) {
       // Do not hide error keys
       current_user_key.clear();
@@ -957,10 +1857,16 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         has_current_user_key = true;
         last_sequence_for_key = kMaxSequenceNumber;
       }
+      if (ikey.type == kTypeBlobIndex) {
+        compact->CountBlob(input->value(), true);
+      }
 
       if (last_sequence_for_key <= compact->smallest_snapshot) {
         // Hidden by an newer entry for same user key
         drop = true;  // (A)
+      } else if (compact->range_del->ShouldDelete(ikey)) {
+        // Deleted by a range tombstone that every snapshot sees
+        drop = true;
       } else if (ikey.type == kTypeDeletion &&
                  ikey.sequence <= compact->smallest_snapshot &&
                  compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
@@ -974,6 +1880,77 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         drop = true;
       }
 
+      bool remove = false;
+      uint32_t timestamp = 0;
+      if (!drop && has_timestamps && ikey.type == kTypeValue) {
+        if (!ExtractValueTimestamp(input->value(), &timestamp)) {
+          status = Status::Corruption("value without timestamp",
+                                      ikey.user_key);
+          break;
+        }
+        // Expired values are hidden from every snapshot.
+        remove = (timestamp < expiry_cutoff);
+      }
+
+      if (!drop && !remove && compaction_filter != nullptr &&
+          last_sequence_for_key == kMaxSequenceNumber &&
+          (ikey.type == kTypeValue || ikey.type == kTypeBlobIndex)) {
+        // Newest entry for this user key
+        Slice value = input->value();
+        if (ikey.type == kTypeBlobIndex) {
+          ReadOptions options;
+          options.verify_checksums = options_.paranoid_checks;
+          status = blob_cache_->Get(options, ikey.user_key, value,
+                                    &compact->blob_value);
+          if (!status.ok()) {
+            break;
+          }
+          value = compact->blob_value;
+        }
+        if (has_timestamps) {
+          value = Slice(value.data(), value.size() - kValueTimestampSize);
+        }
+        CompactionFilter::Context context;
+        context.output_level = compact->compaction->output_level();
+        context.is_bottommost_level =
+            compact->compaction->IsBaseLevelForKey(ikey.user_key);
+        context.snapshot_safe = (ikey.sequence > compact->newest_snapshot);
+        filtered_value.clear();
+        CompactionFilter::Decision decision = compaction_filter->Filter(
+            context, ikey.user_key, value, &filtered_value);
+        if (!context.snapshot_safe) {
+          decision = CompactionFilter::kKeep;
+        }
+        if (decision == CompactionFilter::kRemove) {
+          remove = true;
+        } else if (decision == CompactionFilter::kChangeValue) {
+          if (has_timestamps) {
+            PutFixed32(&filtered_value, timestamp);
+          }
+          filtered_key.clear();
+          AppendInternalKey(&filtered_key,
+                            ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                              kTypeValue));
+          filtered = true;
+        }
+      }
+
+      if (remove) {
+        if (ikey.sequence <= compact->smallest_snapshot &&
+            compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+          // Like an obsolete deletion marker, see above.
+          drop = true;
+        } else {
+          // Older entries for the key still have to be hidden.
+          filtered_key.clear();
+          AppendInternalKey(&filtered_key,
+                            ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                              kTypeDeletion));
+          filtered_value.clear();
+          filtered = true;
+        }
+      }
+
       last_sequence_for_key = ikey.sequence;
     }
 #if 0
@@ -986,27 +1963,28 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
-    if (!drop) {
-      // Open output file if necessary
-      if (compact->builder == nullptr) {
-        status = OpenCompactionOutputFile(compact);
-        if (!status.ok()) {
-          break;
-        }
-      }
-      if (compact->builder->NumEntries() == 0) {
-        compact->current_output()->smallest.DecodeFrom(key);
+    if (!drop && ikey.type == kTypeMerge &&
+        ikey.sequence <= compact->smallest_snapshot &&
+        options_.merge_operator != nullptr) {
+      // No snapshot can see the entries below this merge operand, so they
+      // can be combined.  This leaves "input" past the consumed entries.
+      status = CompactMergeOperands(compact, input, current_user_key,
+                                    ikey.sequence);
+      if (!status.ok()) {
+        break;
       }
-      compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
+      continue;
+    }
 
-      // Close output file if it is big enough
-      if (compact->builder->FileSize() >=
-          compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
-        if (!status.ok()) {
-          break;
-        }
+    if (filtered) {
+      status = AddCompactionOutput(compact, filtered_key, filtered_value);
+      if (!status.ok()) {
+        break;
+      }
+    } else if (!drop) {
+      status = AddCompactionOutput(compact, key, input->value());
+      if (!status.ok()) {
+        break;
       }
     }
 
@@ -1016,28 +1994,51 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && compact->builder == nullptr) {
+    // The entries after the last output, if any, were all dropped, but
+    // tombstones may still extend past it.
+    for (const RangeTombstone& t : compact->range_tombstones) {
+      if (!compact->has_output_lower_bound ||
+          user_comparator()->Compare(compact->output_lower_bound, t.end) < 0) {
+        status = OpenCompactionOutputFile(compact);
+        break;
+      }
+    }
+  }
   if (status.ok() && compact->builder != nullptr) {
-    status = FinishCompactionOutputFile(compact, input);
+    status = FinishCompactionOutputFile(compact, input, nullptr);
   }
   if (status.ok()) {
     status = input->status();
   }
+  if (status.ok() && compact->blobs != nullptr) {
+    // The blob file must be durable before the outputs are installed.
+    status = compact->blobs->Finish();
+  }
   delete input;
   input = nullptr;
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros - imm_micros;
+  int64_t bytes_read[2] = {0, 0};
   for (int which = 0; which < 2; which++) {
     for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+      bytes_read[which] += compact->compaction->input(which, i)->file_size;
     }
   }
+  stats.bytes_read = bytes_read[0] + bytes_read[1];
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     stats.bytes_written += compact->outputs[i].file_size;
   }
+  if (compact->blobs != nullptr) {
+    stats.bytes_written += compact->blobs->BlobBytes();
+  }
 
   mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
+  stats_[compact->compaction->output_level()].Add(stats);
+  counters_.compactions++;
+  counters_.bytes_picked += bytes_read[0];
+  counters_.bytes_overlapped += bytes_read[1];
 
   if (status.ok()) {
     status = InstallCompactionResults(compact);
@@ -1074,9 +2075,9 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 
 }  // anonymous namespace
 
-Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
-                                      SequenceNumber* latest_snapshot,
-                                      uint32_t* seed) {
+Iterator* DBImpl::NewInternalIterator(
+    const ReadOptions& options, SequenceNumber* latest_snapshot,
+    uint32_t* seed, std::vector<Iterator*>* range_del_iters) {
   mutex_.Lock();
   *latest_snapshot = versions_->LastSequence();
 
@@ -1097,14 +2098,26 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
 
   *seed = ++seed_;
+  MemTable* const mem = mem_;
+  MemTable* const imm = imm_;
+  Version* const current = versions_->current();
   mutex_.Unlock();
+
+  if (range_del_iters != nullptr) {
+    // The memtables and the version are kept alive by internal_iter.
+    range_del_iters->push_back(mem->NewRangeTombstoneIterator());
+    if (imm != nullptr) {
+      range_del_iters->push_back(imm->NewRangeTombstoneIterator());
+    }
+    current->AddRangeTombstoneIterators(range_del_iters);
+  }
   return internal_iter;
 }
 
 Iterator* DBImpl::TEST_NewInternalIterator() {
   SequenceNumber ignored;
   uint32_t ignored_seed;
-  return NewInternalIterator(ReadOptions(), &ignored, &ignored_seed);
+  return NewInternalIterator(ReadOptions(), &ignored, &ignored_seed, nullptr);
 }
 
 int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
@@ -1112,6 +2125,49 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
   return versions_->MaxNextLevelOverlappingBytes();
 }
 
+void DBImpl::RemoveExpiredFiles(uint32_t cutoff) {
+  mutex_.AssertHeld();
+  VersionEdit edit;
+  const int removed = versions_->RemoveExpiredFiles(cutoff, &edit);
+  Status status = versions_->LogAndApply(&edit, &mutex_);
+  if (!status.ok()) {
+    RecordBackgroundError(status);
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log, "Removed %d expired files: %s, %s\n", removed,
+      status.ToString().c_str(), versions_->LevelSummary(&tmp));
+  RemoveObsoleteFiles();
+}
+
+uint32_t DBImpl::ExpiryCutoff() const {
+  if (options_.ttl_seconds == 0) {
+    return 0;
+  }
+  const uint64_t now = env_->NowMicros() / 1000000;
+  return now > options_.ttl_seconds
+             ? static_cast<uint32_t>(now - options_.ttl_seconds)
+             : 0;
+}
+
+namespace {
+
+// Remove the write time from "*value", a value read in TTL mode.  Returns
+// NotFound if the value expired before "expiry_cutoff".
+Status RemoveValueTimestamp(uint32_t expiry_cutoff, const Slice& key,
+                            std::string* value) {
+  uint32_t timestamp;
+  if (!ExtractValueTimestamp(*value, &timestamp)) {
+    return Status::Corruption("value without timestamp", key);
+  }
+  if (timestamp < expiry_cutoff) {
+    return Status::NotFound(Slice());
+  }
+  value->resize(value->size() - kValueTimestampSize);
+  return Status::OK();
+}
+
+}  // namespace
+
 Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
   Status s;
@@ -1139,14 +2195,26 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
     mutex_.Unlock();
     // First look in the memtable, then in the immutable memtable (if any).
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
+    std::vector<std::string> merge_operands;
+    SequenceNumber max_covering_tombstone_seq = 0;
+    if (mem->Get(lkey, value, &s, &merge_operands,
+                 &max_covering_tombstone_seq)) {
       // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
+    } else if (imm != nullptr &&
+               imm->Get(lkey, value, &s, &merge_operands,
+                        &max_covering_tombstone_seq)) {
       // Done
     } else {
-      s = current->Get(options, lkey, value, &stats);
+      s = current->Get(options, lkey, value, &stats, &merge_operands,
+                       &max_covering_tombstone_seq);
       have_stat_update = true;
     }
+    if (!merge_operands.empty()) {
+      s = FinishMergeLookup(options_.merge_operator, key, merge_operands, s,
+                            value);
+    } else if (s.ok() && options_.ttl_seconds > 0) {
+      s = RemoveValueTimestamp(ExpiryCutoff(), key, value);
+    }
     mutex_.Lock();
   }
 
@@ -1159,16 +2227,138 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   return s;
 }
 
+std::vector<Status> DBImpl::MultiGet(const ReadOptions& options,
+                                     const std::vector<Slice>& keys,
+                                     std::vector<std::string>* values) {
+  std::vector<Status> statuses(keys.size());
+  values->resize(keys.size());
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != nullptr) {
+    snapshot =
+        static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != nullptr) imm->Ref();
+  current->Ref();
+
+  std::vector<Version::GetStats> stats;
+
+  // Unlock while reading from files and memtables
+  {
+    mutex_.Unlock();
+    // Resolve what we can from the memtables and remember the rest.
+    std::vector<std::vector<std::string>> merge_operands(keys.size());
+    std::vector<SequenceNumber> max_covering_tombstone_seqs(keys.size(), 0);
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < keys.size(); i++) {
+      LookupKey lkey(keys[i], snapshot);
+      if (mem->Get(lkey, &(*values)[i], &statuses[i], &merge_operands[i],
+                   &max_covering_tombstone_seqs[i])) {
+        // Done
+      } else if (imm != nullptr &&
+                 imm->Get(lkey, &(*values)[i], &statuses[i],
+                          &merge_operands[i],
+                          &max_covering_tombstone_seqs[i])) {
+        // Done
+      } else {
+        pending.push_back(i);
+      }
+    }
+
+    // Fetch the table blocks of all remaining lookups in one batch per
+    // file before running them one by one against the block cache.
+    if (pending.size() > 1) {
+      std::vector<std::string> internal_keys;
+      internal_keys.reserve(pending.size());
+      for (size_t i : pending) {
+        LookupKey lkey(keys[i], snapshot);
+        internal_keys.push_back(lkey.internal_key().ToString());
+      }
+      current->PrefetchForGet(
+          options, std::vector<Slice>(internal_keys.begin(),
+                                      internal_keys.end()));
+    }
+
+    for (size_t i : pending) {
+      LookupKey lkey(keys[i], snapshot);
+      Version::GetStats get_stats;
+      statuses[i] = current->Get(options, lkey, &(*values)[i], &get_stats,
+                                 &merge_operands[i],
+                                 &max_covering_tombstone_seqs[i]);
+      if (get_stats.seek_file != nullptr) {
+        stats.push_back(get_stats);
+      }
+    }
+
+    const uint32_t expiry_cutoff = ExpiryCutoff();
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (!merge_operands[i].empty()) {
+        statuses[i] = FinishMergeLookup(options_.merge_operator, keys[i],
+                                        merge_operands[i], statuses[i],
+                                        &(*values)[i]);
+      } else if (statuses[i].ok() && options_.ttl_seconds > 0) {
+        statuses[i] =
+            RemoveValueTimestamp(expiry_cutoff, keys[i], &(*values)[i]);
+      }
+    }
+    mutex_.Lock();
+  }
+
+  bool schedule_compaction = false;
+  for (const Version::GetStats& get_stats : stats) {
+    if (current->UpdateStats(get_stats)) {
+      schedule_compaction = true;
+    }
+  }
+  if (schedule_compaction) {
+    MaybeScheduleCompaction();
+  }
+  mem->Unref();
+  if (imm != nullptr) imm->Unref();
+  current->Unref();
+  return statuses;
+}
+
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
-  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
-  return NewDBIterator(this, user_comparator(), iter,
-                       (options.snapshot != nullptr
-                            ? static_cast<const SnapshotImpl*>(options.snapshot)
-                                  ->sequence_number()
-                            : latest_snapshot),
-                       seed);
+  std::vector<Iterator*> range_del_iters;
+  Iterator* iter =
+      NewInternalIterator(options, &latest_snapshot, &seed, &range_del_iters);
+  const SequenceNumber snapshot =
+      (options.snapshot != nullptr
+           ? static_cast<const SnapshotImpl*>(options.snapshot)
+                 ->sequence_number()
+           : latest_snapshot);
+
+  RangeDelAggregator* range_del =
+      new RangeDelAggregator(user_comparator(), snapshot);
+  Status s;
+  for (Iterator* range_del_iter : range_del_iters) {
+    if (s.ok()) {
+      s = range_del->AddTombstones(range_del_iter);
+    }
+    delete range_del_iter;
+  }
+  if (!s.ok()) {
+    delete range_del;
+    delete iter;
+    return NewErrorIterator(s);
+  }
+  if (range_del->empty()) {
+    delete range_del;
+    range_del = nullptr;
+  }
+  return NewDBIterator(this, user_comparator(), options_.merge_operator,
+                       range_del, options_.ttl_seconds > 0, ExpiryCutoff(),
+                       blob_cache_, options, iter, snapshot, seed);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1197,6 +2387,22 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
   return DB::Delete(options, key);
 }
 
+Status DBImpl::Merge(const WriteOptions& options, const Slice& key,
+                     const Slice& value) {
+  if (options_.merge_operator == nullptr) {
+    return Status::InvalidArgument("no merge operator");
+  }
+  return DB::Merge(options, key, value);
+}
+
+Status DBImpl::DeleteRange(const WriteOptions& options, const Slice& begin_key,
+                           const Slice& end_key) {
+  if (user_comparator()->Compare(begin_key, end_key) > 0) {
+    return Status::InvalidArgument("range deletion end precedes its begin");
+  }
+  return DB::DeleteRange(options, begin_key, end_key);
+}
+
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   Writer w(&mutex_);
   w.batch = updates;
@@ -1212,24 +2418,103 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     return w.status;
   }
 
+  std::vector<Writer*> async_done;
+  Status status = CommitWriteGroup(&w, &async_done);
+  FinishAsyncWrites(&async_done);
+  return status;
+}
+
+void DBImpl::WriteAsync(const WriteOptions& options, WriteBatch* updates,
+                        WriteCallback callback, void* arg) {
+  Writer* w = new Writer(&mutex_);
+  w->async_batch = *updates;
+  w->batch = &w->async_batch;
+  w->sync = options.sync;
+  w->callback = callback;
+  w->callback_arg = arg;
+
+  MutexLock l(&mutex_);
+  // Push back on the caller while too many writes are queued.
+  while (pending_async_writes_ >= options_.max_pending_async_writes) {
+    async_writes_cv_.Wait();
+  }
+  pending_async_writes_++;
+  writers_.push_back(w);
+  if (!async_writer_running_) {
+    async_writer_running_ = true;
+    env_->StartThread(&DBImpl::AsyncWriterMain, this);
+  }
+  if (w == writers_.front()) {
+    SignalWriteQueueHead();
+  }
+}
+
+void DBImpl::AsyncWriterMain(void* db) {
+  reinterpret_cast<DBImpl*>(db)->AsyncWriterLoop();
+}
+
+void DBImpl::AsyncWriterLoop() {
+  MutexLock l(&mutex_);
+  std::vector<Writer*> async_done;
+  while (true) {
+    if (!writers_.empty() && writers_.front()->callback != nullptr) {
+      CommitWriteGroup(writers_.front(), &async_done);
+      FinishAsyncWrites(&async_done);
+    } else if (stop_async_writer_) {
+      break;
+    } else {
+      async_writes_cv_.Wait();
+    }
+  }
+  async_writer_running_ = false;
+  async_writes_cv_.SignalAll();
+}
+
+Status DBImpl::CommitWriteGroup(Writer* leader,
+                                std::vector<Writer*>* async_done) {
+  mutex_.AssertHeld();
+  assert(leader == writers_.front());
+  WriteBatch* updates = leader->batch;
+
+  if (leader->sync && updates != nullptr &&
+      options_.sync_write_group_wait_micros > 0 &&
+      last_sync_group_size_ > 1) {
+    WaitForSyncWriteGroup();
+  }
+
   // May temporarily unlock and wait.
   Status status = MakeRoomForWrite(updates == nullptr);
   uint64_t last_sequence = versions_->LastSequence();
-  Writer* last_writer = &w;
+  Writer* last_writer = leader;
+  WriteBatch timestamped_batch;
   if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
     WriteBatch* write_batch = BuildBatchGroup(&last_writer);
-    WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
-    last_sequence += WriteBatchInternal::Count(write_batch);
+    if (options_.ttl_seconds > 0) {
+      // Store the write time with each value, see Options::ttl_seconds.
+      const uint32_t now =
+          static_cast<uint32_t>(env_->NowMicros() / 1000000);
+      status = WriteBatchInternal::AppendWithTimestamps(&timestamped_batch,
+                                                        write_batch, now);
+      if (write_batch == tmp_batch_) tmp_batch_->Clear();
+      write_batch = &timestamped_batch;
+      // Files only expire as time passes, so look for them on writes.
+      if (versions_->HasExpiredFiles(ExpiryCutoff())) {
+        MaybeScheduleCompaction();
+      }
+    }
 
     // Add to log and apply to memtable.  We can release the lock
-    // during this phase since &w is currently responsible for logging
+    // during this phase since leader is currently responsible for logging
     // and protects against concurrent loggers and concurrent writes
     // into mem_.
-    {
+    if (status.ok()) {
+      WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
+      last_sequence += WriteBatchInternal::Count(write_batch);
       mutex_.Unlock();
-      status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+      status = log_->AddRecord(WriteBatchInternal::Contents(write_batch),
+                               options_.wal_compression);
       bool sync_error = false;
-      if (status.ok() && options.sync) {
+      if (status.ok() && leader->sync) {
         status = logfile_->Sync();
         if (!status.ok()) {
           sync_error = true;
@@ -1251,23 +2536,85 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     versions_->SetLastSequence(last_sequence);
   }
 
+  size_t sync_writers = 0;
   while (true) {
     Writer* ready = writers_.front();
     writers_.pop_front();
-    if (ready != &w) {
+    if (ready->sync) {
+      sync_writers++;
+    }
+    if (ready->callback != nullptr) {
+      ready->status = status;
+      async_done->push_back(ready);
+      if (pending_async_writes_-- == options_.max_pending_async_writes) {
+        async_writes_cv_.SignalAll();
+      }
+    } else if (ready != leader) {
       ready->status = status;
       ready->done = true;
       ready->cv.Signal();
     }
     if (ready == last_writer) break;
   }
+  if (leader->sync && updates != nullptr) {
+    last_sync_group_size_ = sync_writers;
+  }
 
   // Notify new head of write queue
-  if (!writers_.empty()) {
+  SignalWriteQueueHead();
+
+  return status;
+}
+
+void DBImpl::SignalWriteQueueHead() {
+  mutex_.AssertHeld();
+  if (writers_.empty()) {
+    return;
+  }
+  if (writers_.front()->callback == nullptr) {
     writers_.front()->cv.Signal();
+  } else {
+    // Only the async writer thread leads writers queued by WriteAsync().
+    async_writes_cv_.SignalAll();
   }
+}
 
-  return status;
+void DBImpl::WaitForSyncWriteGroup() {
+  mutex_.AssertHeld();
+  // Followers need the mutex to join the queue, so it is released while
+  // spinning.  The window is meant to be short, which makes yielding
+  // cheaper than sleeping on a condition variable.  Only sync writers are
+  // waited for, since the others would not save a sync by joining.
+  const uint64_t deadline =
+      env_->NowMicros() + options_.sync_write_group_wait_micros;
+  while (env_->NowMicros() < deadline) {
+    size_t sync_writers = 0;
+    for (const Writer* w : writers_) {
+      if (w->sync) {
+        sync_writers++;
+      }
+    }
+    if (sync_writers >= last_sync_group_size_) {
+      break;
+    }
+    mutex_.Unlock();
+    std::this_thread::yield();
+    mutex_.Lock();
+  }
+}
+
+void DBImpl::FinishAsyncWrites(std::vector<Writer*>* async_done) {
+  mutex_.AssertHeld();
+  if (async_done->empty()) {
+    return;
+  }
+  mutex_.Unlock();
+  for (Writer* w : *async_done) {
+    (*w->callback)(w->callback_arg, w->status);
+    delete w;
+  }
+  mutex_.Lock();
+  async_done->clear();
 }
 
 // REQUIRES: Writer list must be non-empty
@@ -1284,9 +2631,9 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
   // Allow the group to grow up to a maximum size, but if the
   // original write is small, limit the growth so we do not slow
   // down the small write too much.
-  size_t max_size = 1 << 20;
-  if (size <= (128 << 10)) {
-    max_size = size + (128 << 10);
+  size_t max_size = options_.max_write_group_bytes;
+  if (size <= max_size / 8) {
+    max_size = size + max_size / 8;
   }
 
   *last_writer = first;
@@ -1294,6 +2641,11 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
   ++iter;  // Advance past "first"
   for (; iter != writers_.end(); ++iter) {
     Writer* w = *iter;
+    if (w->exclusive) {
+      // Not a write, see IngestExternalFiles().
+      break;
+    }
+
     if (w->sync && !first->sync) {
       // Do not include a sync write into a batch handled by a non-sync write.
       break;
@@ -1362,7 +2714,8 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       assert(versions_->PrevLogNumber() == 0);
       uint64_t new_log_number = versions_->NewFileNumber();
       WritableFile* lfile = nullptr;
-      s = env_->NewWritableFile(LogFileName(dbname_, new_log_number), &lfile);
+      log::Writer* new_log = nullptr;
+      s = NewLogFile(new_log_number, &lfile, &new_log);
       if (!s.ok()) {
         // Avoid chewing through file number space in a tight loop.
         versions_->ReuseFileNumber(new_log_number);
@@ -1372,7 +2725,7 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       delete logfile_;
       logfile_ = lfile;
       logfile_number_ = new_log_number;
-      log_ = new log::Writer(lfile);
+      log_ = new_log;
       imm_ = mem_;
       has_imm_.store(true, std::memory_order_release);
       mem_ = new MemTable(internal_comparator_);
@@ -1384,6 +2737,321 @@ Status DBImpl::MakeRoomForWrite(bool force) {
   return s;
 }
 
+Status DBImpl::NewLogFile(uint64_t log_number, WritableFile** file,
+                          log::Writer** writer) {
+  mutex_.AssertHeld();
+  const std::string fname = LogFileName(dbname_, log_number);
+  *file = nullptr;
+  Status s;
+  if (!recycled_logs_.empty()) {
+    const uint64_t old_number = recycled_logs_.front();
+    recycled_logs_.pop_front();
+    s = env_->ReuseWritableFile(fname, LogFileName(dbname_, old_number), file);
+    Log(options_.info_log, "Reusing log #%llu as #%llu: %s\n",
+        static_cast<unsigned long long>(old_number),
+        static_cast<unsigned long long>(log_number), s.ToString().c_str());
+  }
+  if (*file == nullptr) {
+    s = env_->NewWritableFile(fname, file);
+    if (s.ok()) {
+      // Reserve room for about a memtable's worth of records, so that
+      // appends and syncs do not have to allocate space as the log grows.
+      (*file)->Preallocate(options_.write_buffer_size +
+                           options_.write_buffer_size / 10);
+    }
+  }
+  if (!s.ok()) {
+    return s;
+  }
+
+  // Logs that may be recycled later tag their records with the log number,
+  // so that stale records of a reused file are not replayed.
+  const bool recyclable = options_.recycle_log_file_num > 0;
+  if (recyclable && first_recyclable_log_ == 0) {
+    first_recyclable_log_ = log_number;
+  }
+  *writer = new log::Writer(*file, log_number, recyclable);
+  return s;
+}
+
+namespace {
+
+struct IngestedFile {
+  std::string path;    // Location the file was ingested from
+  std::string fname;   // Current location of the file
+  bool linked = false;  // Is fname a hard link to path rather than a copy?
+  uint64_t temp_number = 0;
+  FileMetaData meta;
+};
+
+// Check that "path" is a table created by SstFileWriter for the user
+// comparator "ucmp" and store its size and key range in *meta.
+Status InspectIngestedFile(const Options& options, const Comparator* ucmp,
+                           const std::string& path, FileMetaData* meta) {
+  uint64_t file_size;
+  Status s = options.env->GetFileSize(path, &file_size);
+  RandomAccessFile* file = nullptr;
+  if (s.ok()) {
+    s = options.env->NewRandomAccessFile(path, &file);
+  }
+  Table* table = nullptr;
+  if (s.ok()) {
+    s = Table::Open(options, file, file_size, &table);
+  }
+  if (s.ok() && table->ComparatorName() != ucmp->Name()) {
+    // Keys ordered by another comparator would be misplaced in the levels.
+    s = Status::InvalidArgument(
+        "ingested file was written for comparator \"" +
+            table->ComparatorName() + "\", not \"" + ucmp->Name() + "\"",
+        path);
+  }
+  if (s.ok()) {
+    Iterator* iter = table->NewRangeTombstoneIterator();
+    iter->SeekToFirst();
+    if (iter->Valid()) {
+      s = Status::InvalidArgument("ingested file has range deletions", path);
+    }
+    delete iter;
+  }
+  if (s.ok()) {
+    Iterator* iter = table->NewIterator(ReadOptions());
+    ParsedInternalKey first, last;
+    iter->SeekToFirst();
+    if (iter->Valid()) {
+      meta->smallest.DecodeFrom(iter->key());
+      iter->SeekToLast();
+      meta->largest.DecodeFrom(iter->key());
+    }
+    if (!iter->status().ok()) {
+      s = iter->status();
+    } else if (!iter->Valid()) {
+      s = Status::InvalidArgument("ingested file is empty", path);
+    } else if (!ParseInternalKey(meta->smallest.Encode(), &first) ||
+               !ParseInternalKey(meta->largest.Encode(), &last) ||
+               first.sequence != 0 || last.sequence != 0) {
+      s = Status::InvalidArgument("not a file created by SstFileWriter", path);
+    }
+    delete iter;
+  }
+  meta->file_size = file_size;
+  delete table;
+  delete file;
+  return s;
+}
+
+Status CopyFile(Env* env, const std::string& src, const std::string& dst) {
+  SequentialFile* in;
+  Status s = env->NewSequentialFile(src, &in);
+  if (!s.ok()) {
+    return s;
+  }
+  WritableFile* out;
+  s = env->NewWritableFile(dst, &out);
+  if (!s.ok()) {
+    delete in;
+    return s;
+  }
+  const size_t kBufferSize = 64 << 10;
+  char* buffer = new char[kBufferSize];
+  while (s.ok()) {
+    Slice fragment;
+    s = in->Read(kBufferSize, &fragment, buffer);
+    if (!s.ok() || fragment.empty()) {
+      break;
+    }
+    s = out->Append(fragment);
+  }
+  delete[] buffer;
+  delete in;
+  if (s.ok()) {
+    s = out->Sync();
+  }
+  if (s.ok()) {
+    s = out->Close();
+  }
+  delete out;
+  if (!s.ok()) {
+    env->RemoveFile(dst);
+  }
+  return s;
+}
+
+// Returns true if "mem" has entries or range deletions for user keys in
+// [smallest,largest].
+bool MemTableOverlaps(MemTable* mem, const Comparator* ucmp,
+                      const Slice& smallest, const Slice& largest) {
+  Iterator* iter = mem->NewIterator();
+  iter->Seek(InternalKey(smallest, kMaxSequenceNumber, kValueTypeForSeek)
+                 .Encode());
+  bool overlap =
+      iter->Valid() && ucmp->Compare(ExtractUserKey(iter->key()), largest) <= 0;
+  delete iter;
+  if (!overlap) {
+    iter = mem->NewRangeTombstoneIterator();
+    for (iter->SeekToFirst(); iter->Valid() && !overlap; iter->Next()) {
+      overlap = ucmp->Compare(ExtractUserKey(iter->key()), largest) <= 0 &&
+                ucmp->Compare(iter->value(), smallest) > 0;
+    }
+    delete iter;
+  }
+  return overlap;
+}
+
+}  // namespace
+
+Status DBImpl::IngestExternalFiles(const IngestOptions& options,
+                                   const std::vector<std::string>& paths) {
+  if (options_.ttl_seconds > 0) {
+    // Ingested values carry no write time.
+    return Status::NotSupported("ingestion into a database with ttl_seconds");
+  }
+  const Comparator* ucmp = user_comparator();
+  std::vector<IngestedFile> files(paths.size());
+  Status s;
+  for (size_t i = 0; i < files.size() && s.ok(); i++) {
+    files[i].path = paths[i];
+    s = InspectIngestedFile(options_, ucmp, paths[i], &files[i].meta);
+  }
+  if (!s.ok() || files.empty()) {
+    return s;
+  }
+  std::sort(files.begin(), files.end(),
+            [ucmp](const IngestedFile& a, const IngestedFile& b) {
+              return ucmp->Compare(a.meta.smallest.user_key(),
+                                   b.meta.smallest.user_key()) < 0;
+            });
+  for (size_t i = 1; i < files.size(); i++) {
+    if (ucmp->Compare(files[i - 1].meta.largest.user_key(),
+                      files[i].meta.smallest.user_key()) >= 0) {
+      return Status::InvalidArgument("ingested files overlap", files[i].path);
+    }
+  }
+
+  // Bring the files into the database directory under temporary names
+  // first.  They get their table file numbers only once any older level-0
+  // files have been written, so that level-0 files stay ordered by age.
+  // The originals stay in place until the files have been added: a crash
+  // before that leaves files the MANIFEST does not refer to, which are
+  // removed when the database is opened again.
+  mutex_.Lock();
+  for (IngestedFile& f : files) {
+    f.temp_number = versions_->NewFileNumber();
+    pending_outputs_.insert(f.temp_number);
+  }
+  mutex_.Unlock();
+  for (size_t i = 0; i < files.size() && s.ok(); i++) {
+    IngestedFile& f = files[i];
+    const std::string fname = TempFileName(dbname_, f.temp_number);
+    if (options.move_files && env_->LinkFile(f.path, fname).ok()) {
+      f.linked = true;
+    } else {
+      s = CopyFile(env_, f.path, fname);
+    }
+    if (s.ok()) {
+      f.fname = fname;
+    }
+  }
+
+  MutexLock l(&mutex_);
+  Writer w(&mutex_);
+  w.exclusive = true;
+  writers_.push_back(&w);
+  while (&w != writers_.front()) {
+    w.cv.Wait();
+  }
+
+  // Leading the write queue keeps the memtable from changing.  Its entries
+  // are older than the files, so if they overlap they have to be written
+  // to level-0 first to end up below the files.
+  bool mem_overlap = false;
+  for (size_t i = 0; i < files.size() && s.ok() && !mem_overlap; i++) {
+    mem_overlap =
+        MemTableOverlaps(mem_, ucmp, files[i].meta.smallest.user_key(),
+                         files[i].meta.largest.user_key());
+  }
+  if (s.ok() && mem_overlap) {
+    s = MakeRoomForWrite(true /* force */);
+  }
+  while (s.ok() && imm_ != nullptr) {
+    background_work_finished_signal_.Wait();
+    s = bg_error_;
+  }
+
+  // A compaction could produce files that overlap the ones added here at
+  // the level picked for them.
+  bool applied = false;
+  if (s.ok()) {
+    ingesting_files_ = true;
+    while (background_compaction_scheduled_) {
+      background_work_finished_signal_.Wait();
+    }
+    s = bg_error_;
+  }
+  if (s.ok()) {
+    const SequenceNumber sequence = versions_->LastSequence() + 1;
+    Version* current = versions_->current();
+    VersionEdit edit;
+    for (size_t i = 0; i < files.size() && s.ok(); i++) {
+      IngestedFile& f = files[i];
+      FileMetaData& meta = f.meta;
+      meta.number = versions_->NewFileNumber();
+      pending_outputs_.insert(meta.number);
+      const std::string fname = TableFileName(dbname_, meta.number);
+      s = env_->RenameFile(f.fname, fname);
+      if (s.ok()) {
+        f.fname = fname;
+        // Parse copies, since the user keys point into the keys replaced.
+        const InternalKey old_smallest = meta.smallest;
+        const InternalKey old_largest = meta.largest;
+        ParsedInternalKey smallest, largest;
+        ParseInternalKey(old_smallest.Encode(), &smallest);
+        ParseInternalKey(old_largest.Encode(), &largest);
+        smallest.sequence = sequence;
+        largest.sequence = sequence;
+        meta.smallest.SetFrom(smallest);
+        meta.largest.SetFrom(largest);
+        meta.global_sequence = sequence;
+        edit.AddFile(current->PickLevelForIngestedFile(
+                         meta.smallest.user_key(), meta.largest.user_key()),
+                     meta);
+      }
+    }
+    if (s.ok()) {
+      versions_->SetLastSequence(sequence);
+      s = versions_->LogAndApply(&edit, &mutex_);
+      applied = true;
+      if (!s.ok()) {
+        // The descriptor may or may not refer to the files now, so they
+        // have to stay where they are.
+        RecordBackgroundError(s);
+      } else {
+        VersionSet::LevelSummaryStorage tmp;
+        Log(options_.info_log, "Ingested %d files at sequence %llu: %s\n",
+            static_cast<int>(files.size()),
+            static_cast<unsigned long long>(sequence),
+            versions_->LevelSummary(&tmp));
+      }
+    }
+  }
+
+  for (const IngestedFile& f : files) {
+    if (!applied && !f.fname.empty()) {
+      env_->RemoveFile(f.fname);
+    } else if (applied && s.ok() && f.linked) {
+      // Complete the move.
+      env_->RemoveFile(f.path);
+    }
+    pending_outputs_.erase(f.temp_number);
+    pending_outputs_.erase(f.meta.number);
+  }
+  ingesting_files_ = false;
+  MaybeScheduleCompaction();
+
+  writers_.pop_front();
+  SignalWriteQueueHead();
+  return s;
+}
+
 bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   value->clear();
 
@@ -1424,10 +3092,41 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
         value->append(buf);
       }
     }
+    int64_t bytes_written = 0;
+    for (int level = 0; level < config::kNumLevels; level++) {
+      bytes_written += stats_[level].bytes_written;
+    }
+    std::snprintf(buf, sizeof(buf),
+                  "Compactions: %lld merges, %lld moves, %.2f MB of output "
+                  "level per MB picked\n"
+                  "Write amplification: %.2f (%.0f MB flushed)\n",
+                  static_cast<long long>(counters_.compactions),
+                  static_cast<long long>(counters_.trivial_moves),
+                  counters_.bytes_picked > 0
+                      ? static_cast<double>(counters_.bytes_overlapped) /
+                            counters_.bytes_picked
+                      : 0.0,
+                  counters_.bytes_flushed > 0
+                      ? static_cast<double>(bytes_written) /
+                            counters_.bytes_flushed
+                      : 0.0,
+                  counters_.bytes_flushed / 1048576.0);
+    value->append(buf);
+    if (options_.rate_limiter != nullptr) {
+      // Covers all users of the limiter if it is shared between databases.
+      std::snprintf(
+          buf, sizeof(buf), "Rate limiter: %.1f MB/s, throttled %.3f sec\n",
+          options_.rate_limiter->GetBytesPerSecond() / 1048576.0,
+          options_.rate_limiter->GetTotalThrottledMicros() / 1e6);
+      value->append(buf);
+    }
     return true;
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "tables-by-deletion-ratio") {
+    versions_->AppendTablesByDeletionRatio(10, value);
+    return true;
   } else if (in == "approximate-memory-usage") {
     size_t total_usage = options_.block_cache->TotalCharge();
     if (mem_) {
@@ -1478,6 +3177,53 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::Merge(const WriteOptions& opt, const Slice& key,
+                 const Slice& value) {
+  WriteBatch batch;
+  batch.Merge(key, value);
+  return Write(opt, &batch);
+}
+
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin_key,
+                       const Slice& end_key) {
+  WriteBatch batch;
+  batch.DeleteRange(begin_key, end_key);
+  return Write(opt, &batch);
+}
+
+void DB::WriteAsync(const WriteOptions& options, WriteBatch* updates,
+                    WriteCallback callback, void* arg) {
+  Status s = Write(options, updates);
+  (*callback)(arg, s);
+}
+
+Status DB::IngestExternalFiles(const IngestOptions& options,
+                               const std::vector<std::string>& paths) {
+  return Status::NotSupported("IngestExternalFiles");
+}
+
+std::vector<Status> DB::MultiGet(const ReadOptions& options,
+                                 const std::vector<Slice>& keys,
+                                 std::vector<std::string>* values) {
+  std::vector<Status> statuses(keys.size());
+  values->resize(keys.size());
+
+  // Use a snapshot so that all lookups observe the same state.
+  ReadOptions read_options = options;
+  const Snapshot* snapshot = nullptr;
+  if (options.snapshot == nullptr) {
+    snapshot = GetSnapshot();
+    read_options.snapshot = snapshot;
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    statuses[i] = Get(read_options, keys[i], &(*values)[i]);
+  }
+  if (snapshot != nullptr) {
+    ReleaseSnapshot(snapshot);
+  }
+  return statuses;
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
@@ -1493,20 +3239,21 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     // Create new log and a corresponding memtable.
     uint64_t new_log_number = impl->versions_->NewFileNumber();
     WritableFile* lfile;
-    s = options.env->NewWritableFile(LogFileName(dbname, new_log_number),
-                                     &lfile);
+    log::Writer* writer;
+    s = impl->NewLogFile(new_log_number, &lfile, &writer);
     if (s.ok()) {
-      edit.SetLogNumber(new_log_number);
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
-      impl->log_ = new log::Writer(lfile);
+      impl->log_ = writer;
       impl->mem_ = new MemTable(impl->internal_comparator_);
       impl->mem_->Ref();
     }
   }
   if (s.ok() && save_manifest) {
     edit.SetPrevLogNumber(0);  // No older logs needed after recovery.
-    edit.SetLogNumber(impl->logfile_number_);
+    if (impl->imm_ == nullptr) {
+      edit.SetLogNumber(impl->logfile_number_);
+    }
     s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
   }
   if (s.ok()) {
@@ -1514,6 +3261,9 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     impl->MaybeScheduleCompaction();
   }
   impl->mutex_.Unlock();
+  if (s.ok() && impl->options_.preload_tables_on_open) {
+    impl->PreloadTables();
+  }
   if (s.ok()) {
     assert(impl->mem_ != nullptr);
     *dbptr = impl;
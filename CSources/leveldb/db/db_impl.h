@@ -9,6 +9,7 @@
 #include <deque>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "db/log_writer.h"
@@ -20,6 +21,7 @@
 
 namespace leveldb {
 
+class BlobFileCache;
 class MemTable;
 class TableCache;
 class Version;
@@ -39,9 +41,20 @@ class DBImpl : public DB {
   Status Put(const WriteOptions&, const Slice& key,
              const Slice& value) override;
   Status Delete(const WriteOptions&, const Slice& key) override;
+  Status Merge(const WriteOptions&, const Slice& key,
+               const Slice& value) override;
+  Status DeleteRange(const WriteOptions&, const Slice& begin_key,
+                     const Slice& end_key) override;
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
+  void WriteAsync(const WriteOptions& options, WriteBatch* updates,
+                  WriteCallback callback, void* arg) override;
+  Status IngestExternalFiles(const IngestOptions& options,
+                             const std::vector<std::string>& paths) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
+  std::vector<Status> MultiGet(const ReadOptions& options,
+                               const std::vector<Slice>& keys,
+                               std::vector<std::string>* values) override;
   Iterator* NewIterator(const ReadOptions&) override;
   const Snapshot* GetSnapshot() override;
   void ReleaseSnapshot(const Snapshot* snapshot) override;
@@ -57,6 +70,9 @@ class DBImpl : public DB {
   // Force current memtable contents to be compacted.
   Status TEST_CompactMemTable();
 
+  // Wait until no compaction is running or needed.
+  Status TEST_WaitForCompactions();
+
   // Return an internal iterator over the current state of the database.
   // The keys of this iterator are internal keys (see format.h).
   // The returned iterator should be deleted when no longer needed.
@@ -75,6 +91,7 @@ class DBImpl : public DB {
   friend class DB;
   struct CompactionState;
   struct Writer;
+  struct RecoveryFlush;
 
   // Information for a manual compaction
   struct ManualCompaction {
@@ -101,9 +118,29 @@ class DBImpl : public DB {
     int64_t bytes_written;
   };
 
+  // Totals over all compactions since the database was opened, for
+  // comparing compaction policies.
+  struct CompactionCounters {
+    CompactionCounters()
+        : bytes_flushed(0),
+          compactions(0),
+          trivial_moves(0),
+          bytes_picked(0),
+          bytes_overlapped(0) {}
+
+    int64_t bytes_flushed;     // Written by memtable flushes
+    int64_t compactions;       // Compactions that merged files
+    int64_t trivial_moves;     // Files moved to the next level as they are
+    int64_t bytes_picked;      // Inputs of the compacted level
+    int64_t bytes_overlapped;  // Inputs of the output level
+  };
+
+  // If "range_del_iters" is non-null, iterators over the range deletions
+  // that apply to the returned iterator are appended to it.
   Iterator* NewInternalIterator(const ReadOptions&,
                                 SequenceNumber* latest_snapshot,
-                                uint32_t* seed);
+                                uint32_t* seed,
+                                std::vector<Iterator*>* range_del_iters);
 
   Status NewDB();
 
@@ -123,18 +160,63 @@ class DBImpl : public DB {
   // Errors are recorded in bg_error_.
   void CompactMemTable() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status RecoverLogFile(uint64_t log_number, bool last_log, bool* save_manifest,
-                        VersionEdit* edit, SequenceNumber* max_sequence)
+  // Replay the log files "logs" in order.  Reading and checksumming the
+  // files runs on separate threads ahead of the replay, and level-0 tables
+  // are built in the background while replay continues.
+  Status RecoverLogFiles(const std::vector<uint64_t>& logs,
+                         bool* save_manifest, VersionEdit* edit,
+                         SequenceNumber* max_sequence)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Background level-0 table build started by RecoverLogFiles().
+  static void BGRecoveryFlush(void* arg);
+  Status StartRecoveryFlush(RecoveryFlush* flush, MemTable* mem)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  Status WaitForRecoveryFlush(RecoveryFlush* flush)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Open the tables of the current version into table_cache_ on
+  // options_.preload_table_threads threads, see
+  // Options::preload_tables_on_open.
+  void PreloadTables() LOCKS_EXCLUDED(mutex_);
+
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Create log file "log_number", reusing a recycled log file if there is
+  // one, and a writer for it.
+  Status NewLogFile(uint64_t log_number, WritableFile** file,
+                    log::Writer** writer) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatch* BuildBatchGroup(Writer** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Log and apply the group of writes led by "leader", the front of
+  // writers_, and remove it from the queue.  Writers of the group queued by
+  // WriteAsync() are appended to "*async_done" instead of being woken up.
+  Status CommitWriteGroup(Writer* leader, std::vector<Writer*>* async_done)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Wait up to options_.sync_write_group_wait_micros for as many sync
+  // writers to queue up as the last sync group had.
+  void WaitForSyncWriteGroup() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Call the callbacks of the writers in "*async_done" without holding
+  // mutex_, delete the writers and clear the vector.
+  void FinishAsyncWrites(std::vector<Writer*>* async_done)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Wake up the thread that leads the write queue next: the one waiting for
+  // the front writer, or the async writer thread if WriteAsync() queued it.
+  void SignalWriteQueueHead() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Commits the writes queued by WriteAsync() that no other thread leads.
+  // Runs on a thread started by the first WriteAsync() call.
+  static void AsyncWriterMain(void* db);
+  void AsyncWriterLoop();
+
   void RecordBackgroundError(const Status& s);
 
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -146,11 +228,32 @@ class DBImpl : public DB {
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Load the range tombstones of the compaction inputs into *compact and
+  // drop the inputs they delete entirely.
+  Status LoadCompactionRangeTombstones(CompactionState* compact)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status OpenCompactionOutputFile(CompactionState* compact);
-  Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  // "limit" is the user key the next output starts at, or null if this is
+  // the last output.
+  Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input,
+                                    const Slice* limit);
+  void AddCompactionRangeTombstones(CompactionState* compact,
+                                    const Slice* limit);
+  Status AddCompactionOutput(CompactionState* compact, Slice key,
+                             Slice value);
+  Status CompactMergeOperands(CompactionState* compact, Iterator* input,
+                              const Slice& user_key, SequenceNumber sequence);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Return the write time before which values have expired, see
+  // Options::ttl_seconds, or zero if nothing expires.
+  uint32_t ExpiryCutoff() const;
+
+  // Delete the table files that hold only values written before "cutoff",
+  // without compacting them.  Errors are recorded in bg_error_.
+  void RemoveExpiredFiles(uint32_t cutoff) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   const Comparator* user_comparator() const {
     return internal_comparator_.user_comparator();
   }
@@ -164,8 +267,9 @@ class DBImpl : public DB {
   const bool owns_cache_;
   const std::string dbname_;
 
-  // table_cache_ provides its own synchronization
+  // table_cache_ and blob_cache_ provide their own synchronization
   TableCache* const table_cache_;
+  BlobFileCache* const blob_cache_;
 
   // Lock over the persistent DB state.  Non-null iff successfully acquired.
   FileLock* db_lock_;
@@ -182,8 +286,22 @@ class DBImpl : public DB {
   log::Writer* log_;
   uint32_t seed_ GUARDED_BY(mutex_);  // For sampling.
 
+  // Obsolete log files kept for reuse by NewLogFile(), oldest first.  Only
+  // logs numbered first_recyclable_log_ or higher were written with
+  // recyclable records by this instance and may be recycled.
+  std::deque<uint64_t> recycled_logs_ GUARDED_BY(mutex_);
+  uint64_t first_recyclable_log_ GUARDED_BY(mutex_);  // 0 if none
+
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
+  int pending_async_writes_ GUARDED_BY(mutex_);  // Queued by WriteAsync()
+  // Signaled when the async writer thread has work or has exited, and when
+  // WriteAsync() may queue another write.
+  port::CondVar async_writes_cv_ GUARDED_BY(mutex_);
+  bool async_writer_running_ GUARDED_BY(mutex_);
+  bool stop_async_writer_ GUARDED_BY(mutex_);  // Exit once queue is empty
+  // Sync writers in the last group led by a sync write.
+  size_t last_sync_group_size_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
   SnapshotList snapshots_ GUARDED_BY(mutex_);
@@ -195,6 +313,11 @@ class DBImpl : public DB {
   // Has a background compaction been scheduled or is running?
   bool background_compaction_scheduled_ GUARDED_BY(mutex_);
 
+  // Is IngestExternalFiles() waiting for compactions to stop or adding
+  // files?  No compactions other than memtable compactions are scheduled
+  // while it is.
+  bool ingesting_files_ GUARDED_BY(mutex_);
+
   ManualCompaction* manual_compaction_ GUARDED_BY(mutex_);
 
   VersionSet* const versions_ GUARDED_BY(mutex_);
@@ -203,6 +326,7 @@ class DBImpl : public DB {
   Status bg_error_ GUARDED_BY(mutex_);
 
   CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
+  CompactionCounters counters_ GUARDED_BY(mutex_);
 };
 
 // Sanitize db options.  The caller should delete result.info_log if
@@ -4,9 +4,16 @@
 
 #include "db/db_iter.h"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "db/blob_file_cache.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/merge_helper.h"
+#include "db/range_del.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "port/port.h"
@@ -43,15 +50,29 @@ class DBIter : public Iterator {
   //     the exact entry that yields this->key(), this->value()
   // (2) When moving backwards, the internal iterator is positioned
   //     just before all entries whose user key == this->key().
+  // Exception: when moving forward and this->value() was merged from the
+  // operands of this->key(), the internal iterator is positioned just
+  // after all entries whose user key == this->key().
   enum Direction { kForward, kReverse };
 
-  DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
+  DBIter(DBImpl* db, const Comparator* cmp, const MergeOperator* merge_op,
+         RangeDelAggregator* range_del, bool has_timestamps,
+         uint32_t expiry_cutoff, BlobFileCache* blob_cache,
+         const ReadOptions& options, Iterator* iter, SequenceNumber s,
          uint32_t seed)
       : db_(db),
         user_comparator_(cmp),
+        merge_operator_(merge_op),
+        range_del_(range_del),
+        value_suffix_size_(has_timestamps ? kValueTimestampSize : 0),
+        expiry_cutoff_(expiry_cutoff),
+        blob_cache_(blob_cache),
+        blob_options_(options),
         iter_(iter),
         sequence_(s),
         direction_(kForward),
+        merged_(false),
+        blob_value_(false),
         valid_(false),
         rnd_(seed),
         bytes_until_read_sampling_(RandomCompactionPeriod()) {}
@@ -59,15 +80,23 @@ class DBIter : public Iterator {
   DBIter(const DBIter&) = delete;
   DBIter& operator=(const DBIter&) = delete;
 
-  ~DBIter() override { delete iter_; }
+  ~DBIter() override {
+    delete iter_;
+    delete range_del_;
+  }
   bool Valid() const override { return valid_; }
   Slice key() const override {
     assert(valid_);
-    return (direction_ == kForward) ? ExtractUserKey(iter_->key()) : saved_key_;
+    return (direction_ == kForward && !merged_) ? ExtractUserKey(iter_->key())
+                                                : saved_key_;
   }
   Slice value() const override {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    if (direction_ == kForward && !merged_ && !blob_value_) {
+      Slice v = iter_->value();
+      return Slice(v.data(), v.size() - value_suffix_size_);
+    }
+    return saved_value_;
   }
   Status status() const override {
     if (status_.ok()) {
@@ -86,6 +115,7 @@ class DBIter : public Iterator {
  private:
   void FindNextUserEntry(bool skipping, std::string* skip);
   void FindPrevUserEntry();
+  void MergeForward();
   bool ParseKey(ParsedInternalKey* key);
 
   inline void SaveKey(const Slice& k, std::string* dst) {
@@ -108,12 +138,20 @@ class DBIter : public Iterator {
 
   DBImpl* db_;
   const Comparator* const user_comparator_;
+  const MergeOperator* const merge_operator_;
+  RangeDelAggregator* const range_del_;
+  const size_t value_suffix_size_;  // Write time stored after values
+  const uint32_t expiry_cutoff_;
+  BlobFileCache* const blob_cache_;
+  const ReadOptions blob_options_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
   Status status_;
   std::string saved_key_;    // == current key when direction_==kReverse
   std::string saved_value_;  // == current raw value when direction_==kReverse
   Direction direction_;
+  bool merged_;  // Current value was merged; key and value are saved_*_
+  bool blob_value_;  // Current value was read from a blob into saved_value_
   bool valid_;
   Random rnd_;
   size_t bytes_until_read_sampling_;
@@ -133,9 +171,24 @@ inline bool DBIter::ParseKey(ParsedInternalKey* ikey) {
   if (!ParseInternalKey(k, ikey)) {
     status_ = Status::Corruption("corrupted internal key in DBIter");
     return false;
-  } else {
-    return true;
   }
+  if (range_del_ != nullptr && range_del_->ShouldDelete(*ikey)) {
+    // An entry within a deleted range hides the older entries for its key
+    // just like a deletion marker would.
+    ikey->type = kTypeDeletion;
+  }
+  if (value_suffix_size_ > 0 && ikey->type == kTypeValue) {
+    uint32_t timestamp;
+    if (!ExtractValueTimestamp(iter_->value(), &timestamp)) {
+      status_ = Status::Corruption("value without timestamp in DBIter");
+      return false;
+    }
+    if (timestamp < expiry_cutoff_) {
+      // Expired values hide the older entries for their key too.
+      ikey->type = kTypeDeletion;
+    }
+  }
+  return true;
 }
 
 void DBIter::Next() {
@@ -157,6 +210,16 @@ void DBIter::Next() {
       return;
     }
     // saved_key_ already contains the key to skip past.
+  } else if (merged_) {
+    // iter_ is already past the entries for this->key(), which is in
+    // saved_key_ so that FindNextUserEntry() skips it.
+    merged_ = false;
+    ClearSavedValue();
+    if (!iter_->Valid()) {
+      valid_ = false;
+      saved_key_.clear();
+      return;
+    }
   } else {
     // Store in saved_key_ the current key so we skip it below.
     SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
@@ -178,10 +241,12 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   // Loop until we hit an acceptable entry to yield
   assert(iter_->Valid());
   assert(direction_ == kForward);
+  blob_value_ = false;
   do {
     ParsedInternalKey ikey;
     if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
       switch (ikey.type) {
+        case kTypeRangeDeletion:  // Never stored with the point entries
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
           // they are hidden by this deletion.
@@ -189,12 +254,26 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
           skipping = true;
           break;
         case kTypeValue:
+        case kTypeMerge:
+        case kTypeBlobIndex:
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
+          } else if (ikey.type == kTypeMerge) {
+            MergeForward();
+            return;
           } else {
-            valid_ = true;
             saved_key_.clear();
+            if (ikey.type == kTypeBlobIndex) {
+              status_ = blob_cache_->Get(blob_options_, ikey.user_key,
+                                         iter_->value(), &saved_value_);
+              if (!status_.ok()) {
+                valid_ = false;
+                return;
+              }
+              blob_value_ = true;
+            }
+            valid_ = true;
             return;
           }
           break;
@@ -206,14 +285,76 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   valid_ = false;
 }
 
+void DBIter::MergeForward() {
+  // iter_ is at the newest visible merge operand of a key.  Collect the
+  // operands and the value below them, leaving iter_ past the key's
+  // entries.
+  SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+  std::vector<std::string> operands(1, iter_->value().ToString());
+  std::string existing_value;
+  bool has_existing_value = false;
+  Status s;
+  for (iter_->Next(); iter_->Valid(); iter_->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseKey(&ikey) ||
+        user_comparator_->Compare(ikey.user_key, saved_key_) != 0) {
+      break;
+    }
+    if (ikey.type == kTypeMerge) {
+      operands.push_back(iter_->value().ToString());
+      continue;
+    }
+    if (ikey.type == kTypeValue) {
+      Slice v = iter_->value();
+      existing_value.assign(v.data(), v.size() - value_suffix_size_);
+      has_existing_value = true;
+    } else if (ikey.type == kTypeBlobIndex) {
+      s = blob_cache_->Get(blob_options_, ikey.user_key, iter_->value(),
+                           &existing_value);
+      has_existing_value = true;
+    }
+    // Skip the entries hidden by the value or deletion.
+    do {
+      iter_->Next();
+    } while (iter_->Valid() &&
+             user_comparator_->Compare(ExtractUserKey(iter_->key()),
+                                       saved_key_) == 0);
+    break;
+  }
+
+  const Slice existing(existing_value);
+  if (s.ok()) {
+    s = ApplyMergeOperands(merge_operator_, saved_key_,
+                           has_existing_value ? &existing : nullptr, operands,
+                           &saved_value_);
+  }
+  if (!s.ok()) {
+    status_ = s;
+    valid_ = false;
+    saved_key_.clear();
+    ClearSavedValue();
+    return;
+  }
+  merged_ = true;
+  valid_ = true;
+}
+
 void DBIter::Prev() {
   assert(valid_);
 
   if (direction_ == kForward) {  // Switch directions?
     // iter_ is pointing at the current entry.  Scan backwards until
     // the key changes so we can use the normal reverse scanning code.
-    assert(iter_->Valid());  // Otherwise valid_ would have been false
-    SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+    if (merged_) {
+      // iter_ is past the entries for this->key(), which is in saved_key_.
+      merged_ = false;
+      if (!iter_->Valid()) {
+        iter_->SeekToLast();
+      }
+    } else {
+      assert(iter_->Valid());  // Otherwise valid_ would have been false
+      SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+    }
     while (true) {
       iter_->Prev();
       if (!iter_->Valid()) {
@@ -237,6 +378,12 @@ void DBIter::FindPrevUserEntry() {
   assert(direction_ == kReverse);
 
   ValueType value_type = kTypeDeletion;
+  // Merge operands above the value in saved_value_, if has_value, or
+  // above nothing, oldest first.  If blob_index, saved_value_ holds the
+  // blob index of the value.
+  std::vector<std::string> operands;
+  bool has_value = false;
+  bool blob_index = false;
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
@@ -250,20 +397,52 @@ void DBIter::FindPrevUserEntry() {
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
           ClearSavedValue();
+          operands.clear();
+          has_value = false;
+        } else if (value_type == kTypeMerge) {
+          SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+          operands.push_back(iter_->value().ToString());
         } else {
+          operands.clear();
+          has_value = true;
+          blob_index = (value_type == kTypeBlobIndex);
           Slice raw_value = iter_->value();
           if (saved_value_.capacity() > raw_value.size() + 1048576) {
             std::string empty;
             swap(empty, saved_value_);
           }
           SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
-          saved_value_.assign(raw_value.data(), raw_value.size());
+          saved_value_.assign(raw_value.data(),
+                              raw_value.size() - value_suffix_size_);
         }
       }
       iter_->Prev();
     } while (iter_->Valid());
   }
 
+  if (value_type != kTypeDeletion && has_value && blob_index) {
+    const std::string index = saved_value_;
+    Status s = blob_cache_->Get(blob_options_, saved_key_, index,
+                                &saved_value_);
+    if (!s.ok()) {
+      status_ = s;
+      value_type = kTypeDeletion;
+    }
+  }
+
+  if (value_type == kTypeMerge) {
+    std::reverse(operands.begin(), operands.end());
+    const std::string existing_value = has_value ? saved_value_ : "";
+    const Slice existing(existing_value);
+    Status s = ApplyMergeOperands(merge_operator_, saved_key_,
+                                  has_value ? &existing : nullptr, operands,
+                                  &saved_value_);
+    if (!s.ok()) {
+      status_ = s;
+      value_type = kTypeDeletion;
+    }
+  }
+
   if (value_type == kTypeDeletion) {
     // End
     valid_ = false;
@@ -277,6 +456,7 @@ void DBIter::FindPrevUserEntry() {
 
 void DBIter::Seek(const Slice& target) {
   direction_ = kForward;
+  merged_ = false;
   ClearSavedValue();
   saved_key_.clear();
   AppendInternalKey(&saved_key_,
@@ -291,6 +471,7 @@ void DBIter::Seek(const Slice& target) {
 
 void DBIter::SeekToFirst() {
   direction_ = kForward;
+  merged_ = false;
   ClearSavedValue();
   iter_->SeekToFirst();
   if (iter_->Valid()) {
@@ -302,6 +483,7 @@ void DBIter::SeekToFirst() {
 
 void DBIter::SeekToLast() {
   direction_ = kReverse;
+  merged_ = false;
   ClearSavedValue();
   iter_->SeekToLast();
   FindPrevUserEntry();
@@ -310,9 +492,14 @@ void DBIter::SeekToLast() {
 }  // anonymous namespace
 
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
-                        Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                        const MergeOperator* merge_operator,
+                        RangeDelAggregator* range_del, bool has_timestamps,
+                        uint32_t expiry_cutoff, BlobFileCache* blob_cache,
+                        const ReadOptions& options, Iterator* internal_iter,
+                        SequenceNumber sequence, uint32_t seed) {
+  return new DBIter(db, user_key_comparator, merge_operator, range_del,
+                    has_timestamps, expiry_cutoff, blob_cache, options,
+                    internal_iter, sequence, seed);
 }
 
 }  // namespace leveldb
@@ -12,14 +12,26 @@
 
 namespace leveldb {
 
+class BlobFileCache;
 class DBImpl;
+class MergeOperator;
+class RangeDelAggregator;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  Merge operands are combined with
+// "merge_operator".  Entries deleted by the range deletions in
+// "*range_del", if not null, are skipped; the iterator takes ownership
+// of it.  If "has_timestamps" is set, values carry their write time (see
+// kValueTimestampSize), and those written before "expiry_cutoff" are
+// skipped.  Values stored in blob files are read through "*blob_cache"
+// with "options".
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
-                        Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed);
+                        const MergeOperator* merge_operator,
+                        RangeDelAggregator* range_del, bool has_timestamps,
+                        uint32_t expiry_cutoff, BlobFileCache* blob_cache,
+                        const ReadOptions& options, Iterator* internal_iter,
+                        SequenceNumber sequence, uint32_t seed);
 
 }  // namespace leveldb
 
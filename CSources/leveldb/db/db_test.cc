@@ -0,0 +1,2288 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/db.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "db/db_impl.h"
+#include "db/dbformat.h"
+#include "db/filename.h"
+#include "db/log_reader.h"
+#include "db/log_writer.h"
+#include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
+#include "leveldb/compaction_filter.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/merge_operator.h"
+#include "leveldb/rate_limiter.h"
+#include "leveldb/sst_file_writer.h"
+#include "leveldb/write_batch.h"
+#include "port/port.h"
+#include "table/format.h"
+#include "util/mutexlock.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+namespace {
+
+// Counts the reads issued through the table files it opens.  Reads are
+// copied into the caller's buffer, as with pread(), so that the blocks read
+// are cached even when the base environment maps table files into memory.
+class CountingEnv : public EnvWrapper {
+ public:
+  explicit CountingEnv(Env* base) : EnvWrapper(base), reads_(0) {}
+
+  Status NewRandomAccessFile(const std::string& f,
+                             RandomAccessFile** r) override {
+    Status s = target()->NewRandomAccessFile(f, r);
+    if (s.ok()) {
+      *r = new CountingFile(*r, &reads_);
+    }
+    return s;
+  }
+
+  int reads() const { return reads_.load(std::memory_order_relaxed); }
+  void ResetReads() { reads_.store(0, std::memory_order_relaxed); }
+
+ private:
+  class CountingFile : public RandomAccessFile {
+   public:
+    CountingFile(RandomAccessFile* target, std::atomic<int>* reads)
+        : target_(target), reads_(reads) {}
+    ~CountingFile() override { delete target_; }
+
+    Status Read(uint64_t offset, size_t n, Slice* result,
+                char* scratch) const override {
+      reads_->fetch_add(1, std::memory_order_relaxed);
+      Status s = target_->Read(offset, n, result, scratch);
+      if (s.ok() && result->data() != scratch) {
+        std::memcpy(scratch, result->data(), result->size());
+        *result = Slice(scratch, result->size());
+      }
+      return s;
+    }
+
+    // A batch counts as a single read, as the requests of a batch that lie
+    // close together are read with one system call.
+    Status MultiRead(ReadRequest* requests, size_t n) const override {
+      reads_->fetch_add(1, std::memory_order_relaxed);
+      Status s = target_->MultiRead(requests, n);
+      for (size_t i = 0; i < n; i++) {
+        ReadRequest* request = &requests[i];
+        if (request->status.ok() &&
+            request->result.data() != request->scratch) {
+          std::memcpy(request->scratch, request->result.data(),
+                      request->result.size());
+          request->result = Slice(request->scratch, request->result.size());
+        }
+      }
+      return s;
+    }
+
+   private:
+    RandomAccessFile* const target_;
+    std::atomic<int>* const reads_;
+  };
+
+  std::atomic<int> reads_;
+};
+
+// Counts how table files are opened.
+class FileOpenCountingEnv : public EnvWrapper {
+ public:
+  explicit FileOpenCountingEnv(Env* base)
+      : EnvWrapper(base),
+        table_reads_(0),
+        direct_table_reads_(0),
+        table_writes_(0),
+        direct_table_writes_(0) {}
+
+  Status NewRandomAccessFile(const std::string& f,
+                             RandomAccessFile** r) override {
+    Count(f, &table_reads_);
+    return target()->NewRandomAccessFile(f, r);
+  }
+  Status NewDirectRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) override {
+    Count(f, &direct_table_reads_);
+    return target()->NewDirectRandomAccessFile(f, r);
+  }
+  Status NewWritableFile(const std::string& f, WritableFile** r) override {
+    Count(f, &table_writes_);
+    return target()->NewWritableFile(f, r);
+  }
+  Status NewDirectWritableFile(const std::string& f,
+                               WritableFile** r) override {
+    Count(f, &direct_table_writes_);
+    return target()->NewDirectWritableFile(f, r);
+  }
+
+  int table_reads() const { return table_reads_.load(); }
+  int direct_table_reads() const { return direct_table_reads_.load(); }
+  int table_writes() const { return table_writes_.load(); }
+  int direct_table_writes() const { return direct_table_writes_.load(); }
+
+ private:
+  static void Count(const std::string& f, std::atomic<int>* counter) {
+    if (f.size() > 4 && f.compare(f.size() - 4, 4, ".ldb") == 0) {
+      counter->fetch_add(1);
+    }
+  }
+
+  std::atomic<int> table_reads_;
+  std::atomic<int> direct_table_reads_;
+  std::atomic<int> table_writes_;
+  std::atomic<int> direct_table_writes_;
+};
+
+// Records how many table files had been created when each log file was
+// opened for reading.
+class LogReadOrderEnv : public EnvWrapper {
+ public:
+  explicit LogReadOrderEnv(Env* base) : EnvWrapper(base), tables_(0) {}
+
+  Status NewSequentialFile(const std::string& f,
+                           SequentialFile** r) override {
+    if (f.size() > 4 && f.compare(f.size() - 4, 4, ".log") == 0) {
+      MutexLock l(&mu_);
+      tables_at_log_open_[f] = tables_;
+    }
+    return target()->NewSequentialFile(f, r);
+  }
+
+  Status NewWritableFile(const std::string& f, WritableFile** r) override {
+    if (f.size() > 4 && f.compare(f.size() - 4, 4, ".ldb") == 0) {
+      MutexLock l(&mu_);
+      tables_++;
+    }
+    return target()->NewWritableFile(f, r);
+  }
+
+  // Returns -1 if log "f" was not opened.
+  int tables_at_log_open(const std::string& f) {
+    MutexLock l(&mu_);
+    auto it = tables_at_log_open_.find(f);
+    return it == tables_at_log_open_.end() ? -1 : it->second;
+  }
+
+ private:
+  port::Mutex mu_;
+  int tables_ GUARDED_BY(mu_);
+  std::map<std::string, int> tables_at_log_open_ GUARDED_BY(mu_);
+};
+
+// Records the log files created by reusing an old one, and checks that
+// the reused file keeps the inode of the old one.
+class LogReuseEnv : public EnvWrapper {
+ public:
+  explicit LogReuseEnv(Env* base)
+      : EnvWrapper(base), reuses_(0), last_log_reused_(false) {}
+
+  Status NewWritableFile(const std::string& f, WritableFile** r) override {
+    if (f.size() > 4 && f.compare(f.size() - 4, 4, ".log") == 0) {
+      MutexLock l(&mu_);
+      last_log_reused_ = false;
+    }
+    return target()->NewWritableFile(f, r);
+  }
+
+  Status ReuseWritableFile(const std::string& f, const std::string& old_f,
+                           WritableFile** r) override {
+    struct ::stat old_stat;
+    EXPECT_EQ(0, ::stat(old_f.c_str(), &old_stat)) << old_f;
+    Status s = target()->ReuseWritableFile(f, old_f, r);
+    if (s.ok()) {
+      struct ::stat new_stat;
+      EXPECT_EQ(0, ::stat(f.c_str(), &new_stat)) << f;
+      EXPECT_EQ(old_stat.st_ino, new_stat.st_ino) << f;
+      MutexLock l(&mu_);
+      reuses_++;
+      last_log_reused_ = true;
+    }
+    return s;
+  }
+
+  int reuses() {
+    MutexLock l(&mu_);
+    return reuses_;
+  }
+
+  // True if the newest log file is a reused one.
+  bool last_log_reused() {
+    MutexLock l(&mu_);
+    return last_log_reused_;
+  }
+
+ private:
+  port::Mutex mu_;
+  int reuses_ GUARDED_BY(mu_);
+  bool last_log_reused_ GUARDED_BY(mu_);
+};
+
+// Counts the RangeSync() calls on table and log files.
+class RangeSyncCountingEnv : public EnvWrapper {
+ public:
+  explicit RangeSyncCountingEnv(Env* base)
+      : EnvWrapper(base), table_syncs_(0), log_syncs_(0) {}
+
+  Status NewWritableFile(const std::string& f, WritableFile** r) override {
+    Status s = target()->NewWritableFile(f, r);
+    if (s.ok()) {
+      if (f.size() > 4 && f.compare(f.size() - 4, 4, ".ldb") == 0) {
+        *r = new CountingFile(*r, &table_syncs_);
+      } else if (f.size() > 4 && f.compare(f.size() - 4, 4, ".log") == 0) {
+        *r = new CountingFile(*r, &log_syncs_);
+      }
+    }
+    return s;
+  }
+
+  int table_syncs() const { return table_syncs_.load(); }
+  int log_syncs() const { return log_syncs_.load(); }
+
+ private:
+  class CountingFile : public WritableFile {
+   public:
+    CountingFile(WritableFile* target, std::atomic<int>* syncs)
+        : target_(target), syncs_(syncs) {}
+    ~CountingFile() override { delete target_; }
+
+    Status Append(const Slice& data) override { return target_->Append(data); }
+    Status Close() override { return target_->Close(); }
+    Status Flush() override { return target_->Flush(); }
+    Status Sync() override { return target_->Sync(); }
+    Status RangeSync(uint64_t offset, uint64_t nbytes) override {
+      syncs_->fetch_add(1);
+      return target_->RangeSync(offset, nbytes);
+    }
+
+   private:
+    WritableFile* const target_;
+    std::atomic<int>* const syncs_;
+  };
+
+  std::atomic<int> table_syncs_;
+  std::atomic<int> log_syncs_;
+};
+
+// Makes each sync of a log file take a millisecond, so that concurrent
+// writers queue up behind it.
+class SlowLogSyncEnv : public EnvWrapper {
+ public:
+  explicit SlowLogSyncEnv(Env* base) : EnvWrapper(base) {}
+
+  Status NewWritableFile(const std::string& f, WritableFile** r) override {
+    Status s = target()->NewWritableFile(f, r);
+    if (s.ok() && f.size() > 4 && f.compare(f.size() - 4, 4, ".log") == 0) {
+      *r = new SlowSyncFile(*r, this);
+    }
+    return s;
+  }
+
+ private:
+  class SlowSyncFile : public WritableFile {
+   public:
+    SlowSyncFile(WritableFile* target, Env* env) : target_(target), env_(env) {}
+    ~SlowSyncFile() override { delete target_; }
+
+    Status Append(const Slice& data) override { return target_->Append(data); }
+    Status Close() override { return target_->Close(); }
+    Status Flush() override { return target_->Flush(); }
+    Status Sync() override {
+      env_->SleepForMicroseconds(1000);
+      return target_->Sync();
+    }
+
+   private:
+    WritableFile* const target_;
+    Env* const env_;
+  };
+};
+
+// Queues the background work scheduled while held, so that nothing the
+// database schedules runs before Release().
+class HeldBackgroundWorkEnv : public EnvWrapper {
+ public:
+  explicit HeldBackgroundWorkEnv(Env* base) : EnvWrapper(base), held_(false) {}
+
+  void Schedule(void (*function)(void*), void* arg) override {
+    MutexLock l(&mu_);
+    if (held_) {
+      work_.emplace_back(function, arg);
+    } else {
+      target()->Schedule(function, arg);
+    }
+  }
+
+  void Hold() {
+    MutexLock l(&mu_);
+    held_ = true;
+  }
+
+  void Release() {
+    MutexLock l(&mu_);
+    held_ = false;
+    for (const auto& work : work_) {
+      target()->Schedule(work.first, work.second);
+    }
+    work_.clear();
+  }
+
+ private:
+  port::Mutex mu_;
+  bool held_ GUARDED_BY(mu_);
+  std::vector<std::pair<void (*)(void*), void*>> work_ GUARDED_BY(mu_);
+};
+
+// Makes appends to log files wait while blocked, to hold up writes while
+// they are being committed.
+class BlockingLogEnv : public EnvWrapper {
+ public:
+  explicit BlockingLogEnv(Env* base)
+      : EnvWrapper(base), cv_(&mu_), blocked_(false) {}
+
+  Status NewWritableFile(const std::string& f, WritableFile** r) override {
+    Status s = target()->NewWritableFile(f, r);
+    if (s.ok() && f.size() > 4 && f.compare(f.size() - 4, 4, ".log") == 0) {
+      *r = new BlockingFile(*r, this);
+    }
+    return s;
+  }
+
+  void Block() {
+    MutexLock l(&mu_);
+    blocked_ = true;
+  }
+
+  void Unblock() {
+    MutexLock l(&mu_);
+    blocked_ = false;
+    cv_.SignalAll();
+  }
+
+ private:
+  class BlockingFile : public WritableFile {
+   public:
+    BlockingFile(WritableFile* target, BlockingLogEnv* env)
+        : target_(target), env_(env) {}
+    ~BlockingFile() override { delete target_; }
+
+    Status Append(const Slice& data) override {
+      env_->WaitWhileBlocked();
+      return target_->Append(data);
+    }
+    Status Close() override { return target_->Close(); }
+    Status Flush() override { return target_->Flush(); }
+    Status Sync() override { return target_->Sync(); }
+
+   private:
+    WritableFile* const target_;
+    BlockingLogEnv* const env_;
+  };
+
+  void WaitWhileBlocked() {
+    MutexLock l(&mu_);
+    while (blocked_) {
+      cv_.Wait();
+    }
+  }
+
+  port::Mutex mu_;
+  port::CondVar cv_ GUARDED_BY(mu_);
+  bool blocked_ GUARDED_BY(mu_);
+};
+
+// Checks whether a file is still in place when an ingested file gets its
+// table file name, and can fail that rename.
+class IngestCheckingEnv : public EnvWrapper {
+ public:
+  explicit IngestCheckingEnv(Env* base)
+      : EnvWrapper(base),
+        fail_table_renames(false),
+        table_renames(0),
+        original_present(false) {}
+
+  Status RenameFile(const std::string& s, const std::string& t) override {
+    if (t.size() > 4 && t.compare(t.size() - 4, 4, ".ldb") == 0) {
+      table_renames++;
+      original_present = target()->FileExists(original);
+      if (fail_table_renames) {
+        return Status::IOError("injected rename failure", t);
+      }
+    }
+    return target()->RenameFile(s, t);
+  }
+
+  std::string original;
+  bool fail_table_renames;
+  int table_renames;
+  bool original_present;
+};
+
+// Joins the operands of a key with commas, and counts its calls.
+class AppendOperator : public MergeOperator {
+ public:
+  explicit AppendOperator(bool partial_merge)
+      : full_merges(0), partial_merges(0), partial_merge_(partial_merge) {}
+
+  const char* Name() const override { return "test.AppendOperator"; }
+
+  bool FullMerge(const Slice& key, const Slice* existing_value,
+                 const std::vector<Slice>& operands,
+                 std::string* new_value) const override {
+    full_merges.fetch_add(1);
+    new_value->clear();
+    if (existing_value != nullptr) {
+      new_value->assign(existing_value->data(), existing_value->size());
+    }
+    for (const Slice& operand : operands) {
+      if (!new_value->empty()) {
+        new_value->push_back(',');
+      }
+      new_value->append(operand.data(), operand.size());
+    }
+    return true;
+  }
+
+  bool PartialMerge(const Slice& key, const Slice& left_operand,
+                    const Slice& right_operand,
+                    std::string* new_operand) const override {
+    partial_merges.fetch_add(1);
+    if (!partial_merge_) {
+      return false;
+    }
+    *new_operand = left_operand.ToString() + "," + right_operand.ToString();
+    return true;
+  }
+
+  mutable std::atomic<int> full_merges;
+  mutable std::atomic<int> partial_merges;
+
+ private:
+  const bool partial_merge_;
+};
+
+// Orders keys in reverse bytewise order.
+class ReverseBytewiseComparator : public Comparator {
+ public:
+  const char* Name() const override { return "test.ReverseBytewise"; }
+  int Compare(const Slice& a, const Slice& b) const override {
+    return -a.compare(b);
+  }
+  void FindShortestSeparator(std::string* start,
+                             const Slice& limit) const override {}
+  void FindShortSuccessor(std::string* key) const override {}
+};
+
+// Removes the keys whose value is "expired" and replaces the value "old"
+// by "changed".  Counts the entries offered while a snapshot reads them.
+class ExpiringFilter : public CompactionFilter {
+ public:
+  ExpiringFilter() : unsafe_calls(0) {}
+
+  const char* Name() const override { return "test.ExpiringFilter"; }
+
+  Decision Filter(const Context& context, const Slice& key,
+                  const Slice& value, std::string* new_value) const override {
+    if (!context.snapshot_safe) {
+      unsafe_calls.fetch_add(1);
+    }
+    if (value == Slice("expired")) {
+      return kRemove;
+    }
+    if (value == Slice("old")) {
+      new_value->assign("changed");
+      return kChangeValue;
+    }
+    return kKeep;
+  }
+
+  mutable std::atomic<int> unsafe_calls;
+};
+
+// Makes the clock run ahead of the real one by a settable amount.
+class FakeClockEnv : public EnvWrapper {
+ public:
+  explicit FakeClockEnv(Env* base) : EnvWrapper(base), offset_micros_(0) {}
+
+  uint64_t NowMicros() override {
+    return target()->NowMicros() + offset_micros_.load();
+  }
+
+  void AdvanceSeconds(uint64_t seconds) {
+    offset_micros_.fetch_add(seconds * 1000000);
+  }
+
+ private:
+  std::atomic<uint64_t> offset_micros_;
+};
+
+// Records the calls of a DB::WriteAsync() callback.
+struct AsyncWriteState {
+  std::atomic<int> calls{0};
+  std::thread::id thread;
+  Status status;
+};
+
+void RecordAsyncWrite(void* arg, const Status& status) {
+  AsyncWriteState* state = reinterpret_cast<AsyncWriteState*>(arg);
+  state->thread = std::this_thread::get_id();
+  state->status = status;
+  state->calls.fetch_add(1);
+}
+
+}  // namespace
+
+class DBTest : public testing::Test {
+ public:
+  DBTest() : env_(Env::Default()), db_(nullptr), model_rnd_(301) {
+    dbname_ = testing::TempDir() + "db_test";
+    DestroyDB(dbname_, Options());
+    Reopen();
+  }
+
+  ~DBTest() {
+    delete db_;
+    DestroyDB(dbname_, Options());
+  }
+
+  Options CurrentOptions() {
+    Options options;
+    options.env = env_;
+    return options;
+  }
+
+  void Reopen(Options* options = nullptr) {
+    ASSERT_LEVELDB_OK(TryReopen(options));
+  }
+
+  void Close() {
+    delete db_;
+    db_ = nullptr;
+  }
+
+  void DestroyAndReopen(Options* options = nullptr) {
+    delete db_;
+    db_ = nullptr;
+    DestroyDB(dbname_, Options());
+    ASSERT_LEVELDB_OK(TryReopen(options));
+  }
+
+  Status TryReopen(Options* options) {
+    delete db_;
+    db_ = nullptr;
+    Options opts;
+    if (options != nullptr) {
+      opts = *options;
+    } else {
+      opts = CurrentOptions();
+      opts.create_if_missing = true;
+    }
+    last_options_ = opts;
+
+    return DB::Open(opts, dbname_, &db_);
+  }
+
+  Status Put(const std::string& k, const std::string& v) {
+    return db_->Put(WriteOptions(), k, v);
+  }
+
+  Status Delete(const std::string& k) { return db_->Delete(WriteOptions(), k); }
+
+  Status Merge(const std::string& k, const std::string& v) {
+    return db_->Merge(WriteOptions(), k, v);
+  }
+
+  DBImpl* dbfull() { return reinterpret_cast<DBImpl*>(db_); }
+
+  // Create a file for DB::IngestExternalFiles() holding "entries", which
+  // must be sorted by key.
+  Status WriteExternalFile(
+      const std::string& fname,
+      const std::vector<std::pair<std::string, std::string>>& entries) {
+    SstFileWriter writer(last_options_);
+    Status s = writer.Open(fname);
+    for (size_t i = 0; s.ok() && i < entries.size(); i++) {
+      s = writer.Put(entries[i].first, entries[i].second);
+    }
+    if (s.ok()) {
+      s = writer.Finish();
+    }
+    return s;
+  }
+
+  Status Ingest(const std::string& fname, bool move_files = true) {
+    IngestOptions options;
+    options.move_files = move_files;
+    return db_->IngestExternalFiles(options, {fname});
+  }
+
+  std::string Get(const std::string& k, const Snapshot* snapshot = nullptr) {
+    ReadOptions options;
+    options.snapshot = snapshot;
+    std::string result;
+    Status s = db_->Get(options, k, &result);
+    if (s.IsNotFound()) {
+      result = "NOT_FOUND";
+    } else if (!s.ok()) {
+      result = s.ToString();
+    }
+    return result;
+  }
+
+  // Return the entries stored for "user_key", newest first.  Merge
+  // operands are prefixed with "+".
+  std::string AllEntriesFor(const Slice& user_key) {
+    Iterator* iter = dbfull()->TEST_NewInternalIterator();
+    InternalKey target(user_key, kMaxSequenceNumber, kValueTypeForSeek);
+    iter->Seek(target.Encode());
+    std::string result;
+    if (!iter->status().ok()) {
+      result = iter->status().ToString();
+    } else {
+      result = "[ ";
+      bool first = true;
+      while (iter->Valid()) {
+        ParsedInternalKey ikey;
+        if (!ParseInternalKey(iter->key(), &ikey)) {
+          result += "CORRUPTED";
+        } else {
+          if (last_options_.comparator->Compare(ikey.user_key, user_key) !=
+              0) {
+            break;
+          }
+          if (!first) {
+            result += ", ";
+          }
+          first = false;
+          switch (ikey.type) {
+            case kTypeValue:
+              result += iter->value().ToString();
+              break;
+            case kTypeDeletion:
+              result += "DEL";
+              break;
+            case kTypeMerge:
+              result += "+" + iter->value().ToString();
+              break;
+            case kTypeRangeDeletion:
+            case kTypeBlobIndex:
+              result += "?";
+              break;
+          }
+        }
+        iter->Next();
+      }
+      if (!first) {
+        result += " ";
+      }
+      result += "]";
+    }
+    delete iter;
+    return result;
+  }
+
+  // Return the numbers of the blob files in the database directory, in
+  // increasing order.
+  std::vector<uint64_t> BlobFiles() {
+    std::vector<std::string> filenames;
+    EXPECT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+    std::vector<uint64_t> numbers;
+    for (const std::string& filename : filenames) {
+      uint64_t number;
+      FileType type;
+      if (ParseFileName(filename, &number, &type) && type == kBlobFile) {
+        numbers.push_back(number);
+      }
+    }
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+  }
+
+  // Return the number of records in the log files of the database.
+  int LogRecords() {
+    std::vector<std::string> filenames;
+    EXPECT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+    int records = 0;
+    for (const std::string& filename : filenames) {
+      uint64_t number;
+      FileType type;
+      if (!ParseFileName(filename, &number, &type) || type != kLogFile) {
+        continue;
+      }
+      SequentialFile* file;
+      EXPECT_LEVELDB_OK(
+          env_->NewSequentialFile(dbname_ + "/" + filename, &file));
+      log::Reader reader(file, nullptr, true, 0);
+      Slice record;
+      std::string scratch;
+      while (reader.ReadRecord(&record, &scratch)) {
+        records++;
+      }
+      delete file;
+    }
+    return records;
+  }
+
+  // Log a sync write, then a group of two writes that queued up behind it
+  // while it was held up by "blocking_env".  The second write of the group
+  // is a sync write if "second_sync" is set.
+  void WriteSyncGroup(BlockingLogEnv* blocking_env, bool second_sync) {
+    WriteOptions sync_options;
+    sync_options.sync = true;
+    WriteOptions second_options;
+    second_options.sync = second_sync;
+    blocking_env->Block();
+    std::thread first(
+        [&]() { EXPECT_LEVELDB_OK(db_->Put(sync_options, "a", "v")); });
+    env_->SleepForMicroseconds(100000);
+    std::thread group_leader(
+        [&]() { EXPECT_LEVELDB_OK(db_->Put(sync_options, "b", "v")); });
+    env_->SleepForMicroseconds(100000);
+    std::thread group_follower(
+        [&]() { EXPECT_LEVELDB_OK(db_->Put(second_options, "c", "v")); });
+    env_->SleepForMicroseconds(100000);
+    blocking_env->Unblock();
+    first.join();
+    group_leader.join();
+    group_follower.join();
+    ASSERT_EQ(2, LogRecords());
+  }
+
+  int NumTableFilesAtLevel(int level) {
+    std::string property;
+    EXPECT_TRUE(db_->GetProperty(
+        "leveldb.num-files-at-level" + std::to_string(level), &property));
+    return std::stoi(property);
+  }
+
+  // Return spread of files per level
+  std::string FilesPerLevel() {
+    std::string result;
+    int last_non_zero_offset = 0;
+    for (int level = 0; level < config::kNumLevels; level++) {
+      int f = NumTableFilesAtLevel(level);
+      char buf[100];
+      std::snprintf(buf, sizeof(buf), "%s%d", (level ? "," : ""), f);
+      result += buf;
+      if (f > 0) {
+        last_non_zero_offset = result.size();
+      }
+    }
+    result.resize(last_non_zero_offset);
+    return result;
+  }
+
+  // The totals reported in the "leveldb.stats" property since the
+  // database was opened.
+  struct CompactionTotals {
+    int merges;
+    int moves;
+    double output_level_mb_per_mb_picked;
+    double write_amplification;
+  };
+
+  CompactionTotals GetCompactionTotals() {
+    CompactionTotals totals = {-1, -1, -1.0, -1.0};
+    std::string stats;
+    EXPECT_TRUE(db_->GetProperty("leveldb.stats", &stats));
+    const size_t pos = stats.find("Compactions: ");
+    EXPECT_NE(std::string::npos, pos) << stats;
+    if (pos != std::string::npos) {
+      EXPECT_EQ(4, std::sscanf(stats.c_str() + pos,
+                               "Compactions: %d merges, %d moves, %lf MB of "
+                               "output level per MB picked\n"
+                               "Write amplification: %lf",
+                               &totals.merges, &totals.moves,
+                               &totals.output_level_mb_per_mb_picked,
+                               &totals.write_amplification))
+          << stats;
+    }
+    return totals;
+  }
+
+  // Start over with an empty model and the same random values.
+  void ResetModel() {
+    model_rnd_ = Random(301);
+    model_.clear();
+  }
+
+  // Put a random value of "value_size" bytes under "key(i)" for each "i"
+  // below "n", and record it in the model.
+  void PutModel(const std::function<std::string(int)>& key, int n,
+                int value_size = 1000) {
+    for (int i = 0; i < n; i++) {
+      const std::string k = key(i);
+      std::string value;
+      test::RandomString(&model_rnd_, value_size, &value);
+      ASSERT_LEVELDB_OK(Put(k, value));
+      model_[k] = value;
+    }
+  }
+
+  void DeleteModel(const std::string& key) {
+    ASSERT_LEVELDB_OK(Delete(key));
+    model_[key] = "NOT_FOUND";
+  }
+
+  // Check that the database holds the model once it is reopened, and close
+  // it.
+  void ReopenAndCheckModel(Options* options) {
+    Reopen(options);
+    for (const auto& entry : model_) {
+      ASSERT_EQ(entry.second, Get(entry.first)) << entry.first;
+    }
+    Close();
+  }
+
+  std::string dbname_;
+  Env* env_;
+  DB* db_;
+  Options last_options_;
+
+  // Used by PutModel(), DeleteModel() and ReopenAndCheckModel().
+  Random model_rnd_;
+  std::map<std::string, std::string> model_;
+};
+
+TEST_F(DBTest, MultiGetMatchesGet) {
+  const FilterPolicy* filter = NewBloomFilterPolicy(10);
+  for (int with_filter = 0; with_filter < 2; with_filter++) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.filter_policy = with_filter ? filter : nullptr;
+    DestroyAndReopen(&options);
+
+    // Spread the versions of the keys over a compacted table, a level-0
+    // table and the memtable.
+    for (int i = 0; i < 300; i++) {
+      ASSERT_LEVELDB_OK(Put("key" + std::to_string(i), "v1"));
+    }
+    db_->CompactRange(nullptr, nullptr);
+    for (int i = 0; i < 300; i += 3) {
+      ASSERT_LEVELDB_OK(Put("key" + std::to_string(i), "v2"));
+    }
+    for (int i = 0; i < 300; i += 5) {
+      ASSERT_LEVELDB_OK(Delete("key" + std::to_string(i)));
+    }
+    Reopen(&options);
+    for (int i = 0; i < 300; i += 7) {
+      ASSERT_LEVELDB_OK(Put("key" + std::to_string(i), "v3"));
+    }
+    const Snapshot* snapshot = db_->GetSnapshot();
+
+    std::vector<std::string> key_storage;
+    for (int i = 0; i < 320; i++) {
+      key_storage.push_back("key" + std::to_string(i));
+    }
+    std::vector<Slice> keys(key_storage.begin(), key_storage.end());
+
+    for (int with_snapshot = 0; with_snapshot < 2; with_snapshot++) {
+      ReadOptions read_options;
+      if (with_snapshot) {
+        read_options.snapshot = snapshot;
+        ASSERT_LEVELDB_OK(Put("key1", "v4"));
+        ASSERT_LEVELDB_OK(Delete("key2"));
+      }
+      std::vector<std::string> values;
+      std::vector<Status> statuses =
+          db_->MultiGet(read_options, keys, &values);
+      ASSERT_EQ(keys.size(), statuses.size());
+      ASSERT_EQ(keys.size(), values.size());
+      for (size_t i = 0; i < keys.size(); i++) {
+        std::string expected = Get(key_storage[i], read_options.snapshot);
+        if (statuses[i].IsNotFound()) {
+          ASSERT_EQ("NOT_FOUND", expected) << key_storage[i];
+        } else {
+          ASSERT_LEVELDB_OK(statuses[i]);
+          ASSERT_EQ(expected, values[i]) << key_storage[i];
+        }
+      }
+    }
+    db_->ReleaseSnapshot(snapshot);
+  }
+  Close();
+  delete filter;
+}
+
+TEST_F(DBTest, MultiGetReadsNoMoreBlocksThanGet) {
+  CountingEnv counting_env(env_);
+  Options options = CurrentOptions();
+  options.env = &counting_env;
+  options.create_if_missing = true;
+  options.block_size = 256;
+  DestroyAndReopen(&options);
+
+  // Every key is stored twice: in an older table that was compacted down
+  // and in a newer level-0 table, which Get() finds first.
+  std::string value(100, 'x');
+  for (int i = 0; i < 200; i++) {
+    ASSERT_LEVELDB_OK(Put("key" + std::to_string(1000 + i), value));
+  }
+  db_->CompactRange(nullptr, nullptr);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_LEVELDB_OK(Put("key" + std::to_string(1000 + i), "new"));
+  }
+  Reopen(&options);
+  ASSERT_EQ(1, NumTableFilesAtLevel(0));
+
+  std::vector<std::string> key_storage;
+  for (int i = 0; i < 200; i += 10) {
+    key_storage.push_back("key" + std::to_string(1000 + i));
+  }
+  std::vector<Slice> keys(key_storage.begin(), key_storage.end());
+
+  // Both runs start with empty table and block caches.
+  Reopen(&options);
+  counting_env.ResetReads();
+  for (const std::string& key : key_storage) {
+    ASSERT_EQ("new", Get(key));
+  }
+  const int get_reads = counting_env.reads();
+
+  Reopen(&options);
+  counting_env.ResetReads();
+  std::vector<std::string> values;
+  std::vector<Status> statuses = db_->MultiGet(ReadOptions(), keys, &values);
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_LEVELDB_OK(statuses[i]);
+    ASSERT_EQ("new", values[i]);
+  }
+  ASSERT_LT(counting_env.reads(), get_reads);
+  Close();
+}
+
+TEST_F(DBTest, DirectIO) {
+  for (int direct = 0; direct < 2; direct++) {
+    FileOpenCountingEnv counting_env(env_);
+    Options options = CurrentOptions();
+    options.env = &counting_env;
+    options.create_if_missing = true;
+    options.write_buffer_size = 100000;
+    options.use_direct_reads = direct;
+    options.use_direct_io_for_flush_and_compaction = direct;
+    DestroyAndReopen(&options);
+
+    // Values of odd sizes leave partial blocks at the ends of the files.
+    Random rnd(test::RandomSeed());
+    std::vector<std::string> values;
+    for (int i = 0; i < 500; i++) {
+      std::string value;
+      test::RandomString(&rnd, 100 + i % 77, &value);
+      values.push_back(value);
+      ASSERT_LEVELDB_OK(Put("key" + std::to_string(i), value));
+    }
+    db_->CompactRange(nullptr, nullptr);
+    for (int i = 0; i < 500; i++) {
+      ASSERT_EQ(values[i], Get("key" + std::to_string(i)));
+    }
+
+    ASSERT_GT(counting_env.table_writes() + counting_env.direct_table_writes(),
+              0);
+    ASSERT_GT(counting_env.table_reads() + counting_env.direct_table_reads(),
+              0);
+    if (direct) {
+      ASSERT_EQ(0, counting_env.table_writes());
+      ASSERT_EQ(0, counting_env.table_reads());
+    } else {
+      ASSERT_EQ(0, counting_env.direct_table_writes());
+      ASSERT_EQ(0, counting_env.direct_table_reads());
+    }
+
+    // Tables written with direct I/O are regular table files.
+    options = CurrentOptions();
+    Reopen(&options);
+    for (int i = 0; i < 500; i++) {
+      ASSERT_EQ(values[i], Get("key" + std::to_string(i)));
+    }
+    Close();
+  }
+}
+
+TEST_F(DBTest, ScanWithReadahead) {
+  CountingEnv counting_env(env_);
+  Options options = CurrentOptions();
+  options.env = &counting_env;
+  options.create_if_missing = true;
+  options.block_size = 1024;
+  DestroyAndReopen(&options);
+
+  std::string value(100, 'x');
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_LEVELDB_OK(Put("key" + std::to_string(10000 + i), value));
+  }
+  db_->CompactRange(nullptr, nullptr);
+
+  int reads[2];
+  for (int readahead = 0; readahead < 2; readahead++) {
+    Reopen(&options);
+    counting_env.ResetReads();
+    ReadOptions read_options;
+    read_options.fill_cache = false;
+    read_options.readahead_size = readahead ? 64 * 1024 : 0;
+    Iterator* iter = db_->NewIterator(read_options);
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_EQ("key" + std::to_string(10000 + count), iter->key().ToString());
+      ASSERT_EQ(value, iter->value().ToString());
+      count++;
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+    ASSERT_EQ(2000, count);
+    reads[readahead] = counting_env.reads();
+  }
+  // More than 200 blocks are read one by one without readahead, and in
+  // chunks of 64 blocks with it.
+  ASSERT_GT(reads[0], 200);
+  ASSERT_LT(reads[1], reads[0] / 10);
+  Close();
+}
+
+TEST_F(DBTest, RateLimiter) {
+  std::unique_ptr<RateLimiter> rate_limiter(
+      NewGenericRateLimiter(1024 * 1024));
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.rate_limiter = rate_limiter.get();
+  options.write_buffer_size = 100 * 1024;
+  DestroyAndReopen(&options);
+
+  // Log writes bypass the limiter.
+  std::string value(1000, 'x');
+  for (int i = 0; i < 50; i++) {
+    ASSERT_LEVELDB_OK(Put("key" + std::to_string(i), value));
+  }
+  ASSERT_EQ(0, rate_limiter->GetTotalBytesThrough());
+
+  // Flushes and compactions write several hundred KB, more than a single
+  // 100ms refill of the limiter grants.
+  for (int i = 0; i < 300; i++) {
+    ASSERT_LEVELDB_OK(Put("key" + std::to_string(i), value));
+  }
+  db_->CompactRange(nullptr, nullptr);
+  uint64_t table_bytes = 0;
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  for (const std::string& filename : filenames) {
+    uint64_t file_size;
+    if (filename.size() > 4 &&
+        filename.compare(filename.size() - 4, 4, ".ldb") == 0 &&
+        env_->GetFileSize(dbname_ + "/" + filename, &file_size).ok()) {
+      table_bytes += file_size;
+    }
+  }
+  ASSERT_GT(table_bytes, 0);
+  ASSERT_GE(rate_limiter->GetTotalBytesThrough(), table_bytes);
+  ASSERT_GT(rate_limiter->GetTotalThrottledMicros(), 0);
+  Close();
+}
+
+TEST_F(DBTest, RecoverManyLogFiles) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  Close();
+
+  // Leave the logs of eight sessions behind, as a process that crashed
+  // after each of them would.
+  std::string value(500, 'x');
+  SequenceNumber sequence = 1;
+  for (int session = 0; session < 8; session++) {
+    WritableFile* file;
+    ASSERT_LEVELDB_OK(
+        env_->NewWritableFile(LogFileName(dbname_, 100 + session), &file));
+    log::Writer writer(file);
+    for (int i = 0; i < 400; i++) {
+      const int key = session * 200 + i;
+      WriteBatch batch;
+      batch.Put("key" + std::to_string(key), value + std::to_string(session));
+      WriteBatchInternal::SetSequence(&batch, sequence++);
+      ASSERT_LEVELDB_OK(writer.AddRecord(WriteBatchInternal::Contents(&batch)));
+    }
+    ASSERT_LEVELDB_OK(file->Close());
+    delete file;
+  }
+
+  // Replay all logs with a memtable that fills up several times per log,
+  // so that level-0 tables are built while later logs are read.
+  LogReadOrderEnv read_order_env(env_);
+  options.env = &read_order_env;
+  options.write_buffer_size = 32 * 1024;
+  Reopen(&options);
+  ASSERT_GT(NumTableFilesAtLevel(0) + NumTableFilesAtLevel(1) +
+                NumTableFilesAtLevel(2),
+            8);
+
+  // Each session log is larger than the read-ahead limit of four
+  // memtables, so the next one is only read once it has been replayed,
+  // which flushes tables.
+  int previous_tables = -1;
+  for (int session = 0; session < 8; session++) {
+    const int tables =
+        read_order_env.tables_at_log_open(LogFileName(dbname_, 100 + session));
+    ASSERT_GT(tables, previous_tables) << session;
+    previous_tables = tables;
+  }
+  for (int key = 0; key < 7 * 200 + 400; key++) {
+    // Keys written by two sessions keep the value of the later one.
+    const int session = std::min(key / 200, 7);
+    ASSERT_EQ(value + std::to_string(session), Get("key" + std::to_string(key)))
+        << key;
+  }
+  Close();
+}
+
+TEST_F(DBTest, AvoidFlushDuringRecovery) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  ASSERT_LEVELDB_OK(Put("a", "v1"));
+  ASSERT_LEVELDB_OK(Put("b", "v2"));
+  Close();
+
+  auto log_files = [&]() {
+    std::vector<std::string> filenames;
+    EXPECT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+    std::vector<uint64_t> logs;
+    for (const std::string& filename : filenames) {
+      uint64_t number;
+      FileType type;
+      if (ParseFileName(filename, &number, &type) && type == kLogFile) {
+        logs.push_back(number);
+      }
+    }
+    std::sort(logs.begin(), logs.end());
+    return logs;
+  };
+  const std::vector<uint64_t> old_logs = log_files();
+  ASSERT_EQ(1u, old_logs.size());
+
+  // Open writes no table, and keeps the log the records came from next to
+  // the new one until the background flush has run.
+  HeldBackgroundWorkEnv held_env(env_);
+  FileOpenCountingEnv counting_env(&held_env);
+  options.env = &counting_env;
+  options.avoid_flush_during_recovery = true;
+  held_env.Hold();
+  Reopen(&options);
+  ASSERT_EQ(0, counting_env.table_writes());
+  ASSERT_EQ("", FilesPerLevel());
+  std::vector<uint64_t> logs = log_files();
+  ASSERT_EQ(2u, logs.size());
+  ASSERT_EQ(old_logs[0], logs[0]);
+  ASSERT_EQ("v1", Get("a"));
+  ASSERT_EQ("v2", Get("b"));
+
+  held_env.Release();
+  ASSERT_LEVELDB_OK(dbfull()->TEST_WaitForCompactions());
+  ASSERT_EQ(1, counting_env.table_writes());
+  logs = log_files();
+  ASSERT_EQ(1u, logs.size());
+  ASSERT_NE(old_logs[0], logs[0]);
+
+  Reopen(&options);
+  ASSERT_EQ("v1", Get("a"));
+  ASSERT_EQ("v2", Get("b"));
+  Close();
+}
+
+TEST_F(DBTest, RecycleLogFiles) {
+  LogReuseEnv reuse_env(env_);
+  Options options = CurrentOptions();
+  options.env = &reuse_env;
+  options.create_if_missing = true;
+  options.write_buffer_size = 64 * 1024;
+  options.recycle_log_file_num = 2;
+  DestroyAndReopen(&options);
+
+  // Fill several memtables, then delete everything and compact it away, so
+  // that nothing but the stale records in the recycled logs holds the keys.
+  std::string value(1000, 'x');
+  for (int i = 0; i < 500; i++) {
+    ASSERT_LEVELDB_OK(Put("key" + std::to_string(i), value));
+  }
+  for (int i = 0; i < 500; i++) {
+    ASSERT_LEVELDB_OK(Delete("key" + std::to_string(i)));
+  }
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("", FilesPerLevel());
+  ASSERT_GT(reuse_env.reuses(), 0);
+
+  // The current log is a reused file, whose first record is followed by
+  // the stale records of its previous use.
+  ASSERT_TRUE(reuse_env.last_log_reused());
+  ASSERT_LEVELDB_OK(Put("a", "v"));
+  Reopen(&options);
+  ASSERT_EQ("v", Get("a"));
+  for (int i = 0; i < 500; i++) {
+    ASSERT_EQ("NOT_FOUND", Get("key" + std::to_string(i))) << i;
+  }
+  Close();
+}
+
+TEST_F(DBTest, CorruptedMetaindexBlock) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  ASSERT_LEVELDB_OK(Put("c", "vc"));
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), "b", "d"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  Close();
+
+  // Damage the compression type of the metaindex block, which ReadBlock()
+  // rejects even without checksum verification.
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  int tables = 0;
+  for (const std::string& filename : filenames) {
+    uint64_t number;
+    FileType type;
+    if (!ParseFileName(filename, &number, &type) || type != kTableFile) {
+      continue;
+    }
+    tables++;
+    const std::string fname = dbname_ + "/" + filename;
+    std::string contents;
+    ASSERT_LEVELDB_OK(ReadFileToString(env_, fname, &contents));
+    Slice footer_input(contents.data() + contents.size() -
+                           Footer::kEncodedLength,
+                       Footer::kEncodedLength);
+    Footer footer;
+    ASSERT_LEVELDB_OK(footer.DecodeFrom(&footer_input));
+    const BlockHandle& metaindex = footer.metaindex_handle();
+    contents[metaindex.offset() + metaindex.size()] = 0x7f;
+    ASSERT_LEVELDB_OK(WriteStringToFile(env_, contents, fname));
+  }
+  ASSERT_EQ(1, tables);
+
+  // Without the metaindex the range deletion is lost, so the table must
+  // not be read at all.
+  Reopen(&options);
+  ASSERT_EQ("Corruption: bad block type", Get("a"));
+  ASSERT_EQ("Corruption: bad block type", Get("c"));
+}
+
+TEST_F(DBTest, WALCompression) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.wal_compression = kZlibCompression;
+  DestroyAndReopen(&options);
+  const std::string value(100000, 'x');
+  ASSERT_LEVELDB_OK(Put("a", value));
+  ASSERT_LEVELDB_OK(Put("b", "v"));
+
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  uint64_t log_bytes = 0;
+  for (const std::string& filename : filenames) {
+    uint64_t number;
+    FileType type;
+    if (ParseFileName(filename, &number, &type) && type == kLogFile) {
+      uint64_t size;
+      ASSERT_LEVELDB_OK(env_->GetFileSize(dbname_ + "/" + filename, &size));
+      log_bytes += size;
+    }
+  }
+  ASSERT_LT(log_bytes, value.size() / 10);
+
+  // Reading the compressed records back does not depend on the option.
+  options.wal_compression = kNoCompression;
+  Reopen(&options);
+  ASSERT_EQ(value, Get("a"));
+  ASSERT_EQ("v", Get("b"));
+}
+
+TEST_F(DBTest, ZlibTableCompression) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.compression = kZlibCompression;
+  DestroyAndReopen(&options);
+  const std::string value(100000, 'x');
+  ASSERT_LEVELDB_OK(Put("a", value));
+  ASSERT_LEVELDB_OK(Put("b", "v"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  uint64_t size;
+  Range r("a", "z");
+  db_->GetApproximateSizes(&r, 1, &size);
+  ASSERT_LT(size, value.size() / 10);
+
+  options.compression = kNoCompression;
+  Reopen(&options);
+  ASSERT_EQ(value, Get("a"));
+  ASSERT_EQ("v", Get("b"));
+}
+
+TEST_F(DBTest, PreloadTablesOnOpen) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_size = 64 * 1024;
+  options.max_file_size = 64 * 1024;
+  DestroyAndReopen(&options);
+  std::string value(200, 'x');
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_LEVELDB_OK(Put("key" + std::to_string(10000 + i), value));
+  }
+  // Leave nothing to flush or compact at the next open.
+  db_->CompactRange(nullptr, nullptr);
+  int tables = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    tables += NumTableFilesAtLevel(level);
+  }
+  ASSERT_GT(tables, 4);
+
+  for (int preload = 0; preload < 2; preload++) {
+    FileOpenCountingEnv counting_env(env_);
+    options.env = &counting_env;
+    options.preload_tables_on_open = preload;
+    options.preload_table_threads = 3;
+    Reopen(&options);
+    ASSERT_EQ(preload ? tables : 0, counting_env.table_reads());
+
+    for (int i = 0; i < 2000; i++) {
+      ASSERT_EQ(value, Get("key" + std::to_string(10000 + i)));
+    }
+    ASSERT_EQ(tables, counting_env.table_reads());
+    Close();
+  }
+}
+
+TEST_F(DBTest, BytesPerSync) {
+  for (int bytes_per_sync = 0; bytes_per_sync <= 16 * 1024;
+       bytes_per_sync += 16 * 1024) {
+    RangeSyncCountingEnv counting_env(env_);
+    Options options = CurrentOptions();
+    options.env = &counting_env;
+    options.create_if_missing = true;
+    options.write_buffer_size = 256 * 1024;
+    options.bytes_per_sync = bytes_per_sync;
+    DestroyAndReopen(&options);
+
+    std::string value(1000, 'x');
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_LEVELDB_OK(Put("key" + std::to_string(i), value));
+    }
+    db_->CompactRange(nullptr, nullptr);
+    Close();
+
+    // About 1MB of tables were written by flushes and a compaction.  Logs
+    // are never written back incrementally.
+    if (bytes_per_sync == 0) {
+      ASSERT_EQ(0, counting_env.table_syncs());
+    } else {
+      ASSERT_GE(counting_env.table_syncs(), 1000 * 1000 / bytes_per_sync);
+    }
+    ASSERT_EQ(0, counting_env.log_syncs());
+  }
+}
+
+TEST_F(DBTest, WriteAsync) {
+  BlockingLogEnv blocking_env(env_);
+  Options options = CurrentOptions();
+  options.env = &blocking_env;
+  options.create_if_missing = true;
+  options.max_pending_async_writes = 2;
+  DestroyAndReopen(&options);
+
+  // Hold up the first write while it is being logged.
+  blocking_env.Block();
+  AsyncWriteState states[3];
+  WriteBatch batch;
+  for (int i = 0; i < 2; i++) {
+    batch.Clear();
+    batch.Put("key" + std::to_string(i), "value" + std::to_string(i));
+    db_->WriteAsync(WriteOptions(), &batch, &RecordAsyncWrite, &states[i]);
+    ASSERT_EQ(0, states[i].calls.load());
+  }
+
+  // Two writes are pending, so a third one waits for the first to commit.
+  std::atomic<bool> third_queued(false);
+  std::thread writer([&]() {
+    WriteBatch third;
+    third.Put("key2", "value2");
+    db_->WriteAsync(WriteOptions(), &third, &RecordAsyncWrite, &states[2]);
+    third_queued.store(true);
+  });
+  env_->SleepForMicroseconds(100000);
+  ASSERT_FALSE(third_queued.load());
+  ASSERT_EQ(0, states[0].calls.load());
+
+  blocking_env.Unblock();
+  writer.join();
+
+  // Deleting the DB commits the writes still queued.
+  Close();
+  for (AsyncWriteState& state : states) {
+    ASSERT_EQ(1, state.calls.load());
+    ASSERT_LEVELDB_OK(state.status);
+    ASSERT_NE(std::this_thread::get_id(), state.thread);
+  }
+
+  Reopen(&options);
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ("value" + std::to_string(i), Get("key" + std::to_string(i)));
+  }
+  Close();
+}
+
+TEST_F(DBTest, ConcurrentSyncWritesShareLogRecords) {
+  SlowLogSyncEnv slow_env(env_);
+  Options options = CurrentOptions();
+  options.env = &slow_env;
+  options.create_if_missing = true;
+  options.max_write_group_bytes = 64 * 1024;
+  options.sync_write_group_wait_micros = 1000;
+  DestroyAndReopen(&options);
+
+  const int kThreads = 8;
+  const int kWritesPerThread = 50;
+  const std::string value(1000, 'x');
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      WriteOptions write_options;
+      write_options.sync = true;
+      for (int i = 0; i < kWritesPerThread; i++) {
+        const std::string key =
+            "key" + std::to_string(t) + "_" + std::to_string(i);
+        ASSERT_LEVELDB_OK(db_->Put(write_options, key, value));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  // Each group of writes is logged as a single record.
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  int records = 0;
+  int writes = 0;
+  for (const std::string& filename : filenames) {
+    uint64_t number;
+    FileType type;
+    if (!ParseFileName(filename, &number, &type) || type != kLogFile) {
+      continue;
+    }
+    SequentialFile* file;
+    ASSERT_LEVELDB_OK(
+        env_->NewSequentialFile(dbname_ + "/" + filename, &file));
+    log::Reader reader(file, nullptr, true, 0);
+    Slice record;
+    std::string scratch;
+    while (reader.ReadRecord(&record, &scratch)) {
+      ASSERT_LE(record.size(), options.max_write_group_bytes);
+      WriteBatch batch;
+      WriteBatchInternal::SetContents(&batch, record);
+      records++;
+      writes += WriteBatchInternal::Count(&batch);
+    }
+    delete file;
+  }
+  ASSERT_EQ(kThreads * kWritesPerThread, writes);
+  ASSERT_LT(records, writes / 2);
+  Close();
+}
+
+TEST_F(DBTest, SyncWriteGroupWait) {
+  // Without the wait as a baseline, then with a wait much longer than the
+  // test takes.
+  for (uint64_t wait_micros : {uint64_t{0}, uint64_t{10000000}}) {
+    BlockingLogEnv blocking_env(env_);
+    Options options = CurrentOptions();
+    options.env = &blocking_env;
+    options.create_if_missing = true;
+    options.sync_write_group_wait_micros = wait_micros;
+    DestroyAndReopen(&options);
+    WriteSyncGroup(&blocking_env, /*second_sync=*/true);
+
+    // The last sync group had two sync writers, so a sync write waits for
+    // another one to join it, and stops waiting as soon as it has.
+    WriteOptions sync_options;
+    sync_options.sync = true;
+    const uint64_t start = env_->NowMicros();
+    std::thread leader(
+        [&]() { ASSERT_LEVELDB_OK(db_->Put(sync_options, "d", "v")); });
+    env_->SleepForMicroseconds(100000);
+    ASSERT_LEVELDB_OK(db_->Put(sync_options, "e", "v"));
+    leader.join();
+    if (wait_micros == 0) {
+      ASSERT_EQ(4, LogRecords());
+    } else {
+      ASSERT_EQ(3, LogRecords());
+      ASSERT_LT(env_->NowMicros() - start, wait_micros / 2);
+    }
+    Close();
+  }
+}
+
+TEST_F(DBTest, SyncWriteGroupWaitCountsOnlySyncWriters) {
+  BlockingLogEnv blocking_env(env_);
+  Options options = CurrentOptions();
+  options.env = &blocking_env;
+  options.create_if_missing = true;
+  options.sync_write_group_wait_micros = 10000000;
+  DestroyAndReopen(&options);
+
+  // The last sync group had one sync writer and a non-sync one, so the
+  // next sync write does not wait for anyone.
+  WriteSyncGroup(&blocking_env, /*second_sync=*/false);
+  WriteOptions sync_options;
+  sync_options.sync = true;
+  const uint64_t start = env_->NowMicros();
+  ASSERT_LEVELDB_OK(db_->Put(sync_options, "d", "v"));
+  ASSERT_LT(env_->NowMicros() - start,
+            options.sync_write_group_wait_micros / 2);
+  ASSERT_EQ(3, LogRecords());
+  Close();
+}
+
+TEST_F(DBTest, MergeOperandsKeptBySnapshot) {
+  AppendOperator merge_operator(true);
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.merge_operator = &merge_operator;
+  DestroyAndReopen(&options);
+
+  ASSERT_LEVELDB_OK(Put("k", "a"));
+  ASSERT_LEVELDB_OK(Merge("k", "b"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(Merge("k", "c"));
+  ASSERT_LEVELDB_OK(Merge("k", "d"));
+  ASSERT_EQ("a,b,c,d", Get("k"));
+  ASSERT_EQ("a,b", Get("k", snapshot));
+
+  // Only the entries the snapshot can not tell apart are combined.
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("0,0,0,1", FilesPerLevel());
+  ASSERT_EQ("[ +d, +c, a,b ]", AllEntriesFor("k"));
+  ASSERT_EQ("a,b,c,d", Get("k"));
+  ASSERT_EQ("a,b", Get("k", snapshot));
+
+  // Once the snapshot is gone, the operands collapse into a plain value
+  // that reads without merging.
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(3, nullptr, nullptr);
+  ASSERT_EQ("[ a,b,c,d ]", AllEntriesFor("k"));
+  const int full_merges = merge_operator.full_merges.load();
+  ASSERT_EQ("a,b,c,d", Get("k"));
+  ASSERT_EQ(full_merges, merge_operator.full_merges.load());
+  Close();
+}
+
+TEST_F(DBTest, PartialMergeFallback) {
+  for (bool partial_merge : {false, true}) {
+    AppendOperator merge_operator(partial_merge);
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.merge_operator = &merge_operator;
+    DestroyAndReopen(&options);
+
+    // Leave the value and each operand in a level of its own.
+    ASSERT_LEVELDB_OK(Put("k", "a"));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_LEVELDB_OK(Merge("k", "b"));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_LEVELDB_OK(Merge("k", "c"));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_EQ("1,1,1", FilesPerLevel());
+
+    // Compacting the operands without the value below them combines them
+    // only if the operator supports it, and keeps them as they are
+    // otherwise.
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    ASSERT_EQ("0,1,1", FilesPerLevel());
+    ASSERT_GT(merge_operator.partial_merges.load(), 0);
+    if (partial_merge) {
+      ASSERT_EQ("[ +b,c, a ]", AllEntriesFor("k"));
+    } else {
+      ASSERT_EQ("[ +c, +b, a ]", AllEntriesFor("k"));
+    }
+    ASSERT_EQ("a,b,c", Get("k"));
+
+    dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+    ASSERT_EQ("0,0,1", FilesPerLevel());
+    ASSERT_EQ("[ a,b,c ]", AllEntriesFor("k"));
+    ASSERT_EQ("a,b,c", Get("k"));
+    Close();
+  }
+}
+
+TEST_F(DBTest, OverlappingRangeDeletionsAcrossOutputs) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  // About 12MB of entries, so that compactions write several tables.
+  Random rnd(301);
+  std::map<std::string, std::string> model;
+  auto key = [](int i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%06d", i);
+    return std::string(buf);
+  };
+  for (int i = 0; i < 12000; i++) {
+    std::string value;
+    test::RandomString(&rnd, 1000, &value);
+    ASSERT_LEVELDB_OK(Put(key(i), value));
+    model[key(i)] = value;
+  }
+  db_->CompactRange(nullptr, nullptr);
+
+  // Overlapping tombstones that span table boundaries, some of them kept
+  // by a snapshot, and entries written over deleted ranges.
+  const int ranges[][2] = {{1000, 3000}, {2000, 4000}, {2500, 2700},
+                           {3900, 5000}, {7000, 8000}};
+  const Snapshot* snapshot = nullptr;
+  for (int r = 0; r < 5; r++) {
+    ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), key(ranges[r][0]),
+                                       key(ranges[r][1])));
+    model.erase(model.lower_bound(key(ranges[r][0])),
+                model.lower_bound(key(ranges[r][1])));
+    for (int i = ranges[r][0] + 100; i < ranges[r][0] + 110; i++) {
+      ASSERT_LEVELDB_OK(Put(key(i), "rewritten"));
+      model[key(i)] = "rewritten";
+    }
+    if (r == 2) {
+      snapshot = db_->GetSnapshot();
+    }
+    if (r % 2 == 0) {
+      ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    }
+  }
+
+  for (int round = 0; round < 4; round++) {
+    if (round == 2) {
+      db_->ReleaseSnapshot(snapshot);
+    }
+    // Rewrite the tables, tombstones included, one level further down.
+    db_->CompactRange(nullptr, nullptr);
+    for (int level = config::kNumLevels - 2; level >= 0; level--) {
+      if (NumTableFilesAtLevel(level) > 0) {
+        dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+        break;
+      }
+    }
+    ASSERT_GT(NumTableFilesAtLevel(3 + round), 1);
+
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    auto expected = model.begin();
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++expected) {
+      ASSERT_TRUE(expected != model.end());
+      ASSERT_EQ(expected->first, iter->key().ToString());
+      ASSERT_EQ(expected->second, iter->value().ToString());
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    ASSERT_TRUE(expected == model.end());
+    delete iter;
+  }
+  Close();
+}
+
+TEST_F(DBTest, IngestExternalFileKeepsOriginalUntilAdded) {
+  IngestCheckingEnv checking_env(env_);
+  Options options = CurrentOptions();
+  options.env = &checking_env;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  const std::string fname = testing::TempDir() + "db_test_ingest.sst";
+  checking_env.original = fname;
+  ASSERT_LEVELDB_OK(WriteExternalFile(fname, {{"a", "va"}, {"b", "vb"}}));
+
+  // A failed ingestion leaves the original and nothing else behind.
+  checking_env.fail_table_renames = true;
+  ASSERT_FALSE(Ingest(fname).ok());
+  ASSERT_TRUE(env_->FileExists(fname));
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  for (const std::string& filename : filenames) {
+    uint64_t number;
+    FileType type;
+    ASSERT_FALSE(ParseFileName(filename, &number, &type) && type == kTempFile);
+  }
+
+  // The original is removed only once the file has been added, so a crash
+  // in between can not lose it.
+  checking_env.fail_table_renames = false;
+  checking_env.table_renames = 0;
+  ASSERT_LEVELDB_OK(Ingest(fname));
+  ASSERT_EQ(1, checking_env.table_renames);
+  ASSERT_TRUE(checking_env.original_present);
+  ASSERT_FALSE(env_->FileExists(fname));
+  ASSERT_EQ("va", Get("a"));
+
+  // Copied files stay where they are.
+  ASSERT_LEVELDB_OK(WriteExternalFile(fname, {{"c", "vc"}}));
+  ASSERT_LEVELDB_OK(Ingest(fname, false));
+  ASSERT_TRUE(env_->FileExists(fname));
+  env_->RemoveFile(fname);
+
+  Reopen(&options);
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ("vb", Get("b"));
+  ASSERT_EQ("vc", Get("c"));
+  Close();
+}
+
+TEST_F(DBTest, IngestExternalFileWithOtherComparator) {
+  ReverseBytewiseComparator reverse;
+  Options writer_options = CurrentOptions();
+  writer_options.comparator = &reverse;
+  const std::string fname = testing::TempDir() + "db_test_ingest.sst";
+  SstFileWriter writer(writer_options);
+  ASSERT_LEVELDB_OK(writer.Open(fname));
+  ASSERT_LEVELDB_OK(writer.Put("b", "vb"));
+  ASSERT_LEVELDB_OK(writer.Put("a", "va"));
+  ASSERT_LEVELDB_OK(writer.Finish());
+
+  Status s = Ingest(fname);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  ASSERT_NE(std::string::npos, s.ToString().find("test.ReverseBytewise"));
+  ASSERT_TRUE(env_->FileExists(fname));
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  env_->RemoveFile(fname);
+}
+
+TEST_F(DBTest, IngestExternalFileOverlappingMemTable) {
+  ASSERT_LEVELDB_OK(Put("a", "old"));
+  ASSERT_LEVELDB_OK(Put("b", "old"));
+  ASSERT_LEVELDB_OK(Put("z", "old"));
+  const std::string fname = testing::TempDir() + "db_test_ingest.sst";
+  ASSERT_LEVELDB_OK(WriteExternalFile(fname, {{"b", "new"}, {"c", "new"}}));
+
+  // The memtable is flushed first so that the file ends up above it.
+  ASSERT_LEVELDB_OK(Ingest(fname));
+  ASSERT_EQ("old", Get("a"));
+  ASSERT_EQ("new", Get("b"));
+  ASSERT_EQ("new", Get("c"));
+  ASSERT_EQ("old", Get("z"));
+  ASSERT_LEVELDB_OK(Put("c", "newer"));
+  ASSERT_EQ("newer", Get("c"));
+
+  Reopen();
+  ASSERT_EQ("old", Get("a"));
+  ASSERT_EQ("new", Get("b"));
+  ASSERT_EQ("newer", Get("c"));
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("new", Get("b"));
+  ASSERT_EQ("newer", Get("c"));
+}
+
+TEST_F(DBTest, IngestExternalFileHiddenFromSnapshots) {
+  ASSERT_LEVELDB_OK(Put("a", "old"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const Snapshot* snapshot = db_->GetSnapshot();
+  const std::string fname = testing::TempDir() + "db_test_ingest.sst";
+  ASSERT_LEVELDB_OK(WriteExternalFile(fname, {{"a", "new"}, {"b", "new"}}));
+  ASSERT_LEVELDB_OK(Ingest(fname));
+
+  for (int compacted = 0; compacted < 2; compacted++) {
+    ASSERT_EQ("new", Get("a"));
+    ASSERT_EQ("new", Get("b"));
+    ASSERT_EQ("old", Get("a", snapshot));
+    ASSERT_EQ("NOT_FOUND", Get("b", snapshot));
+
+    ReadOptions read_options;
+    read_options.snapshot = snapshot;
+    Iterator* iter = db_->NewIterator(read_options);
+    iter->SeekToFirst();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("a", iter->key().ToString());
+    ASSERT_EQ("old", iter->value().ToString());
+    iter->Next();
+    ASSERT_FALSE(iter->Valid());
+    delete iter;
+
+    db_->CompactRange(nullptr, nullptr);
+  }
+  db_->ReleaseSnapshot(snapshot);
+
+  Reopen();
+  ASSERT_EQ("new", Get("a"));
+  ASSERT_EQ("new", Get("b"));
+}
+
+TEST_F(DBTest, CompactionFilterSkipsEntriesReadBySnapshot) {
+  ExpiringFilter filter;
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.compaction_filter = &filter;
+  DestroyAndReopen(&options);
+
+  ASSERT_LEVELDB_OK(Put("a", "expired"));
+  ASSERT_LEVELDB_OK(Put("b", "old"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(Put("c", "expired"));
+  ASSERT_LEVELDB_OK(Put("d", "old"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  // Only the entries written after the snapshot are filtered.
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("0,0,0,1", FilesPerLevel());
+  ASSERT_EQ(2, filter.unsafe_calls.load());
+  ASSERT_EQ("expired", Get("a", snapshot));
+  ASSERT_EQ("old", Get("b", snapshot));
+  ASSERT_EQ("expired", Get("a"));
+  ASSERT_EQ("old", Get("b"));
+  ASSERT_EQ("NOT_FOUND", Get("c"));
+  ASSERT_EQ("changed", Get("d"));
+
+  // Once the snapshot is gone, a later compaction offers them again.
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(3, nullptr, nullptr);
+  ASSERT_EQ(2, filter.unsafe_calls.load());
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("changed", Get("b"));
+  ASSERT_EQ("[ ]", AllEntriesFor("a"));
+
+  Reopen(&options);
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("changed", Get("b"));
+  ASSERT_EQ("NOT_FOUND", Get("c"));
+  ASSERT_EQ("changed", Get("d"));
+  Close();
+}
+
+TEST_F(DBTest, TtlExpiryAcrossCompaction) {
+  FakeClockEnv clock_env(env_);
+  Options options = CurrentOptions();
+  options.env = &clock_env;
+  options.create_if_missing = true;
+  options.ttl_seconds = 100;
+  DestroyAndReopen(&options);
+
+  // Build a table holding values written 60 seconds apart.
+  ASSERT_LEVELDB_OK(Put("a1", "old"));
+  ASSERT_LEVELDB_OK(Put("a2", "old"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  clock_env.AdvanceSeconds(60);
+  ASSERT_LEVELDB_OK(Put("a0", "new"));
+  ASSERT_LEVELDB_OK(Put("b1", "new"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  // Reads hide the expired values before any compaction drops them.
+  clock_env.AdvanceSeconds(50);
+  ASSERT_EQ("NOT_FOUND", Get("a1"));
+  ASSERT_EQ("new", Get("a0"));
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("a0", iter->key().ToString());
+  iter->Next();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("b1", iter->key().ToString());
+  iter->Next();
+  ASSERT_FALSE(iter->Valid());
+  delete iter;
+
+  // A compaction drops the expired values and keeps the others.
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("0,0,0,1", FilesPerLevel());
+  ASSERT_EQ("[ ]", AllEntriesFor("a1"));
+  ASSERT_EQ("[ ]", AllEntriesFor("a2"));
+  ASSERT_EQ("new", Get("a0"));
+  ASSERT_EQ("new", Get("b1"));
+
+  // A table holding nothing but expired values is deleted before the next
+  // compaction, without being read.
+  clock_env.AdvanceSeconds(100);
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  ASSERT_EQ("", FilesPerLevel());
+
+  Reopen(&options);
+  ASSERT_EQ("NOT_FOUND", Get("a0"));
+  ASSERT_EQ("NOT_FOUND", Get("b1"));
+  Close();
+}
+
+TEST_F(DBTest, TtlModeMustNotChange) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  ASSERT_LEVELDB_OK(Put("k1", "value-one-abcd"));
+  Close();
+
+  // The value has no write time to strip.
+  options.ttl_seconds = 3600;
+  Status s = TryReopen(&options);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  options.ttl_seconds = 0;
+  Reopen(&options);
+  ASSERT_EQ("value-one-abcd", Get("k1"));
+
+  // The other way around, the write time would show up in the value.  The
+  // mode is kept in the MANIFEST written on each reopen, and the number of
+  // seconds may change.
+  options.ttl_seconds = 3600;
+  DestroyAndReopen(&options);
+  ASSERT_LEVELDB_OK(Put("k1", "value-one-abcd"));
+  for (int i = 0; i < 2; i++) {
+    options.ttl_seconds = 0;
+    s = TryReopen(&options);
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+    options.ttl_seconds = 7200;
+    Reopen(&options);
+    ASSERT_EQ("value-one-abcd", Get("k1"));
+  }
+  Close();
+}
+
+TEST_F(DBTest, BlobValuesReadable) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.min_blob_size = 100;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  std::string large1, large2, large3;
+  test::RandomString(&rnd, 1000, &large1);
+  test::RandomString(&rnd, 1000, &large2);
+  test::RandomString(&rnd, 100, &large3);
+  ASSERT_LEVELDB_OK(Put("a", "small"));
+  ASSERT_LEVELDB_OK(Put("b", large1));
+  ASSERT_LEVELDB_OK(Put("c", large3));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(Put("b", large2));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(2u, BlobFiles().size());
+
+  for (int compacted = 0; compacted < 2; compacted++) {
+    ASSERT_EQ("small", Get("a"));
+    ASSERT_EQ(large2, Get("b"));
+    ASSERT_EQ(large3, Get("c"));
+    ASSERT_EQ(large1, Get("b", snapshot));
+
+    ReadOptions read_options;
+    for (const Snapshot* s : {static_cast<const Snapshot*>(nullptr),
+                              snapshot}) {
+      read_options.snapshot = s;
+      Iterator* iter = db_->NewIterator(read_options);
+      iter->SeekToFirst();
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ("small", iter->value().ToString());
+      iter->Next();
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(s == nullptr ? large2 : large1, iter->value().ToString());
+      iter->Next();
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(large3, iter->value().ToString());
+      iter->Next();
+      ASSERT_FALSE(iter->Valid());
+      ASSERT_LEVELDB_OK(iter->status());
+      delete iter;
+    }
+
+    db_->CompactRange(nullptr, nullptr);
+  }
+  db_->ReleaseSnapshot(snapshot);
+
+  Reopen(&options);
+  ASSERT_EQ("small", Get("a"));
+  ASSERT_EQ(large2, Get("b"));
+  ASSERT_EQ(large3, Get("c"));
+  Close();
+}
+
+TEST_F(DBTest, BlobGarbageCollection) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.min_blob_size = 100;
+  options.blob_garbage_collection_threshold = 0.5;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  std::vector<std::string> values(100);
+  auto overwrite = [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      test::RandomString(&rnd, 1000, &values[i]);
+      ASSERT_LEVELDB_OK(Put("key" + std::to_string(100 + i), values[i]));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  };
+  overwrite(0, 100);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ(1u, BlobFiles().size());
+  const uint64_t first_blob_file = BlobFiles()[0];
+  const std::string first_blob_fname = BlobFileName(dbname_, first_blob_file);
+
+  // 40% of the first blob file is garbage: it stays, since the table
+  // still refers to it.
+  overwrite(0, 40);
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_TRUE(env_->FileExists(first_blob_fname));
+
+  // 60% is garbage: a compaction copies the blobs still in use and the
+  // file is deleted.
+  overwrite(40, 60);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  for (int i = 0; i < 1000 && env_->FileExists(first_blob_fname); i++) {
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_FALSE(env_->FileExists(first_blob_fname));
+  ASSERT_LT(first_blob_file, BlobFiles()[0]);
+
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(values[i], Get("key" + std::to_string(100 + i)));
+  }
+  Reopen(&options);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(values[i], Get("key" + std::to_string(100 + i)));
+  }
+  Close();
+}
+
+TEST_F(DBTest, TieredCompactionLevelShape) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_size = 100 * 1024;
+  DestroyAndReopen(&options);
+
+  auto random_key = [&](int) {
+    return "key" + std::to_string(model_rnd_.Uniform(1000));
+  };
+  auto check_intermediate_levels_empty = [&]() {
+    for (int level = 1; level < config::kNumLevels - 1; level++) {
+      ASSERT_EQ(0, NumTableFilesAtLevel(level)) << "level " << level;
+    }
+  };
+
+  // Leveled compaction leaves files in the intermediate levels.
+  PutModel(random_key, 1000);
+  db_->CompactRange(nullptr, nullptr);
+  int intermediate_files = 0;
+  for (int level = 1; level < config::kNumLevels - 1; level++) {
+    intermediate_files += NumTableFilesAtLevel(level);
+  }
+  ASSERT_GT(intermediate_files, 0);
+
+  // Tiered compaction pushes them down to the last level first.
+  options.compaction_style = kTieredCompaction;
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(dbfull()->TEST_WaitForCompactions());
+  check_intermediate_levels_empty();
+  ASSERT_GT(NumTableFilesAtLevel(config::kNumLevels - 1), 0);
+  const CompactionTotals pushed_down = GetCompactionTotals();
+  ASSERT_EQ(0, pushed_down.merges);
+  ASSERT_GT(pushed_down.moves, 0);
+
+  // The sorted runs are the level-0 files and the last level, and merging
+  // them keeps their number below the compaction trigger.
+  for (int round = 0; round < 20; round++) {
+    PutModel(random_key, 200);
+    ASSERT_LEVELDB_OK(dbfull()->TEST_WaitForCompactions());
+    check_intermediate_levels_empty();
+    ASSERT_LT(NumTableFilesAtLevel(0) + 1, config::kL0_CompactionTrigger);
+  }
+  const CompactionTotals merged = GetCompactionTotals();
+  ASSERT_GT(merged.merges, 0);
+  ASSERT_EQ(pushed_down.moves, merged.moves);
+  ASSERT_GT(merged.write_amplification, 1.0);
+
+  ReopenAndCheckModel(&options);
+}
+
+TEST_F(DBTest, DynamicLevelBytesLevelShape) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_size = 100 * 1024;
+  options.level_compaction_dynamic_level_bytes = true;
+  DestroyAndReopen(&options);
+
+  auto random_key_below = [&](int key_space) {
+    return [this, key_space](int) {
+      char key[100];
+      std::snprintf(key, sizeof(key), "key%08d",
+                    model_rnd_.Uniform(key_space));
+      return std::string(key);
+    };
+  };
+  auto first_level_with_files = [&]() {
+    for (int level = 1; level < config::kNumLevels; level++) {
+      if (NumTableFilesAtLevel(level) > 0) {
+        return level;
+      }
+    }
+    return config::kNumLevels;
+  };
+
+  // While the database is smaller than the level-1 size limit, flushes and
+  // level-0 compactions skip all the levels above the last one.
+  for (int round = 0; round < 10; round++) {
+    PutModel(random_key_below(1000), 300);
+    ASSERT_LEVELDB_OK(dbfull()->TEST_WaitForCompactions());
+    ASSERT_EQ(config::kNumLevels - 1, first_level_with_files());
+  }
+  // Level-0 files are merged into the last level instead of being moved
+  // down one level at a time.
+  const CompactionTotals small = GetCompactionTotals();
+  ASSERT_GT(small.merges, 0);
+  ASSERT_EQ(0, small.moves);
+
+  // A larger database fills the levels upwards from the last one, leaving
+  // the levels above the base level empty.
+  PutModel(random_key_below(1000000), 30000);
+  ASSERT_LEVELDB_OK(dbfull()->TEST_WaitForCompactions());
+  const int base_level = first_level_with_files();
+  ASSERT_LT(base_level, config::kNumLevels - 1);
+  ASSERT_GT(base_level, 1);
+  for (int level = base_level; level < config::kNumLevels; level++) {
+    ASSERT_GT(NumTableFilesAtLevel(level), 0) << "level " << level;
+  }
+  const CompactionTotals large = GetCompactionTotals();
+  ASSERT_GT(large.merges, small.merges);
+  ASSERT_GT(large.write_amplification, small.write_amplification);
+
+  ReopenAndCheckModel(&options);
+}
+
+TEST_F(DBTest, MinOverlappingRatioLevelShape) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_size = 64 << 20;
+
+  // Returns the compaction totals once level-1 is compacted below its size
+  // limit, and sets "level2_files" to the number of level-2 files.
+  auto compact_level1 = [&](CompactionPriority priority, int* level2_files) {
+    options.compaction_priority = priority;
+    DestroyAndReopen(&options);
+    ResetModel();
+    auto key_with_prefix = [](char prefix) {
+      return [prefix](int i) {
+        char key[100];
+        std::snprintf(key, sizeof(key), "%c%06d", prefix, i);
+        return std::string(key);
+      };
+    };
+
+    // A single large level-2 table holds the "a" keys.
+    PutModel(key_with_prefix('a'), 20000);
+    EXPECT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    EXPECT_EQ("0,0,1", FilesPerLevel());
+
+    // Level-1 gets a few tables of "a" keys, each overlapping all of
+    // level-2, and tables of "b" keys that overlap nothing.  A flush that
+    // spans both ranges keeps the next flush in level-0, from where it is
+    // split into tables.
+    PutModel([](int) { return std::string("a"); }, 1);
+    PutModel([](int) { return std::string("b999999"); }, 1);
+    EXPECT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    PutModel(key_with_prefix('a'), 2000);
+    PutModel(key_with_prefix('b'), 10000);
+    EXPECT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    EXPECT_EQ("1,1,1", FilesPerLevel());
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    EXPECT_LEVELDB_OK(dbfull()->TEST_WaitForCompactions());
+    EXPECT_EQ(0, NumTableFilesAtLevel(0));
+    EXPECT_GT(NumTableFilesAtLevel(1), 0);
+    *level2_files = NumTableFilesAtLevel(2);
+    const CompactionTotals totals = GetCompactionTotals();
+
+    ReopenAndCheckModel(&options);
+    return totals;
+  };
+
+  int round_robin_files;
+  const CompactionTotals round_robin =
+      compact_level1(kRoundRobin, &round_robin_files);
+  int min_overlap_files;
+  const CompactionTotals min_overlap =
+      compact_level1(kMinOverlappingRatio, &min_overlap_files);
+  // Round-robin merges the "a" tables into the large level-2 table and
+  // rewrites it, while the minimum overlapping ratio moves "b" tables down
+  // and leaves it in place.
+  ASSERT_EQ(2, min_overlap_files);
+  ASSERT_LT(min_overlap_files, round_robin_files);
+  ASSERT_EQ(0, round_robin.moves);
+  ASSERT_GT(min_overlap.moves, 0);
+  ASSERT_LT(min_overlap.merges, round_robin.merges);
+  ASSERT_LT(min_overlap.output_level_mb_per_mb_picked,
+            round_robin.output_level_mb_per_mb_picked);
+  ASSERT_LT(min_overlap.write_amplification, round_robin.write_amplification);
+}
+
+TEST_F(DBTest, DeletionCompactionLevelShape) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_size = 64 << 20;
+  options.deletion_compaction_ratio = 0.9;
+  DestroyAndReopen(&options);
+
+  auto key = [](int i) {
+    char buf[100];
+    std::snprintf(buf, sizeof(buf), "key%06d", i);
+    return std::string(buf);
+  };
+  PutModel(key, 1000);
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("0,0,0,1", FilesPerLevel());
+
+  // A table in which 60% of the entries are deletions stays above the
+  // data it deletes while the ratio is below the threshold.
+  for (int i = 0; i < 1000; i++) {
+    if (i % 5 < 3) {
+      DeleteModel(key(i));
+    } else {
+      PutModel([&](int) { return key(i); }, 1, 10);
+    }
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(dbfull()->TEST_WaitForCompactions());
+  ASSERT_EQ("0,0,1,1", FilesPerLevel());
+  std::string tables;
+  ASSERT_TRUE(db_->GetProperty("leveldb.tables-by-deletion-ratio", &tables));
+  ASSERT_NE(std::string::npos, tables.find("600 of 1000 entries deleted"))
+      << tables;
+  // Only the compaction into level-3 has run.
+  const CompactionTotals kept = GetCompactionTotals();
+  ASSERT_EQ(1, kept.merges);
+  ASSERT_EQ(0, kept.moves);
+
+  // The entry counts are read back from the MANIFEST, and a lower
+  // threshold compacts the table into the level below.
+  options.deletion_compaction_ratio = 0.5;
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(dbfull()->TEST_WaitForCompactions());
+  ASSERT_EQ("0,0,0,1", FilesPerLevel());
+  ASSERT_TRUE(db_->GetProperty("leveldb.tables-by-deletion-ratio", &tables));
+  ASSERT_EQ("", tables);
+  // The small table is merged with the much larger one it deletes from.
+  const CompactionTotals compacted = GetCompactionTotals();
+  ASSERT_EQ(1, compacted.merges);
+  ASSERT_EQ(0, compacted.moves);
+  ASSERT_GT(compacted.output_level_mb_per_mb_picked, 1.0);
+
+  ReopenAndCheckModel(&options);
+}
+
+}  // namespace leveldb
@@ -51,14 +51,23 @@ class InternalKey;
 // Value types encoded as the last component of internal keys.
 // DO NOT CHANGE THESE ENUM VALUES: they are embedded in the on-disk
 // data structures.
-enum ValueType { kTypeDeletion = 0x0, kTypeValue = 0x1 };
+// Range deletions (see db/range_del.h) are never mixed with the other
+// types in the same sequence of entries.  A blob index is a value that is
+// stored in a blob file (see db/blob_file.h); it only appears in tables.
+enum ValueType {
+  kTypeDeletion = 0x0,
+  kTypeValue = 0x1,
+  kTypeMerge = 0x2,
+  kTypeRangeDeletion = 0x3,
+  kTypeBlobIndex = 0x4
+};
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
 // sequence number (since we sort sequence numbers in decreasing order
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeBlobIndex;
 
 typedef uint64_t SequenceNumber;
 
@@ -97,6 +106,23 @@ inline Slice ExtractUserKey(const Slice& internal_key) {
   return Slice(internal_key.data(), internal_key.size() - 8);
 }
 
+// If Options::ttl_seconds is set, the value of each kTypeValue entry is
+// followed by the time it was written, in seconds since the epoch, encoded
+// with EncodeFixed32.
+static const size_t kValueTimestampSize = 4;
+
+// Store the write time appended to "stored_value" in *timestamp.  Returns
+// false if "stored_value" is too short to hold one.
+inline bool ExtractValueTimestamp(const Slice& stored_value,
+                                  uint32_t* timestamp) {
+  if (stored_value.size() < kValueTimestampSize) {
+    return false;
+  }
+  *timestamp = DecodeFixed32(stored_value.data() + stored_value.size() -
+                             kValueTimestampSize);
+  return true;
+}
+
 // A comparator for internal keys that uses a specified comparator for
 // the user key portion and breaks ties by decreasing sequence number.
 class InternalKeyComparator : public Comparator {
@@ -177,7 +203,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
   result->sequence = num >> 8;
   result->type = static_cast<ValueType>(c);
   result->user_key = Slice(internal_key.data(), n - 8);
-  return (c <= static_cast<uint8_t>(kTypeValue));
+  return (c <= static_cast<uint8_t>(kValueTypeForSeek));
 }
 
 // A helper class useful for DBImpl::Get()
@@ -23,7 +23,7 @@ namespace leveldb {
 
 namespace {
 
-bool GuessType(const std::string& fname, FileType* type) {
+bool GuessType(const std::string& fname, FileType* type, uint64_t* number) {
   size_t pos = fname.rfind('/');
   std::string basename;
   if (pos == std::string::npos) {
@@ -31,8 +31,7 @@ bool GuessType(const std::string& fname, FileType* type) {
   } else {
     basename = std::string(fname.data() + pos + 1, fname.size() - pos - 1);
   }
-  uint64_t ignored;
-  return ParseFileName(basename, &ignored, type);
+  return ParseFileName(basename, number, type);
 }
 
 // Notified when log reader encounters corruption.
@@ -61,7 +60,11 @@ Status PrintLogContents(Env* env, const std::string& fname,
   }
   CorruptionReporter reporter;
   reporter.dst_ = dst;
-  log::Reader reader(file, &reporter, true, 0);
+  // Records of recycled logs are only accepted for the log's own number.
+  FileType type;
+  uint64_t number = 0;
+  GuessType(fname, &type, &number);
+  log::Reader reader(file, &reporter, true, 0, number);
   Slice record;
   std::string scratch;
   while (reader.ReadRecord(&record, &scratch)) {
@@ -88,6 +91,22 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
     r += "'\n";
     dst_->Append(r);
   }
+  void Merge(const Slice& key, const Slice& value) override {
+    std::string r = "  merge '";
+    AppendEscapedStringTo(&r, key);
+    r += "' '";
+    AppendEscapedStringTo(&r, value);
+    r += "'\n";
+    dst_->Append(r);
+  }
+  void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+    std::string r = "  delrange '";
+    AppendEscapedStringTo(&r, begin_key);
+    r += "' '";
+    AppendEscapedStringTo(&r, end_key);
+    r += "'\n";
+    dst_->Append(r);
+  }
 
   WritableFile* dst_;
 };
@@ -144,30 +163,8 @@ Status DumpDescriptor(Env* env, const std::string& fname, WritableFile* dst) {
   return PrintLogContents(env, fname, VersionEditPrinter, dst);
 }
 
-Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
-  uint64_t file_size;
-  RandomAccessFile* file = nullptr;
-  Table* table = nullptr;
-  Status s = env->GetFileSize(fname, &file_size);
-  if (s.ok()) {
-    s = env->NewRandomAccessFile(fname, &file);
-  }
-  if (s.ok()) {
-    // We use the default comparator, which may or may not match the
-    // comparator used in this database. However this should not cause
-    // problems since we only use Table operations that do not require
-    // any comparisons.  In particular, we do not call Seek or Prev.
-    s = Table::Open(Options(), file, file_size, &table);
-  }
-  if (!s.ok()) {
-    delete table;
-    delete file;
-    return s;
-  }
-
-  ReadOptions ro;
-  ro.fill_cache = false;
-  Iterator* iter = table->NewIterator(ro);
+// Print the entries of a table yielded by "iter".
+static void DumpTableEntries(Iterator* iter, WritableFile* dst) {
   std::string r;
   for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
     r.clear();
@@ -189,6 +186,12 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
         r += "del";
       } else if (key.type == kTypeValue) {
         r += "val";
+      } else if (key.type == kTypeMerge) {
+        r += "merge";
+      } else if (key.type == kTypeRangeDeletion) {
+        r += "rangedel";
+      } else if (key.type == kTypeBlobIndex) {
+        r += "blob";
       } else {
         AppendNumberTo(&r, key.type);
       }
@@ -198,11 +201,42 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
       dst->Append(r);
     }
   }
-  s = iter->status();
+  Status s = iter->status();
   if (!s.ok()) {
     dst->Append("iterator error: " + s.ToString() + "\n");
   }
+}
+
+Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
+  uint64_t file_size;
+  RandomAccessFile* file = nullptr;
+  Table* table = nullptr;
+  Status s = env->GetFileSize(fname, &file_size);
+  if (s.ok()) {
+    s = env->NewRandomAccessFile(fname, &file);
+  }
+  if (s.ok()) {
+    // We use the default comparator, which may or may not match the
+    // comparator used in this database. However this should not cause
+    // problems since we only use Table operations that do not require
+    // any comparisons.  In particular, we do not call Seek or Prev.
+    s = Table::Open(Options(), file, file_size, &table);
+  }
+  if (!s.ok()) {
+    delete table;
+    delete file;
+    return s;
+  }
+
+  ReadOptions ro;
+  ro.fill_cache = false;
+  Iterator* iter = table->NewIterator(ro);
+  DumpTableEntries(iter, dst);
+  delete iter;
 
+  // Range deletions are kept apart from the other entries.
+  iter = table->NewRangeTombstoneIterator();
+  DumpTableEntries(iter, dst);
   delete iter;
   delete table;
   delete file;
@@ -213,7 +247,8 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
 
 Status DumpFile(Env* env, const std::string& fname, WritableFile* dst) {
   FileType ftype;
-  if (!GuessType(fname, &ftype)) {
+  uint64_t number;
+  if (!GuessType(fname, &ftype, &number)) {
     return Status::InvalidArgument(fname + ": unknown file type");
   }
   switch (ftype) {
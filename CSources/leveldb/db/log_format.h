@@ -8,6 +8,8 @@
 #ifndef STORAGE_LEVELDB_DB_LOG_FORMAT_H_
 #define STORAGE_LEVELDB_DB_LOG_FORMAT_H_
 
+#include <cstddef>
+
 namespace leveldb {
 namespace log {
 
@@ -20,15 +22,38 @@ enum RecordType {
   // For fragments
   kFirstType = 2,
   kMiddleType = 3,
-  kLastType = 4
+  kLastType = 4,
+
+  // Variants of the above for log files that may be recycled.  Their header
+  // also holds the lower 32 bits of the log number, so that records left
+  // over from a previous use of the file can be told apart.
+  kRecyclableFullType = 5,
+  kRecyclableFirstType = 6,
+  kRecyclableMiddleType = 7,
+  kRecyclableLastType = 8,
+
+  // Start of a logical record whose payload is compressed: the compressed
+  // data followed by one byte holding its CompressionType.  Further
+  // fragments use kMiddleType and kLastType.
+  kCompressedFullType = 9,
+  kCompressedFirstType = 10,
+  kRecyclableCompressedFullType = 11,
+  kRecyclableCompressedFirstType = 12
 };
-static const int kMaxRecordType = kLastType;
+static const int kMaxRecordType = kRecyclableCompressedFirstType;
 
 static const int kBlockSize = 32768;
 
 // Header is checksum (4 bytes), length (2 bytes), type (1 byte).
 static const int kHeaderSize = 4 + 2 + 1;
 
+// Recyclable header is checksum (4 bytes), length (2 bytes), type (1 byte),
+// log number (4 bytes).
+static const int kRecyclableHeaderSize = kHeaderSize + 4;
+
+// Records shorter than this are never compressed.
+static const size_t kMinCompressedRecordSize = 4096;
+
 }  // namespace log
 }  // namespace leveldb
 
@@ -7,6 +7,8 @@
 #include <cstdio>
 
 #include "leveldb/env.h"
+#include "leveldb/options.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -16,7 +18,7 @@ namespace log {
 Reader::Reporter::~Reporter() = default;
 
 Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
-               uint64_t initial_offset)
+               uint64_t initial_offset, uint64_t log_number)
     : file_(file),
       reporter_(reporter),
       checksum_(checksum),
@@ -26,7 +28,9 @@ Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
       last_record_offset_(0),
       end_of_buffer_offset_(0),
       initial_offset_(initial_offset),
-      resyncing_(initial_offset > 0) {}
+      resyncing_(initial_offset > 0),
+      log_number_(static_cast<uint32_t>(log_number)),
+      recycled_(false) {}
 
 Reader::~Reader() { delete[] backing_store_; }
 
@@ -63,19 +67,23 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
   scratch->clear();
   record->clear();
   bool in_fragmented_record = false;
+  // True if the logical record being read is compressed
+  bool compressed = false;
   // Record offset of the logical record that we're reading
   // 0 is a dummy value to make compilers happy
   uint64_t prospective_record_offset = 0;
 
   Slice fragment;
   while (true) {
-    const unsigned int record_type = ReadPhysicalRecord(&fragment);
+    int header_size = kHeaderSize;
+    const unsigned int record_type =
+        ReadPhysicalRecord(&fragment, &header_size);
 
     // ReadPhysicalRecord may have only had an empty trailer remaining in its
     // internal buffer. Calculate the offset of the next physical record now
     // that it has returned, properly accounting for its header size.
     uint64_t physical_record_offset =
-        end_of_buffer_offset_ - buffer_.size() - kHeaderSize - fragment.size();
+        end_of_buffer_offset_ - buffer_.size() - header_size - fragment.size();
 
     if (resyncing_) {
       if (record_type == kMiddleType) {
@@ -90,6 +98,7 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 
     switch (record_type) {
       case kFullType:
+      case kCompressedFullType:
         if (in_fragmented_record) {
           // Handle bug in earlier versions of log::Writer where
           // it could emit an empty kFirstType record at the tail end
@@ -102,10 +111,15 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
         prospective_record_offset = physical_record_offset;
         scratch->clear();
         *record = fragment;
+        if (record_type == kCompressedFullType && !Uncompress(record)) {
+          in_fragmented_record = false;
+          break;
+        }
         last_record_offset_ = prospective_record_offset;
         return true;
 
       case kFirstType:
+      case kCompressedFirstType:
         if (in_fragmented_record) {
           // Handle bug in earlier versions of log::Writer where
           // it could emit an empty kFirstType record at the tail end
@@ -118,6 +132,7 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
         prospective_record_offset = physical_record_offset;
         scratch->assign(fragment.data(), fragment.size());
         in_fragmented_record = true;
+        compressed = (record_type == kCompressedFirstType);
         break;
 
       case kMiddleType:
@@ -136,11 +151,22 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
         } else {
           scratch->append(fragment.data(), fragment.size());
           *record = Slice(*scratch);
+          if (compressed && !Uncompress(record)) {
+            in_fragmented_record = false;
+            scratch->clear();
+            break;
+          }
           last_record_offset_ = prospective_record_offset;
           return true;
         }
         break;
 
+      case kOldRecord:
+        // The rest of the file was written by a previous user of a recycled
+        // log file.  Like kEof, this can also cut off a partial record.
+        scratch->clear();
+        return false;
+
       case kEof:
         if (in_fragmented_record) {
           // This can be caused by the writer dying immediately after
@@ -175,6 +201,42 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 
 uint64_t Reader::LastRecordOffset() { return last_record_offset_; }
 
+bool Reader::Uncompress(Slice* record) {
+  const char* data = record->data();
+  size_t n = record->size();
+  bool (*get_uncompressed_length)(const char*, size_t, size_t*) = nullptr;
+  bool (*uncompress)(const char*, size_t, char*) = nullptr;
+  if (n >= 1) {
+    switch (data[n - 1]) {
+      case kSnappyCompression:
+        get_uncompressed_length = port::Snappy_GetUncompressedLength;
+        uncompress = port::Snappy_Uncompress;
+        break;
+      case kZlibCompression:
+        get_uncompressed_length = port::Zlib_GetUncompressedLength;
+        uncompress = port::Zlib_Uncompress;
+        break;
+    }
+  }
+  if (uncompress == nullptr) {
+    ReportCorruption(n, "unknown record compression type");
+    return false;
+  }
+  n--;
+  size_t ulength = 0;
+  if (!get_uncompressed_length(data, n, &ulength)) {
+    ReportCorruption(n + 1, "corrupted compressed record");
+    return false;
+  }
+  uncompressed_.resize(ulength);
+  if (!uncompress(data, n, &uncompressed_[0])) {
+    ReportCorruption(n + 1, "corrupted compressed record");
+    return false;
+  }
+  *record = Slice(uncompressed_);
+  return true;
+}
+
 void Reader::ReportCorruption(uint64_t bytes, const char* reason) {
   ReportDrop(bytes, Status::Corruption(reason));
 }
@@ -186,7 +248,7 @@ void Reader::ReportDrop(uint64_t bytes, const Status& reason) {
   }
 }
 
-unsigned int Reader::ReadPhysicalRecord(Slice* result) {
+unsigned int Reader::ReadPhysicalRecord(Slice* result, int* header_size) {
   while (true) {
     if (buffer_.size() < kHeaderSize) {
       if (!eof_) {
@@ -217,11 +279,19 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     const char* header = buffer_.data();
     const uint32_t a = static_cast<uint32_t>(header[4]) & 0xff;
     const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
-    const unsigned int type = header[6];
+    unsigned int type = header[6];
     const uint32_t length = a | (b << 8);
-    if (kHeaderSize + length > buffer_.size()) {
+    const bool recyclable_type =
+        (type >= kRecyclableFullType && type <= kRecyclableLastType) ||
+        type == kRecyclableCompressedFullType ||
+        type == kRecyclableCompressedFirstType;
+    *header_size = recyclable_type ? kRecyclableHeaderSize : kHeaderSize;
+    if (*header_size + length > buffer_.size()) {
       size_t drop_size = buffer_.size();
       buffer_.clear();
+      if (recycled_) {
+        return kOldRecord;
+      }
       if (!eof_) {
         ReportCorruption(drop_size, "bad record length");
         return kBadRecord;
@@ -240,10 +310,12 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
       return kBadRecord;
     }
 
-    // Check crc
+    // Check crc.  It covers the type, the log number of recyclable records
+    // and the payload, which are contiguous.
     if (checksum_) {
       uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
-      uint32_t actual_crc = crc32c::Value(header + 6, 1 + length);
+      uint32_t actual_crc =
+          crc32c::Value(header + 6, *header_size - 6 + length);
       if (actual_crc != expected_crc) {
         // Drop the rest of the buffer since "length" itself may have
         // been corrupted and if we trust it, we could find some
@@ -251,21 +323,40 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
         // like a valid log record.
         size_t drop_size = buffer_.size();
         buffer_.clear();
+        if (recycled_) {
+          return kOldRecord;
+        }
         ReportCorruption(drop_size, "checksum mismatch");
         return kBadRecord;
       }
     }
 
-    buffer_.remove_prefix(kHeaderSize + length);
+    if (recyclable_type) {
+      recycled_ = true;
+      if (DecodeFixed32(header + kHeaderSize) != log_number_) {
+        buffer_.clear();
+        return kOldRecord;
+      }
+      if (type >= kRecyclableCompressedFullType) {
+        type -= kRecyclableCompressedFullType - kCompressedFullType;
+      } else {
+        type -= kRecyclableFullType - kFullType;
+      }
+    } else if (recycled_) {
+      buffer_.clear();
+      return kOldRecord;
+    }
+
+    buffer_.remove_prefix(*header_size + length);
 
     // Skip physical record that started before initial_offset_
-    if (end_of_buffer_offset_ - buffer_.size() - kHeaderSize - length <
+    if (end_of_buffer_offset_ - buffer_.size() - *header_size - length <
         initial_offset_) {
       result->clear();
       return kBadRecord;
     }
 
-    *result = Slice(header + kHeaderSize, length);
+    *result = Slice(header + *header_size, length);
     return type;
   }
 }
@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_DB_LOG_READER_H_
 
 #include <cstdint>
+#include <string>
 
 #include "db/log_format.h"
 #include "leveldb/slice.h"
@@ -40,19 +41,23 @@ class Reader {
   //
   // The Reader will start reading at the first record located at physical
   // position >= initial_offset within the file.
+  //
+  // "log_number" is the number of the log file being read.  Recyclable
+  // records written for another log number are stale contents of a
+  // recycled file and end the log.
   Reader(SequentialFile* file, Reporter* reporter, bool checksum,
-         uint64_t initial_offset);
+         uint64_t initial_offset, uint64_t log_number = 0);
 
   Reader(const Reader&) = delete;
   Reader& operator=(const Reader&) = delete;
 
   ~Reader();
 
-  // Read the next record into *record.  Returns true if read
-  // successfully, false if we hit end of the input.  May use
-  // "*scratch" as temporary storage.  The contents filled in *record
-  // will only be valid until the next mutating operation on this
-  // reader or the next mutation to *scratch.
+  // Read the next record into *record, uncompressing it if it was stored
+  // compressed.  Returns true if read successfully, false if we hit end of
+  // the input.  May use "*scratch" as temporary storage.  The contents
+  // filled in *record will only be valid until the next mutating operation
+  // on this reader or the next mutation to *scratch.
   bool ReadRecord(Slice* record, std::string* scratch);
 
   // Returns the physical offset of the last record returned by ReadRecord.
@@ -69,7 +74,11 @@ class Reader {
     // * The record has an invalid CRC (ReadPhysicalRecord reports a drop)
     // * The record is a 0-length record (No drop is reported)
     // * The record is below constructor's initial_offset (No drop is reported)
-    kBadRecord = kMaxRecordType + 2
+    kBadRecord = kMaxRecordType + 2,
+    // Returned when we find a record left over from a previous use of a
+    // recycled log file, or, once the log is known to be recycled, any data
+    // that does not parse as a record of this log.  Ends the log.
+    kOldRecord = kMaxRecordType + 3
   };
 
   // Skips all blocks that are completely before "initial_offset_".
@@ -77,8 +86,14 @@ class Reader {
   // Returns true on success. Handles reporting.
   bool SkipToInitialBlock();
 
-  // Return type, or one of the preceding special values
-  unsigned int ReadPhysicalRecord(Slice* result);
+  // Return type, or one of the preceding special values.  Recyclable types
+  // are returned as their plain counterparts.  Sets "*header_size" to the
+  // size of the record's header.
+  unsigned int ReadPhysicalRecord(Slice* result, int* header_size);
+
+  // Replace "*record", a compressed logical record, by its uncompressed
+  // contents.  Returns false and reports a corruption on failure.
+  bool Uncompress(Slice* record);
 
   // Reports dropped bytes to the reporter.
   // buffer_ must be updated to remove the dropped bytes prior to invocation.
@@ -104,6 +119,15 @@ class Reader {
   // particular, a run of kMiddleType and kLastType records can be silently
   // skipped in this mode
   bool resyncing_;
+
+  // Lower 32 bits of the number of the log being read.
+  uint32_t const log_number_;
+
+  // True once a recyclable record has been read.
+  bool recycled_;
+
+  // Holds the contents of the last compressed record returned.
+  std::string uncompressed_;
 };
 
 }  // namespace log
@@ -0,0 +1,422 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "db/log_reader.h"
+#include "db/log_writer.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+namespace log {
+
+// Construct a string of the specified length made out of the supplied
+// partial string.
+static std::string BigString(const std::string& partial_string, size_t n) {
+  std::string result;
+  while (result.size() < n) {
+    result.append(partial_string);
+  }
+  result.resize(n);
+  return result;
+}
+
+// Construct a string from a number
+static std::string NumberString(int n) {
+  char buf[50];
+  std::snprintf(buf, sizeof(buf), "%d.", n);
+  return std::string(buf);
+}
+
+class LogTest : public testing::Test {
+ public:
+  LogTest() : reading_(false) {}
+
+  ~LogTest() {
+    delete writer_;
+    delete reader_;
+  }
+
+  // Start writing log "log_number" over the current contents, as a
+  // recycled log file is written.
+  void StartRecycledLog(uint64_t log_number) {
+    delete writer_;
+    dest_.Rewind();
+    writer_ = new Writer(&dest_, log_number, /*recyclable=*/true);
+  }
+
+  void Write(const std::string& msg,
+             CompressionType compression = kNoCompression) {
+    ASSERT_TRUE(!reading_) << "Write() after starting to read";
+    writer_->AddRecord(Slice(msg), compression);
+  }
+
+  size_t WrittenBytes() const { return dest_.contents_.size(); }
+
+  // Read the next record, or "EOF" at the end of the log.
+  std::string Read(uint64_t log_number = 0) {
+    if (!reading_) {
+      reading_ = true;
+      source_.contents_ = Slice(dest_.contents_);
+      delete reader_;
+      reader_ = new Reader(&source_, &report_, true /*checksum*/,
+                           0 /*initial_offset*/, log_number);
+    }
+    std::string scratch;
+    Slice record;
+    if (reader_->ReadRecord(&record, &scratch)) {
+      return record.ToString();
+    } else {
+      return "EOF";
+    }
+  }
+
+  // Type byte of the physical record whose header starts at "offset".
+  int RecordTypeAt(int offset) const {
+    return static_cast<unsigned char>(dest_.contents_[offset + 6]);
+  }
+
+  void IncrementByte(int offset, int delta) {
+    dest_.contents_[offset] += delta;
+  }
+
+  void FixChecksum(int header_offset, int len, int header_size) {
+    // Compute crc of type/len/data
+    uint32_t crc = crc32c::Value(&dest_.contents_[header_offset + 6],
+                                 header_size - 6 + len);
+    crc = crc32c::Mask(crc);
+    EncodeFixed32(&dest_.contents_[header_offset], crc);
+  }
+
+  size_t DroppedBytes() const { return report_.dropped_bytes_; }
+
+  std::string ReportMessage() const { return report_.message_; }
+
+  // Returns OK iff recorded error message contains "msg"
+  std::string MatchError(const std::string& msg) const {
+    if (report_.message_.find(msg) == std::string::npos) {
+      return report_.message_;
+    } else {
+      return "OK";
+    }
+  }
+
+ private:
+  // A log file in memory.  Rewind() makes further appends overwrite the
+  // contents from the beginning, the way a reused log file is written.
+  class StringDest : public WritableFile {
+   public:
+    StringDest() : position_(0) {}
+
+    void Rewind() { position_ = 0; }
+
+    Status Close() override { return Status::OK(); }
+    Status Flush() override { return Status::OK(); }
+    Status Sync() override { return Status::OK(); }
+    Status Append(const Slice& slice) override {
+      const size_t overlap =
+          std::min(slice.size(), contents_.size() - position_);
+      contents_.replace(position_, overlap, slice.data(), overlap);
+      contents_.append(slice.data() + overlap, slice.size() - overlap);
+      position_ += slice.size();
+      return Status::OK();
+    }
+
+    std::string contents_;
+
+   private:
+    size_t position_;
+  };
+
+  class StringSource : public SequentialFile {
+   public:
+    StringSource() : force_error_(false), returned_partial_(false) {}
+
+    Status Read(size_t n, Slice* result, char* scratch) override {
+      EXPECT_TRUE(!returned_partial_) << "must not Read() after eof/error";
+
+      if (force_error_) {
+        force_error_ = false;
+        returned_partial_ = true;
+        return Status::Corruption("read error");
+      }
+
+      if (contents_.size() < n) {
+        n = contents_.size();
+        returned_partial_ = true;
+      }
+      *result = Slice(contents_.data(), n);
+      contents_.remove_prefix(n);
+      return Status::OK();
+    }
+
+    Status Skip(uint64_t n) override {
+      if (n > contents_.size()) {
+        contents_.clear();
+        return Status::NotFound("in-memory file skipped past end");
+      }
+
+      contents_.remove_prefix(n);
+
+      return Status::OK();
+    }
+
+    Slice contents_;
+    bool force_error_;
+    bool returned_partial_;
+  };
+
+  class ReportCollector : public Reader::Reporter {
+   public:
+    ReportCollector() : dropped_bytes_(0) {}
+    void Corruption(size_t bytes, const Status& status) override {
+      dropped_bytes_ += bytes;
+      message_.append(status.ToString());
+    }
+
+    size_t dropped_bytes_;
+    std::string message_;
+  };
+
+  StringDest dest_;
+  StringSource source_;
+  ReportCollector report_;
+  bool reading_;
+  Writer* writer_ = new Writer(&dest_);
+  Reader* reader_ = nullptr;
+};
+
+TEST_F(LogTest, Empty) { ASSERT_EQ("EOF", Read()); }
+
+TEST_F(LogTest, ReadWrite) {
+  Write("foo");
+  Write("bar");
+  Write("");
+  Write("xxxx");
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ("xxxx", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ("EOF", Read());  // Make sure reads at eof work
+}
+
+TEST_F(LogTest, ManyBlocks) {
+  for (int i = 0; i < 100000; i++) {
+    Write(NumberString(i));
+  }
+  for (int i = 0; i < 100000; i++) {
+    ASSERT_EQ(NumberString(i), Read());
+  }
+  ASSERT_EQ("EOF", Read());
+}
+
+TEST_F(LogTest, Fragmentation) {
+  Write("small");
+  Write(BigString("medium", 50000));
+  Write(BigString("large", 100000));
+  ASSERT_EQ("small", Read());
+  ASSERT_EQ(BigString("medium", 50000), Read());
+  ASSERT_EQ(BigString("large", 100000), Read());
+  ASSERT_EQ("EOF", Read());
+}
+
+TEST_F(LogTest, ChecksumMismatch) {
+  Write("foo");
+  IncrementByte(0, 10);
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(10, DroppedBytes());
+  ASSERT_EQ("OK", MatchError("checksum mismatch"));
+}
+
+TEST_F(LogTest, RecyclableReadWrite) {
+  StartRecycledLog(7);
+  Write("foo");
+  Write(BigString("large", 100000));
+  Write("bar");
+  ASSERT_EQ("foo", Read(7));
+  ASSERT_EQ(BigString("large", 100000), Read(7));
+  ASSERT_EQ("bar", Read(7));
+  ASSERT_EQ("EOF", Read(7));
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogEndsAtStaleRecords) {
+  // The first use of the file, as log 7, fills several blocks.
+  StartRecycledLog(7);
+  for (int i = 0; i < 10000; i++) {
+    Write("old" + NumberString(i));
+  }
+  const size_t old_size = WrittenBytes();
+
+  // Log 8 reuses the file and overwrites only part of the first block, so
+  // that the stale records of log 7 follow its own.
+  StartRecycledLog(8);
+  Write("new1");
+  Write(BigString("new2", 1000));
+  ASSERT_EQ(old_size, WrittenBytes());
+
+  ASSERT_EQ("new1", Read(8));
+  ASSERT_EQ(BigString("new2", 1000), Read(8));
+  ASSERT_EQ("EOF", Read(8));
+  ASSERT_EQ(0, DroppedBytes());
+  ASSERT_EQ("", ReportMessage());
+}
+
+TEST_F(LogTest, RecycledLogEndsAtStaleFragment) {
+  StartRecycledLog(7);
+  for (int i = 0; i < 10000; i++) {
+    Write("old" + NumberString(i));
+  }
+
+  // The last record of log 8 spans into the second block, where it ends.
+  // The stale records that follow it there belong to log 7.
+  StartRecycledLog(8);
+  Write("new1");
+  Write(BigString("new2", kBlockSize));
+
+  ASSERT_EQ("new1", Read(8));
+  ASSERT_EQ(BigString("new2", kBlockSize), Read(8));
+  ASSERT_EQ("EOF", Read(8));
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogReadAsOtherLog) {
+  // A record with a valid checksum that was written for another log number
+  // ends the log instead of being replayed.
+  StartRecycledLog(7);
+  Write("foo");
+  Write("bar");
+  ASSERT_EQ("EOF", Read(8));
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogEndsAtLegacyRecords) {
+  // Records without a log number after recyclable ones are left over from
+  // before the file was recycled.
+  Write("legacy1");
+  Write("legacy2");
+  Write("legacy3");
+  StartRecycledLog(8);
+  Write("new");
+
+  ASSERT_EQ("new", Read(8));
+  ASSERT_EQ("EOF", Read(8));
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogEndsAtTornStaleRecord) {
+  // The stale contents behind the new records start in the middle of a
+  // record of log 7 and do not parse as records.
+  StartRecycledLog(7);
+  Write(BigString("old", 1000));
+  Write(BigString("old", 1000));
+  StartRecycledLog(8);
+  Write(BigString("new", 500));
+
+  ASSERT_EQ(BigString("new", 500), Read(8));
+  ASSERT_EQ("EOF", Read(8));
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, CompressedReadWrite) {
+  const std::string large = BigString("compressible", 100000);
+  Write("small", kZlibCompression);
+  Write(large, kZlibCompression);
+  Write("", kZlibCompression);
+  // The small record is stored as is, the large one in a single compressed
+  // fragment.
+  ASSERT_EQ(kFullType, RecordTypeAt(0));
+  ASSERT_EQ(kCompressedFullType, RecordTypeAt(kHeaderSize + 5));
+  ASSERT_LT(WrittenBytes(), large.size() / 10);
+
+  ASSERT_EQ("small", Read());
+  ASSERT_EQ(large, Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, CompressedFragmentedReadWrite) {
+  // Random data does not compress much, so the compressed form of this
+  // record spans several blocks.
+  std::string large;
+  uint32_t x = 301;
+  for (int i = 0; i < 8 * kBlockSize; i++) {
+    x = x * 1103515245 + 12345;
+    large.push_back(static_cast<char>('a' + (x >> 16) % 4));
+  }
+  Write(large, kZlibCompression);
+  Write("bar");
+  ASSERT_EQ(kCompressedFirstType, RecordTypeAt(0));
+  ASSERT_LT(WrittenBytes(), large.size() - large.size() / 8);
+  ASSERT_GT(WrittenBytes(), static_cast<size_t>(2 * kBlockSize));
+
+  ASSERT_EQ(large, Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, IncompressibleRecordIsStoredUncompressed) {
+  std::string random;
+  uint32_t x = 301;
+  for (int i = 0; i < 10000; i++) {
+    x = x * 1103515245 + 12345;
+    random.push_back(static_cast<char>(x >> 16));
+  }
+  Write(random, kZlibCompression);
+  ASSERT_EQ(kFullType, RecordTypeAt(0));
+  ASSERT_EQ(random, Read());
+  ASSERT_EQ("EOF", Read());
+}
+
+TEST_F(LogTest, RecyclableCompressedReadWrite) {
+  StartRecycledLog(7);
+  const std::string large = BigString("compressible", 100000);
+  Write(large, kZlibCompression);
+  Write("bar");
+  ASSERT_EQ(kRecyclableCompressedFullType, RecordTypeAt(0));
+  ASSERT_EQ(large, Read(7));
+  ASSERT_EQ("bar", Read(7));
+  ASSERT_EQ("EOF", Read(7));
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, CorruptedCompressedRecord) {
+  Write(BigString("compressible", 100000), kZlibCompression);
+  const int length = static_cast<int>(WrittenBytes()) - kHeaderSize;
+  Write("bar");
+  // Damage the end of the compressed stream, just before the compression
+  // type byte, and fix up the record checksum so that only the
+  // decompression can detect it.
+  IncrementByte(kHeaderSize + length - 2, 1);
+  FixChecksum(0, length, kHeaderSize);
+
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(length, DroppedBytes());
+  ASSERT_EQ("OK", MatchError("corrupted compressed record"));
+}
+
+TEST_F(LogTest, UnknownRecordCompressionType) {
+  Write(BigString("compressible", 100000), kZlibCompression);
+  const int length = static_cast<int>(WrittenBytes()) - kHeaderSize;
+  Write("bar");
+  IncrementByte(kHeaderSize + length - 1, 10);
+  FixChecksum(0, length, kHeaderSize);
+
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(length, DroppedBytes());
+  ASSERT_EQ("OK", MatchError("unknown record compression type"));
+}
+
+}  // namespace log
+}  // namespace leveldb
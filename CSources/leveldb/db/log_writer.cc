@@ -7,6 +7,7 @@
 #include <cstdint>
 
 #include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -20,21 +21,63 @@ static void InitTypeCrc(uint32_t* type_crc) {
   }
 }
 
-Writer::Writer(WritableFile* dest) : dest_(dest), block_offset_(0) {
+Writer::Writer(WritableFile* dest)
+    : dest_(dest),
+      block_offset_(0),
+      recyclable_(false),
+      header_size_(kHeaderSize),
+      log_number_(0) {
   InitTypeCrc(type_crc_);
 }
 
 Writer::Writer(WritableFile* dest, uint64_t dest_length)
-    : dest_(dest), block_offset_(dest_length % kBlockSize) {
+    : dest_(dest),
+      block_offset_(dest_length % kBlockSize),
+      recyclable_(false),
+      header_size_(kHeaderSize),
+      log_number_(0) {
+  InitTypeCrc(type_crc_);
+}
+
+Writer::Writer(WritableFile* dest, uint64_t log_number, bool recyclable)
+    : dest_(dest),
+      block_offset_(0),
+      recyclable_(recyclable),
+      header_size_(recyclable ? kRecyclableHeaderSize : kHeaderSize),
+      log_number_(static_cast<uint32_t>(log_number)) {
   InitTypeCrc(type_crc_);
 }
 
 Writer::~Writer() = default;
 
-Status Writer::AddRecord(const Slice& slice) {
+Status Writer::AddRecord(const Slice& slice, CompressionType compression) {
   const char* ptr = slice.data();
   size_t left = slice.size();
 
+  bool compressed = false;
+  if (compression != kNoCompression &&
+      slice.size() >= kMinCompressedRecordSize) {
+    bool ok = false;
+    switch (compression) {
+      case kNoCompression:
+        break;
+      case kSnappyCompression:
+        ok = port::Snappy_Compress(slice.data(), slice.size(), &compressed_);
+        break;
+      case kZlibCompression:
+        ok = port::Zlib_Compress(slice.data(), slice.size(), &compressed_);
+        break;
+    }
+    // Like table blocks, only keep the compressed form if it saves at least
+    // 12.5%.
+    if (ok && compressed_.size() < slice.size() - (slice.size() / 8u)) {
+      compressed_.push_back(static_cast<char>(compression));
+      ptr = compressed_.data();
+      left = compressed_.size();
+      compressed = true;
+    }
+  }
+
   // Fragment the record if necessary and emit it.  Note that if slice
   // is empty, we still want to iterate once to emit a single
   // zero-length record
@@ -43,32 +86,39 @@ Status Writer::AddRecord(const Slice& slice) {
   do {
     const int leftover = kBlockSize - block_offset_;
     assert(leftover >= 0);
-    if (leftover < kHeaderSize) {
+    if (leftover < header_size_) {
       // Switch to a new block
       if (leftover > 0) {
-        // Fill the trailer (literal below relies on kHeaderSize being 7)
-        static_assert(kHeaderSize == 7, "");
-        dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+        // Fill the trailer (literal below relies on kRecyclableHeaderSize
+        // being 11)
+        static_assert(kRecyclableHeaderSize == 11, "");
+        dest_->Append(
+            Slice("\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", leftover));
       }
       block_offset_ = 0;
     }
 
-    // Invariant: we never leave < kHeaderSize bytes in a block.
-    assert(kBlockSize - block_offset_ - kHeaderSize >= 0);
+    // Invariant: we never leave < header_size_ bytes in a block.
+    assert(kBlockSize - block_offset_ - header_size_ >= 0);
 
-    const size_t avail = kBlockSize - block_offset_ - kHeaderSize;
+    const size_t avail = kBlockSize - block_offset_ - header_size_;
     const size_t fragment_length = (left < avail) ? left : avail;
 
     RecordType type;
     const bool end = (left == fragment_length);
-    if (begin && end) {
-      type = kFullType;
+    if (begin && end && compressed) {
+      type = recyclable_ ? kRecyclableCompressedFullType : kCompressedFullType;
+    } else if (begin && end) {
+      type = recyclable_ ? kRecyclableFullType : kFullType;
+    } else if (begin && compressed) {
+      type =
+          recyclable_ ? kRecyclableCompressedFirstType : kCompressedFirstType;
     } else if (begin) {
-      type = kFirstType;
+      type = recyclable_ ? kRecyclableFirstType : kFirstType;
     } else if (end) {
-      type = kLastType;
+      type = recyclable_ ? kRecyclableLastType : kLastType;
     } else {
-      type = kMiddleType;
+      type = recyclable_ ? kRecyclableMiddleType : kMiddleType;
     }
 
     s = EmitPhysicalRecord(type, ptr, fragment_length);
@@ -82,28 +132,34 @@ Status Writer::AddRecord(const Slice& slice) {
 Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr,
                                   size_t length) {
   assert(length <= 0xffff);  // Must fit in two bytes
-  assert(block_offset_ + kHeaderSize + length <= kBlockSize);
+  assert(block_offset_ + header_size_ + length <= kBlockSize);
 
   // Format the header
-  char buf[kHeaderSize];
+  char buf[kRecyclableHeaderSize];
   buf[4] = static_cast<char>(length & 0xff);
   buf[5] = static_cast<char>(length >> 8);
   buf[6] = static_cast<char>(t);
 
-  // Compute the crc of the record type and the payload.
-  uint32_t crc = crc32c::Extend(type_crc_[t], ptr, length);
+  // Compute the crc of the record type, the log number (if recyclable) and
+  // the payload.
+  uint32_t crc = type_crc_[t];
+  if (recyclable_) {
+    EncodeFixed32(buf + kHeaderSize, log_number_);
+    crc = crc32c::Extend(crc, buf + kHeaderSize, 4);
+  }
+  crc = crc32c::Extend(crc, ptr, length);
   crc = crc32c::Mask(crc);  // Adjust for storage
   EncodeFixed32(buf, crc);
 
   // Write the header and the payload
-  Status s = dest_->Append(Slice(buf, kHeaderSize));
+  Status s = dest_->Append(Slice(buf, header_size_));
   if (s.ok()) {
     s = dest_->Append(Slice(ptr, length));
     if (s.ok()) {
       s = dest_->Flush();
     }
   }
-  block_offset_ += kHeaderSize + length;
+  block_offset_ += header_size_ + length;
   return s;
 }
 
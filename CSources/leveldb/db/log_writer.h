@@ -6,8 +6,10 @@
 #define STORAGE_LEVELDB_DB_LOG_WRITER_H_
 
 #include <cstdint>
+#include <string>
 
 #include "db/log_format.h"
+#include "leveldb/options.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 
@@ -29,18 +31,34 @@ class Writer {
   // "*dest" must remain live while this Writer is in use.
   Writer(WritableFile* dest, uint64_t dest_length);
 
+  // Create a writer that will write records for log "log_number" to
+  // "*dest", starting at its beginning.  If "recyclable" is true, the
+  // records are tagged with the log number, and "*dest" may be a recycled
+  // log file whose stale contents get overwritten.  Otherwise "*dest" must
+  // be initially empty.
+  // "*dest" must remain live while this Writer is in use.
+  Writer(WritableFile* dest, uint64_t log_number, bool recyclable);
+
   Writer(const Writer&) = delete;
   Writer& operator=(const Writer&) = delete;
 
   ~Writer();
 
-  Status AddRecord(const Slice& slice);
+  // Append "slice" as one logical record.  If "compression" is not
+  // kNoCompression and the record is at least kMinCompressedRecordSize
+  // bytes, it is stored compressed unless that saves less than 12.5%.
+  Status AddRecord(const Slice& slice,
+                   CompressionType compression = kNoCompression);
 
  private:
   Status EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
 
   WritableFile* dest_;
   int block_offset_;  // Current offset in block
+  const bool recyclable_;
+  const int header_size_;
+  const uint32_t log_number_;  // Lower 32 bits, written if recyclable_
+  std::string compressed_;     // Buffer for compressed records
 
   // crc32c values for all supported record types.  These are
   // pre-computed to reduce the overhead of computing the crc of the
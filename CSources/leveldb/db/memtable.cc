@@ -4,6 +4,7 @@
 
 #include "db/memtable.h"
 #include "db/dbformat.h"
+#include "db/range_del.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
@@ -19,7 +20,10 @@ static Slice GetLengthPrefixedSlice(const char* data) {
 }
 
 MemTable::MemTable(const InternalKeyComparator& comparator)
-    : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
+    : comparator_(comparator),
+      refs_(0),
+      table_(comparator_, &arena_),
+      range_del_table_(comparator_, &arena_) {}
 
 MemTable::~MemTable() { assert(refs_ == 0); }
 
@@ -73,6 +77,10 @@ class MemTableIterator : public Iterator {
 
 Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
 
+Iterator* MemTable::NewRangeTombstoneIterator() {
+  return new MemTableIterator(&range_del_table_);
+}
+
 void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
                    const Slice& value) {
   // Format of an entry is concatenation of:
@@ -95,14 +103,29 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   p = EncodeVarint32(p, val_size);
   std::memcpy(p, value.data(), val_size);
   assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  if (type == kTypeRangeDeletion) {
+    range_del_table_.Insert(buf);
+  } else {
+    table_.Insert(buf);
+  }
 }
 
-bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+bool MemTable::Get(const LookupKey& key, std::string* value, Status* s,
+                   std::vector<std::string>* merge_operands,
+                   SequenceNumber* max_covering_tombstone_seq) {
+  const Slice internal_key = key.internal_key();
+  const SequenceNumber snapshot =
+      DecodeFixed64(internal_key.data() + internal_key.size() - 8) >> 8;
+  MemTableIterator range_del_iter(&range_del_table_);
+  UpdateMaxCoveringTombstone(&range_del_iter,
+                             comparator_.comparator.user_comparator(),
+                             key.user_key(), snapshot,
+                             max_covering_tombstone_seq);
+
   Slice memkey = key.memtable_key();
   Table::Iterator iter(&table_);
   iter.Seek(memkey.data());
-  if (iter.Valid()) {
+  for (; iter.Valid(); iter.Next()) {
     // entry format is:
     //    klength  varint32
     //    userkey  char[klength]
@@ -116,19 +139,34 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
     uint32_t key_length;
     const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
     if (comparator_.comparator.user_comparator()->Compare(
-            Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
-      // Correct user key
-      const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
-      switch (static_cast<ValueType>(tag & 0xff)) {
-        case kTypeValue: {
-          Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
-          value->assign(v.data(), v.size());
-          return true;
-        }
-        case kTypeDeletion:
-          *s = Status::NotFound(Slice());
-          return true;
+            Slice(key_ptr, key_length - 8), key.user_key()) != 0) {
+      break;
+    }
+    // Correct user key
+    const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+    ValueType type = static_cast<ValueType>(tag & 0xff);
+    if ((tag >> 8) < *max_covering_tombstone_seq) {
+      type = kTypeRangeDeletion;
+    }
+    switch (type) {
+      case kTypeValue: {
+        Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+        value->assign(v.data(), v.size());
+        return true;
+      }
+      case kTypeRangeDeletion:  // The entry is within a deleted range
+      case kTypeDeletion:
+        *s = Status::NotFound(Slice());
+        return true;
+      case kTypeMerge: {
+        // Keep looking for the entries this operand applies to.
+        Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+        merge_operands->push_back(v.ToString());
+        break;
       }
+      case kTypeBlobIndex:  // Only written to tables
+        *s = Status::Corruption("blob index in memtable", key.user_key());
+        return true;
     }
   }
   return false;
@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "db/skiplist.h"
@@ -50,9 +51,15 @@ class MemTable {
   // db/format.{h,cc} module.
   Iterator* NewIterator();
 
+  // Return an iterator over the range deletions of the memtable, stored as
+  // described in db/range_del.h.  Same requirements as for NewIterator().
+  Iterator* NewRangeTombstoneIterator();
+
   // Add an entry into memtable that maps key to value at the
   // specified sequence number and with the specified type.
-  // Typically value will be empty if type==kTypeDeletion.
+  // Typically value will be empty if type==kTypeDeletion.  For
+  // type==kTypeRangeDeletion, key and value are the begin and end of the
+  // deleted range.
   void Add(SequenceNumber seq, ValueType type, const Slice& key,
            const Slice& value);
 
@@ -60,7 +67,14 @@ class MemTable {
   // If memtable contains a deletion for key, store a NotFound() error
   // in *status and return true.
   // Else, return false.
-  bool Get(const LookupKey& key, std::string* value, Status* s);
+  // Merge operands for key found above the value or deletion are appended
+  // to *merge_operands, newest first.
+  // *max_covering_tombstone_seq is raised to the sequence number of the
+  // newest range deletion in the memtable that covers key, and entries
+  // older than it are treated as deleted.
+  bool Get(const LookupKey& key, std::string* value, Status* s,
+           std::vector<std::string>* merge_operands,
+           SequenceNumber* max_covering_tombstone_seq);
 
  private:
   friend class MemTableIterator;
@@ -80,6 +94,7 @@ class MemTable {
   int refs_;
   Arena arena_;
   Table table_;
+  Table range_del_table_;
 };
 
 }  // namespace leveldb
@@ -0,0 +1,44 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/merge_helper.h"
+
+#include "leveldb/merge_operator.h"
+
+namespace leveldb {
+
+Status ApplyMergeOperands(const MergeOperator* merge_operator,
+                          const Slice& user_key, const Slice* existing_value,
+                          const std::vector<std::string>& operands,
+                          std::string* result) {
+  if (merge_operator == nullptr) {
+    return Status::NotSupported("merge operand found without a merge operator",
+                                user_key);
+  }
+  std::vector<Slice> oldest_first(operands.rbegin(), operands.rend());
+  result->clear();
+  if (!merge_operator->FullMerge(user_key, existing_value, oldest_first,
+                                 result)) {
+    return Status::Corruption("merge failed for ", user_key);
+  }
+  return Status::OK();
+}
+
+Status FinishMergeLookup(const MergeOperator* merge_operator,
+                         const Slice& user_key,
+                         const std::vector<std::string>& operands,
+                         const Status& s, std::string* value) {
+  if (s.ok()) {
+    const std::string existing_value = *value;
+    const Slice existing(existing_value);
+    return ApplyMergeOperands(merge_operator, user_key, &existing, operands,
+                              value);
+  } else if (s.IsNotFound()) {
+    return ApplyMergeOperands(merge_operator, user_key, nullptr, operands,
+                              value);
+  }
+  return s;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,37 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_MERGE_HELPER_H_
+#define STORAGE_LEVELDB_DB_MERGE_HELPER_H_
+
+#include <string>
+#include <vector>
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class MergeOperator;
+
+// Apply "operands", the merge operands of "user_key" newest first, to
+// "*existing_value", or to nothing if "existing_value" is null, and store
+// the result in "*result".  "*result" may not alias "*existing_value".
+Status ApplyMergeOperands(const MergeOperator* merge_operator,
+                          const Slice& user_key, const Slice* existing_value,
+                          const std::vector<std::string>& operands,
+                          std::string* result);
+
+// Complete a lookup of "user_key" that found "operands", newest first,
+// above the entries that produced "s" and "*value": OK and the value
+// below them, NotFound if there is none, or an error that is returned
+// unchanged.  On success, stores the merged value in "*value".
+Status FinishMergeLookup(const MergeOperator* merge_operator,
+                         const Slice& user_key,
+                         const std::vector<std::string>& operands,
+                         const Status& s, std::string* value);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MERGE_HELPER_H_
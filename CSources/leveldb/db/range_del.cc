@@ -0,0 +1,172 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_del.h"
+
+#include <algorithm>
+#include <set>
+
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+void AddTombstoneToFileRange(const Comparator* icmp,
+                             const Slice& tombstone_key, const Slice& end,
+                             bool* empty, InternalKey* smallest,
+                             InternalKey* largest) {
+  const InternalKey limit(end, kMaxSequenceNumber, kTypeRangeDeletion);
+  if (*empty) {
+    smallest->DecodeFrom(tombstone_key);
+    *largest = limit;
+    *empty = false;
+    return;
+  }
+  if (icmp->Compare(tombstone_key, smallest->Encode()) < 0) {
+    smallest->DecodeFrom(tombstone_key);
+  }
+  if (icmp->Compare(limit.Encode(), largest->Encode()) > 0) {
+    *largest = limit;
+  }
+}
+
+Status UpdateMaxCoveringTombstone(Iterator* iter, const Comparator* ucmp,
+                                  const Slice& user_key,
+                                  SequenceNumber snapshot,
+                                  SequenceNumber* max_sequence) {
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey tombstone;
+    if (!ParseInternalKey(iter->key(), &tombstone)) {
+      return Status::Corruption("corrupted range tombstone");
+    }
+    if (ucmp->Compare(tombstone.user_key, user_key) > 0) {
+      break;  // Tombstones are sorted by their start key
+    }
+    if (tombstone.sequence <= snapshot &&
+        tombstone.sequence > *max_sequence &&
+        ucmp->Compare(user_key, iter->value()) < 0) {
+      *max_sequence = tombstone.sequence;
+    }
+  }
+  return iter->status();
+}
+
+RangeDelAggregator::RangeDelAggregator(const Comparator* ucmp,
+                                       SequenceNumber snapshot)
+    : ucmp_(ucmp), snapshot_(snapshot), fragmented_(true) {}
+
+Status RangeDelAggregator::AddTombstones(Iterator* iter) {
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey tombstone;
+    if (!ParseInternalKey(iter->key(), &tombstone)) {
+      return Status::Corruption("corrupted range tombstone");
+    }
+    if (tombstone.sequence <= snapshot_ &&
+        ucmp_->Compare(tombstone.user_key, iter->value()) < 0) {
+      tombstones_.emplace_back(tombstone.user_key, iter->value(),
+                               tombstone.sequence);
+      fragmented_ = false;
+    }
+  }
+  return iter->status();
+}
+
+void RangeDelAggregator::Fragment() {
+  std::sort(tombstones_.begin(), tombstones_.end(),
+            [this](const RangeTombstone& a, const RangeTombstone& b) {
+              const int r = ucmp_->Compare(a.start, b.start);
+              return r < 0 || (r == 0 && a.sequence > b.sequence);
+            });
+
+  // Sweep over the start and end keys of all tombstones, tracking the
+  // sequence numbers of the tombstones that cover the current position.
+  struct Boundary {
+    const std::string* key;
+    SequenceNumber sequence;
+    bool is_start;
+  };
+  std::vector<Boundary> boundaries;
+  boundaries.reserve(2 * tombstones_.size());
+  for (const RangeTombstone& t : tombstones_) {
+    boundaries.push_back(Boundary{&t.start, t.sequence, true});
+    boundaries.push_back(Boundary{&t.end, t.sequence, false});
+  }
+  std::sort(boundaries.begin(), boundaries.end(),
+            [this](const Boundary& a, const Boundary& b) {
+              return ucmp_->Compare(*a.key, *b.key) < 0;
+            });
+
+  fragments_.clear();
+  std::multiset<SequenceNumber> active;
+  size_t i = 0;
+  while (i < boundaries.size()) {
+    const std::string& key = *boundaries[i].key;
+    for (; i < boundaries.size(); i++) {
+      if (ucmp_->Compare(*boundaries[i].key, key) != 0) {
+        break;
+      }
+      if (boundaries[i].is_start) {
+        active.insert(boundaries[i].sequence);
+      } else {
+        active.erase(active.find(boundaries[i].sequence));
+      }
+    }
+    const SequenceNumber max_sequence = active.empty() ? 0 : *active.rbegin();
+    if (fragments_.empty() || fragments_.back().second != max_sequence) {
+      fragments_.emplace_back(key, max_sequence);
+    }
+  }
+  fragmented_ = true;
+}
+
+size_t RangeDelAggregator::FindFragment(const Slice& user_key) {
+  if (!fragmented_) {
+    Fragment();
+  }
+  // Find the first piece that starts after user_key.
+  size_t left = 0;
+  size_t right = fragments_.size();
+  while (left < right) {
+    const size_t mid = (left + right) / 2;
+    if (ucmp_->Compare(user_key, fragments_[mid].first) < 0) {
+      right = mid;
+    } else {
+      left = mid + 1;
+    }
+  }
+  return left == 0 ? fragments_.size() : left - 1;
+}
+
+SequenceNumber RangeDelAggregator::MaxCoveringSequence(const Slice& user_key) {
+  const size_t i = FindFragment(user_key);
+  return i == fragments_.size() ? 0 : fragments_[i].second;
+}
+
+bool RangeDelAggregator::CoversRange(const Slice& begin, const Slice& end) {
+  size_t i = FindFragment(begin);
+  if (i == fragments_.size()) {
+    return false;
+  }
+  // All pieces overlapping [begin, end] must be covered.  The last piece
+  // never is.
+  for (; i < fragments_.size(); i++) {
+    if (fragments_[i].second == 0) {
+      return false;
+    }
+    if (i + 1 < fragments_.size() &&
+        ucmp_->Compare(fragments_[i + 1].first, end) > 0) {
+      break;
+    }
+  }
+  return true;
+}
+
+const std::vector<RangeTombstone>& RangeDelAggregator::tombstones() {
+  if (!fragmented_) {
+    Fragment();
+  }
+  return tombstones_;
+}
+
+}  // namespace leveldb
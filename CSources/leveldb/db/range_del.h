@@ -0,0 +1,112 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A range tombstone deletes every key in [start, end) that was written
+// before it.  Tombstones are kept apart from point entries: memtables hold
+// them in a separate skiplist and tables in a meta block.  Both store a
+// tombstone as an entry whose key is the internal key
+// (start, sequence, kTypeRangeDeletion) and whose value is "end".
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_DEL_H_
+#define STORAGE_LEVELDB_DB_RANGE_DEL_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Comparator;
+class Iterator;
+
+struct RangeTombstone {
+  RangeTombstone() : sequence(0) {}
+  RangeTombstone(const Slice& s, const Slice& e, SequenceNumber seq)
+      : start(s.ToString()), end(e.ToString()), sequence(seq) {}
+
+  std::string start;  // Inclusive
+  std::string end;    // Exclusive
+  SequenceNumber sequence;
+};
+
+// Widen the key range [*smallest, *largest] of a table, whose internal
+// keys are ordered by "icmp", to include the range tombstone stored under
+// internal key "tombstone_key" that ends at "end".  If "*empty", the range
+// is set to the tombstone's instead and "*empty" is cleared.
+//
+// A tombstone does not cover its end key, so the range ends at the
+// sentinel (end, kMaxSequenceNumber, kTypeRangeDeletion), which sorts
+// before every entry for "end".
+void AddTombstoneToFileRange(const Comparator* icmp,
+                             const Slice& tombstone_key, const Slice& end,
+                             bool* empty, InternalKey* smallest,
+                             InternalKey* largest);
+
+// Raise "*max_sequence" to the sequence number of the newest tombstone
+// yielded by "iter" that covers "user_key" and is visible at "snapshot".
+// Returns iter->status().
+Status UpdateMaxCoveringTombstone(Iterator* iter, const Comparator* ucmp,
+                                  const Slice& user_key,
+                                  SequenceNumber snapshot,
+                                  SequenceNumber* max_sequence);
+
+// Collects the range tombstones visible at a snapshot and answers whether
+// they delete given entries.  Lookups take logarithmic time in the number
+// of tombstones.
+//
+// Not thread-safe: lookups reorganize the collected tombstones.
+class RangeDelAggregator {
+ public:
+  RangeDelAggregator(const Comparator* ucmp, SequenceNumber snapshot);
+
+  RangeDelAggregator(const RangeDelAggregator&) = delete;
+  RangeDelAggregator& operator=(const RangeDelAggregator&) = delete;
+
+  // Add the tombstones yielded by "iter" that are visible at the snapshot.
+  // Does not take ownership of "iter".  Returns iter->status().
+  Status AddTombstones(Iterator* iter);
+
+  bool empty() const { return tombstones_.empty(); }
+
+  // Return the sequence number of the newest tombstone that covers
+  // "user_key", or zero if there is none.
+  SequenceNumber MaxCoveringSequence(const Slice& user_key);
+
+  // Return true iff the entry "key" is deleted by a tombstone.
+  bool ShouldDelete(const ParsedInternalKey& key) {
+    return !empty() && key.sequence < MaxCoveringSequence(key.user_key);
+  }
+
+  // Return true iff every key in [begin, end] is covered by a tombstone.
+  bool CoversRange(const Slice& begin, const Slice& end);
+
+  // Return the collected tombstones, sorted by start key and then by
+  // decreasing sequence number.
+  const std::vector<RangeTombstone>& tombstones();
+
+ private:
+  void Fragment();
+
+  // Return the index of the piece containing "user_key", or
+  // fragments_.size() if "user_key" precedes all pieces.
+  size_t FindFragment(const Slice& user_key);
+
+  const Comparator* const ucmp_;
+  const SequenceNumber snapshot_;
+  std::vector<RangeTombstone> tombstones_;
+  bool fragmented_;
+
+  // Disjoint pieces of the key space sorted by their start key.  Piece i
+  // spans [fragments_[i].first, fragments_[i + 1].first) and holds the
+  // sequence number of the newest tombstone covering it, or zero.
+  std::vector<std::pair<std::string, SequenceNumber>> fragments_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_DEL_H_
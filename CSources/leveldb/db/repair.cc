@@ -14,6 +14,8 @@
 //        all tables (see 2c)
 //      - compaction pointers are cleared
 //      - every table file is added at level 0
+//      - every blob file some table refers to is added, and the blobs
+//        no table refers to are counted as garbage
 //
 // Possible optimization 1:
 //   (a) Compute total size and use to pick appropriate max-level M
@@ -24,6 +26,10 @@
 //   Store per-table metadata (smallest, largest, largest-seq#, ...)
 //   in the table's meta section to speed up ScanTable.
 
+#include <algorithm>
+#include <map>
+
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
@@ -31,6 +37,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
@@ -119,6 +126,8 @@ class Repairer {
             logs_.push_back(number);
           } else if (type == kTableFile) {
             table_numbers_.push_back(number);
+          } else if (type == kBlobFile) {
+            blob_numbers_.push_back(number);
           } else {
             // Ignore other files
           }
@@ -171,7 +180,7 @@ class Repairer {
     // propagating bad information (like overly large sequence
     // numbers).
     log::Reader reader(lfile, &reporter, false /*do not checksum*/,
-                       0 /*initial_offset*/);
+                       0 /*initial_offset*/, log);
 
     // Read all the records and add to a memtable
     std::string scratch;
@@ -203,8 +212,11 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
+    status = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                        range_del_iter, nullptr, &meta);
     delete iter;
+    delete range_del_iter;
     mem->Unref();
     mem = nullptr;
     if (status.ok()) {
@@ -276,11 +288,45 @@ class Repairer {
       if (parsed.sequence > t.max_sequence) {
         t.max_sequence = parsed.sequence;
       }
+      BlobIndex index;
+      if (parsed.type == kTypeBlobIndex && index.DecodeFrom(iter->value())) {
+        if (t.meta.oldest_blob_file == 0 ||
+            index.file_number < t.meta.oldest_blob_file) {
+          t.meta.oldest_blob_file = index.file_number;
+        }
+        BlobFileMetaData* refs = &blob_refs_[index.file_number];
+        refs->num_blobs++;
+        refs->blob_bytes += index.size;
+      }
     }
     if (!iter->status().ok()) {
       status = iter->status();
     }
     delete iter;
+
+    // Range deletions widen the key range of the table.
+    iter = table_cache_->NewRangeTombstoneIterator(t.meta.number,
+                                                   t.meta.file_size);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      if (!ParseInternalKey(iter->key(), &parsed)) {
+        Log(options_.info_log, "Table #%llu: unparsable range deletion %s",
+            (unsigned long long)t.meta.number,
+            EscapeString(iter->key()).c_str());
+        continue;
+      }
+
+      counter++;
+      AddTombstoneToFileRange(&icmp_, iter->key(), iter->value(), &empty,
+                              &t.meta.smallest, &t.meta.largest);
+      t.meta.has_range_deletions = true;
+      if (parsed.sequence > t.max_sequence) {
+        t.max_sequence = parsed.sequence;
+      }
+    }
+    if (status.ok() && !iter->status().ok()) {
+      status = iter->status();
+    }
+    delete iter;
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long)t.meta.number, counter, status.ToString().c_str());
 
@@ -312,6 +358,13 @@ class Repairer {
       counter++;
     }
     delete iter;
+    iter = table_cache_->NewRangeTombstoneIterator(t.meta.number,
+                                                   t.meta.file_size);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      builder->AddRangeTombstone(iter->key(), iter->value());
+      counter++;
+    }
+    delete iter;
 
     ArchiveFile(src);
     if (counter == 0) {
@@ -361,6 +414,9 @@ class Repairer {
     }
 
     edit_.SetComparatorName(icmp_.user_comparator()->Name());
+    if (options_.ttl_seconds > 0) {
+      edit_.SetTimestampedValues();
+    }
     edit_.SetLogNumber(0);
     edit_.SetNextFile(next_file_number_);
     edit_.SetLastSequence(max_sequence);
@@ -368,8 +424,26 @@ class Repairer {
     for (size_t i = 0; i < tables_.size(); i++) {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
-      edit_.AddFile(0, t.meta.number, t.meta.file_size, t.meta.smallest,
-                    t.meta.largest);
+      edit_.AddFile(0, t.meta);
+    }
+
+    for (uint64_t number : blob_numbers_) {
+      uint64_t num_blobs, blob_bytes;
+      Status s = ScanBlobFile(env_, BlobFileName(dbname_, number), &num_blobs,
+                              &blob_bytes);
+      Log(options_.info_log, "Blob file #%llu: %llu blobs %s",
+          (unsigned long long)number, (unsigned long long)num_blobs,
+          s.ToString().c_str());
+      auto refs = blob_refs_.find(number);
+      if (num_blobs > 0 && refs != blob_refs_.end()) {
+        // Blobs past a corruption are left unreachable.
+        edit_.AddBlobFile(number, num_blobs, blob_bytes);
+        const BlobFileMetaData& r = refs->second;
+        if (r.num_blobs < num_blobs) {
+          edit_.AddBlobGarbage(number, num_blobs - r.num_blobs,
+                               blob_bytes - std::min(r.blob_bytes, blob_bytes));
+        }
+      }
     }
 
     // std::fprintf(stderr,
@@ -437,6 +511,9 @@ class Repairer {
 
   std::vector<std::string> manifests_;
   std::vector<uint64_t> table_numbers_;
+  std::vector<uint64_t> blob_numbers_;
+  // Blobs of each blob file the tables refer to
+  std::map<uint64_t, BlobFileMetaData> blob_refs_;
   std::vector<uint64_t> logs_;
   std::vector<TableInfo> tables_;
   uint64_t next_file_number_;
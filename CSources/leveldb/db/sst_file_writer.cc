@@ -0,0 +1,137 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/sst_file_writer.h"
+
+#include "db/dbformat.h"
+#include "leveldb/env.h"
+#include "leveldb/table_builder.h"
+
+namespace leveldb {
+
+// The entries of the file are stored under internal keys with sequence
+// number zero.  DB::IngestExternalFiles() assigns the file a sequence
+// number that the database substitutes when reading it.
+struct SstFileWriter::Rep {
+  explicit Rep(const Options& opt)
+      : internal_comparator(opt.comparator),
+        internal_filter_policy(opt.filter_policy),
+        options(opt),
+        file(nullptr),
+        builder(nullptr),
+        num_entries(0),
+        file_size(0) {
+    options.comparator = &internal_comparator;
+    options.filter_policy =
+        (opt.filter_policy != nullptr) ? &internal_filter_policy : nullptr;
+  }
+
+  const InternalKeyComparator internal_comparator;
+  const InternalFilterPolicy internal_filter_policy;
+  Options options;
+  WritableFile* file;
+  TableBuilder* builder;
+  std::string last_key;  // User key of the last entry
+  uint64_t num_entries;  // Of the finished file
+  uint64_t file_size;    // Of the finished file
+};
+
+SstFileWriter::SstFileWriter(const Options& options)
+    : rep_(new Rep(options)) {}
+
+SstFileWriter::~SstFileWriter() {
+  if (rep_->builder != nullptr) {
+    rep_->builder->Abandon();
+    delete rep_->builder;
+  }
+  delete rep_->file;
+  delete rep_;
+}
+
+Status SstFileWriter::Open(const std::string& fname) {
+  Rep* r = rep_;
+  if (r->file != nullptr || r->builder != nullptr) {
+    return Status::InvalidArgument("file already open");
+  }
+  Status s = r->options.env->NewWritableFile(fname, &r->file);
+  if (s.ok()) {
+    r->builder = new TableBuilder(r->options, r->file);
+    r->builder->SetComparatorName(
+        r->internal_comparator.user_comparator()->Name());
+    r->last_key.clear();
+    r->num_entries = 0;
+    r->file_size = 0;
+  }
+  return s;
+}
+
+static Status AddEntry(TableBuilder* builder, const Comparator* ucmp,
+                       std::string* last_key, const Slice& key,
+                       ValueType type, const Slice& value) {
+  if (builder == nullptr) {
+    return Status::InvalidArgument("file not open");
+  }
+  if (builder->NumEntries() > 0 && ucmp->Compare(key, *last_key) <= 0) {
+    return Status::InvalidArgument("keys not added in increasing order");
+  }
+  std::string internal_key;
+  AppendInternalKey(&internal_key, ParsedInternalKey(key, 0, type));
+  builder->Add(internal_key, value);
+  last_key->assign(key.data(), key.size());
+  return builder->status();
+}
+
+Status SstFileWriter::Put(const Slice& key, const Slice& value) {
+  return AddEntry(rep_->builder, rep_->internal_comparator.user_comparator(),
+                  &rep_->last_key, key, kTypeValue, value);
+}
+
+Status SstFileWriter::Merge(const Slice& key, const Slice& value) {
+  return AddEntry(rep_->builder, rep_->internal_comparator.user_comparator(),
+                  &rep_->last_key, key, kTypeMerge, value);
+}
+
+Status SstFileWriter::Delete(const Slice& key) {
+  return AddEntry(rep_->builder, rep_->internal_comparator.user_comparator(),
+                  &rep_->last_key, key, kTypeDeletion, Slice());
+}
+
+Status SstFileWriter::Finish() {
+  Rep* r = rep_;
+  if (r->builder == nullptr) {
+    return Status::InvalidArgument("file not open");
+  }
+  Status s;
+  if (r->builder->NumEntries() == 0) {
+    r->builder->Abandon();
+    s = Status::InvalidArgument("cannot create an empty file");
+  } else {
+    s = r->builder->Finish();
+  }
+  if (s.ok()) {
+    r->num_entries = r->builder->NumEntries();
+    r->file_size = r->builder->FileSize();
+    s = r->file->Sync();
+  }
+  if (s.ok()) {
+    s = r->file->Close();
+  }
+  delete r->builder;
+  r->builder = nullptr;
+  delete r->file;
+  r->file = nullptr;
+  return s;
+}
+
+uint64_t SstFileWriter::NumEntries() const {
+  return rep_->builder != nullptr ? rep_->builder->NumEntries()
+                                  : rep_->num_entries;
+}
+
+uint64_t SstFileWriter::FileSize() const {
+  return rep_->builder != nullptr ? rep_->builder->FileSize()
+                                  : rep_->file_size;
+}
+
+}  // namespace leveldb
@@ -29,6 +29,19 @@ static void UnrefEntry(void* arg1, void* arg2) {
   cache->Release(h);
 }
 
+static void DeleteTableAndFile(void* arg1, void* arg2) {
+  delete reinterpret_cast<Table*>(arg1);
+  delete reinterpret_cast<RandomAccessFile*>(arg2);
+}
+
+static Status NewTableFile(Env* env, bool direct_io, const std::string& fname,
+                           RandomAccessFile** file) {
+  if (direct_io) {
+    return env->NewDirectRandomAccessFile(fname, file);
+  }
+  return env->NewRandomAccessFile(fname, file);
+}
+
 TableCache::TableCache(const std::string& dbname, const Options& options,
                        int entries)
     : env_(options.env),
@@ -46,23 +59,11 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
   Slice key(buf, sizeof(buf));
   *handle = cache_->Lookup(key);
   if (*handle == nullptr) {
-    std::string fname = TableFileName(dbname_, file_number);
     RandomAccessFile* file = nullptr;
     Table* table = nullptr;
-    s = env_->NewRandomAccessFile(fname, &file);
-    if (!s.ok()) {
-      std::string old_fname = SSTTableFileName(dbname_, file_number);
-      if (env_->NewRandomAccessFile(old_fname, &file).ok()) {
-        s = Status::OK();
-      }
-    }
-    if (s.ok()) {
-      s = Table::Open(options_, file, file_size, &table);
-    }
-
+    s = OpenTable(file_number, file_size, options_.use_direct_reads, &file,
+                  &table);
     if (!s.ok()) {
-      assert(table == nullptr);
-      delete file;
       // We do not cache error results so that if the error is transient,
       // or somebody repairs the file, we recover automatically.
     } else {
@@ -75,6 +76,31 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
   return s;
 }
 
+Status TableCache::OpenTable(uint64_t file_number, uint64_t file_size,
+                             bool direct_io, RandomAccessFile** file,
+                             Table** table) {
+  *file = nullptr;
+  *table = nullptr;
+  std::string fname = TableFileName(dbname_, file_number);
+  Status s = NewTableFile(env_, direct_io, fname, file);
+  if (!s.ok()) {
+    std::string old_fname = SSTTableFileName(dbname_, file_number);
+    if (NewTableFile(env_, direct_io, old_fname, file).ok()) {
+      s = Status::OK();
+    }
+  }
+  if (s.ok()) {
+    s = Table::Open(options_, *file, file_size, table);
+  }
+
+  if (!s.ok()) {
+    assert(*table == nullptr);
+    delete *file;
+    *file = nullptr;
+  }
+  return s;
+}
+
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number, uint64_t file_size,
                                   Table** tableptr) {
@@ -97,6 +123,41 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   return result;
 }
 
+Iterator* TableCache::NewCompactionIterator(const ReadOptions& options,
+                                            uint64_t file_number,
+                                            uint64_t file_size) {
+  if (!options_.use_direct_io_for_flush_and_compaction ||
+      options_.use_direct_reads) {
+    return NewIterator(options, file_number, file_size);
+  }
+
+  RandomAccessFile* file = nullptr;
+  Table* table = nullptr;
+  Status s = OpenTable(file_number, file_size, /*direct_io=*/true, &file,
+                       &table);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+
+  Iterator* result = table->NewIterator(options);
+  result->RegisterCleanup(&DeleteTableAndFile, table, file);
+  return result;
+}
+
+Iterator* TableCache::NewRangeTombstoneIterator(uint64_t file_number,
+                                                uint64_t file_size) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+
+  Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  Iterator* result = table->NewRangeTombstoneIterator();
+  result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  return result;
+}
+
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
                        uint64_t file_size, const Slice& k, void* arg,
                        void (*handle_result)(void*, const Slice&,
@@ -111,6 +172,40 @@ Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
   return s;
 }
 
+void TableCache::Prefetch(const ReadOptions& options, uint64_t file_number,
+                          uint64_t file_size, const Slice* keys, size_t n) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    t->PrefetchBlocks(options, keys, n);
+    cache_->Release(handle);
+  }
+}
+
+Status TableCache::Preload(uint64_t file_number, uint64_t file_size) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+bool TableCache::KeyMayMatch(uint64_t file_number, uint64_t file_size,
+                             const Slice& k) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (!s.ok()) {
+    // The lookup itself reports the error.
+    return true;
+  }
+  Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  const bool result = t->KeyMayMatch(k);
+  cache_->Release(handle);
+  return result;
+}
+
 void TableCache::Evict(uint64_t file_number) {
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
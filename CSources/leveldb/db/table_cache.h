@@ -34,17 +34,44 @@ class TableCache {
   Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
                         uint64_t file_size, Table** tableptr = nullptr);
 
+  // Return an iterator over the specified file for use as compaction input.
+  // If options.use_direct_io_for_flush_and_compaction is set (and
+  // use_direct_reads is not), the file is read through a private direct I/O
+  // handle instead of the cached Table, so that compactions do not pull
+  // their input through the operating system's page cache.
+  Iterator* NewCompactionIterator(const ReadOptions& options,
+                                  uint64_t file_number, uint64_t file_size);
+
+  // Return an iterator over the range deletions of the specified file.
+  Iterator* NewRangeTombstoneIterator(uint64_t file_number,
+                                      uint64_t file_size);
+
   // If a seek to internal key "k" in specified file finds an entry,
   // call (*handle_result)(arg, found_key, found_value).
   Status Get(const ReadOptions& options, uint64_t file_number,
              uint64_t file_size, const Slice& k, void* arg,
              void (*handle_result)(void*, const Slice&, const Slice&));
 
+  // Load the blocks of the specified file that may contain any of the
+  // internal keys "keys[0..n-1]" into the block cache.
+  void Prefetch(const ReadOptions& options, uint64_t file_number,
+                uint64_t file_size, const Slice* keys, size_t n);
+
+  // Open the specified file into the cache, so that the first read from it
+  // does not have to.
+  Status Preload(uint64_t file_number, uint64_t file_size);
+
+  // Returns false if the filter policy of the specified file rules out that
+  // it contains the internal key "k", true otherwise.
+  bool KeyMayMatch(uint64_t file_number, uint64_t file_size, const Slice& k);
+
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
  private:
   Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  Status OpenTable(uint64_t file_number, uint64_t file_size, bool direct_io,
+                   RandomAccessFile** file, Table** table);
 
   Env* const env_;
   const std::string dbname_;
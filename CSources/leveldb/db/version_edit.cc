@@ -20,7 +20,17 @@ enum Tag {
   kDeletedFile = 6,
   kNewFile = 7,
   // 8 was used for large value refs
-  kPrevLogNumber = 9
+  kPrevLogNumber = 9,
+  kNewFileWithRangeDeletions = 10,
+  kNewFileWithGlobalSequence = 11,
+  kNewFileWithTimestamp = 12,
+  kNewFileWithBlobs = 13,
+  kNewBlobFile = 14,
+  kBlobGarbage = 15,
+  kFileEntryCounts = 16,
+  // Only written for databases in TTL mode, so that older versions refuse
+  // to open them and other MANIFESTs stay readable by those versions.
+  kTimestampedValues = 17
 };
 
 void VersionEdit::Clear() {
@@ -34,8 +44,11 @@ void VersionEdit::Clear() {
   has_prev_log_number_ = false;
   has_next_file_number_ = false;
   has_last_sequence_ = false;
+  timestamped_values_ = false;
   deleted_files_.clear();
   new_files_.clear();
+  new_blob_files_.clear();
+  blob_garbage_.clear();
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -43,6 +56,9 @@ void VersionEdit::EncodeTo(std::string* dst) const {
     PutVarint32(dst, kComparator);
     PutLengthPrefixedSlice(dst, comparator_);
   }
+  if (timestamped_values_) {
+    PutVarint32(dst, kTimestampedValues);
+  }
   if (has_log_number_) {
     PutVarint32(dst, kLogNumber);
     PutVarint64(dst, log_number_);
@@ -74,12 +90,58 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    // Files without range deletions keep the old tag, so that databases
+    // that never use them stay readable by older versions.  Ingested
+    // files and files with a timestamp have nothing but point entries, and
+    // neither refers to blob files.
+    assert(f.global_sequence == 0 || !f.has_range_deletions);
+    assert(f.newest_timestamp == 0 || !f.has_range_deletions);
+    assert(f.newest_timestamp == 0 || f.global_sequence == 0);
+    assert(f.oldest_blob_file == 0 ||
+           (f.global_sequence == 0 && f.newest_timestamp == 0));
+    if (f.global_sequence != 0) {
+      PutVarint32(dst, kNewFileWithGlobalSequence);
+    } else if (f.newest_timestamp != 0) {
+      PutVarint32(dst, kNewFileWithTimestamp);
+    } else if (f.oldest_blob_file != 0) {
+      PutVarint32(dst, kNewFileWithBlobs);
+    } else {
+      PutVarint32(dst, f.has_range_deletions ? kNewFileWithRangeDeletions
+                                             : kNewFile);
+    }
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (f.global_sequence != 0) {
+      PutVarint64(dst, f.global_sequence);
+    } else if (f.newest_timestamp != 0) {
+      PutVarint32(dst, f.newest_timestamp);
+    } else if (f.oldest_blob_file != 0) {
+      PutVarint64(dst, f.oldest_blob_file);
+      PutVarint32(dst, f.has_range_deletions ? 1 : 0);
+    }
+    if (f.num_entries != 0) {
+      // Applies to the file just added.
+      PutVarint32(dst, kFileEntryCounts);
+      PutVarint64(dst, f.num_entries);
+      PutVarint64(dst, f.num_deletions);
+    }
+  }
+
+  for (const BlobFileMetaData& b : new_blob_files_) {
+    PutVarint32(dst, kNewBlobFile);
+    PutVarint64(dst, b.number);
+    PutVarint64(dst, b.num_blobs);
+    PutVarint64(dst, b.blob_bytes);
+  }
+
+  for (const BlobFileMetaData& b : blob_garbage_) {
+    PutVarint32(dst, kBlobGarbage);
+    PutVarint64(dst, b.number);
+    PutVarint64(dst, b.garbage_blobs);
+    PutVarint64(dst, b.garbage_bytes);
   }
 }
 
@@ -126,6 +188,10 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kTimestampedValues:
+        timestamped_values_ = true;
+        break;
+
       case kLogNumber:
         if (GetVarint64(&input, &log_number_)) {
           has_log_number_ = true;
@@ -175,16 +241,111 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         break;
 
       case kNewFile:
+      case kNewFileWithRangeDeletions:
         if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
             GetVarint64(&input, &f.file_size) &&
             GetInternalKey(&input, &f.smallest) &&
             GetInternalKey(&input, &f.largest)) {
+          f.has_range_deletions = (tag == kNewFileWithRangeDeletions);
+          f.global_sequence = 0;
+          f.newest_timestamp = 0;
+          f.oldest_blob_file = 0;
           new_files_.push_back(std::make_pair(level, f));
         } else {
           msg = "new-file entry";
         }
         break;
 
+      case kNewFileWithGlobalSequence:
+        if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
+            GetVarint64(&input, &f.file_size) &&
+            GetInternalKey(&input, &f.smallest) &&
+            GetInternalKey(&input, &f.largest) &&
+            GetVarint64(&input, &f.global_sequence) &&
+            f.global_sequence != 0) {
+          f.has_range_deletions = false;
+          f.newest_timestamp = 0;
+          f.oldest_blob_file = 0;
+          new_files_.push_back(std::make_pair(level, f));
+        } else {
+          msg = "new-file entry";
+        }
+        break;
+
+      case kNewFileWithTimestamp:
+        if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
+            GetVarint64(&input, &f.file_size) &&
+            GetInternalKey(&input, &f.smallest) &&
+            GetInternalKey(&input, &f.largest) &&
+            GetVarint32(&input, &f.newest_timestamp) &&
+            f.newest_timestamp != 0) {
+          f.has_range_deletions = false;
+          f.global_sequence = 0;
+          f.oldest_blob_file = 0;
+          new_files_.push_back(std::make_pair(level, f));
+        } else {
+          msg = "new-file entry";
+        }
+        break;
+
+      case kNewFileWithBlobs: {
+        uint32_t has_range_deletions;
+        if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
+            GetVarint64(&input, &f.file_size) &&
+            GetInternalKey(&input, &f.smallest) &&
+            GetInternalKey(&input, &f.largest) &&
+            GetVarint64(&input, &f.oldest_blob_file) &&
+            f.oldest_blob_file != 0 &&
+            GetVarint32(&input, &has_range_deletions) &&
+            has_range_deletions <= 1) {
+          f.has_range_deletions = (has_range_deletions != 0);
+          f.global_sequence = 0;
+          f.newest_timestamp = 0;
+          new_files_.push_back(std::make_pair(level, f));
+        } else {
+          msg = "new-file entry";
+        }
+        break;
+      }
+
+      case kFileEntryCounts: {
+        uint64_t num_entries, num_deletions;
+        if (!new_files_.empty() && GetVarint64(&input, &num_entries) &&
+            GetVarint64(&input, &num_deletions) &&
+            num_deletions <= num_entries) {
+          // The counts belong to the file added just before.
+          new_files_.back().second.num_entries = num_entries;
+          new_files_.back().second.num_deletions = num_deletions;
+        } else {
+          msg = "entry-counts entry";
+        }
+        break;
+      }
+
+      case kNewBlobFile: {
+        BlobFileMetaData b;
+        if (GetVarint64(&input, &b.number) &&
+            GetVarint64(&input, &b.num_blobs) &&
+            GetVarint64(&input, &b.blob_bytes)) {
+          new_blob_files_.push_back(b);
+        } else {
+          msg = "new-blob-file entry";
+        }
+        break;
+      }
+
+      case kBlobGarbage: {
+        BlobFileMetaData b;
+        if (GetVarint64(&input, &b.number) &&
+            GetVarint64(&input, &b.garbage_blobs) &&
+            GetVarint64(&input, &b.garbage_bytes)) {
+          blob_garbage_.push_back(b);
+        } else {
+          msg = "blob-garbage entry";
+        }
+        break;
+      }
+
       default:
         msg = "unknown tag";
         break;
@@ -209,6 +370,9 @@ std::string VersionEdit::DebugString() const {
     r.append("\n  Comparator: ");
     r.append(comparator_);
   }
+  if (timestamped_values_) {
+    r.append("\n  TimestampedValues");
+  }
   if (has_log_number_) {
     r.append("\n  LogNumber: ");
     AppendNumberTo(&r, log_number_);
@@ -249,6 +413,47 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.has_range_deletions) {
+      r.append(" (range deletions)");
+    }
+    if (f.global_sequence != 0) {
+      r.append(" (ingested @ ");
+      AppendNumberTo(&r, f.global_sequence);
+      r.append(")");
+    }
+    if (f.newest_timestamp != 0) {
+      r.append(" (written until ");
+      AppendNumberTo(&r, f.newest_timestamp);
+      r.append(")");
+    }
+    if (f.oldest_blob_file != 0) {
+      r.append(" (blobs from ");
+      AppendNumberTo(&r, f.oldest_blob_file);
+      r.append(")");
+    }
+    if (f.num_entries != 0) {
+      r.append(" (");
+      AppendNumberTo(&r, f.num_deletions);
+      r.append(" of ");
+      AppendNumberTo(&r, f.num_entries);
+      r.append(" entries deleted)");
+    }
+  }
+  for (const BlobFileMetaData& b : new_blob_files_) {
+    r.append("\n  AddBlobFile: ");
+    AppendNumberTo(&r, b.number);
+    r.append(" ");
+    AppendNumberTo(&r, b.num_blobs);
+    r.append(" ");
+    AppendNumberTo(&r, b.blob_bytes);
+  }
+  for (const BlobFileMetaData& b : blob_garbage_) {
+    r.append("\n  BlobGarbage: ");
+    AppendNumberTo(&r, b.number);
+    r.append(" ");
+    AppendNumberTo(&r, b.garbage_blobs);
+    r.append(" ");
+    AppendNumberTo(&r, b.garbage_bytes);
   }
   r.append("\n}\n");
   return r;
@@ -16,7 +16,16 @@ namespace leveldb {
 class VersionSet;
 
 struct FileMetaData {
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+  FileMetaData()
+      : refs(0),
+        allowed_seeks(1 << 30),
+        file_size(0),
+        has_range_deletions(false),
+        global_sequence(0),
+        newest_timestamp(0),
+        oldest_blob_file(0),
+        num_entries(0),
+        num_deletions(0) {}
 
   int refs;
   int allowed_seeks;  // Seeks allowed until compaction
@@ -24,6 +33,44 @@ struct FileMetaData {
   uint64_t file_size;    // File size in bytes
   InternalKey smallest;  // Smallest internal key served by table
   InternalKey largest;   // Largest internal key served by table
+  bool has_range_deletions;  // Table has range deletions (db/range_del.h)
+
+  // Non-zero for a table added by DB::IngestExternalFiles().  The keys of
+  // such a table carry sequence number zero and are read as if they
+  // carried this one instead.
+  SequenceNumber global_sequence;
+
+  // If Options::ttl_seconds is set and the table holds nothing but values,
+  // the newest write time of the values (see kValueTimestampSize), and
+  // zero otherwise.  The table can be deleted once this has expired.
+  uint32_t newest_timestamp;
+
+  // Number of the oldest blob file the table refers to, or zero if it has
+  // no blob indexes.
+  uint64_t oldest_blob_file;
+
+  // Number of point entries in the table and how many of them are
+  // deletions, if Options::deletion_compaction_ratio was set when the
+  // table was written.  Both are zero otherwise.
+  uint64_t num_entries;
+  uint64_t num_deletions;
+};
+
+// A blob file (see db/blob_file.h) and how much of it the tables no longer
+// refer to.
+struct BlobFileMetaData {
+  BlobFileMetaData()
+      : number(0),
+        num_blobs(0),
+        blob_bytes(0),
+        garbage_blobs(0),
+        garbage_bytes(0) {}
+
+  uint64_t number;
+  uint64_t num_blobs;      // Blobs in the file
+  uint64_t blob_bytes;     // Combined record size of the blobs
+  uint64_t garbage_blobs;  // Blobs no table refers to any more
+  uint64_t garbage_bytes;  // Combined record size of the garbage blobs
 };
 
 class VersionEdit {
@@ -37,6 +84,9 @@ class VersionEdit {
     has_comparator_ = true;
     comparator_ = name.ToString();
   }
+  // Record that values carry their write time, see Options::ttl_seconds.
+  // Like the comparator name, this belongs to the first edit of a MANIFEST.
+  void SetTimestampedValues() { timestamped_values_ = true; }
   void SetLogNumber(uint64_t num) {
     has_log_number_ = true;
     log_number_ = num;
@@ -61,15 +111,50 @@ class VersionEdit {
   // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
   // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
   void AddFile(int level, uint64_t file, uint64_t file_size,
-               const InternalKey& smallest, const InternalKey& largest) {
+               const InternalKey& smallest, const InternalKey& largest,
+               bool has_range_deletions = false) {
     FileMetaData f;
     f.number = file;
     f.file_size = file_size;
     f.smallest = smallest;
     f.largest = largest;
+    f.has_range_deletions = has_range_deletions;
     new_files_.push_back(std::make_pair(level, f));
   }
 
+  // Add the file described by "f" at the specified level.
+  // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
+  void AddFile(int level, const FileMetaData& f) {
+    AddFile(level, f.number, f.file_size, f.smallest, f.largest,
+            f.has_range_deletions);
+    new_files_.back().second.global_sequence = f.global_sequence;
+    new_files_.back().second.newest_timestamp = f.newest_timestamp;
+    new_files_.back().second.oldest_blob_file = f.oldest_blob_file;
+    new_files_.back().second.num_entries = f.num_entries;
+    new_files_.back().second.num_deletions = f.num_deletions;
+  }
+
+  // Add blob file "number" holding "num_blobs" blobs with a combined
+  // record size of "blob_bytes".
+  void AddBlobFile(uint64_t number, uint64_t num_blobs, uint64_t blob_bytes) {
+    BlobFileMetaData b;
+    b.number = number;
+    b.num_blobs = num_blobs;
+    b.blob_bytes = blob_bytes;
+    new_blob_files_.push_back(b);
+  }
+
+  // Record that the tables no longer refer to "num_blobs" blobs of blob
+  // file "number" with a combined record size of "blob_bytes".
+  void AddBlobGarbage(uint64_t number, uint64_t num_blobs,
+                      uint64_t blob_bytes) {
+    BlobFileMetaData b;
+    b.number = number;
+    b.garbage_blobs = num_blobs;
+    b.garbage_bytes = blob_bytes;
+    blob_garbage_.push_back(b);
+  }
+
   // Delete the specified "file" from the specified "level".
   void RemoveFile(int level, uint64_t file) {
     deleted_files_.insert(std::make_pair(level, file));
@@ -95,10 +180,13 @@ class VersionEdit {
   bool has_prev_log_number_;
   bool has_next_file_number_;
   bool has_last_sequence_;
+  bool timestamped_values_;
 
   std::vector<std::pair<int, InternalKey>> compact_pointers_;
   DeletedFileSet deleted_files_;
   std::vector<std::pair<int, FileMetaData>> new_files_;
+  std::vector<BlobFileMetaData> new_blob_files_;
+  std::vector<BlobFileMetaData> blob_garbage_;
 };
 
 }  // namespace leveldb
@@ -0,0 +1,108 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/version_edit.h"
+
+#include "gtest/gtest.h"
+
+namespace leveldb {
+
+static void TestEncodeDecode(const VersionEdit& edit) {
+  std::string encoded, encoded2;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  Status s = parsed.DecodeFrom(encoded);
+  ASSERT_TRUE(s.ok()) << s.ToString();
+  parsed.EncodeTo(&encoded2);
+  ASSERT_EQ(encoded, encoded2);
+}
+
+TEST(VersionEditTest, EncodeDecode) {
+  static const uint64_t kBig = 1ull << 50;
+
+  VersionEdit edit;
+  for (int i = 0; i < 4; i++) {
+    TestEncodeDecode(edit);
+    edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
+                 InternalKey("foo", kBig + 500 + i, kTypeValue),
+                 InternalKey("zoo", kBig + 600 + i, kTypeDeletion));
+    edit.RemoveFile(4, kBig + 700 + i);
+    edit.SetCompactPointer(i, InternalKey("x", kBig + 900 + i, kTypeValue));
+  }
+
+  edit.SetComparatorName("foo");
+  edit.SetLogNumber(kBig + 100);
+  edit.SetNextFile(kBig + 200);
+  edit.SetLastSequence(kBig + 1000);
+  TestEncodeDecode(edit);
+}
+
+TEST(VersionEditTest, EncodeDecodeTimestampedValues) {
+  VersionEdit edit;
+  edit.SetComparatorName("foo");
+  std::string plain;
+  edit.EncodeTo(&plain);
+  edit.SetTimestampedValues();
+  TestEncodeDecode(edit);
+  std::string timestamped;
+  edit.EncodeTo(&timestamped);
+  ASSERT_NE(plain, timestamped);
+}
+
+TEST(VersionEditTest, EncodeDecodeFileEntryCounts) {
+  static const uint64_t kBig = 1ull << 50;
+
+  // The entry counts follow each kind of new-file entry.
+  VersionEdit edit;
+  for (int i = 0; i < 4; i++) {
+    FileMetaData f;
+    f.number = kBig + 300 + i;
+    f.file_size = kBig + 400 + i;
+    f.smallest = InternalKey("foo", kBig + 500 + i, kTypeValue);
+    f.largest = InternalKey("zoo", kBig + 600 + i, kTypeDeletion);
+    f.num_entries = kBig + 700 + i;
+    f.num_deletions = (i == 3) ? f.num_entries : i;
+    if (i == 0) {
+      f.has_range_deletions = true;
+    } else if (i == 1) {
+      f.global_sequence = kBig + 800;
+    } else if (i == 2) {
+      f.oldest_blob_file = kBig + 900;
+    }
+    edit.AddFile(i, f);
+    TestEncodeDecode(edit);
+  }
+
+  // A table without counts has none recorded.
+  edit.AddFile(5, kBig + 1000, 100, InternalKey("a", 1, kTypeValue),
+               InternalKey("b", 2, kTypeValue));
+  TestEncodeDecode(edit);
+}
+
+TEST(VersionEditTest, DecodeInvalidFileEntryCounts) {
+  // More deletions than entries.
+  FileMetaData f;
+  f.number = 10;
+  f.file_size = 100;
+  f.smallest = InternalKey("a", 1, kTypeValue);
+  f.largest = InternalKey("b", 2, kTypeValue);
+  f.num_entries = 5;
+  f.num_deletions = 6;
+  VersionEdit edit;
+  edit.AddFile(0, f);
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_TRUE(parsed.DecodeFrom(encoded).IsCorruption());
+
+  // Counts that do not follow a new-file entry.
+  std::string file_entry;
+  VersionEdit file_edit;
+  file_edit.AddFile(0, 10, 100, f.smallest, f.largest);
+  file_edit.EncodeTo(&file_entry);
+  const std::string counts = encoded.substr(file_entry.size());
+  ASSERT_TRUE(parsed.DecodeFrom(counts).IsCorruption());
+}
+
+}  // namespace leveldb
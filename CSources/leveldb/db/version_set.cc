@@ -6,11 +6,14 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <limits>
 
+#include "db/blob_file_cache.h"
 #include "db/filename.h"
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
 #include "leveldb/table_builder.h"
@@ -38,6 +41,10 @@ static int64_t ExpandedCompactionByteSizeLimit(const Options* options) {
   return 25 * TargetFileSize(options);
 }
 
+// Maximum number of edits appended to a MANIFEST before it is replaced by
+// a new snapshot, however small they are.
+static const uint64_t kMaxManifestEdits = 10000;
+
 static double MaxBytesForLevel(const Options* options, int level) {
   // Note: the result for level zero is not really used since we set
   // the level-0 compaction threshold based on number of files.
@@ -158,8 +165,8 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
 // An internal iterator.  For a given version/level pair, yields
 // information about the files in the level.  For a given entry, key()
 // is the largest key that occurs in the file, and value() is an
-// 16-byte value containing the file number and file size, both
-// encoded using EncodeFixed64.
+// 24-byte value containing the file number, file size and global
+// sequence number, all encoded using EncodeFixed64.
 class Version::LevelFileNumIterator : public Iterator {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
@@ -194,6 +201,7 @@ class Version::LevelFileNumIterator : public Iterator {
     assert(Valid());
     EncodeFixed64(value_buf_, (*flist_)[index_]->number);
     EncodeFixed64(value_buf_ + 8, (*flist_)[index_]->file_size);
+    EncodeFixed64(value_buf_ + 16, (*flist_)[index_]->global_sequence);
     return Slice(value_buf_, sizeof(value_buf_));
   }
   Status status() const override { return Status::OK(); }
@@ -203,19 +211,101 @@ class Version::LevelFileNumIterator : public Iterator {
   const std::vector<FileMetaData*>* const flist_;
   uint32_t index_;
 
-  // Backing store for value().  Holds the file number and size.
-  mutable char value_buf_[16];
+  // Backing store for value().  Holds the file number, size and global
+  // sequence number.
+  mutable char value_buf_[24];
+};
+
+namespace {
+
+// Yields the entries of a table added by DB::IngestExternalFiles() with
+// their sequence number zero replaced by the global sequence number of the
+// table.  Since the table holds at most one entry per user key, this does
+// not change the order of its entries.
+class GlobalSequenceIterator : public Iterator {
+ public:
+  GlobalSequenceIterator(const InternalKeyComparator* icmp, Iterator* iter,
+                         SequenceNumber sequence)
+      : icmp_(icmp), iter_(iter), sequence_(sequence) {}
+
+  ~GlobalSequenceIterator() override { delete iter_; }
+
+  bool Valid() const override { return iter_->Valid(); }
+  void Seek(const Slice& target) override {
+    // The entry for the user key of "target" sorts before "target" if the
+    // global sequence number is larger than the one of "target".
+    iter_->Seek(target);
+    if (iter_->Valid() && icmp_->Compare(key(), target) < 0) {
+      iter_->Next();
+    }
+  }
+  void SeekToFirst() override { iter_->SeekToFirst(); }
+  void SeekToLast() override { iter_->SeekToLast(); }
+  void Next() override { iter_->Next(); }
+  void Prev() override { iter_->Prev(); }
+  Slice key() const override {
+    assert(Valid());
+    const Slice k = iter_->key();
+    if (k.size() < 8) {
+      return k;  // Corrupt, leave it for the caller to notice
+    }
+    key_.assign(k.data(), k.size() - 8);
+    const uint64_t type = DecodeFixed64(k.data() + k.size() - 8) & 0xff;
+    PutFixed64(&key_, (sequence_ << 8) | type);
+    return key_;
+  }
+  Slice value() const override { return iter_->value(); }
+  Status status() const override { return iter_->status(); }
+
+ private:
+  const InternalKeyComparator* const icmp_;
+  Iterator* const iter_;
+  const SequenceNumber sequence_;
+  mutable std::string key_;  // Backing store for key()
 };
 
+}  // namespace
+
+// Wrap "iter", an iterator over a table with the global sequence number
+// "sequence", so that it yields the actual sequence numbers.
+static Iterator* ApplyGlobalSequence(const InternalKeyComparator* icmp,
+                                     Iterator* iter, SequenceNumber sequence) {
+  if (sequence == 0) {
+    return iter;
+  }
+  return new GlobalSequenceIterator(icmp, iter, sequence);
+}
+
 static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
                                  const Slice& file_value) {
-  TableCache* cache = reinterpret_cast<TableCache*>(arg);
-  if (file_value.size() != 16) {
+  const VersionSet* vset = reinterpret_cast<const VersionSet*>(arg);
+  if (file_value.size() != 24) {
+    return NewErrorIterator(
+        Status::Corruption("FileReader invoked with unexpected value"));
+  } else {
+    return ApplyGlobalSequence(
+        vset->internal_comparator(),
+        vset->table_cache()->NewIterator(options,
+                                         DecodeFixed64(file_value.data()),
+                                         DecodeFixed64(file_value.data() + 8)),
+        DecodeFixed64(file_value.data() + 16));
+  }
+}
+
+static Iterator* GetCompactionFileIterator(void* arg,
+                                           const ReadOptions& options,
+                                           const Slice& file_value) {
+  const VersionSet* vset = reinterpret_cast<const VersionSet*>(arg);
+  if (file_value.size() != 24) {
     return NewErrorIterator(
         Status::Corruption("FileReader invoked with unexpected value"));
   } else {
-    return cache->NewIterator(options, DecodeFixed64(file_value.data()),
-                              DecodeFixed64(file_value.data() + 8));
+    return ApplyGlobalSequence(
+        vset->internal_comparator(),
+        vset->table_cache()->NewCompactionIterator(
+            options, DecodeFixed64(file_value.data()),
+            DecodeFixed64(file_value.data() + 8)),
+        DecodeFixed64(file_value.data() + 16));
   }
 }
 
@@ -223,15 +313,18 @@ Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
   return NewTwoLevelIterator(
       new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
-      vset_->table_cache_, options);
+      vset_, options);
 }
 
 void Version::AddIterators(const ReadOptions& options,
                            std::vector<Iterator*>* iters) {
   // Merge all level zero files together since they may overlap
   for (size_t i = 0; i < files_[0].size(); i++) {
-    iters->push_back(vset_->table_cache_->NewIterator(
-        options, files_[0][i]->number, files_[0][i]->file_size));
+    iters->push_back(ApplyGlobalSequence(
+        &vset_->icmp_,
+        vset_->table_cache_->NewIterator(options, files_[0][i]->number,
+                                         files_[0][i]->file_size),
+        files_[0][i]->global_sequence));
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
@@ -244,6 +337,17 @@ void Version::AddIterators(const ReadOptions& options,
   }
 }
 
+void Version::AddRangeTombstoneIterators(std::vector<Iterator*>* iters) {
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (FileMetaData* f : files_[level]) {
+      if (f->has_range_deletions) {
+        iters->push_back(vset_->table_cache_->NewRangeTombstoneIterator(
+            f->number, f->file_size));
+      }
+    }
+  }
+}
+
 // Callback from TableCache::Get()
 namespace {
 enum SaverState {
@@ -251,12 +355,23 @@ enum SaverState {
   kFound,
   kDeleted,
   kCorrupt,
+  kMerge,
 };
 struct Saver {
   SaverState state;
   const Comparator* ucmp;
   Slice user_key;
   std::string* value;
+  bool blob_index;  // *value holds the blob index of the value found
+  std::vector<std::string>* merge_operands;
+  SequenceNumber merge_sequence;  // Sequence number of the last operand
+  // Entries older than this are deleted by a range deletion
+  SequenceNumber* max_covering_tombstone_seq;
+  // Global sequence number of the table searched, or zero
+  SequenceNumber global_sequence;
+  // Entries newer than this are ignored.  Only needed for tables with a
+  // global sequence number, the table lookup skips them in other tables.
+  SequenceNumber sequence;
 };
 }  // namespace
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -266,9 +381,33 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
-      if (s->state == kFound) {
-        s->value->assign(v.data(), v.size());
+      if (s->global_sequence != 0) {
+        parsed_key.sequence = s->global_sequence;
+        if (parsed_key.sequence > s->sequence) {
+          return;
+        }
+      }
+      if (parsed_key.sequence < *s->max_covering_tombstone_seq) {
+        parsed_key.type = kTypeDeletion;
+      }
+      switch (parsed_key.type) {
+        case kTypeValue:
+        case kTypeBlobIndex:
+          s->state = kFound;
+          s->value->assign(v.data(), v.size());
+          s->blob_index = (parsed_key.type == kTypeBlobIndex);
+          break;
+        case kTypeDeletion:
+          s->state = kDeleted;
+          break;
+        case kTypeMerge:
+          s->state = kMerge;
+          s->merge_operands->push_back(v.ToString());
+          s->merge_sequence = parsed_key.sequence;
+          break;
+        case kTypeRangeDeletion:  // Never stored among point entries
+          s->state = kCorrupt;
+          break;
       }
     }
   }
@@ -307,22 +446,29 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
     if (num_files == 0) continue;
 
     // Binary search to find earliest index whose largest key >= internal_key.
-    uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
-    if (index < num_files) {
+    // The entries for user_key may continue in the following files if a
+    // compaction split them at a file boundary.
+    for (uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
+         index < num_files; index++) {
       FileMetaData* f = files_[level][index];
       if (ucmp->Compare(user_key, f->smallest.user_key()) < 0) {
         // All of "f" is past any data for user_key
-      } else {
-        if (!(*func)(arg, level, f)) {
-          return;
-        }
+        break;
+      }
+      if (!(*func)(arg, level, f)) {
+        return;
+      }
+      if (ucmp->Compare(user_key, f->largest.user_key()) != 0) {
+        break;
       }
     }
   }
 }
 
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
-                    std::string* value, GetStats* stats) {
+                    std::string* value, GetStats* stats,
+                    std::vector<std::string>* merge_operands,
+                    SequenceNumber* max_covering_tombstone_seq) {
   stats->seek_file = nullptr;
   stats->seek_file_level = -1;
 
@@ -331,6 +477,7 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
     GetStats* stats;
     const ReadOptions* options;
     Slice ikey;
+    SequenceNumber snapshot;
     FileMetaData* last_file_read;
     int last_file_read_level;
 
@@ -351,18 +498,62 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
       state->last_file_read = f;
       state->last_file_read_level = level;
 
-      state->s = state->vset->table_cache_->Get(*state->options, f->number,
-                                                f->file_size, state->ikey,
-                                                &state->saver, SaveValue);
+      if (f->has_range_deletions) {
+        // Files are visited from newest to oldest, so the range deletions
+        // of this file may hide its entries and those of the files after it.
+        Iterator* iter = state->vset->table_cache_->NewRangeTombstoneIterator(
+            f->number, f->file_size);
+        state->s = UpdateMaxCoveringTombstone(
+            iter, state->saver.ucmp, state->saver.user_key, state->snapshot,
+            state->saver.max_covering_tombstone_seq);
+        delete iter;
+        if (!state->s.ok()) {
+          state->found = true;
+          return false;
+        }
+      }
+
+      Slice ikey = state->ikey;
+      std::string next_ikey;
+      state->saver.global_sequence = f->global_sequence;
+      state->saver.sequence = state->snapshot;
+      while (true) {
+        state->s = state->vset->table_cache_->Get(*state->options, f->number,
+                                                  f->file_size, ikey,
+                                                  &state->saver, SaveValue);
+        if (!state->s.ok() || state->saver.state != kMerge) {
+          break;
+        }
+        // Look for the entries below the merge operand, which may be in
+        // this file too.
+        state->saver.state = kNotFound;
+        if (state->saver.merge_sequence == 0) {
+          break;
+        }
+        next_ikey.clear();
+        AppendInternalKey(&next_ikey, ParsedInternalKey(
+                                          state->saver.user_key,
+                                          state->saver.merge_sequence - 1,
+                                          kValueTypeForSeek));
+        ikey = next_ikey;
+        state->saver.sequence = state->saver.merge_sequence - 1;
+      }
       if (!state->s.ok()) {
         state->found = true;
         return false;
       }
       switch (state->saver.state) {
         case kNotFound:
+        case kMerge:
           return true;  // Keep searching in other files
         case kFound:
           state->found = true;
+          if (state->saver.blob_index) {
+            const std::string index = *state->saver.value;
+            state->s = state->vset->blob_cache_->Get(
+                *state->options, state->saver.user_key, index,
+                state->saver.value);
+          }
           return false;
         case kDeleted:
           return false;
@@ -387,23 +578,73 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 
   state.options = &options;
   state.ikey = k.internal_key();
+  state.snapshot =
+      DecodeFixed64(state.ikey.data() + state.ikey.size() - 8) >> 8;
   state.vset = vset_;
 
   state.saver.state = kNotFound;
   state.saver.ucmp = vset_->icmp_.user_comparator();
   state.saver.user_key = k.user_key();
   state.saver.value = value;
+  state.saver.blob_index = false;
+  state.saver.merge_operands = merge_operands;
+  state.saver.merge_sequence = 0;
+  state.saver.max_covering_tombstone_seq = max_covering_tombstone_seq;
+  state.saver.global_sequence = 0;
+  state.saver.sequence = state.snapshot;
 
   ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
   return state.found ? state.s : Status::NotFound(Slice());
 }
 
+void Version::PrefetchForGet(const ReadOptions& options,
+                             const std::vector<Slice>& keys) {
+  // Group the keys by the files that a lookup reads.  Files are visited in
+  // the order Get() searches them, and only the first file that may contain
+  // a key is prefetched for it since Get() usually stops there.
+  struct State {
+    std::map<uint64_t, std::pair<FileMetaData*, std::vector<Slice>>> files;
+    Slice ikey;
+    TableCache* table_cache;
+
+    static bool Match(void* arg, int level, FileMetaData* f) {
+      State* state = reinterpret_cast<State*>(arg);
+      if (!state->table_cache->KeyMayMatch(f->number, f->file_size,
+                                           state->ikey)) {
+        return true;
+      }
+      std::pair<FileMetaData*, std::vector<Slice>>* entry =
+          &state->files[f->number];
+      entry->first = f;
+      entry->second.push_back(state->ikey);
+      return false;
+    }
+  };
+
+  State state;
+  state.table_cache = vset_->table_cache_;
+  for (size_t i = 0; i < keys.size(); i++) {
+    state.ikey = keys[i];
+    ForEachOverlapping(ExtractUserKey(keys[i]), keys[i], &state,
+                       &State::Match);
+  }
+
+  for (const auto& entry : state.files) {
+    const FileMetaData* f = entry.second.first;
+    const std::vector<Slice>& file_keys = entry.second.second;
+    vset_->table_cache_->Prefetch(options, f->number, f->file_size,
+                                  file_keys.data(), file_keys.size());
+  }
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
   FileMetaData* f = stats.seek_file;
   if (f != nullptr) {
     f->allowed_seeks--;
-    if (f->allowed_seeks <= 0 && file_to_compact_ == nullptr) {
+    // Merging sorted runs is driven by their sizes alone.
+    if (f->allowed_seeks <= 0 && file_to_compact_ == nullptr &&
+        vset_->options_->compaction_style != kTieredCompaction) {
       file_to_compact_ = f;
       file_to_compact_level_ = stats.seek_file_level;
       return true;
@@ -461,6 +702,17 @@ void Version::Unref() {
   }
 }
 
+bool Version::NeedsBlobGarbageCollection(uint64_t number) const {
+  auto it = blob_files_.find(number);
+  if (it == blob_files_.end()) {
+    return false;
+  }
+  const BlobFileMetaData& b = it->second;
+  return b.garbage_bytes > 0 &&
+         b.garbage_bytes >=
+             vset_->options_->blob_garbage_collection_threshold * b.blob_bytes;
+}
+
 bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
                              const Slice* largest_user_key) {
   return SomeFileOverlapsRange(vset_->icmp_, (level > 0), files_[level],
@@ -470,6 +722,30 @@ bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
 int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                         const Slice& largest_user_key) {
   int level = 0;
+  if (vset_->options_->compaction_style == kTieredCompaction) {
+    // Each new table is the newest sorted run.
+    return level;
+  }
+  if (vset_->options_->level_compaction_dynamic_level_bytes) {
+    // Skip the empty levels above the base level.  Push to the base level
+    // under the same conditions as below.
+    if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key) &&
+        !OverlapInLevel(base_level_, &smallest_user_key, &largest_user_key)) {
+      level = base_level_;
+      if (level + 1 < config::kNumLevels) {
+        InternalKey start(smallest_user_key, kMaxSequenceNumber,
+                          kValueTypeForSeek);
+        InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
+        std::vector<FileMetaData*> overlaps;
+        GetOverlappingInputs(level + 1, &start, &limit, &overlaps);
+        if (TotalFileSize(overlaps) >
+            MaxGrandParentOverlapBytes(vset_->options_)) {
+          level = 0;
+        }
+      }
+    }
+    return level;
+  }
   if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
     // Push to next level if there is no overlap in next level,
     // and the #bytes overlapping in the level after that are limited.
@@ -494,6 +770,30 @@ int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
   return level;
 }
 
+int Version::PickLevelForIngestedFile(const Slice& smallest_user_key,
+                                      const Slice& largest_user_key) {
+  // Level-0 files may overlap each other, so the file is added there as the
+  // newest one if any level-0 file overlaps it.
+  if (OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
+    return 0;
+  }
+  if (vset_->options_->compaction_style == kTieredCompaction) {
+    // Keep the intermediate levels empty.
+    for (int level = 1; level < config::kNumLevels; level++) {
+      if (OverlapInLevel(level, &smallest_user_key, &largest_user_key)) {
+        return 0;
+      }
+    }
+    return config::kNumLevels - 1;
+  }
+  for (int level = 1; level < config::kNumLevels; level++) {
+    if (OverlapInLevel(level, &smallest_user_key, &largest_user_key)) {
+      return level - 1;
+    }
+  }
+  return config::kNumLevels - 1;
+}
+
 // Store in "*inputs" all files in "level" that overlap [begin,end]
 void Version::GetOverlappingInputs(int level, const InternalKey* begin,
                                    const InternalKey* end,
@@ -560,6 +860,21 @@ std::string Version::DebugString() const {
       r.append("]\n");
     }
   }
+  if (!blob_files_.empty()) {
+    // E.g.,
+    //   --- blob files ---
+    //   12:100/25
+    r.append("--- blob files ---\n");
+    for (const auto& kvp : blob_files_) {
+      r.push_back(' ');
+      AppendNumberTo(&r, kvp.first);
+      r.push_back(':');
+      AppendNumberTo(&r, kvp.second.num_blobs);
+      r.push_back('/');
+      AppendNumberTo(&r, kvp.second.garbage_blobs);
+      r.append("\n");
+    }
+  }
   return r;
 }
 
@@ -583,39 +898,32 @@ class VersionSet::Builder {
     }
   };
 
-  typedef std::set<FileMetaData*, BySmallestKey> FileSet;
+  // Files added to a level are collected in order and sorted once by
+  // SaveTo(), which is much cheaper than keeping them in a sorted set while
+  // the long sequence of edits in a MANIFEST is applied during recovery.
   struct LevelState {
-    std::set<uint64_t> deleted_files;
-    FileSet* added_files;
+    // Numbers of deleted files, each paired with the size of added_files at
+    // the time of the deletion.  An added file is dropped only if it was
+    // deleted after it was added.
+    std::vector<std::pair<uint64_t, size_t>> deleted_files;
+    std::vector<FileMetaData*> added_files;
   };
 
   VersionSet* vset_;
   Version* base_;
   LevelState levels_[config::kNumLevels];
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
-  Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+  Builder(VersionSet* vset, Version* base)
+      : vset_(vset), base_(base), blob_files_(base->blob_files_) {
     base_->Ref();
-    BySmallestKey cmp;
-    cmp.internal_comparator = &vset_->icmp_;
-    for (int level = 0; level < config::kNumLevels; level++) {
-      levels_[level].added_files = new FileSet(cmp);
-    }
   }
 
   ~Builder() {
     for (int level = 0; level < config::kNumLevels; level++) {
-      const FileSet* added = levels_[level].added_files;
-      std::vector<FileMetaData*> to_unref;
-      to_unref.reserve(added->size());
-      for (FileSet::const_iterator it = added->begin(); it != added->end();
-           ++it) {
-        to_unref.push_back(*it);
-      }
-      delete added;
-      for (uint32_t i = 0; i < to_unref.size(); i++) {
-        FileMetaData* f = to_unref[i];
+      for (FileMetaData* f : levels_[level].added_files) {
         f->refs--;
         if (f->refs <= 0) {
           delete f;
@@ -638,7 +946,8 @@ class VersionSet::Builder {
     for (const auto& deleted_file_set_kvp : edit->deleted_files_) {
       const int level = deleted_file_set_kvp.first;
       const uint64_t number = deleted_file_set_kvp.second;
-      levels_[level].deleted_files.insert(number);
+      LevelState* state = &levels_[level];
+      state->deleted_files.emplace_back(number, state->added_files.size());
     }
 
     // Add new files
@@ -663,8 +972,19 @@ class VersionSet::Builder {
       f->allowed_seeks = static_cast<int>((f->file_size / 16384U));
       if (f->allowed_seeks < 100) f->allowed_seeks = 100;
 
-      levels_[level].deleted_files.erase(f->number);
-      levels_[level].added_files->insert(f);
+      levels_[level].added_files.push_back(f);
+    }
+
+    // Add new blob files and account for their garbage
+    for (const BlobFileMetaData& b : edit->new_blob_files_) {
+      blob_files_[b.number] = b;
+    }
+    for (const BlobFileMetaData& g : edit->blob_garbage_) {
+      auto it = blob_files_.find(g.number);
+      if (it != blob_files_.end()) {
+        it->second.garbage_blobs += g.garbage_blobs;
+        it->second.garbage_bytes += g.garbage_bytes;
+      }
     }
   }
 
@@ -673,14 +993,27 @@ class VersionSet::Builder {
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
     for (int level = 0; level < config::kNumLevels; level++) {
-      // Merge the set of added files with the set of pre-existing files.
-      // Drop any deleted files.  Store the result in *v.
+      LevelState* state = &levels_[level];
+      std::sort(state->deleted_files.begin(), state->deleted_files.end());
+
+      // Collect the added files that were not deleted afterwards, in order.
+      std::vector<FileMetaData*> added_files;
+      added_files.reserve(state->added_files.size());
+      for (size_t i = 0; i < state->added_files.size(); i++) {
+        FileMetaData* f = state->added_files[i];
+        if (!IsDeleted(*state, f->number, i + 1)) {
+          added_files.push_back(f);
+        }
+      }
+      std::sort(added_files.begin(), added_files.end(), cmp);
+
+      // Merge the added files with the pre-existing files.  Drop any
+      // deleted files.  Store the result in *v.
       const std::vector<FileMetaData*>& base_files = base_->files_[level];
       std::vector<FileMetaData*>::const_iterator base_iter = base_files.begin();
       std::vector<FileMetaData*>::const_iterator base_end = base_files.end();
-      const FileSet* added_files = levels_[level].added_files;
-      v->files_[level].reserve(base_files.size() + added_files->size());
-      for (const auto& added_file : *added_files) {
+      v->files_[level].reserve(base_files.size() + added_files.size());
+      for (FileMetaData* added_file : added_files) {
         // Add all smaller files listed in base_
         for (std::vector<FileMetaData*>::const_iterator bpos =
                  std::upper_bound(base_iter, base_end, added_file, cmp);
@@ -688,7 +1021,7 @@ class VersionSet::Builder {
           MaybeAddFile(v, level, *base_iter);
         }
 
-        MaybeAddFile(v, level, added_file);
+        AddFile(v, level, added_file);
       }
 
       // Add remaining base files
@@ -712,31 +1045,55 @@ class VersionSet::Builder {
       }
 #endif
     }
+
+    // Drop the blob files no table refers to any more.
+    for (const auto& kvp : blob_files_) {
+      if (kvp.second.garbage_blobs < kvp.second.num_blobs) {
+        v->blob_files_.insert(v->blob_files_.end(), kvp);
+      }
+    }
+  }
+
+ private:
+  // Returns true if file "number" was deleted after the first "min_added"
+  // added files of the level had been added.  Requires that
+  // state.deleted_files is sorted.
+  static bool IsDeleted(const LevelState& state, uint64_t number,
+                        size_t min_added) {
+    auto it = std::lower_bound(state.deleted_files.begin(),
+                               state.deleted_files.end(),
+                               std::make_pair(number, min_added));
+    return it != state.deleted_files.end() && it->first == number;
   }
 
   void MaybeAddFile(Version* v, int level, FileMetaData* f) {
-    if (levels_[level].deleted_files.count(f->number) > 0) {
+    if (IsDeleted(levels_[level], f->number, 0)) {
       // File is deleted: do nothing
     } else {
-      std::vector<FileMetaData*>* files = &v->files_[level];
-      if (level > 0 && !files->empty()) {
-        // Must not overlap
-        assert(vset_->icmp_.Compare((*files)[files->size() - 1]->largest,
-                                    f->smallest) < 0);
-      }
-      f->refs++;
-      files->push_back(f);
+      AddFile(v, level, f);
+    }
+  }
+
+  void AddFile(Version* v, int level, FileMetaData* f) {
+    std::vector<FileMetaData*>* files = &v->files_[level];
+    if (level > 0 && !files->empty()) {
+      // Must not overlap
+      assert(vset_->icmp_.Compare((*files)[files->size() - 1]->largest,
+                                  f->smallest) < 0);
     }
+    f->refs++;
+    files->push_back(f);
   }
 };
 
 VersionSet::VersionSet(const std::string& dbname, const Options* options,
-                       TableCache* table_cache,
+                       TableCache* table_cache, BlobFileCache* blob_cache,
                        const InternalKeyComparator* cmp)
     : env_(options->env),
       dbname_(dbname),
       options_(options),
       table_cache_(table_cache),
+      blob_cache_(blob_cache),
       icmp_(*cmp),
       next_file_number_(2),
       manifest_file_number_(0),  // Filled by Recover()
@@ -745,6 +1102,8 @@ VersionSet::VersionSet(const std::string& dbname, const Options* options,
       prev_log_number_(0),
       descriptor_file_(nullptr),
       descriptor_log_(nullptr),
+      descriptor_size_(0),
+      descriptor_edits_(0),
       dummy_versions_(this),
       current_(nullptr) {
   AppendVersion(new Version(this));
@@ -774,25 +1133,73 @@ void VersionSet::AppendVersion(Version* v) {
   v->next_->prev_ = v;
 }
 
+struct VersionSet::ManifestWriter {
+  ManifestWriter(VersionEdit* edit, port::Mutex* mu)
+      : edit(edit), done(false), cv(mu) {}
+
+  VersionEdit* const edit;
+  Status status;
+  bool done;
+  port::CondVar cv;
+};
+
 Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
-  if (edit->has_log_number_) {
-    assert(edit->log_number_ >= log_number_);
-    assert(edit->log_number_ < next_file_number_);
-  } else {
-    edit->SetLogNumber(log_number_);
-  }
+  // Concurrent callers queue up.  The caller at the front of the queue
+  // writes the edits of everyone queued behind it with a single MANIFEST
+  // sync and installs the resulting version; the others just wait for it.
+  ManifestWriter w(edit, mu);
+  manifest_writers_.push_back(&w);
+  while (!w.done && &w != manifest_writers_.front()) {
+    w.cv.Wait();
+  }
+  if (w.done) {
+    return w.status;
+  }
+
+  // Callers that queue up while *mu is released below are left for the
+  // next group.
+  std::vector<ManifestWriter*> group(manifest_writers_.begin(),
+                                     manifest_writers_.end());
+  uint64_t log_number = log_number_;
+  uint64_t prev_log_number = prev_log_number_;
+  for (ManifestWriter* writer : group) {
+    VersionEdit* e = writer->edit;
+    if (e->has_log_number_) {
+      assert(e->log_number_ >= log_number);
+      assert(e->log_number_ < next_file_number_);
+      log_number = e->log_number_;
+    } else {
+      e->SetLogNumber(log_number);
+    }
 
-  if (!edit->has_prev_log_number_) {
-    edit->SetPrevLogNumber(prev_log_number_);
+    if (e->has_prev_log_number_) {
+      prev_log_number = e->prev_log_number_;
+    } else {
+      e->SetPrevLogNumber(prev_log_number);
+    }
   }
 
-  edit->SetNextFile(next_file_number_);
-  edit->SetLastSequence(last_sequence_);
+  // Replace a MANIFEST that has grown too long by a new one that starts
+  // with a snapshot of the current version, so that Recover() only has to
+  // replay the edits made since.  The old MANIFEST stays in use until
+  // CURRENT points at the new one.
+  const bool roll_manifest =
+      descriptor_log_ != nullptr && ShouldRollManifest();
+  uint64_t manifest_number = manifest_file_number_;
+  std::string snapshot;
+  if (roll_manifest) {
+    manifest_number = NewFileNumber();
+    EncodeSnapshot(&snapshot);
+  }
 
   Version* v = new Version(this);
   {
     Builder builder(this, current_);
-    builder.Apply(edit);
+    for (ManifestWriter* writer : group) {
+      writer->edit->SetNextFile(next_file_number_);
+      writer->edit->SetLastSequence(last_sequence_);
+      builder.Apply(writer->edit);
+    }
     builder.SaveTo(v);
   }
   Finalize(v);
@@ -806,25 +1213,48 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     // first call to LogAndApply (when opening the database).
     assert(descriptor_file_ == nullptr);
     new_manifest_file = DescriptorFileName(dbname_, manifest_file_number_);
-    edit->SetNextFile(next_file_number_);
     s = env_->NewWritableFile(new_manifest_file, &descriptor_file_);
     if (s.ok()) {
       descriptor_log_ = new log::Writer(descriptor_file_);
-      s = WriteSnapshot(descriptor_log_);
+      EncodeSnapshot(&snapshot);
+      s = descriptor_log_->AddRecord(snapshot);
+      descriptor_size_ = snapshot.size();
+      descriptor_edits_ = 0;
     }
+  } else if (roll_manifest) {
+    new_manifest_file = DescriptorFileName(dbname_, manifest_number);
   }
 
   // Unlock during expensive MANIFEST log write
+  WritableFile* rolled_file = nullptr;
+  log::Writer* rolled_log = nullptr;
+  uint64_t record_bytes = 0;
   {
     mu->Unlock();
 
-    // Write new record to MANIFEST log
+    if (s.ok() && roll_manifest) {
+      Log(options_->info_log, "Rolling over MANIFEST to #%llu\n",
+          static_cast<unsigned long long>(manifest_number));
+      s = env_->NewWritableFile(new_manifest_file, &rolled_file);
+      if (s.ok()) {
+        rolled_log = new log::Writer(rolled_file);
+        s = rolled_log->AddRecord(snapshot);
+      }
+    }
+    WritableFile* file = roll_manifest ? rolled_file : descriptor_file_;
+    log::Writer* log = roll_manifest ? rolled_log : descriptor_log_;
+
+    // Write new records to MANIFEST log
     if (s.ok()) {
       std::string record;
-      edit->EncodeTo(&record);
-      s = descriptor_log_->AddRecord(record);
+      for (size_t i = 0; i < group.size() && s.ok(); i++) {
+        record.clear();
+        group[i]->edit->EncodeTo(&record);
+        s = log->AddRecord(record);
+        record_bytes += record.size();
+      }
       if (s.ok()) {
-        s = descriptor_file_->Sync();
+        s = file->Sync();
       }
       if (!s.ok()) {
         Log(options_->info_log, "MANIFEST write: %s\n", s.ToString().c_str());
@@ -834,7 +1264,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     // If we just created a new descriptor file, install it by writing a
     // new CURRENT file that points to it.
     if (s.ok() && !new_manifest_file.empty()) {
-      s = SetCurrentFile(env_, dbname_, manifest_file_number_);
+      s = SetCurrentFile(env_, dbname_, manifest_number);
     }
 
     mu->Lock();
@@ -843,11 +1273,27 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
   // Install the new version
   if (s.ok()) {
     AppendVersion(v);
-    log_number_ = edit->log_number_;
-    prev_log_number_ = edit->prev_log_number_;
+    log_number_ = log_number;
+    prev_log_number_ = prev_log_number;
+    if (roll_manifest) {
+      delete descriptor_log_;
+      delete descriptor_file_;
+      descriptor_log_ = rolled_log;
+      descriptor_file_ = rolled_file;
+      manifest_file_number_ = manifest_number;
+      descriptor_size_ = snapshot.size();
+      descriptor_edits_ = 0;
+    }
+    descriptor_size_ += record_bytes;
+    descriptor_edits_ += group.size();
   } else {
     delete v;
-    if (!new_manifest_file.empty()) {
+    if (roll_manifest) {
+      // Keep appending to the old MANIFEST.
+      delete rolled_log;
+      delete rolled_file;
+      env_->RemoveFile(new_manifest_file);
+    } else if (!new_manifest_file.empty()) {
       delete descriptor_log_;
       delete descriptor_file_;
       descriptor_log_ = nullptr;
@@ -856,6 +1302,21 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     }
   }
 
+  for (ManifestWriter* writer : group) {
+    assert(writer == manifest_writers_.front());
+    manifest_writers_.pop_front();
+    if (writer != &w) {
+      writer->status = s;
+      writer->done = true;
+      writer->cv.Signal();
+    }
+  }
+
+  // Notify new head of manifest writer queue
+  if (!manifest_writers_.empty()) {
+    manifest_writers_.front()->cv.Signal();
+  }
+
   return s;
 }
 
@@ -897,6 +1358,7 @@ Status VersionSet::Recover(bool* save_manifest) {
   uint64_t last_sequence = 0;
   uint64_t log_number = 0;
   uint64_t prev_log_number = 0;
+  bool timestamped_values = false;
   Builder builder(this, current_);
   int read_records = 0;
 
@@ -924,6 +1386,10 @@ Status VersionSet::Recover(bool* save_manifest) {
         builder.Apply(&edit);
       }
 
+      if (edit.timestamped_values_) {
+        timestamped_values = true;
+      }
+
       if (edit.has_log_number_) {
         log_number = edit.log_number_;
         have_log_number = true;
@@ -955,6 +1421,13 @@ Status VersionSet::Recover(bool* save_manifest) {
       s = Status::Corruption("no meta-lognumber entry in descriptor");
     } else if (!have_last_sequence) {
       s = Status::Corruption("no last-sequence-number entry in descriptor");
+    } else if (timestamped_values != (options_->ttl_seconds > 0)) {
+      // Values would be misread and expired, see Options::ttl_seconds.
+      s = Status::InvalidArgument(
+          timestamped_values ? "database was created with ttl_seconds"
+                             : "database was created without ttl_seconds",
+          options_->ttl_seconds > 0 ? "ttl_seconds is set"
+                                    : "ttl_seconds is not set");
     }
 
     if (!have_prev_log_number) {
@@ -980,6 +1453,7 @@ Status VersionSet::Recover(bool* save_manifest) {
     // See if we can reuse the existing MANIFEST file.
     if (ReuseManifest(dscname, current)) {
       // No need to save new manifest
+      descriptor_edits_ = read_records;
     } else {
       *save_manifest = true;
     }
@@ -1019,6 +1493,7 @@ bool VersionSet::ReuseManifest(const std::string& dscname,
 
   Log(options_->info_log, "Reusing MANIFEST %s\n", dscname.c_str());
   descriptor_log_ = new log::Writer(descriptor_file_, manifest_size);
+  descriptor_size_ = manifest_size;
   manifest_file_number_ = manifest_number;
   return true;
 }
@@ -1034,7 +1509,11 @@ void VersionSet::Finalize(Version* v) {
   int best_level = -1;
   double best_score = -1;
 
+  ComputeLevelTargets(v);
   for (int level = 0; level < config::kNumLevels - 1; level++) {
+    if (options_->compaction_style == kTieredCompaction) {
+      break;
+    }
     double score;
     if (level == 0) {
       // We treat level-0 specially by bounding the number of files
@@ -1050,11 +1529,12 @@ void VersionSet::Finalize(Version* v) {
       // overwrites/deletions).
       score = v->files_[level].size() /
               static_cast<double>(config::kL0_CompactionTrigger);
+    } else if (level < v->base_level_) {
+      continue;
     } else {
       // Compute the ratio of current size to size limit.
       const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score =
-          static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+      score = static_cast<double>(level_bytes) / v->max_bytes_for_level_[level];
     }
 
     if (score > best_score) {
@@ -1065,14 +1545,169 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+  if (options_->compaction_style == kTieredCompaction) {
+    FinalizeTiered(v);
+  }
+
+  uint32_t oldest_timestamp = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (const FileMetaData* f : v->files_[level]) {
+      if (f->newest_timestamp != 0 &&
+          (oldest_timestamp == 0 || f->newest_timestamp < oldest_timestamp)) {
+        oldest_timestamp = f->newest_timestamp;
+      }
+    }
+  }
+  v->oldest_file_timestamp_ = oldest_timestamp;
+
+  // Compact the table referring to the oldest blob file that is worth
+  // collecting.
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (FileMetaData* f : v->files_[level]) {
+      if (f->oldest_blob_file != 0 &&
+          (v->blob_file_to_compact_ == nullptr ||
+           f->oldest_blob_file <
+               v->blob_file_to_compact_->oldest_blob_file) &&
+          v->NeedsBlobGarbageCollection(f->oldest_blob_file)) {
+        v->blob_file_to_compact_ = f;
+        v->blob_file_to_compact_level_ = level;
+      }
+    }
+  }
+
+  // Compact the table with the largest fraction of deletions.  Compacting
+  // a table pushes its deletions down a level, and they are dropped on
+  // reaching the last level, so tables in the last level are left alone.
+  if (options_->deletion_compaction_ratio > 0 &&
+      options_->compaction_style == kLeveledCompaction) {
+    double best_ratio = options_->deletion_compaction_ratio;
+    for (int level = 0; level < config::kNumLevels - 1; level++) {
+      for (FileMetaData* f : v->files_[level]) {
+        if (f->num_entries == 0) {
+          continue;
+        }
+        const double ratio =
+            static_cast<double>(f->num_deletions) / f->num_entries;
+        if (ratio >= best_ratio) {
+          v->deletion_file_to_compact_ = f;
+          v->deletion_file_to_compact_level_ = level;
+          best_ratio = ratio;
+        }
+      }
+    }
+  }
 }
 
-Status VersionSet::WriteSnapshot(log::Writer* log) {
+void VersionSet::ComputeLevelTargets(Version* v) {
+  v->base_level_ = 1;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    v->max_bytes_for_level_[level] = MaxBytesForLevel(options_, level);
+  }
+  if (!options_->level_compaction_dynamic_level_bytes ||
+      options_->compaction_style != kLeveledCompaction) {
+    return;
+  }
+
+  int first_level = 0;
+  int64_t last_level_bytes = 0;
+  for (int level = 1; level < config::kNumLevels; level++) {
+    const int64_t level_bytes = TotalFileSize(v->files_[level]);
+    if (level_bytes > 0) {
+      if (first_level == 0) {
+        first_level = level;
+      }
+      last_level_bytes = level_bytes;
+    }
+  }
+  const int last_level = config::kNumLevels - 1;
+  if (first_level == 0) {
+    // Level-0 compactions write straight to the last level.
+    v->base_level_ = last_level;
+    return;
+  }
+
+  // Work upwards from the last level, which is expected to hold as much
+  // as the last non-empty level does now, until the level size drops to
+  // the size limit of level-1.  The base level is never below a level
+  // that holds files, since nothing would move them down.
+  const double kBaseBytes = MaxBytesForLevel(options_, 1);
+  double base_bytes = last_level_bytes;
+  for (int level = last_level - 1; level >= first_level; level--) {
+    base_bytes /= 10;
+  }
+  int base_level = first_level;
+  while (base_level > 1 && base_bytes > kBaseBytes) {
+    base_level--;
+    base_bytes /= 10;
+  }
+  // Do not let small databases compact level-1 too eagerly.
+  base_bytes = std::max(base_bytes, kBaseBytes / 10);
+
+  v->base_level_ = base_level;
+  for (int level = base_level; level < config::kNumLevels; level++) {
+    v->max_bytes_for_level_[level] = base_bytes;
+    base_bytes *= 10;
+  }
+}
+
+void VersionSet::FinalizeTiered(Version* v) {
+  // The sorted runs are the level-0 files and the last level.  Files in
+  // the intermediate levels, left there by leveled compaction or by
+  // compactions that collect blob garbage, are pushed down first.
+  const int last_level = config::kNumLevels - 1;
+  for (int level = 1; level < last_level; level++) {
+    if (!v->files_[level].empty()) {
+      v->compaction_level_ = level;
+      v->compaction_score_ = 1;
+      return;
+    }
+  }
+
+  const int runs =
+      v->files_[0].size() + (v->files_[last_level].empty() ? 0 : 1);
+  double score = runs / static_cast<double>(config::kL0_CompactionTrigger);
+
+  // Space amplification: the bytes in the newer runs may all be obsolete
+  // versions of the entries in the last level.
+  const int64_t last_bytes = TotalFileSize(v->files_[last_level]);
+  if (last_bytes > 0 && !v->files_[0].empty()) {
+    const double amplification =
+        TotalFileSize(v->files_[0]) * 100.0 / last_bytes;
+    score = std::max(
+        score,
+        amplification / options_->tiered_max_size_amplification_percent);
+  }
+  v->compaction_level_ = 0;
+  v->compaction_score_ = score;
+}
+
+int VersionSet::RemoveExpiredFiles(uint32_t cutoff, VersionEdit* edit) {
+  int removed = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (const FileMetaData* f : current_->files_[level]) {
+      if (f->newest_timestamp != 0 && f->newest_timestamp < cutoff) {
+        edit->RemoveFile(level, f->number);
+        removed++;
+      }
+    }
+  }
+  return removed;
+}
+
+bool VersionSet::ShouldRollManifest() const {
+  return descriptor_size_ >= options_->max_manifest_file_size ||
+         descriptor_edits_ >= kMaxManifestEdits;
+}
+
+void VersionSet::EncodeSnapshot(std::string* record) {
   // TODO: Break up into multiple records to reduce memory usage on recovery?
 
   // Save metadata
   VersionEdit edit;
   edit.SetComparatorName(icmp_.user_comparator()->Name());
+  if (options_->ttl_seconds > 0) {
+    edit.SetTimestampedValues();
+  }
 
   // Save compaction pointers
   for (int level = 0; level < config::kNumLevels; level++) {
@@ -1088,13 +1723,20 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, *f);
     }
   }
 
-  std::string record;
-  edit.EncodeTo(&record);
-  return log->AddRecord(record);
+  // Save blob files
+  for (const auto& kvp : current_->blob_files_) {
+    const BlobFileMetaData& b = kvp.second;
+    edit.AddBlobFile(b.number, b.num_blobs, b.blob_bytes);
+    if (b.garbage_blobs != 0) {
+      edit.AddBlobGarbage(b.number, b.garbage_blobs, b.garbage_bytes);
+    }
+  }
+
+  edit.EncodeTo(record);
 }
 
 int VersionSet::NumLevelFiles(int level) const {
@@ -1115,6 +1757,46 @@ const char* VersionSet::LevelSummary(LevelSummaryStorage* scratch) const {
   return scratch->buffer;
 }
 
+void VersionSet::AppendTablesByDeletionRatio(int n, std::string* result) const {
+  std::vector<std::pair<int, const FileMetaData*>> tables;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (const FileMetaData* f : current_->files_[level]) {
+      if (f->num_deletions > 0) {
+        tables.emplace_back(level, f);
+      }
+    }
+  }
+  // Compare a/b against c/d as a*d against c*b to avoid rounding.
+  auto by_ratio = [](const std::pair<int, const FileMetaData*>& a,
+                     const std::pair<int, const FileMetaData*>& b) {
+    const double x = static_cast<double>(a.second->num_deletions) *
+                     b.second->num_entries;
+    const double y = static_cast<double>(b.second->num_deletions) *
+                     a.second->num_entries;
+    if (x != y) {
+      return x > y;
+    }
+    return a.first != b.first ? a.first < b.first
+                              : a.second->number < b.second->number;
+  };
+  const size_t count = std::min(tables.size(), static_cast<size_t>(n));
+  std::partial_sort(tables.begin(), tables.begin() + count, tables.end(),
+                    by_ratio);
+  char buf[200];
+  for (size_t i = 0; i < count; i++) {
+    const FileMetaData* f = tables[i].second;
+    std::snprintf(buf, sizeof(buf),
+                  "level %d table #%llu: %llu of %llu entries deleted "
+                  "(%.1f%%), %llu bytes\n",
+                  tables[i].first, static_cast<unsigned long long>(f->number),
+                  static_cast<unsigned long long>(f->num_deletions),
+                  static_cast<unsigned long long>(f->num_entries),
+                  100.0 * f->num_deletions / f->num_entries,
+                  static_cast<unsigned long long>(f->file_size));
+    result->append(buf);
+  }
+}
+
 uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
   uint64_t result = 0;
   for (int level = 0; level < config::kNumLevels; level++) {
@@ -1156,6 +1838,9 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
         live->insert(files[i]->number);
       }
     }
+    for (const auto& kvp : v->blob_files_) {
+      live->insert(kvp.first);
+    }
   }
 }
 
@@ -1221,6 +1906,7 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   ReadOptions options;
   options.verify_checksums = options_->paranoid_checks;
   options.fill_cache = false;
+  options.readahead_size = options_->compaction_readahead_size;
 
   // Level-0 files have to be merged together.  For other levels,
   // we will make a concatenating iterator per level.
@@ -1230,17 +1916,20 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   int num = 0;
   for (int which = 0; which < 2; which++) {
     if (!c->inputs_[which].empty()) {
-      if (c->level() + which == 0) {
+      if ((which == 0 ? c->level() : c->output_level()) == 0) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
-          list[num++] = table_cache_->NewIterator(options, files[i]->number,
-                                                  files[i]->file_size);
+          list[num++] = ApplyGlobalSequence(
+              &icmp_,
+              table_cache_->NewCompactionIterator(options, files[i]->number,
+                                                  files[i]->file_size),
+              files[i]->global_sequence);
         }
       } else {
         // Create concatenating iterator for the files from this level
         list[num++] = NewTwoLevelIterator(
             new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
-            &GetFileIterator, table_cache_, options);
+            &GetCompactionFileIterator, this, options);
       }
     }
   }
@@ -1258,29 +1947,60 @@ Compaction* VersionSet::PickCompaction() {
   // the compactions triggered by seeks.
   const bool size_compaction = (current_->compaction_score_ >= 1);
   const bool seek_compaction = (current_->file_to_compact_ != nullptr);
-  if (size_compaction) {
+  const bool blob_compaction = (current_->blob_file_to_compact_ != nullptr);
+  const bool deletion_compaction =
+      (current_->deletion_file_to_compact_ != nullptr);
+  if (size_compaction && options_->compaction_style == kTieredCompaction &&
+      current_->compaction_level_ == 0) {
+    return PickTieredCompaction();
+  } else if (size_compaction) {
     level = current_->compaction_level_;
     assert(level >= 0);
     assert(level + 1 < config::kNumLevels);
     c = new Compaction(options_, level);
 
-    // Pick the first file that comes after compact_pointer_[level]
-    for (size_t i = 0; i < current_->files_[level].size(); i++) {
-      FileMetaData* f = current_->files_[level][i];
-      if (compact_pointer_[level].empty() ||
-          icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
-        c->inputs_[0].push_back(f);
-        break;
+    if (level > 0 && options_->compaction_priority == kMinOverlappingRatio) {
+      c->inputs_[0].push_back(PickMinOverlappingRatioFile(level));
+    } else {
+      // Pick the first file that comes after compact_pointer_[level]
+      for (size_t i = 0; i < current_->files_[level].size(); i++) {
+        FileMetaData* f = current_->files_[level][i];
+        if (compact_pointer_[level].empty() ||
+            icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
+          c->inputs_[0].push_back(f);
+          break;
+        }
+      }
+      if (c->inputs_[0].empty()) {
+        // Wrap-around to the beginning of the key space
+        c->inputs_[0].push_back(current_->files_[level][0]);
       }
     }
-    if (c->inputs_[0].empty()) {
-      // Wrap-around to the beginning of the key space
-      c->inputs_[0].push_back(current_->files_[level][0]);
-    }
+  } else if (deletion_compaction) {
+    level = current_->deletion_file_to_compact_level_;
+    c = new Compaction(options_, level);
+    c->inputs_[0].push_back(current_->deletion_file_to_compact_);
+    c->collects_deletions_ = true;
   } else if (seek_compaction) {
     level = current_->file_to_compact_level_;
     c = new Compaction(options_, level);
     c->inputs_[0].push_back(current_->file_to_compact_);
+  } else if (blob_compaction) {
+    level = current_->blob_file_to_compact_level_;
+    if (level == config::kNumLevels - 1) {
+      // Tables in the last level cannot be pushed down any further, so the
+      // table is rewritten in place by a compaction without inputs from
+      // the level above.
+      c = new Compaction(options_, level - 1);
+      c->inputs_[1].push_back(current_->blob_file_to_compact_);
+      c->collects_blob_garbage_ = true;
+      c->input_version_ = current_;
+      c->input_version_->Ref();
+      return c;
+    }
+    c = new Compaction(options_, level);
+    c->inputs_[0].push_back(current_->blob_file_to_compact_);
+    c->collects_blob_garbage_ = true;
   } else {
     return nullptr;
   }
@@ -1290,6 +2010,7 @@ Compaction* VersionSet::PickCompaction() {
 
   // Files in level 0 may overlap each other, so pick up all overlapping ones
   if (level == 0) {
+    c->output_level_ = current_->base_level_;
     InternalKey smallest, largest;
     GetRange(c->inputs_[0], &smallest, &largest);
     // Note that the next call will discard the file we placed in
@@ -1304,6 +2025,106 @@ Compaction* VersionSet::PickCompaction() {
   return c;
 }
 
+FileMetaData* VersionSet::PickMinOverlappingRatioFile(int level) {
+  // Both levels are sorted and their files do not overlap, so the files
+  // of the next level that overlap each file are found in a single pass.
+  const Comparator* ucmp = icmp_.user_comparator();
+  const std::vector<FileMetaData*>& files = current_->files_[level];
+  const std::vector<FileMetaData*>& next = current_->files_[level + 1];
+  FileMetaData* best = nullptr;
+  double best_ratio = 0;
+  size_t first = 0;
+  for (FileMetaData* f : files) {
+    while (first < next.size() &&
+           ucmp->Compare(next[first]->largest.user_key(),
+                         f->smallest.user_key()) < 0) {
+      first++;
+    }
+    uint64_t overlapped = 0;
+    for (size_t i = first;
+         i < next.size() && ucmp->Compare(next[i]->smallest.user_key(),
+                                          f->largest.user_key()) <= 0;
+         i++) {
+      overlapped += next[i]->file_size;
+    }
+    const double ratio =
+        static_cast<double>(overlapped) / std::max<uint64_t>(f->file_size, 1);
+    if (best == nullptr || ratio < best_ratio) {
+      best = f;
+      best_ratio = ratio;
+    }
+  }
+  return best;
+}
+
+Compaction* VersionSet::PickTieredCompaction() {
+  const int last_level = config::kNumLevels - 1;
+  std::vector<FileMetaData*> newest_first = current_->files_[0];
+  std::sort(newest_first.begin(), newest_first.end(), NewestFirst);
+  const std::vector<FileMetaData*>& last_files = current_->files_[last_level];
+
+  // Sorted runs, newest first, as (level-0 file or nullptr for the last
+  // level, size in bytes).
+  std::vector<std::pair<FileMetaData*, int64_t>> runs;
+  for (FileMetaData* f : newest_first) {
+    runs.emplace_back(f, f->file_size);
+  }
+  if (!last_files.empty()) {
+    runs.emplace_back(nullptr, TotalFileSize(last_files));
+  }
+
+  // Always merge the newest runs: the output of a merge into level 0 is
+  // then newer than the level-0 files left alone, as its file number says.
+  size_t merge = 0;
+  const int64_t newer_bytes = TotalFileSize(newest_first);
+  if (!last_files.empty() && !newest_first.empty() &&
+      newer_bytes * 100.0 >=
+          static_cast<double>(runs.back().second) *
+              options_->tiered_max_size_amplification_percent) {
+    // Too much space amplification: merge everything.
+    merge = runs.size();
+    Log(options_->info_log, "Tiered: space amplification %lld%%\n",
+        static_cast<long long>(newer_bytes * 100 / runs.back().second));
+  } else {
+    // Merge the newest runs while the next one is not much larger than
+    // the runs picked so far.
+    int64_t picked_bytes = runs.empty() ? 0 : runs[0].second;
+    merge = 1;
+    while (merge < runs.size() &&
+           runs[merge].second * 100.0 <=
+               picked_bytes * (100.0 + options_->tiered_size_ratio)) {
+      picked_bytes += runs[merge].second;
+      merge++;
+    }
+    // Otherwise merge just enough of them to bring the number of runs
+    // below the trigger.
+    if (merge < 2 &&
+        runs.size() >= static_cast<size_t>(config::kL0_CompactionTrigger)) {
+      merge = runs.size() - config::kL0_CompactionTrigger + 2;
+    }
+  }
+  if (merge < 2) {
+    return nullptr;
+  }
+
+  Compaction* c = new Compaction(options_, 0);
+  for (size_t i = 0; i < merge && runs[i].first != nullptr; i++) {
+    c->inputs_[0].push_back(runs[i].first);
+  }
+  if (merge == runs.size()) {
+    // Nothing older is left, so the result belongs in the last level.
+    c->output_level_ = last_level;
+    c->inputs_[1] = last_files;
+  } else {
+    // Write a single table for the merged run.
+    c->output_level_ = 0;
+    c->max_output_file_size_ = std::numeric_limits<uint64_t>::max();
+  }
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  return c;
+}
+
 // Finds the largest key in a vector of files. Returns true if files it not
 // empty.
 bool FindLargestKey(const InternalKeyComparator& icmp,
@@ -1370,6 +2191,13 @@ void AddBoundaryInputs(const InternalKeyComparator& icmp,
 
   bool continue_searching = true;
   while (continue_searching) {
+    // A file ending at the limit of a range tombstone holds no entry for
+    // the limit's user key.
+    ParsedInternalKey parsed;
+    if (ParseInternalKey(largest_key.Encode(), &parsed) &&
+        parsed.sequence == kMaxSequenceNumber) {
+      break;
+    }
     FileMetaData* smallest_boundary_file =
         FindSmallestBoundaryFile(icmp, level_files, largest_key);
 
@@ -1385,12 +2213,13 @@ void AddBoundaryInputs(const InternalKeyComparator& icmp,
 
 void VersionSet::SetupOtherInputs(Compaction* c) {
   const int level = c->level();
+  const int output_level = c->output_level();
   InternalKey smallest, largest;
 
   AddBoundaryInputs(icmp_, current_->files_[level], &c->inputs_[0]);
   GetRange(c->inputs_[0], &smallest, &largest);
 
-  current_->GetOverlappingInputs(level + 1, &smallest, &largest,
+  current_->GetOverlappingInputs(output_level, &smallest, &largest,
                                  &c->inputs_[1]);
 
   // Get entire range covered by compaction
@@ -1398,7 +2227,7 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
   GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
 
   // See if we can grow the number of inputs in "level" without
-  // changing the number of "level+1" files we pick up.
+  // changing the number of "output_level" files we pick up.
   if (!c->inputs_[1].empty()) {
     std::vector<FileMetaData*> expanded0;
     current_->GetOverlappingInputs(level, &all_start, &all_limit, &expanded0);
@@ -1412,7 +2241,7 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
       InternalKey new_start, new_limit;
       GetRange(expanded0, &new_start, &new_limit);
       std::vector<FileMetaData*> expanded1;
-      current_->GetOverlappingInputs(level + 1, &new_start, &new_limit,
+      current_->GetOverlappingInputs(output_level, &new_start, &new_limit,
                                      &expanded1);
       if (expanded1.size() == c->inputs_[1].size()) {
         Log(options_->info_log,
@@ -1430,9 +2259,9 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
   }
 
   // Compute the set of grandparent files that overlap this compaction
-  // (parent == level+1; grandparent == level+2)
-  if (level + 2 < config::kNumLevels) {
-    current_->GetOverlappingInputs(level + 2, &all_start, &all_limit,
+  // (parent == output_level; grandparent == output_level+1)
+  if (output_level + 1 < config::kNumLevels) {
+    current_->GetOverlappingInputs(output_level + 1, &all_start, &all_limit,
                                    &c->grandparents_);
   }
 
@@ -1473,14 +2302,20 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
   c->input_version_ = current_;
   c->input_version_->Ref();
   c->inputs_[0] = inputs;
+  if (level == 0) {
+    c->output_level_ = current_->base_level_;
+  }
   SetupOtherInputs(c);
   return c;
 }
 
 Compaction::Compaction(const Options* options, int level)
     : level_(level),
+      output_level_(level + 1),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
       input_version_(nullptr),
+      collects_blob_garbage_(false),
+      collects_deletions_(false),
       grandparent_index_(0),
       seen_key_(false),
       overlapped_bytes_(0) {
@@ -1500,7 +2335,10 @@ bool Compaction::IsTrivialMove() const {
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
   // a very expensive merge later on.
-  return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
+  // A move would not relocate any blobs, nor drop any deletions.
+  return (!collects_blob_garbage_ && !collects_deletions_ &&
+          num_input_files(0) == 1 &&
+          num_input_files(1) == 0 &&
           TotalFileSize(grandparents_) <=
               MaxGrandParentOverlapBytes(vset->options_));
 }
@@ -1508,15 +2346,28 @@ bool Compaction::IsTrivialMove() const {
 void Compaction::AddInputDeletions(VersionEdit* edit) {
   for (int which = 0; which < 2; which++) {
     for (size_t i = 0; i < inputs_[which].size(); i++) {
-      edit->RemoveFile(level_ + which, inputs_[which][i]->number);
+      edit->RemoveFile(which == 0 ? level_ : output_level_,
+                       inputs_[which][i]->number);
     }
   }
+  for (size_t i = 0; i < dropped_inputs_.size(); i++) {
+    edit->RemoveFile(output_level_, dropped_inputs_[i]->number);
+  }
+}
+
+void Compaction::DropInput(int i) {
+  dropped_inputs_.push_back(inputs_[1][i]);
+  inputs_[1].erase(inputs_[1].begin() + i);
 }
 
 bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
+  if (output_level_ == 0) {
+    // Older sorted runs are left in level 0 and the last level.
+    return false;
+  }
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
     while (level_ptrs_[lvl] < files.size()) {
       FileMetaData* f = files[level_ptrs_[lvl]];
@@ -1534,6 +2385,18 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   return true;
 }
 
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end) {
+  if (output_level_ == 0) {
+    return false;
+  }
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
+    if (input_version_->OverlapInLevel(lvl, &begin, &end)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool Compaction::ShouldStopBefore(const Slice& internal_key) {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
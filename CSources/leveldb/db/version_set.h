@@ -15,6 +15,7 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_SET_H_
 #define STORAGE_LEVELDB_DB_VERSION_SET_H_
 
+#include <deque>
 #include <map>
 #include <set>
 #include <vector>
@@ -30,6 +31,7 @@ namespace log {
 class Writer;
 }
 
+class BlobFileCache;
 class Compaction;
 class Iterator;
 class MemTable;
@@ -72,8 +74,24 @@ class Version {
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
   void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
+  // Append to *iters iterators over the range deletions of all files of
+  // this Version that have any.
+  void AddRangeTombstoneIterators(std::vector<Iterator*>* iters);
+
+  // Values stored in blob files are read through the blob file cache.
+  // Merge operands for key found above its value or deletion are appended
+  // to *merge_operands, newest first.  Entries older than
+  // *max_covering_tombstone_seq, which is raised by the range deletions
+  // found on the way, are treated as deleted.
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-             GetStats* stats);
+             GetStats* stats, std::vector<std::string>* merge_operands,
+             SequenceNumber* max_covering_tombstone_seq);
+
+  // Load the table blocks that subsequent Get() calls for the internal
+  // keys in "keys" may need into the block cache.  Reads are batched per
+  // table file.
+  // REQUIRES: lock is not held
+  void PrefetchForGet(const ReadOptions&, const std::vector<Slice>& keys);
 
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
@@ -109,8 +127,25 @@ class Version {
   int PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                  const Slice& largest_user_key);
 
+  // Return the level at which we should place an ingested file that covers
+  // the range [smallest_user_key,largest_user_key]: the deepest level such
+  // that neither it nor any level above it overlaps the range.
+  int PickLevelForIngestedFile(const Slice& smallest_user_key,
+                               const Slice& largest_user_key);
+
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // Returns true iff the tables no longer refer to enough of blob file
+  // "number" for its remaining blobs to be moved to a new one, see
+  // Options::blob_garbage_collection_threshold.
+  bool NeedsBlobGarbageCollection(uint64_t number) const;
+
+  // Return the files of the specified level, sorted by smallest key for
+  // levels > 0.
+  const std::vector<FileMetaData*>& files(int level) const {
+    return files_[level];
+  }
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -128,7 +163,13 @@ class Version {
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1),
+        base_level_(1),
+        oldest_file_timestamp_(0),
+        blob_file_to_compact_(nullptr),
+        blob_file_to_compact_level_(-1),
+        deletion_file_to_compact_(nullptr),
+        deletion_file_to_compact_level_(-1) {}
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
@@ -153,6 +194,9 @@ class Version {
   // List of files per level
   std::vector<FileMetaData*> files_[config::kNumLevels];
 
+  // Blob files referred to by the tables, by number
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
+
   // Next file to compact based on seek stats.
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
@@ -162,12 +206,33 @@ class Version {
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Level that level-0 compactions write to, and the size limit of each
+  // level.  The levels between 0 and base_level_ are empty.  Initialized
+  // by Finalize().
+  int base_level_;
+  double max_bytes_for_level_[config::kNumLevels];
+
+  // Smallest non-zero FileMetaData::newest_timestamp of the files, or zero.
+  // Initialized by Finalize().
+  uint32_t oldest_file_timestamp_;
+
+  // Next file to compact so that it no longer refers to a blob file that
+  // NeedsBlobGarbageCollection().  Initialized by Finalize().
+  FileMetaData* blob_file_to_compact_;
+  int blob_file_to_compact_level_;
+
+  // Table with the largest fraction of deletions above
+  // Options::deletion_compaction_ratio.  Initialized by Finalize().
+  FileMetaData* deletion_file_to_compact_;
+  int deletion_file_to_compact_level_;
 };
 
 class VersionSet {
  public:
   VersionSet(const std::string& dbname, const Options* options,
-             TableCache* table_cache, const InternalKeyComparator*);
+             TableCache* table_cache, BlobFileCache* blob_cache,
+             const InternalKeyComparator*);
   VersionSet(const VersionSet&) = delete;
   VersionSet& operator=(const VersionSet&) = delete;
 
@@ -176,8 +241,9 @@ class VersionSet {
   // Apply *edit to the current version to form a new descriptor that
   // is both saved to persistent state and installed as the new
   // current version.  Will release *mu while actually writing to the file.
+  // Edits from concurrent callers are written together with a single sync
+  // and applied in the order in which the calls were made.
   // REQUIRES: *mu is held on entry.
-  // REQUIRES: no other thread concurrently calls LogAndApply()
   Status LogAndApply(VersionEdit* edit, port::Mutex* mu)
       EXCLUSIVE_LOCKS_REQUIRED(mu);
 
@@ -187,6 +253,9 @@ class VersionSet {
   // Return the current version.
   Version* current() const { return current_; }
 
+  const InternalKeyComparator* internal_comparator() const { return &icmp_; }
+  TableCache* table_cache() const { return table_cache_; }
+
   // Return the current manifest file number
   uint64_t ManifestFileNumber() const { return manifest_file_number_; }
 
@@ -251,9 +320,22 @@ class VersionSet {
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
+    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr) ||
+           (v->blob_file_to_compact_ != nullptr) ||
+           (v->deletion_file_to_compact_ != nullptr);
   }
 
+  // Returns true iff some file holds only values written before "cutoff",
+  // see Options::ttl_seconds.
+  bool HasExpiredFiles(uint32_t cutoff) const {
+    const uint32_t oldest = current_->oldest_file_timestamp_;
+    return oldest != 0 && oldest < cutoff;
+  }
+
+  // Add the removal of every file holding only values written before
+  // "cutoff" to *edit.  Returns the number of files removed.
+  int RemoveExpiredFiles(uint32_t cutoff, VersionEdit* edit);
+
   // Add all files listed in any live version to *live.
   // May also mutate some internal state.
   void AddLiveFiles(std::set<uint64_t>* live);
@@ -269,8 +351,13 @@ class VersionSet {
   };
   const char* LevelSummary(LevelSummaryStorage* scratch) const;
 
+  // Append a line for each of the "n" tables with the largest fraction of
+  // deletions to *result, largest first.
+  void AppendTablesByDeletionRatio(int n, std::string* result) const;
+
  private:
   class Builder;
+  struct ManifestWriter;
 
   friend class Compaction;
   friend class Version;
@@ -279,6 +366,21 @@ class VersionSet {
 
   void Finalize(Version* v);
 
+  // Return the file of "level" that overlaps the fewest bytes in the next
+  // level for its own size.
+  // REQUIRES: level > 0 and level has files
+  FileMetaData* PickMinOverlappingRatioFile(int level);
+
+  // Compute v->base_level_ and the size limits of the levels of "v".
+  void ComputeLevelTargets(Version* v);
+
+  // Compute the compaction score of "v" for kTieredCompaction.
+  void FinalizeTiered(Version* v);
+
+  // Pick the sorted runs to merge for kTieredCompaction.  Returns nullptr
+  // if there is no compaction to be done.
+  Compaction* PickTieredCompaction();
+
   void GetRange(const std::vector<FileMetaData*>& inputs, InternalKey* smallest,
                 InternalKey* largest);
 
@@ -288,8 +390,12 @@ class VersionSet {
 
   void SetupOtherInputs(Compaction* c);
 
-  // Save current contents to *log
-  Status WriteSnapshot(log::Writer* log);
+  // Save current contents as a single MANIFEST record into *record
+  void EncodeSnapshot(std::string* record);
+
+  // Returns true if the MANIFEST has accumulated enough edits since its
+  // snapshot that it should be replaced by a new one.
+  bool ShouldRollManifest() const;
 
   void AppendVersion(Version* v);
 
@@ -297,6 +403,7 @@ class VersionSet {
   const std::string dbname_;
   const Options* const options_;
   TableCache* const table_cache_;
+  BlobFileCache* const blob_cache_;
   const InternalKeyComparator icmp_;
   uint64_t next_file_number_;
   uint64_t manifest_file_number_;
@@ -307,6 +414,11 @@ class VersionSet {
   // Opened lazily
   WritableFile* descriptor_file_;
   log::Writer* descriptor_log_;
+  uint64_t descriptor_size_;   // Bytes of records in descriptor_log_
+  uint64_t descriptor_edits_;  // Edits appended after the snapshot
+
+  // Queue of LogAndApply() callers; the front one is writing the MANIFEST.
+  std::deque<ManifestWriter*> manifest_writers_;
   Version dummy_versions_;  // Head of circular doubly-linked list of versions.
   Version* current_;        // == dummy_versions_.prev_
 
@@ -321,9 +433,17 @@ class Compaction {
   ~Compaction();
 
   // Return the level that is being compacted.  Inputs from "level"
-  // and "level+1" will be merged to produce a set of "level+1" files.
+  // and "output_level" will be merged to produce a set of "output_level"
+  // files.
   int level() const { return level_; }
 
+  // Return the level that the compaction writes to.  This is "level+1"
+  // except for compactions of level-0 that skip empty levels with
+  // Options::level_compaction_dynamic_level_bytes, and for merges of
+  // sorted runs by kTieredCompaction, which write to level 0 or to the
+  // last level.
+  int output_level() const { return output_level_; }
+
   // Return the object that holds the edits to the descriptor done
   // by this compaction.
   VersionEdit* edit() { return &edit_; }
@@ -331,7 +451,8 @@ class Compaction {
   // "which" must be either 0 or 1
   int num_input_files(int which) const { return inputs_[which].size(); }
 
-  // Return the ith input file at "level()+which" ("which" must be 0 or 1).
+  // Return the ith input file at "level()" if "which" is 0, or at
+  // "output_level()" if "which" is 1.
   FileMetaData* input(int which, int i) const { return inputs_[which][i]; }
 
   // Maximum size of files to build during this compaction.
@@ -341,14 +462,30 @@ class Compaction {
   // moving a single input file to the next level (no merging or splitting)
   bool IsTrivialMove() const;
 
+  // Returns true iff the blobs of blob file "number" that the inputs refer
+  // to should be moved to a new blob file.
+  bool ShouldRelocateBlobs(uint64_t number) const {
+    return input_version_->NeedsBlobGarbageCollection(number);
+  }
+
   // Add all inputs to this compaction as delete operations to *edit.
   void AddInputDeletions(VersionEdit* edit);
 
   // Returns true if the information we have available guarantees that
-  // the compaction is producing data in "level+1" for which no data exists
-  // in levels greater than "level+1".
+  // the compaction is producing data in "output_level" for which no data
+  // exists in levels greater than "output_level", nor in the older
+  // level-0 files when writing to level 0.
   bool IsBaseLevelForKey(const Slice& user_key);
 
+  // Returns true if no file in levels greater than "output_level" overlaps
+  // the user key range [begin, end].
+  bool IsBaseLevelForRange(const Slice& begin, const Slice& end);
+
+  // Remove the ith input file at "output_level" from the files to merge, for
+  // a file whose entries are all known to be deleted.  The file is still
+  // deleted by AddInputDeletions().
+  void DropInput(int i);
+
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
   bool ShouldStopBefore(const Slice& internal_key);
@@ -364,12 +501,16 @@ class Compaction {
   Compaction(const Options* options, int level);
 
   int level_;
+  int output_level_;
   uint64_t max_output_file_size_;
   Version* input_version_;
   VersionEdit edit_;
+  bool collects_blob_garbage_;  // Picked for blob garbage collection
+  bool collects_deletions_;     // Picked for its fraction of deletions
 
-  // Each compaction reads inputs from "level_" and "level_+1"
+  // Each compaction reads inputs from "level_" and "output_level_"
   std::vector<FileMetaData*> inputs_[2];  // The two sets of inputs
+  std::vector<FileMetaData*> dropped_inputs_;  // See DropInput()
 
   // State used to check for number of overlapping grandparent files
   // (parent == level_ + 1, grandparent == level_ + 2)
@@ -384,7 +525,7 @@ class Compaction {
   // level_ptrs_ holds indices into input_version_->levels_: our state
   // is that we are positioned at one of the file ranges for each
   // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
+  // all L > output_level_).
   size_t level_ptrs_[config::kNumLevels];
 };
 
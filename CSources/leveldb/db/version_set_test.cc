@@ -0,0 +1,183 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/version_set.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "db/blob_file_cache.h"
+#include "db/filename.h"
+#include "db/table_cache.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/mutexlock.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+namespace {
+
+// Counts the syncs of MANIFEST files and makes each of them slow, so that
+// concurrent LogAndApply() calls queue up behind it.
+class SlowManifestSyncEnv : public EnvWrapper {
+ public:
+  explicit SlowManifestSyncEnv(Env* base) : EnvWrapper(base), syncs_(0) {}
+
+  Status NewWritableFile(const std::string& f, WritableFile** r) override {
+    Status s = target()->NewWritableFile(f, r);
+    if (s.ok() && f.find("MANIFEST") != std::string::npos) {
+      *r = new SlowSyncFile(*r, this);
+    }
+    return s;
+  }
+
+  int syncs() const { return syncs_.load(); }
+
+ private:
+  class SlowSyncFile : public WritableFile {
+   public:
+    SlowSyncFile(WritableFile* target, SlowManifestSyncEnv* env)
+        : target_(target), env_(env) {}
+    ~SlowSyncFile() override { delete target_; }
+
+    Status Append(const Slice& data) override { return target_->Append(data); }
+    Status Close() override { return target_->Close(); }
+    Status Flush() override { return target_->Flush(); }
+    Status Sync() override {
+      env_->syncs_.fetch_add(1);
+      env_->SleepForMicroseconds(1000);
+      return target_->Sync();
+    }
+
+   private:
+    WritableFile* const target_;
+    SlowManifestSyncEnv* const env_;
+  };
+
+  std::atomic<int> syncs_;
+};
+
+}  // namespace
+
+class VersionSetTest : public testing::Test {
+ public:
+  VersionSetTest() : icmp_(BytewiseComparator()) {
+    dbname_ = testing::TempDir() + "version_set_test";
+    options_.env = Env::Default();
+    options_.create_if_missing = true;
+    DestroyDB(dbname_, options_);
+
+    // Let DB::Open() create the initial CURRENT and MANIFEST files.
+    DB* db;
+    EXPECT_LEVELDB_OK(DB::Open(options_, dbname_, &db));
+    delete db;
+  }
+
+  ~VersionSetTest() { DestroyDB(dbname_, options_); }
+
+  // Open a VersionSet on the database and recover its current version.
+  // REQUIRES: No VersionSet returned earlier is still open.
+  VersionSet* OpenVersionSet() {
+    table_cache_.reset(new TableCache(dbname_, options_, 100));
+    blob_cache_.reset(new BlobFileCache(dbname_, options_, 100));
+    VersionSet* versions = new VersionSet(
+        dbname_, &options_, table_cache_.get(), blob_cache_.get(), &icmp_);
+    bool save_manifest;
+    EXPECT_LEVELDB_OK(versions->Recover(&save_manifest));
+    return versions;
+  }
+
+  // Add a level-0 file holding the single key "k<number>" and return its
+  // number.
+  static uint64_t AddFile(VersionSet* versions, VersionEdit* edit) {
+    const uint64_t number = versions->NewFileNumber();
+    const std::string key = "k" + std::to_string(number);
+    edit->AddFile(0, number, 100, InternalKey(key, number, kTypeValue),
+                  InternalKey(key, number, kTypeValue));
+    return number;
+  }
+
+  std::string dbname_;
+  Options options_;
+  InternalKeyComparator icmp_;
+  std::unique_ptr<TableCache> table_cache_;
+  std::unique_ptr<BlobFileCache> blob_cache_;
+  port::Mutex mu_;
+};
+
+TEST_F(VersionSetTest, ManifestRollover) {
+  options_.max_manifest_file_size = 4096;
+  std::unique_ptr<VersionSet> versions(OpenVersionSet());
+  const uint64_t first_manifest = versions->ManifestFileNumber();
+
+  // Each edit adds a file and deletes the one added before, unless that is
+  // one of every ten files that are kept.  The edits fill the MANIFEST
+  // several times over.
+  uint64_t previous = 0;
+  for (int i = 0; i < 500; i++) {
+    MutexLock l(&mu_);
+    VersionEdit edit;
+    const uint64_t number = AddFile(versions.get(), &edit);
+    if (i % 10 != 1 && i > 0) {
+      edit.RemoveFile(0, previous);
+    }
+    previous = number;
+    ASSERT_LEVELDB_OK(versions->LogAndApply(&edit, &mu_));
+  }
+  ASSERT_EQ(51, versions->NumLevelFiles(0));
+  ASSERT_NE(first_manifest, versions->ManifestFileNumber());
+
+  // The current MANIFEST starts with a snapshot and holds the edits since.
+  uint64_t manifest_size;
+  ASSERT_LEVELDB_OK(options_.env->GetFileSize(
+      DescriptorFileName(dbname_, versions->ManifestFileNumber()),
+      &manifest_size));
+  ASSERT_LT(manifest_size, 2 * options_.max_manifest_file_size);
+
+  const std::string expected = versions->current()->DebugString();
+  versions.reset();
+  versions.reset(OpenVersionSet());
+  ASSERT_EQ(expected, versions->current()->DebugString());
+}
+
+TEST_F(VersionSetTest, ConcurrentLogAndApplyShareSyncs) {
+  SlowManifestSyncEnv env(Env::Default());
+  options_.env = &env;
+  std::unique_ptr<VersionSet> versions(OpenVersionSet());
+
+  const int kThreads = 8;
+  const int kEditsPerThread = 50;
+  const int syncs_before = env.syncs();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < kEditsPerThread; i++) {
+        MutexLock l(&mu_);
+        VersionEdit edit;
+        AddFile(versions.get(), &edit);
+        ASSERT_LEVELDB_OK(versions->LogAndApply(&edit, &mu_));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(kThreads * kEditsPerThread, versions->NumLevelFiles(0));
+  ASSERT_LT(env.syncs() - syncs_before, kThreads * kEditsPerThread / 2);
+
+  const std::string expected = versions->current()->DebugString();
+  versions.reset();
+  versions.reset(OpenVersionSet());
+  ASSERT_EQ(expected, versions->current()->DebugString());
+  versions.reset();
+  options_.env = Env::Default();
+}
+
+}  // namespace leveldb
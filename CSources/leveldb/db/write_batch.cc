@@ -8,7 +8,9 @@
 //    data: record[count]
 // record :=
 //    kTypeValue varstring varstring         |
-//    kTypeDeletion varstring
+//    kTypeDeletion varstring                |
+//    kTypeMerge varstring varstring         |
+//    kTypeRangeDeletion varstring varstring
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
@@ -32,6 +34,15 @@ WriteBatch::~WriteBatch() = default;
 
 WriteBatch::Handler::~Handler() = default;
 
+void WriteBatch::Handler::Merge(const Slice& key, const Slice& value) {
+  unsupported_ = "Merge";
+}
+
+void WriteBatch::Handler::DeleteRange(const Slice& begin_key,
+                                      const Slice& end_key) {
+  unsupported_ = "DeleteRange";
+}
+
 void WriteBatch::Clear() {
   rep_.clear();
   rep_.resize(kHeader);
@@ -48,6 +59,7 @@ Status WriteBatch::Iterate(Handler* handler) const {
   input.remove_prefix(kHeader);
   Slice key, value;
   int found = 0;
+  handler->unsupported_ = nullptr;
   while (!input.empty()) {
     found++;
     char tag = input[0];
@@ -68,9 +80,29 @@ Status WriteBatch::Iterate(Handler* handler) const {
           return Status::Corruption("bad WriteBatch Delete");
         }
         break;
+      case kTypeMerge:
+        if (GetLengthPrefixedSlice(&input, &key) &&
+            GetLengthPrefixedSlice(&input, &value)) {
+          handler->Merge(key, value);
+        } else {
+          return Status::Corruption("bad WriteBatch Merge");
+        }
+        break;
+      case kTypeRangeDeletion:
+        if (GetLengthPrefixedSlice(&input, &key) &&
+            GetLengthPrefixedSlice(&input, &value)) {
+          handler->DeleteRange(key, value);
+        } else {
+          return Status::Corruption("bad WriteBatch DeleteRange");
+        }
+        break;
       default:
         return Status::Corruption("unknown WriteBatch tag");
     }
+    if (handler->unsupported_ != nullptr) {
+      return Status::NotSupported("WriteBatch::Handler does not implement",
+                                  handler->unsupported_);
+    }
   }
   if (found != WriteBatchInternal::Count(this)) {
     return Status::Corruption("WriteBatch has wrong count");
@@ -108,6 +140,20 @@ void WriteBatch::Delete(const Slice& key) {
   PutLengthPrefixedSlice(&rep_, key);
 }
 
+void WriteBatch::Merge(const Slice& key, const Slice& value) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeMerge));
+  PutLengthPrefixedSlice(&rep_, key);
+  PutLengthPrefixedSlice(&rep_, value);
+}
+
+void WriteBatch::DeleteRange(const Slice& begin_key, const Slice& end_key) {
+  WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+  rep_.push_back(static_cast<char>(kTypeRangeDeletion));
+  PutLengthPrefixedSlice(&rep_, begin_key);
+  PutLengthPrefixedSlice(&rep_, end_key);
+}
+
 void WriteBatch::Append(const WriteBatch& source) {
   WriteBatchInternal::Append(this, &source);
 }
@@ -126,6 +172,14 @@ class MemTableInserter : public WriteBatch::Handler {
     mem_->Add(sequence_, kTypeDeletion, key, Slice());
     sequence_++;
   }
+  void Merge(const Slice& key, const Slice& value) override {
+    mem_->Add(sequence_, kTypeMerge, key, value);
+    sequence_++;
+  }
+  void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+    mem_->Add(sequence_, kTypeRangeDeletion, begin_key, end_key);
+    sequence_++;
+  }
 };
 }  // namespace
 
@@ -147,4 +201,35 @@ void WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src) {
   dst->rep_.append(src->rep_.data() + kHeader, src->rep_.size() - kHeader);
 }
 
+namespace {
+class TimestampAppender : public WriteBatch::Handler {
+ public:
+  WriteBatch* dst_;
+  uint32_t timestamp_;
+  std::string value_;
+
+  void Put(const Slice& key, const Slice& value) override {
+    value_.assign(value.data(), value.size());
+    PutFixed32(&value_, timestamp_);
+    dst_->Put(key, value_);
+  }
+  void Delete(const Slice& key) override { dst_->Delete(key); }
+  void Merge(const Slice& key, const Slice& value) override {
+    dst_->Merge(key, value);
+  }
+  void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+    dst_->DeleteRange(begin_key, end_key);
+  }
+};
+}  // namespace
+
+Status WriteBatchInternal::AppendWithTimestamps(WriteBatch* dst,
+                                                const WriteBatch* src,
+                                                uint32_t timestamp) {
+  TimestampAppender appender;
+  appender.dst_ = dst;
+  appender.timestamp_ = timestamp;
+  return src->Iterate(&appender);
+}
+
 }  // namespace leveldb
@@ -38,6 +38,11 @@ class WriteBatchInternal {
   static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
 
   static void Append(WriteBatch* dst, const WriteBatch* src);
+
+  // Append the updates of "src" to "dst", storing "timestamp" with each
+  // value as described for kValueTimestampSize.
+  static Status AppendWithTimestamps(WriteBatch* dst, const WriteBatch* src,
+                                     uint32_t timestamp);
 };
 
 }  // namespace leveldb
@@ -0,0 +1,85 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/write_batch.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+namespace {
+
+// Records the puts and deletions it is handed, and nothing else.
+class PutDeleteRecorder : public WriteBatch::Handler {
+ public:
+  void Put(const Slice& key, const Slice& value) override {
+    entries_ += "Put(" + key.ToString() + ", " + value.ToString() + ")";
+  }
+  void Delete(const Slice& key) override {
+    entries_ += "Delete(" + key.ToString() + ")";
+  }
+
+  std::string entries_;
+};
+
+// Records every type of entry.
+class EntryRecorder : public PutDeleteRecorder {
+ public:
+  void Merge(const Slice& key, const Slice& value) override {
+    entries_ += "Merge(" + key.ToString() + ", " + value.ToString() + ")";
+  }
+  void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+    entries_ +=
+        "DeleteRange(" + begin_key.ToString() + ", " + end_key.ToString() + ")";
+  }
+};
+
+}  // namespace
+
+TEST(WriteBatchTest, IterateAllEntries) {
+  WriteBatch batch;
+  batch.Put("a", "va");
+  batch.Merge("b", "vb");
+  batch.DeleteRange("c", "d");
+  batch.Delete("e");
+  EntryRecorder recorder;
+  ASSERT_LEVELDB_OK(batch.Iterate(&recorder));
+  ASSERT_EQ("Put(a, va)Merge(b, vb)DeleteRange(c, d)Delete(e)",
+            recorder.entries_);
+}
+
+TEST(WriteBatchTest, HandlerWithoutMerge) {
+  WriteBatch batch;
+  batch.Put("a", "va");
+  batch.Merge("b", "vb");
+  batch.Put("c", "vc");
+  PutDeleteRecorder recorder;
+  Status s = batch.Iterate(&recorder);
+  ASSERT_TRUE(s.IsNotSupportedError()) << s.ToString();
+  ASSERT_NE(std::string::npos, s.ToString().find("Merge"));
+  ASSERT_EQ("Put(a, va)", recorder.entries_);
+
+  // The handler is fine for batches without merge operands.
+  batch.Clear();
+  batch.Delete("a");
+  recorder.entries_.clear();
+  ASSERT_LEVELDB_OK(batch.Iterate(&recorder));
+  ASSERT_EQ("Delete(a)", recorder.entries_);
+}
+
+TEST(WriteBatchTest, HandlerWithoutDeleteRange) {
+  WriteBatch batch;
+  batch.DeleteRange("a", "b");
+  batch.Put("c", "vc");
+  PutDeleteRecorder recorder;
+  Status s = batch.Iterate(&recorder);
+  ASSERT_TRUE(s.IsNotSupportedError()) << s.ToString();
+  ASSERT_NE(std::string::npos, s.ToString().find("DeleteRange"));
+  ASSERT_EQ("", recorder.entries_);
+}
+
+}  // namespace leveldb
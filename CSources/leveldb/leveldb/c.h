@@ -62,6 +62,7 @@ typedef struct leveldb_iterator_t leveldb_iterator_t;
 typedef struct leveldb_logger_t leveldb_logger_t;
 typedef struct leveldb_options_t leveldb_options_t;
 typedef struct leveldb_randomfile_t leveldb_randomfile_t;
+typedef struct leveldb_ratelimiter_t leveldb_ratelimiter_t;
 typedef struct leveldb_readoptions_t leveldb_readoptions_t;
 typedef struct leveldb_seqfile_t leveldb_seqfile_t;
 typedef struct leveldb_snapshot_t leveldb_snapshot_t;
@@ -184,15 +185,50 @@ LEVELDB_EXPORT void leveldb_options_set_write_buffer_size(leveldb_options_t*,
 LEVELDB_EXPORT void leveldb_options_set_max_open_files(leveldb_options_t*, int);
 LEVELDB_EXPORT void leveldb_options_set_cache(leveldb_options_t*,
                                               leveldb_cache_t*);
+LEVELDB_EXPORT void leveldb_options_set_rate_limiter(leveldb_options_t*,
+                                                     leveldb_ratelimiter_t*);
 LEVELDB_EXPORT void leveldb_options_set_block_size(leveldb_options_t*, size_t);
 LEVELDB_EXPORT void leveldb_options_set_block_restart_interval(
     leveldb_options_t*, int);
 LEVELDB_EXPORT void leveldb_options_set_max_file_size(leveldb_options_t*,
                                                       size_t);
-
-enum { leveldb_no_compression = 0, leveldb_snappy_compression = 1 };
+LEVELDB_EXPORT void leveldb_options_set_max_manifest_file_size(
+    leveldb_options_t*, size_t);
+
+enum {
+  leveldb_no_compression = 0,
+  leveldb_snappy_compression = 1,
+  leveldb_zlib_compression = 2
+};
 LEVELDB_EXPORT void leveldb_options_set_compression(leveldb_options_t*, int);
 
+enum { leveldb_crc32c_checksum = 0, leveldb_xxh3_checksum = 1 };
+LEVELDB_EXPORT void leveldb_options_set_checksum_type(leveldb_options_t*, int);
+LEVELDB_EXPORT void leveldb_options_set_wal_compression(leveldb_options_t*,
+                                                       int);
+LEVELDB_EXPORT void leveldb_options_set_avoid_flush_during_recovery(
+    leveldb_options_t*, uint8_t);
+LEVELDB_EXPORT void leveldb_options_set_recycle_log_file_num(
+    leveldb_options_t*, size_t);
+LEVELDB_EXPORT void leveldb_options_set_bytes_per_sync(leveldb_options_t*,
+                                                      size_t);
+LEVELDB_EXPORT void leveldb_options_set_preload_tables_on_open(
+    leveldb_options_t*, uint8_t);
+LEVELDB_EXPORT void leveldb_options_set_preload_table_threads(
+    leveldb_options_t*, int);
+
+LEVELDB_EXPORT void leveldb_options_set_max_write_group_bytes(
+    leveldb_options_t*, size_t);
+LEVELDB_EXPORT void leveldb_options_set_sync_write_group_wait_micros(
+    leveldb_options_t*, uint64_t);
+
+LEVELDB_EXPORT void leveldb_options_set_compaction_readahead_size(
+    leveldb_options_t*, size_t);
+LEVELDB_EXPORT void leveldb_options_set_use_direct_reads(leveldb_options_t*,
+                                                         uint8_t);
+LEVELDB_EXPORT void leveldb_options_set_use_direct_io_for_flush_and_compaction(
+    leveldb_options_t*, uint8_t);
+
 /* Comparator */
 
 LEVELDB_EXPORT leveldb_comparator_t* leveldb_comparator_create(
@@ -227,6 +263,8 @@ LEVELDB_EXPORT void leveldb_readoptions_set_fill_cache(leveldb_readoptions_t*,
                                                        uint8_t);
 LEVELDB_EXPORT void leveldb_readoptions_set_snapshot(leveldb_readoptions_t*,
                                                      const leveldb_snapshot_t*);
+LEVELDB_EXPORT void leveldb_readoptions_set_readahead_size(
+    leveldb_readoptions_t*, size_t);
 
 /* Write options */
 
@@ -240,6 +278,14 @@ LEVELDB_EXPORT void leveldb_writeoptions_set_sync(leveldb_writeoptions_t*,
 LEVELDB_EXPORT leveldb_cache_t* leveldb_cache_create_lru(size_t capacity);
 LEVELDB_EXPORT void leveldb_cache_destroy(leveldb_cache_t* cache);
 
+/* Rate limiter */
+
+LEVELDB_EXPORT leveldb_ratelimiter_t* leveldb_ratelimiter_create_generic(
+    int64_t bytes_per_second, uint8_t auto_tuned);
+LEVELDB_EXPORT void leveldb_ratelimiter_destroy(leveldb_ratelimiter_t*);
+LEVELDB_EXPORT uint64_t
+leveldb_ratelimiter_get_total_throttled_micros(leveldb_ratelimiter_t*);
+
 /* Env */
 
 LEVELDB_EXPORT leveldb_env_t* leveldb_create_default_env(void);
@@ -0,0 +1,59 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A CompactionFilter lets an application drop or rewrite entries while
+// compactions copy them, for example to expire old records without
+// scanning the database and deleting them.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+
+#include <string>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Slice;
+
+class LEVELDB_EXPORT CompactionFilter {
+ public:
+  enum Decision {
+    kKeep,         // Leave the entry as it is
+    kRemove,       // Delete the key
+    kChangeValue,  // Replace the value by "*new_value"
+  };
+
+  struct Context {
+    // Level the compaction writes its output to.
+    int output_level;
+
+    // True if no level below the output level has entries for the key,
+    // so that removing the key does not leave a deletion marker behind.
+    bool is_bottommost_level;
+
+    // False if a snapshot reads the entry.  The decision is ignored then,
+    // since changing the entry would change the result of reads from the
+    // snapshot.  A later compaction offers the entry again.  Snapshots
+    // taken while the compaction runs are not taken into account.
+    bool snapshot_safe;
+  };
+
+  virtual ~CompactionFilter();
+
+  // The name of the compaction filter.  Used for logging.
+  virtual const char* Name() const = 0;
+
+  // Called for the entries of the compaction that set a value and are not
+  // hidden by a newer entry for the same key.  Deletions and merge operands
+  // are not offered.
+  //
+  // Called by the background compaction thread only, one entry at a time.
+  virtual Decision Filter(const Context& context, const Slice& key,
+                          const Slice& value, std::string* new_value) const = 0;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
@@ -7,6 +7,8 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
@@ -72,11 +74,64 @@ class LEVELDB_EXPORT DB {
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Record "value" as a merge operand for "key" without reading "key".
+  // Reads of "key" combine it with the existing value using
+  // Options::merge_operator.  Returns InvalidArgument if the database has
+  // no merge operator, OK on success, and a non-OK status on error.
+  // Note: consider setting options.sync = true.
+  virtual Status Merge(const WriteOptions& options, const Slice& key,
+                       const Slice& value);
+
+  // Remove the database entries (if any) for the keys in the range
+  // ["begin_key", "end_key").  Returns OK on success, and a non-OK status
+  // on error.  It is not an error if no key in the range exists.
+  // Deleting a range costs about as much as deleting a single key; the
+  // space used by the deleted entries is reclaimed by later compactions.
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options,
+                             const Slice& begin_key, const Slice& end_key);
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
   virtual Status Write(const WriteOptions& options, WriteBatch* updates) = 0;
 
+  // Called by WriteAsync() with the outcome of the write.
+  typedef void (*WriteCallback)(void* arg, const Status& status);
+
+  // Queue the specified updates for writing and return without waiting for
+  // them to be logged and applied.  Then call (*callback)(arg, status) with
+  // the status Write() would have returned.  "updates" may be reused as
+  // soon as this returns.
+  //
+  // The writes are committed in the order of the calls by a background
+  // thread, grouped with concurrent Write() calls.  The callback is called
+  // without any locks held, on that thread or on a thread inside a Write()
+  // call, and must not call Write() or WriteAsync() itself.  Deleting the
+  // DB commits the writes still queued and calls their callbacks first.
+  //
+  // If options.max_pending_async_writes writes are queued already, this
+  // waits until one of them has been committed.
+  //
+  // The default implementation calls Write() and then the callback.
+  virtual void WriteAsync(const WriteOptions& options, WriteBatch* updates,
+                          WriteCallback callback, void* arg);
+
+  // Add the table files named by "paths", created with SstFileWriter (see
+  // leveldb/sst_file_writer.h), to the database.  The entries of the files
+  // behave as if they were written by a single Write() call that happened
+  // now: they hide older entries for the same keys and are hidden from
+  // snapshots taken before.  The key ranges of the files must not overlap.
+  // Either all files are added or, on error, none of them.
+  //
+  // Each file is placed at the deepest level that keeps its entries above
+  // the older entries for the same keys, so a bulk load of data that does
+  // not overlap the database does not need to be compacted.
+  //
+  // The default implementation returns a NotSupported status.
+  virtual Status IngestExternalFiles(const IngestOptions& options,
+                                     const std::vector<std::string>& paths);
+
   // If the database contains an entry for "key" store the
   // corresponding value in *value and return OK.
   //
@@ -87,6 +142,17 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options, const Slice& key,
                      std::string* value) = 0;
 
+  // For each i in [0,keys.size()-1], look up keys[i] like Get() does and
+  // store its value in (*values)[i].  Returns the status of each lookup,
+  // in the same order as "keys".  All lookups observe the same state of
+  // the DB.
+  //
+  // Implementations may batch the disk reads needed by the individual
+  // lookups, which can make this faster than a Get() call per key.
+  virtual std::vector<Status> MultiGet(const ReadOptions& options,
+                                       const std::vector<Slice>& keys,
+                                       std::vector<std::string>* values);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -121,6 +187,10 @@ class LEVELDB_EXPORT DB {
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.tables-by-deletion-ratio" - returns a line for each of the ten
+  //     sstables with the largest fraction of deleted entries, largest first.
+  //     Only lists sstables written while options.deletion_compaction_ratio
+  //     was set.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
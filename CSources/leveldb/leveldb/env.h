@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "leveldb/export.h"
+#include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 // This workaround can be removed when leveldb::Env::DeleteFile is removed.
@@ -45,7 +46,6 @@ class FileLock;
 class Logger;
 class RandomAccessFile;
 class SequentialFile;
-class Slice;
 class WritableFile;
 
 class LEVELDB_EXPORT Env {
@@ -95,6 +95,36 @@ class LEVELDB_EXPORT Env {
   virtual Status NewWritableFile(const std::string& fname,
                                  WritableFile** result) = 0;
 
+  // Like NewRandomAccessFile(), but reads of the returned file bypass the
+  // operating system's page cache where the platform supports it (O_DIRECT
+  // on Linux, F_NOCACHE on macOS and iOS).  Used for table files when
+  // Options::use_direct_reads is set.
+  //
+  // The default implementation calls NewRandomAccessFile().
+  virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result);
+
+  // Like NewWritableFile(), but writes to the returned file bypass the
+  // operating system's page cache where the platform supports it.  Used for
+  // table files written by memtable flushes and compactions when
+  // Options::use_direct_io_for_flush_and_compaction is set.
+  //
+  // The default implementation calls NewWritableFile().
+  virtual Status NewDirectWritableFile(const std::string& fname,
+                                       WritableFile** result);
+
+  // Rename the existing file "old_fname" to "fname" and open it for writing
+  // from its beginning, like NewWritableFile() does for a new file.  The old
+  // contents are overwritten as the file is written rather than discarded
+  // up front, so writes within the old size do not have to allocate space.
+  // Used to recycle log files when Options::recycle_log_file_num is set.
+  //
+  // The default implementation renames the file and calls
+  // NewWritableFile().
+  virtual Status ReuseWritableFile(const std::string& fname,
+                                   const std::string& old_fname,
+                                   WritableFile** result);
+
   // Create an object that either appends to an existing file, or
   // writes to a new file (if the file does not exist to begin with).
   // On success, stores a pointer to the new file in *result and
@@ -168,6 +198,11 @@ class LEVELDB_EXPORT Env {
   virtual Status RenameFile(const std::string& src,
                             const std::string& target) = 0;
 
+  // Create "target" as a hard link to the existing file "src".
+  //
+  // The default implementation returns a NotSupported status.
+  virtual Status LinkFile(const std::string& src, const std::string& target);
+
   // Lock the specified file.  Used to prevent concurrent access to
   // the same db by multiple processes.  On failure, stores nullptr in
   // *lock and returns non-OK.
@@ -248,6 +283,19 @@ class LEVELDB_EXPORT SequentialFile {
   virtual Status Skip(uint64_t n) = 0;
 };
 
+// A single read of a batch submitted with RandomAccessFile::MultiRead().
+struct LEVELDB_EXPORT ReadRequest {
+  // Read up to "n" bytes starting at "offset" into "scratch[0..n-1]".
+  uint64_t offset = 0;
+  size_t n = 0;
+  char* scratch = nullptr;
+
+  // Set by MultiRead() with the same meaning as the "*result" argument
+  // and the returned status of RandomAccessFile::Read().
+  Slice result;
+  Status status;
+};
+
 // A file abstraction for randomly reading the contents of a file.
 class LEVELDB_EXPORT RandomAccessFile {
  public:
@@ -269,6 +317,16 @@ class LEVELDB_EXPORT RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       char* scratch) const = 0;
+
+  // Perform all reads described by "requests[0..n-1]".  Each request is
+  // handled as if by a call to Read() and receives its own result and
+  // status.  Implementations are free to merge, reorder or issue the
+  // reads concurrently.  Returns a non-OK status if any request failed.
+  //
+  // The default implementation calls Read() for each request in turn.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual Status MultiRead(ReadRequest* requests, size_t n) const;
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -287,6 +345,18 @@ class LEVELDB_EXPORT WritableFile {
   virtual Status Close() = 0;
   virtual Status Flush() = 0;
   virtual Status Sync() = 0;
+
+  // Start writing back "nbytes" bytes of data at "offset" that were already
+  // passed to Flush(), without waiting for them to reach durable storage
+  // where the platform allows it; otherwise the call waits for the
+  // write-back.  Used to spread out the I/O of a later Sync().  The default
+  // implementation does nothing.
+  virtual Status RangeSync(uint64_t offset, uint64_t nbytes);
+
+  // Reserve disk space for the file to grow to "size" bytes without
+  // changing its size, so that later appends and syncs do not have to
+  // allocate space.  Only a hint; the default implementation does nothing.
+  virtual Status Preallocate(uint64_t size);
 };
 
 // An interface for writing log messages.
@@ -352,6 +422,18 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   Status NewWritableFile(const std::string& f, WritableFile** r) override {
     return target_->NewWritableFile(f, r);
   }
+  Status NewDirectRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) override {
+    return target_->NewDirectRandomAccessFile(f, r);
+  }
+  Status NewDirectWritableFile(const std::string& f,
+                               WritableFile** r) override {
+    return target_->NewDirectWritableFile(f, r);
+  }
+  Status ReuseWritableFile(const std::string& f, const std::string& old_f,
+                           WritableFile** r) override {
+    return target_->ReuseWritableFile(f, old_f, r);
+  }
   Status NewAppendableFile(const std::string& f, WritableFile** r) override {
     return target_->NewAppendableFile(f, r);
   }
@@ -377,6 +459,9 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   Status RenameFile(const std::string& s, const std::string& t) override {
     return target_->RenameFile(s, t);
   }
+  Status LinkFile(const std::string& s, const std::string& t) override {
+    return target_->LinkFile(s, t);
+  }
   Status LockFile(const std::string& f, FileLock** l) override {
     return target_->LockFile(f, l);
   }
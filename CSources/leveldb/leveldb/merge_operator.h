@@ -0,0 +1,54 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MergeOperator turns read-modify-write updates, such as incrementing a
+// counter or appending to a list, into blind writes.  DB::Merge() and
+// WriteBatch::Merge() record a merge operand for a key without reading it.
+// Reads combine the operands with the value stored before them, and
+// compactions collapse them into a plain value once no snapshot needs the
+// individual operands anymore.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Slice;
+
+class LEVELDB_EXPORT MergeOperator {
+ public:
+  virtual ~MergeOperator();
+
+  // The name of the merge operator.  Used for logging.
+  virtual const char* Name() const = 0;
+
+  // Combine "*existing_value", or nothing if "existing_value" is null
+  // because "key" had no value or was deleted, with "operands", oldest
+  // first, and store the result in "*new_value".  Return false if the
+  // operands are malformed, in which case reads of "key" fail with a
+  // Corruption status.
+  virtual bool FullMerge(const Slice& key, const Slice* existing_value,
+                         const std::vector<Slice>& operands,
+                         std::string* new_value) const = 0;
+
+  // Combine two operands of "key", "left_operand" being the older one,
+  // into a single operand with the same effect and store it in
+  // "*new_operand".  Compactions use this when the value below the
+  // operands is not part of their inputs.  Return false if the operands
+  // can not be combined without the value.
+  //
+  // The default implementation returns false.
+  virtual bool PartialMerge(const Slice& key, const Slice& left_operand,
+                            const Slice& right_operand,
+                            std::string* new_operand) const;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
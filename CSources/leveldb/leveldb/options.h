@@ -6,16 +6,20 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <cstdint>
 
 #include "leveldb/export.h"
 
 namespace leveldb {
 
 class Cache;
+class CompactionFilter;
 class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class MergeOperator;
+class RateLimiter;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -26,7 +30,46 @@ enum CompressionType {
   // NOTE: do not change the values of existing entries, as these are
   // part of the persistent format on disk.
   kNoCompression = 0x0,
-  kSnappyCompression = 0x1
+  kSnappyCompression = 0x1,
+  kZlibCompression = 0x2
+};
+
+// Each block stored in a table file is followed by a checksum over the
+// block contents and its compression type.  The following enum describes
+// which algorithm is used to compute that checksum.
+enum ChecksumType {
+  // NOTE: do not change the values of existing entries, as these are
+  // part of the persistent format on disk.
+  kCRC32CChecksum = 0x0,
+  kXXH3Checksum = 0x1
+};
+
+// Which file of a level a compaction triggered by the size of the level
+// starts from.
+enum CompactionPriority {
+  // Cycle through the key space of the level, so that every file is
+  // compacted in turn.
+  kRoundRobin = 0x0,
+
+  // Pick the file that overlaps the fewest bytes in the next level for
+  // its own size.  Each compaction then rewrites as little of the next
+  // level as possible, which lowers the total write amplification.
+  kMinOverlappingRatio = 0x1
+};
+
+// How compactions organize the table files of a database.
+enum CompactionStyle {
+  // Keep each level at a fixed multiple of the size of the level above,
+  // merging a few files at a time into the next level.  Reads touch few
+  // files, but each value is rewritten once for every level.
+  kLeveledCompaction = 0x0,
+
+  // Keep the data in a small number of sorted runs: the level-0 files,
+  // newest first, followed by the last level.  Runs of similar size are
+  // merged into a single one, so each value is rewritten far less often,
+  // at the cost of more files to read and of extra space for overwritten
+  // and deleted entries.
+  kTieredCompaction = 0x1
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -81,6 +124,33 @@ struct LEVELDB_EXPORT Options {
   // the next time the database is opened.
   size_t write_buffer_size = 4 * 1024 * 1024;
 
+  // Concurrent writes are combined into groups that are logged as one
+  // record.  This is the maximum size of a group.  If the first write of a
+  // group is at most 1/8 of this, the group is limited to that write's size
+  // plus 1/8 of this, so that the small write is not slowed down too much.
+  // Values outside 64KB..64MB are clipped to that range when the DB is
+  // opened.
+  //
+  // Default: 1MB
+  size_t max_write_group_bytes = 1024 * 1024;
+
+  // If non-zero, a write with WriteOptions::sync set waits up to this many
+  // microseconds for more writers to join its group before it is logged, so
+  // that concurrent sync writes share a single sync of the log.  The wait
+  // is skipped while the previous sync group had only one sync writer, and
+  // ends early once the queue holds as many sync writers as that group had.
+  //
+  // Default: 0
+  uint64_t sync_write_group_wait_micros = 0;
+
+  // Maximum number of writes queued by DB::WriteAsync() that have not been
+  // committed yet.  Once reached, WriteAsync() waits until a queued write
+  // has been committed, which bounds the memory held by queued writes.
+  // Values below 1 are raised to 1 when the DB is opened.
+  //
+  // Default: 1000
+  int max_pending_async_writes = 1000;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
@@ -114,6 +184,13 @@ struct LEVELDB_EXPORT Options {
   // initially populating a large database.
   size_t max_file_size = 2 * 1024 * 1024;
 
+  // Once the MANIFEST file that records changes to the set of table files
+  // grows beyond this many bytes, leveldb starts a new one that holds just
+  // a snapshot of the current set.  Smaller values keep the time spent
+  // replaying the MANIFEST in DB::Open() short, at the cost of rewriting
+  // the snapshot more often.
+  size_t max_manifest_file_size = 4 * 1024 * 1024;
+
   // Compress blocks using the specified compression algorithm.  This
   // parameter can be changed dynamically.
   //
@@ -128,14 +205,226 @@ struct LEVELDB_EXPORT Options {
   // worth switching to kNoCompression.  Even if the input data is
   // incompressible, the kSnappyCompression implementation will
   // efficiently detect that and will switch to uncompressed mode.
+  //
+  // kZlibCompression compresses better but several times slower.  Blocks
+  // are stored uncompressed if the selected algorithm was not built in
+  // (HAVE_SNAPPY, HAVE_ZLIB).
   CompressionType compression = kSnappyCompression;
 
+  // Checksum algorithm used to protect the blocks of newly written tables.
+  // The algorithm is recorded in the table footer, so tables written with
+  // different settings can be mixed freely in the same database.
+  //
+  // Default: kCRC32CChecksum, which keeps table files readable by older
+  // versions of leveldb.
+  //
+  // kXXH3Checksum stores the low 32 bits of a 64-bit XXH3 hash instead.
+  // It is several times faster to compute than the portable crc32c
+  // implementation, which matters when reads run with verify_checksums or
+  // paranoid_checks enabled.  Tables using it cannot be opened by versions
+  // of leveldb that do not know about this option.
+  ChecksumType checksum_type = kCRC32CChecksum;
+
+  // Compactions read their input files sequentially in chunks of this many
+  // bytes instead of one block at a time.  Larger values mean fewer, larger
+  // reads, which matters most on devices with high seek or request latency
+  // such as spinning disks and network block devices.  Memory-mapped table
+  // files are read directly.  Zero disables compaction readahead.
+  //
+  // Default: 2MB
+  size_t compaction_readahead_size = 2 * 1024 * 1024;
+
+  // Picks the file to compact in a level that grew beyond its size limit.
+  // Level-0 and kTieredCompaction are not affected.  Compare the counters
+  // at the end of the "leveldb.stats" property to choose.
+  //
+  // Default: kRoundRobin
+  CompactionPriority compaction_priority = kRoundRobin;
+
+  // If true, the size limits of the levels are derived backwards from the
+  // size of the last non-empty level, each level being a tenth of the
+  // next one, instead of being fixed at 10MB for level-1 and ten times
+  // more for every further level.  The levels above the first one that
+  // reaches 10MB are left empty: compactions of level-0 and memtable
+  // flushes skip them.  This keeps about 90% of the data in the last
+  // level whatever the size of the database, which bounds the space taken
+  // by obsolete entries.  Only used with kLeveledCompaction.
+  //
+  // Default: false
+  bool level_compaction_dynamic_level_bytes = false;
+
+  // Compaction strategy of the database.  It is read when the database is
+  // opened and can differ from one open to the next: files left in the
+  // intermediate levels by leveled compaction are pushed down to the last
+  // level first.
+  //
+  // Default: kLeveledCompaction
+  CompactionStyle compaction_style = kLeveledCompaction;
+
+  // kTieredCompaction only: the newest sorted runs are merged while each
+  // next run is at most this many percent larger than the runs picked so
+  // far combined.
+  //
+  // Default: 1
+  int tiered_size_ratio = 1;
+
+  // kTieredCompaction only: all sorted runs are merged into the last level
+  // once the other runs take up more than this many percent of its size.
+  // Each value then takes up at most (100 + this) percent of its own size
+  // on disk.  Smaller values keep less obsolete data around but rewrite
+  // the last level more often.
+  //
+  // Default: 200
+  int tiered_max_size_amplification_percent = 200;
+
+  // If non-null, memtable flushes and compactions request tokens from this
+  // limiter before writing to their table files, which caps the bandwidth
+  // background work takes away from foreground reads.  Log writes are not
+  // limited.  See NewGenericRateLimiter().
+  RateLimiter* rate_limiter = nullptr;
+
+  // If true, table files are read with direct I/O, bypassing the operating
+  // system's page cache, so blocks are cached only once, in block_cache.
+  // Consider a larger block_cache when enabling this, since reads that miss
+  // it always go to the storage device.  Table files are then read with
+  // pread() instead of being memory-mapped.
+  //
+  // Default: false
+  bool use_direct_reads = false;
+
+  // If true, memtable flushes and compactions write their table files with
+  // direct I/O, and compactions read their input files through separate
+  // direct I/O file handles.  This keeps background work from evicting the
+  // application's working set from the operating system's page cache.
+  //
+  // Default: false
+  bool use_direct_io_for_flush_and_compaction = false;
+
+  // If non-zero, the table files written by memtable flushes and
+  // compactions are written back to disk every bytes_per_sync bytes as they
+  // are written, so that dirty data does not pile up in the operating
+  // system's page cache and the final sync is cheap.  Uses
+  // sync_file_range() where available, which does not wait for the
+  // write-back, and a data sync otherwise, e.g. on macOS and iOS.  Does not
+  // apply to table files written with direct I/O.
+  //
+  // Log files are not covered: without sync_file_range() the write-back
+  // blocks, which would stall the foreground writes appending to the log.
+  //
+  // Default: 0
+  size_t bytes_per_sync = 0;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
   // Default: currently false, but may become true later.
   bool reuse_logs = false;
 
+  // If non-zero, up to this many log files that are no longer needed are
+  // kept and reused for new logs instead of being deleted.  Writing over an
+  // existing file avoids allocating space as the log grows, which makes
+  // syncs cheaper.  Records in such logs carry the log number so that
+  // stale records are ignored on recovery, which also means that a
+  // corrupted record ends the log instead of being reported.  Logs are
+  // never reused by reuse_logs while this is set.
+  //
+  // Default: 0
+  size_t recycle_log_file_num = 0;
+
+  // Compress write batches of at least 4KB in the log using the specified
+  // compression algorithm.  Batches that do not shrink by at least 12.5%
+  // are logged uncompressed, as are all batches if the algorithm was not
+  // built in (HAVE_SNAPPY, HAVE_ZLIB).  Logs with compressed records can
+  // not be recovered by versions of this library that do not support this
+  // option, nor by builds without the algorithm.
+  //
+  // Default: kNoCompression
+  CompressionType wal_compression = kNoCompression;
+
+  // If true, DB::Open() keeps the records replayed from the log files in a
+  // memtable instead of writing them to level-0 tables, as long as they fit
+  // into write_buffer_size.  The memtable is flushed by a background
+  // compaction once the database is open, and the log files it came from
+  // are kept until then.  This bounds the time spent in DB::Open() by the
+  // time it takes to read the logs.
+  //
+  // Default: false
+  bool avoid_flush_during_recovery = false;
+
+  // If true, DB::Open() opens the table files of the database before it
+  // returns, so that the first reads after a restart do not pay for it.
+  // Opening a table reads its index and filter blocks into memory.  At most
+  // as many tables as the table cache holds (see max_open_files) are
+  // preloaded, starting with the lowest levels.
+  //
+  // Default: false
+  bool preload_tables_on_open = false;
+
+  // Number of threads DB::Open() uses to preload tables.
+  //
+  // Default: 4
+  int preload_table_threads = 4;
+
+  // If non-null, combines the operands recorded by DB::Merge() and
+  // WriteBatch::Merge() with the existing value of their key.  Reading a
+  // key that has merge operands fails with NotSupported if this is null.
+  //
+  // Default: nullptr
+  const MergeOperator* merge_operator = nullptr;
+
+  // If non-null, compactions pass the entries they copy to this filter,
+  // which may remove them or change their values.  See
+  // leveldb/compaction_filter.h.
+  //
+  // Default: nullptr
+  const CompactionFilter* compaction_filter = nullptr;
+
+  // If non-zero, the database works as a cache: values expire this many
+  // seconds after they were written.  Reads and iterators do not return
+  // expired values, compactions drop them, and table files that hold
+  // nothing but expired values are deleted without being compacted.
+  //
+  // The write time is stored with each value, so whether this is zero must
+  // be the same every time the database is opened: the MANIFEST records
+  // it, and DB::Open() fails with InvalidArgument if it differs.  The
+  // number of seconds itself may change.  It cannot be combined with a
+  // merge_operator, and DB::IngestExternalFiles() is not supported.
+  //
+  // Default: 0
+  uint32_t ttl_seconds = 0;
+
+  // If non-zero, memtable flushes and compactions store values of at least
+  // this many bytes in separate blob files, and the tables only refer to
+  // them.  Compactions then no longer copy these values from level to
+  // level, which cuts the write amplification of large values at the cost
+  // of an extra read for each of them.  Values that are already stored
+  // can be read whatever this is set to.
+  //
+  // Cannot be combined with ttl_seconds.
+  //
+  // Default: 0
+  size_t min_blob_size = 0;
+
+  // Once the tables no longer refer to this fraction of the bytes in a blob
+  // file, compactions copy the blobs still in use to new blob files, and
+  // the tables referring to the oldest blob files are compacted for that
+  // purpose.  The blob file is deleted once no table refers to it.
+  //
+  // Default: 0.5
+  double blob_garbage_collection_threshold = 0.5;
+
+  // If non-zero, tables in which at least this fraction of the entries are
+  // deletions are compacted ahead of the compactions triggered by seeks or
+  // by blob garbage, so that scans no longer skip over the deleted keys
+  // one by one.  Only levels above the last one are considered, and
+  // kTieredCompaction does not use it.  The counts of entries and
+  // deletions of new tables are then recorded in the MANIFEST, which
+  // versions of leveldb that do not know about this option cannot read.
+  // See also the "leveldb.tables-by-deletion-ratio" property.
+  //
+  // Default: 0
+  double deletion_compaction_ratio = 0;
+
   // If non-null, use the specified filter policy to reduce disk reads.
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
@@ -154,6 +443,12 @@ struct LEVELDB_EXPORT ReadOptions {
   // Callers may wish to set this field to false for bulk scans.
   bool fill_cache = true;
 
+  // If non-zero, iterators that find themselves reading the data blocks of
+  // a table file sequentially read ahead this many bytes at once into a
+  // per-iterator buffer.  Worth setting for long scans on devices with high
+  // request latency.  Has no effect on memory-mapped table files.
+  size_t readahead_size = 0;
+
   // If "snapshot" is non-null, read as of the supplied snapshot
   // (which must belong to the DB that is being read and which must
   // not have been released).  If "snapshot" is null, use an implicit
@@ -182,6 +477,26 @@ struct LEVELDB_EXPORT WriteOptions {
   bool sync = false;
 };
 
+// Options that control DB::IngestExternalFiles()
+struct LEVELDB_EXPORT IngestOptions {
+  IngestOptions() = default;
+
+  // If true, the files are moved into the database directory by hard
+  // linking them there and removing the originals once the files have been
+  // added, which is much cheaper than copying them.  The files are copied
+  // and left in place instead if they cannot be linked, for example because
+  // they are on a different file system.
+  //
+  // Until a move completes, each original path is a hard link to the same
+  // inode as the table file in the database directory.  If ingestion fails,
+  // the database's links are removed and the originals stay as they were.
+  // If the process crashes after the files were added but before the
+  // originals were removed, the originals remain as further links to table
+  // files of the database.  They must then not be modified, but can be
+  // removed.
+  bool move_files = true;
+};
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
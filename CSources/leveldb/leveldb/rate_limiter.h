@@ -0,0 +1,64 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A RateLimiter caps the rate at which background work (memtable flushes
+// and compactions) writes table files, so that it does not saturate the
+// storage device and starve foreground reads.  Log writes bypass it.
+//
+// A single RateLimiter may be shared by several databases, in which case
+// their combined background writes are limited.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+#define STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT RateLimiter {
+ public:
+  RateLimiter() = default;
+
+  RateLimiter(const RateLimiter&) = delete;
+  RateLimiter& operator=(const RateLimiter&) = delete;
+
+  virtual ~RateLimiter();
+
+  // Block until "bytes" more bytes may be written.  Safe to call from
+  // multiple threads.
+  virtual void Request(size_t bytes) = 0;
+
+  // Change the maximum write rate.  With auto-tuning enabled, this is the
+  // upper bound the tuned rate may grow to.  "bytes_per_second" must be
+  // positive.
+  virtual void SetBytesPerSecond(int64_t bytes_per_second) = 0;
+
+  // Return the write rate currently enforced.
+  virtual int64_t GetBytesPerSecond() const = 0;
+
+  // Return the total number of bytes requested so far.
+  virtual uint64_t GetTotalBytesThrough() const = 0;
+
+  // Return the total time, in microseconds, that callers of Request()
+  // spent waiting for the limiter.
+  virtual uint64_t GetTotalThrottledMicros() const = 0;
+};
+
+// Return a new rate limiter that allows "bytes_per_second" bytes of writes
+// per second, refilled in 100ms intervals.
+//
+// If "auto_tuned" is true, the enforced rate is adjusted periodically
+// between 5% and 100% of "bytes_per_second" depending on demand: it drops
+// while background work rarely has to wait, which keeps sudden bursts of
+// compaction from hogging the device, and grows back toward the maximum
+// while writes are being throttled most of the time.
+LEVELDB_EXPORT RateLimiter* NewGenericRateLimiter(int64_t bytes_per_second,
+                                                  bool auto_tuned = false);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
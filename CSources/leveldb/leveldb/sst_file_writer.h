@@ -0,0 +1,70 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// SstFileWriter builds a table file outside of any database, typically
+// for a bulk load.  The finished file is added to a database with
+// DB::IngestExternalFiles(), which bypasses the log, the memtable and the
+// compactions that writing the same entries with DB::Write() would cost.
+//
+// An SstFileWriter is not thread-safe.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+#define STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SstFileWriter {
+ public:
+  // "options" should be the options of the database the file is meant
+  // for.  In particular, the file can only be ingested into databases that
+  // use the same comparator.
+  explicit SstFileWriter(const Options& options);
+
+  SstFileWriter(const SstFileWriter&) = delete;
+  SstFileWriter& operator=(const SstFileWriter&) = delete;
+
+  // Abandons the file if Finish() has not been called.
+  ~SstFileWriter();
+
+  // Create the file "fname" to add entries to.
+  Status Open(const std::string& fname);
+
+  // Add an entry to the file.  The keys of the entries added must be in
+  // strictly increasing order according to the comparator.  Put() sets
+  // "key" to "value" on ingestion, Merge() records a merge operand for it
+  // and Delete() removes it.
+  // REQUIRES: Open() has succeeded and Finish() has not been called
+  Status Put(const Slice& key, const Slice& value);
+  Status Merge(const Slice& key, const Slice& value);
+  Status Delete(const Slice& key);
+
+  // Finish writing the file, sync and close it.  Fails if no entry was
+  // added.
+  // REQUIRES: Open() has succeeded and Finish() has not been called
+  Status Finish();
+
+  // Number of entries added so far.
+  uint64_t NumEntries() const;
+
+  // Size of the file generated so far.  If invoked after a successful
+  // Finish() call, returns the size of the final generated file.
+  uint64_t FileSize() const;
+
+ private:
+  struct Rep;
+
+  Rep* rep_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
@@ -50,6 +50,14 @@ class LEVELDB_EXPORT Table {
   // call one of the Seek methods on the iterator before using it).
   Iterator* NewIterator(const ReadOptions&) const;
 
+  // Returns a new iterator over the entries added to the table with
+  // TableBuilder::AddRangeTombstone().  The result is initially invalid.
+  Iterator* NewRangeTombstoneIterator() const;
+
+  // Returns the name recorded by TableBuilder::SetComparatorName(), or an
+  // empty string if the table does not record a comparator.
+  std::string ComparatorName() const;
+
   // Given a key, return an approximate byte offset in the file where
   // the data for that key begins (or would begin if the key were
   // present in the file).  The returned value is in terms of file
@@ -63,6 +71,13 @@ class LEVELDB_EXPORT Table {
   struct Rep;
 
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* ReadaheadBlockReader(void*, const ReadOptions&,
+                                        const Slice&);
+
+  // Returns an iterator over the block that "index_value" refers to, reading
+  // it from "file" if it is not in the block cache.
+  Iterator* NewBlockIterator(RandomAccessFile* file, const ReadOptions&,
+                             const Slice& index_value);
 
   explicit Table(Rep* rep) : rep_(rep) {}
 
@@ -73,8 +88,19 @@ class LEVELDB_EXPORT Table {
                      void (*handle_result)(void* arg, const Slice& k,
                                            const Slice& v));
 
+  // Load the data blocks that may hold any of "keys[0..n-1]" into the
+  // block cache.  All blocks that are not cached yet are fetched with a
+  // single RandomAccessFile::MultiRead() call.  Blocks ruled out by the
+  // filter policy are skipped.
+  void PrefetchBlocks(const ReadOptions&, const Slice* keys, size_t n);
+
+  // Returns false if the filter policy rules out that "key" is stored in
+  // this table, true otherwise.
+  bool KeyMayMatch(const Slice& key) const;
+
   void ReadMeta(const Footer& footer);
   void ReadFilter(const Slice& filter_handle_value);
+  void ReadRangeDel(const Slice& range_del_handle_value);
 
   Rep* const rep_;
 };
@@ -51,6 +51,17 @@ class LEVELDB_EXPORT TableBuilder {
   // REQUIRES: Finish(), Abandon() have not been called
   void Add(const Slice& key, const Slice& value);
 
+  // Add key,value to the range deletion block of the table, which is kept
+  // apart from the entries added by Add().
+  // REQUIRES: key is after any key previously passed to this method.
+  // REQUIRES: Finish(), Abandon() have not been called
+  void AddRangeTombstone(const Slice& key, const Slice& value);
+
+  // Record "name" in the table as the name of the comparator that orders
+  // its user keys, see Table::ComparatorName().
+  // REQUIRES: Finish(), Abandon() have not been called
+  void SetComparatorName(const Slice& name);
+
   // Advanced operation: flush any buffered key/value pairs to file.
   // Can be used to ensure that two adjacent entries never live in
   // the same data block.  Most clients should not need to use this method.
@@ -75,6 +86,9 @@ class LEVELDB_EXPORT TableBuilder {
   // Number of calls to Add() so far.
   uint64_t NumEntries() const;
 
+  // Number of calls to AddRangeTombstone() so far.
+  uint64_t NumRangeTombstones() const;
+
   // Size of the file generated so far.  If invoked after a successful
   // Finish() call, returns the size of the final generated file.
   uint64_t FileSize() const;
@@ -37,6 +37,18 @@ class LEVELDB_EXPORT WriteBatch {
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
     virtual void Delete(const Slice& key) = 0;
+    // Handlers that do not override Merge() or DeleteRange() can not take
+    // such entries: WriteBatch::Iterate() stops at the first one and
+    // returns a NotSupported error, instead of skipping it.
+    virtual void Merge(const Slice& key, const Slice& value);
+    virtual void DeleteRange(const Slice& begin_key, const Slice& end_key);
+
+   private:
+    friend class WriteBatch;
+
+    // Set by the default Merge() and DeleteRange() to the name of the
+    // entry type this handler does not support.
+    const char* unsupported_ = nullptr;
   };
 
   WriteBatch();
@@ -53,6 +65,14 @@ class LEVELDB_EXPORT WriteBatch {
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Record "value" as a merge operand for "key", to be combined with the
+  // existing value of "key" by Options::merge_operator when it is read.
+  void Merge(const Slice& key, const Slice& value);
+
+  // If the database contains keys in the range ["begin_key", "end_key"),
+  // erase them.  Keys written after this range deletion are not affected.
+  void DeleteRange(const Slice& begin_key, const Slice& end_key);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
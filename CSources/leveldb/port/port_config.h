@@ -7,7 +7,11 @@
 
 // Define to 1 if you have a definition for fdatasync() in <unistd.h>.
 #if !defined(HAVE_FDATASYNC)
+#if defined(__linux__)
+#define HAVE_FDATASYNC 1
+#else
 #define HAVE_FDATASYNC 0
+#endif  // defined(__linux__)
 #endif  // !defined(HAVE_FDATASYNC)
 
 // Define to 1 if you have a definition for F_FULLFSYNC in <fcntl.h>.
@@ -30,4 +34,9 @@
 #define HAVE_SNAPPY 0
 #endif  // !defined(HAVE_SNAPPY)
 
+// Define to 1 if you have zlib.
+#if !defined(HAVE_ZLIB)
+#define HAVE_ZLIB 1
+#endif  // !defined(HAVE_ZLIB)
+
 #endif  // STORAGE_LEVELDB_PORT_PORT_CONFIG_H_
@@ -28,6 +28,9 @@
 #if HAVE_SNAPPY
 #include <snappy.h>
 #endif  // HAVE_SNAPPY
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif  // HAVE_ZLIB
 
 #include <cassert>
 #include <condition_variable>  // NOLINT
@@ -126,6 +129,76 @@ inline bool Snappy_Uncompress(const char* input, size_t length, char* output) {
 #endif  // HAVE_SNAPPY
 }
 
+// A zlib stream does not record its uncompressed length, so Zlib_Compress()
+// stores it in front of the stream as a little-endian 32-bit integer.
+inline bool Zlib_Compress(const char* input, size_t length,
+                          std::string* output) {
+#if HAVE_ZLIB
+  if (length > 0xffffffffu) {
+    return false;
+  }
+  uLongf outlen = ::compressBound(static_cast<uLong>(length));
+  output->resize(4 + outlen);
+  for (int i = 0; i < 4; i++) {
+    (*output)[i] = static_cast<char>(length >> (8 * i));
+  }
+  if (::compress(reinterpret_cast<Bytef*>(&(*output)[4]), &outlen,
+                 reinterpret_cast<const Bytef*>(input),
+                 static_cast<uLong>(length)) != Z_OK) {
+    return false;
+  }
+  output->resize(4 + outlen);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_ZLIB
+}
+
+inline bool Zlib_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) {
+#if HAVE_ZLIB
+  if (length < 4) {
+    return false;
+  }
+  *result = 0;
+  for (int i = 0; i < 4; i++) {
+    *result |= static_cast<size_t>(static_cast<unsigned char>(input[i]))
+               << (8 * i);
+  }
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)result;
+  return false;
+#endif  // HAVE_ZLIB
+}
+
+inline bool Zlib_Uncompress(const char* input, size_t length, char* output) {
+#if HAVE_ZLIB
+  size_t ulength;
+  if (!Zlib_GetUncompressedLength(input, length, &ulength)) {
+    return false;
+  }
+  uLongf outlen = static_cast<uLongf>(ulength);
+  return ::uncompress(reinterpret_cast<Bytef*>(output), &outlen,
+                      reinterpret_cast<const Bytef*>(input + 4),
+                      static_cast<uLong>(length - 4)) == Z_OK &&
+         outlen == ulength;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_ZLIB
+}
+
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg) {
   // Silence compiler warnings about unused arguments.
   (void)func;
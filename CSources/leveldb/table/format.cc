@@ -4,11 +4,14 @@
 
 #include "table/format.h"
 
+#include <vector>
+
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "table/block.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/xxh3.h"
 
 namespace leveldb {
 
@@ -32,9 +35,17 @@ void Footer::EncodeTo(std::string* dst) const {
   const size_t original_size = dst->size();
   metaindex_handle_.EncodeTo(dst);
   index_handle_.EncodeTo(dst);
-  dst->resize(2 * BlockHandle::kMaxEncodedLength);  // Padding
-  PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber & 0xffffffffu));
-  PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber >> 32));
+  uint64_t magic = kTableMagicNumber;
+  if (checksum_type_ == kCRC32CChecksum) {
+    dst->resize(original_size + 2 * BlockHandle::kMaxEncodedLength);  // Padding
+  } else {
+    assert(dst->size() < original_size + 2 * BlockHandle::kMaxEncodedLength);
+    dst->resize(original_size + 2 * BlockHandle::kMaxEncodedLength - 1);
+    dst->push_back(static_cast<char>(checksum_type_));
+    magic = kChecksummedTableMagicNumber;
+  }
+  PutFixed32(dst, static_cast<uint32_t>(magic & 0xffffffffu));
+  PutFixed32(dst, static_cast<uint32_t>(magic >> 32));
   assert(dst->size() == original_size + kEncodedLength);
   (void)original_size;  // Disable unused variable warning.
 }
@@ -45,7 +56,20 @@ Status Footer::DecodeFrom(Slice* input) {
   const uint32_t magic_hi = DecodeFixed32(magic_ptr + 4);
   const uint64_t magic = ((static_cast<uint64_t>(magic_hi) << 32) |
                           (static_cast<uint64_t>(magic_lo)));
-  if (magic != kTableMagicNumber) {
+  if (magic == kTableMagicNumber) {
+    checksum_type_ = kCRC32CChecksum;
+  } else if (magic == kChecksummedTableMagicNumber) {
+    switch (magic_ptr[-1]) {
+      case kCRC32CChecksum:
+        checksum_type_ = kCRC32CChecksum;
+        break;
+      case kXXH3Checksum:
+        checksum_type_ = kXXH3Checksum;
+        break;
+      default:
+        return Status::Corruption("unknown block checksum type");
+    }
+  } else {
     return Status::Corruption("not an sstable (bad magic number)");
   }
 
@@ -61,36 +85,42 @@ Status Footer::DecodeFrom(Slice* input) {
   return result;
 }
 
-Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result) {
-  result->data = Slice();
-  result->cachable = false;
-  result->heap_allocated = false;
-
-  // Read the block contents as well as the type/crc footer.
-  // See table_builder.cc for the code that built this structure.
-  size_t n = static_cast<size_t>(handle.size());
-  char* buf = new char[n + kBlockTrailerSize];
-  Slice contents;
-  Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
-  if (!s.ok()) {
-    delete[] buf;
-    return s;
+uint32_t BlockChecksum(ChecksumType checksum_type, const char* data, size_t n,
+                       char type) {
+  switch (checksum_type) {
+    case kXXH3Checksum: {
+      // Fold the type byte in with a multiplicative mix instead of hashing
+      // it along with the data, which would require a copy of the block.
+      const uint32_t hash = static_cast<uint32_t>(xxh3::Value(data, n));
+      return hash ^ (static_cast<uint8_t>(type) * 0x6b9083d9u);
+    }
+    case kCRC32CChecksum:
+    default: {
+      uint32_t crc = crc32c::Value(data, n);
+      crc = crc32c::Extend(crc, &type, 1);  // Extend crc to cover block type
+      return crc32c::Mask(crc);
+    }
   }
+}
+
+// Verify and uncompress the block of size "n" that was read into
+// "contents", using "buf" as the read buffer.  Takes ownership of "buf".
+static Status DecodeBlock(const ReadOptions& options,
+                          ChecksumType checksum_type, size_t n, char* buf,
+                          const Slice& contents, BlockContents* result) {
   if (contents.size() != n + kBlockTrailerSize) {
     delete[] buf;
     return Status::Corruption("truncated block read");
   }
 
-  // Check the crc of the type and the block contents
+  // Check the checksum of the type and the block contents
   const char* data = contents.data();  // Pointer to where Read put the data
   if (options.verify_checksums) {
-    const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
-    const uint32_t actual = crc32c::Value(data, n + 1);
-    if (actual != crc) {
+    const uint32_t expected = DecodeFixed32(data + n + 1);
+    const uint32_t actual = BlockChecksum(checksum_type, data, n, data[n]);
+    if (actual != expected) {
       delete[] buf;
-      s = Status::Corruption("block checksum mismatch");
-      return s;
+      return Status::Corruption("block checksum mismatch");
     }
   }
 
@@ -130,6 +160,24 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
       result->cachable = true;
       break;
     }
+    case kZlibCompression: {
+      size_t ulength = 0;
+      if (!port::Zlib_GetUncompressedLength(data, n, &ulength)) {
+        delete[] buf;
+        return Status::Corruption("corrupted compressed block contents");
+      }
+      char* ubuf = new char[ulength];
+      if (!port::Zlib_Uncompress(data, n, ubuf)) {
+        delete[] buf;
+        delete[] ubuf;
+        return Status::Corruption("corrupted compressed block contents");
+      }
+      delete[] buf;
+      result->data = Slice(ubuf, ulength);
+      result->heap_allocated = true;
+      result->cachable = true;
+      break;
+    }
     default:
       delete[] buf;
       return Status::Corruption("bad block type");
@@ -138,4 +186,55 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
   return Status::OK();
 }
 
+Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
+                 ChecksumType checksum_type, const BlockHandle& handle,
+                 BlockContents* result) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+
+  // Read the block contents as well as the type/crc footer.
+  // See table_builder.cc for the code that built this structure.
+  size_t n = static_cast<size_t>(handle.size());
+  char* buf = new char[n + kBlockTrailerSize];
+  Slice contents;
+  Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+  if (!s.ok()) {
+    delete[] buf;
+    return s;
+  }
+  return DecodeBlock(options, checksum_type, n, buf, contents, result);
+}
+
+void ReadBlocks(RandomAccessFile* file, const ReadOptions& options,
+                ChecksumType checksum_type, const BlockHandle* handles,
+                size_t num_blocks, BlockContents* results, Status* statuses) {
+  std::vector<ReadRequest> requests(num_blocks);
+  for (size_t i = 0; i < num_blocks; i++) {
+    results[i].data = Slice();
+    results[i].cachable = false;
+    results[i].heap_allocated = false;
+
+    const size_t n = static_cast<size_t>(handles[i].size());
+    requests[i].offset = handles[i].offset();
+    requests[i].n = n + kBlockTrailerSize;
+    requests[i].scratch = new char[n + kBlockTrailerSize];
+  }
+
+  // Per-request errors are reported through requests[i].status.
+  file->MultiRead(requests.data(), requests.size());
+
+  for (size_t i = 0; i < num_blocks; i++) {
+    const ReadRequest& request = requests[i];
+    if (!request.status.ok()) {
+      delete[] request.scratch;
+      statuses[i] = request.status;
+    } else {
+      statuses[i] =
+          DecodeBlock(options, checksum_type, request.n - kBlockTrailerSize,
+                      request.scratch, request.result, &results[i]);
+    }
+  }
+}
+
 }  // namespace leveldb
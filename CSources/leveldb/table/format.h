@@ -50,9 +50,14 @@ class Footer {
   // Encoded length of a Footer.  Note that the serialization of a
   // Footer will always occupy exactly this many bytes.  It consists
   // of two block handles and a magic number.
+  //
+  // Tables that use a block checksum other than crc32c store the checksum
+  // type in the last byte of the block handle padding and are marked with
+  // kChecksummedTableMagicNumber instead of kTableMagicNumber.  The byte is
+  // always free since no valid file offset or size needs a 10 byte varint.
   enum { kEncodedLength = 2 * BlockHandle::kMaxEncodedLength + 8 };
 
-  Footer() = default;
+  Footer() : checksum_type_(kCRC32CChecksum) {}
 
   // The block handle for the metaindex block of the table
   const BlockHandle& metaindex_handle() const { return metaindex_handle_; }
@@ -62,12 +67,17 @@ class Footer {
   const BlockHandle& index_handle() const { return index_handle_; }
   void set_index_handle(const BlockHandle& h) { index_handle_ = h; }
 
+  // The algorithm used for the checksums of all blocks in the table
+  ChecksumType checksum_type() const { return checksum_type_; }
+  void set_checksum_type(ChecksumType t) { checksum_type_ = t; }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(Slice* input);
 
  private:
   BlockHandle metaindex_handle_;
   BlockHandle index_handle_;
+  ChecksumType checksum_type_;
 };
 
 // kTableMagicNumber was picked by running
@@ -75,19 +85,46 @@ class Footer {
 // and taking the leading 64 bits.
 static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 
-// 1-byte type + 32-bit crc
+// Magic number of tables whose footer records a block checksum type.
+// Older versions of leveldb reject these tables instead of failing every
+// checksum verification.
+static const uint64_t kChecksummedTableMagicNumber = 0x8b80fb57db477525ull;
+
+// 1-byte type + 32-bit checksum
 static const size_t kBlockTrailerSize = 5;
 
+// Metaindex key of the block holding the range deletions of a table.
+static const char kRangeDelBlockName[] = "leveldb.rangedel";
+
+// Metaindex key whose value is the name of the comparator that orders the
+// user keys of a table.  Only present if TableBuilder::SetComparatorName()
+// was called.
+static const char kComparatorNameKey[] = "leveldb.comparator";
+
+// Return the value stored in the trailer of a block with the given
+// contents data[0,n-1] and compression type byte.
+uint32_t BlockChecksum(ChecksumType checksum_type, const char* data, size_t n,
+                       char type);
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
   bool heap_allocated;  // True iff caller should delete[] data.data()
 };
 
-// Read the block identified by "handle" from "file".  On failure
-// return non-OK.  On success fill *result and return OK.
+// Read the block identified by "handle" from "file".  The block checksum
+// is verified with "checksum_type" if options.verify_checksums is set.
+// On failure return non-OK.  On success fill *result and return OK.
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result);
+                 ChecksumType checksum_type, const BlockHandle& handle,
+                 BlockContents* result);
+
+// Read the blocks identified by "handles[0..num_blocks-1]" from "file"
+// with a single RandomAccessFile::MultiRead() call.  For each i, fills
+// results[i] and statuses[i] as ReadBlock() would for handles[i].
+void ReadBlocks(RandomAccessFile* file, const ReadOptions& options,
+                ChecksumType checksum_type, const BlockHandle* handles,
+                size_t num_blocks, BlockContents* results, Status* statuses);
 
 // Implementation details follow.  Clients should ignore,
 
@@ -4,6 +4,12 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
@@ -22,17 +28,22 @@ struct Table::Rep {
     delete filter;
     delete[] filter_data;
     delete index_block;
+    delete range_del_block;
   }
 
   Options options;
   Status status;
   RandomAccessFile* file;
+  uint64_t file_size;
   uint64_t cache_id;
+  ChecksumType checksum_type;  // Block checksum algorithm: saved from footer
   FilterBlockReader* filter;
   const char* filter_data;
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
+  Block* range_del_block;  // nullptr if the table has no range deletions
+  std::string comparator_name;  // Empty if the table does not record it
 };
 
 Status Table::Open(const Options& options, RandomAccessFile* file,
@@ -58,7 +69,8 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
   if (options.paranoid_checks) {
     opt.verify_checksums = true;
   }
-  s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
+  s = ReadBlock(file, opt, footer.checksum_type(), footer.index_handle(),
+                &index_block_contents);
 
   if (s.ok()) {
     // We've successfully read the footer and the index block: we're
@@ -67,23 +79,27 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     Rep* rep = new Table::Rep;
     rep->options = options;
     rep->file = file;
+    rep->file_size = size;
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+    rep->checksum_type = footer.checksum_type();
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->range_del_block = nullptr;
     *table = new Table(rep);
     (*table)->ReadMeta(footer);
+    s = rep->status;
+    if (!s.ok()) {
+      delete *table;
+      *table = nullptr;
+    }
   }
 
   return s;
 }
 
 void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
-  }
-
   // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
   // it is an empty block.
   ReadOptions opt;
@@ -91,18 +107,32 @@ void Table::ReadMeta(const Footer& footer) {
     opt.verify_checksums = true;
   }
   BlockContents contents;
-  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
-    // Do not propagate errors since meta info is not needed for operation
+  Status s = ReadBlock(rep_->file, opt, rep_->checksum_type,
+                       footer.metaindex_handle(), &contents);
+  if (!s.ok()) {
+    // The metaindex locates the range deletion block, which is needed for
+    // correct reads.  Filters alone could be done without.
+    rep_->status = s;
     return;
   }
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  if (rep_->options.filter_policy != nullptr) {
+    std::string key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value());
+    }
+  }
+  iter->Seek(kComparatorNameKey);
+  if (iter->Valid() && iter->key() == Slice(kComparatorNameKey)) {
+    rep_->comparator_name = iter->value().ToString();
+  }
+  iter->Seek(kRangeDelBlockName);
+  if (iter->Valid() && iter->key() == Slice(kRangeDelBlockName)) {
+    ReadRangeDel(iter->value());
   }
   delete iter;
   delete meta;
@@ -122,7 +152,8 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
     opt.verify_checksums = true;
   }
   BlockContents block;
-  if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) {
+  if (!ReadBlock(rep_->file, opt, rep_->checksum_type, filter_handle, &block)
+           .ok()) {
     return;
   }
   if (block.heap_allocated) {
@@ -131,6 +162,29 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
 }
 
+void Table::ReadRangeDel(const Slice& range_del_handle_value) {
+  Slice v = range_del_handle_value;
+  BlockHandle range_del_handle;
+  if (!range_del_handle.DecodeFrom(&v).ok()) {
+    rep_->status = Status::Corruption("bad range deletion block handle");
+    return;
+  }
+
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents contents;
+  Status s = ReadBlock(rep_->file, opt, rep_->checksum_type, range_del_handle,
+                       &contents);
+  if (!s.ok()) {
+    // Unlike filters, range deletions are needed for correct reads.
+    rep_->status = s;
+    return;
+  }
+  rep_->range_del_block = new Block(contents);
+}
+
 Table::~Table() { delete rep_; }
 
 static void DeleteBlock(void* arg, void* ignored) {
@@ -148,12 +202,134 @@ static void ReleaseBlock(void* arg, void* h) {
   cache->Release(handle);
 }
 
+// Fill cache_key_buffer with the block cache key of the block at "offset".
+static Slice BlockCacheKey(uint64_t cache_id, uint64_t offset,
+                           char* cache_key_buffer) {
+  EncodeFixed64(cache_key_buffer, cache_id);
+  EncodeFixed64(cache_key_buffer + 8, offset);
+  return Slice(cache_key_buffer, 16);
+}
+
+namespace {
+
+// Wraps the file of a table for a single iterator.  Once two consecutive
+// reads are found to be sequential, the next "readahead_size" bytes are read
+// into a buffer with one call and later reads are served from it.
+//
+// Files that return pointers into their own memory instead of filling the
+// scratch buffer (i.e. memory-mapped files) are passed through unchanged.
+//
+// Unlike other RandomAccessFile implementations, instances are not
+// thread-safe, which is fine as each one is used by a single iterator.
+class ReadaheadFile : public RandomAccessFile {
+ public:
+  ReadaheadFile(RandomAccessFile* file, uint64_t file_size,
+                size_t readahead_size)
+      : file_(file),
+        file_size_(file_size),
+        readahead_size_(readahead_size),
+        passthrough_(false),
+        next_offset_(std::numeric_limits<uint64_t>::max()),
+        buffer_offset_(0),
+        buffer_size_(0) {}
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    const bool sequential = (offset == next_offset_);
+    next_offset_ = offset + n;
+
+    if (offset >= buffer_offset_ &&
+        offset + n <= buffer_offset_ + buffer_size_) {
+      std::memcpy(scratch, buffer_.get() + (offset - buffer_offset_), n);
+      *result = Slice(scratch, n);
+      return Status::OK();
+    }
+
+    if (passthrough_ || !sequential || n >= readahead_size_ ||
+        offset >= file_size_) {
+      Status s = file_->Read(offset, n, result, scratch);
+      if (s.ok() && result->data() != scratch) {
+        passthrough_ = true;
+      }
+      return s;
+    }
+
+    // Sequential access: refill the buffer starting at "offset".
+    if (buffer_ == nullptr) {
+      buffer_.reset(new char[readahead_size_]);
+    }
+    const size_t size = static_cast<size_t>(
+        std::min<uint64_t>(readahead_size_, file_size_ - offset));
+    Slice data;
+    Status s = file_->Read(offset, std::max(size, n), &data, buffer_.get());
+    buffer_size_ = 0;
+    if (!s.ok()) {
+      return s;
+    }
+    if (data.data() != buffer_.get()) {
+      passthrough_ = true;
+      *result = Slice(data.data(), std::min(n, data.size()));
+      return s;
+    }
+    buffer_offset_ = offset;
+    buffer_size_ = data.size();
+
+    const size_t available = std::min(n, data.size());
+    std::memcpy(scratch, buffer_.get(), available);
+    *result = Slice(scratch, available);
+    return s;
+  }
+
+ private:
+  RandomAccessFile* const file_;
+  const uint64_t file_size_;
+  const size_t readahead_size_;
+
+  mutable bool passthrough_;     // True if file_ hands out its own memory.
+  mutable uint64_t next_offset_;  // Offset following the last read.
+
+  // buffer_[0, buffer_size_ - 1] holds the file contents at buffer_offset_.
+  mutable std::unique_ptr<char[]> buffer_;
+  mutable uint64_t buffer_offset_;
+  mutable size_t buffer_size_;
+};
+
+// Argument of Table::ReadaheadBlockReader(), owned by the table iterator.
+struct ReadaheadState {
+  ReadaheadState(Table* t, RandomAccessFile* file, uint64_t file_size,
+                 size_t readahead_size)
+      : table(t), file(file, file_size, readahead_size) {}
+
+  Table* const table;
+  ReadaheadFile file;
+};
+
+void DeleteReadaheadState(void* arg, void* ignored) {
+  delete reinterpret_cast<ReadaheadState*>(arg);
+}
+
+}  // namespace
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
-  Cache* block_cache = table->rep_->options.block_cache;
+  return table->NewBlockIterator(table->rep_->file, options, index_value);
+}
+
+// Like BlockReader(), but reads blocks through the ReadaheadFile of the
+// ReadaheadState passed as "arg".
+Iterator* Table::ReadaheadBlockReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  return state->table->NewBlockIterator(&state->file, options, index_value);
+}
+
+Iterator* Table::NewBlockIterator(RandomAccessFile* file,
+                                  const ReadOptions& options,
+                                  const Slice& index_value) {
+  Cache* block_cache = rep_->options.block_cache;
   Block* block = nullptr;
   Cache::Handle* cache_handle = nullptr;
 
@@ -167,14 +343,13 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
     BlockContents contents;
     if (block_cache != nullptr) {
       char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
-      EncodeFixed64(cache_key_buffer + 8, handle.offset());
-      Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+      Slice key =
+          BlockCacheKey(rep_->cache_id, handle.offset(), cache_key_buffer);
       cache_handle = block_cache->Lookup(key);
       if (cache_handle != nullptr) {
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = ReadBlock(file, options, rep_->checksum_type, handle, &contents);
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
@@ -184,7 +359,7 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
         }
       }
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = ReadBlock(file, options, rep_->checksum_type, handle, &contents);
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -193,7 +368,7 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 
   Iterator* iter;
   if (block != nullptr) {
-    iter = block->NewIterator(table->rep_->options.comparator);
+    iter = block->NewIterator(rep_->options.comparator);
     if (cache_handle == nullptr) {
       iter->RegisterCleanup(&DeleteBlock, block, nullptr);
     } else {
@@ -206,9 +381,20 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 }
 
 Iterator* Table::NewIterator(const ReadOptions& options) const {
-  return NewTwoLevelIterator(
+  if (options.readahead_size == 0) {
+    return NewTwoLevelIterator(
+        rep_->index_block->NewIterator(rep_->options.comparator),
+        &Table::BlockReader, const_cast<Table*>(this), options);
+  }
+
+  ReadaheadState* state =
+      new ReadaheadState(const_cast<Table*>(this), rep_->file,
+                         rep_->file_size, options.readahead_size);
+  Iterator* iter = NewTwoLevelIterator(
       rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+      &Table::ReadaheadBlockReader, state, options);
+  iter->RegisterCleanup(&DeleteReadaheadState, state, nullptr);
+  return iter;
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
@@ -241,6 +427,104 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
   return s;
 }
 
+void Table::PrefetchBlocks(const ReadOptions& options, const Slice* keys,
+                           size_t n) {
+  Cache* block_cache = rep_->options.block_cache;
+  if (block_cache == nullptr || !options.fill_cache) {
+    return;
+  }
+
+  // Collect the handles of all candidate blocks that are not cached yet.
+  std::vector<BlockHandle> handles;
+  char cache_key_buffer[16];
+  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  for (size_t i = 0; i < n; i++) {
+    iiter->Seek(keys[i]);
+    if (!iiter->Valid()) {
+      continue;
+    }
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    if (!handle.DecodeFrom(&handle_value).ok()) {
+      continue;
+    }
+    FilterBlockReader* filter = rep_->filter;
+    if (filter != nullptr && !filter->KeyMayMatch(handle.offset(), keys[i])) {
+      continue;
+    }
+    Cache::Handle* cache_handle = block_cache->Lookup(
+        BlockCacheKey(rep_->cache_id, handle.offset(), cache_key_buffer));
+    if (cache_handle != nullptr) {
+      block_cache->Release(cache_handle);
+      continue;
+    }
+    handles.push_back(handle);
+  }
+  delete iiter;
+
+  std::sort(handles.begin(), handles.end(),
+            [](const BlockHandle& a, const BlockHandle& b) {
+              return a.offset() < b.offset();
+            });
+  handles.erase(std::unique(handles.begin(), handles.end(),
+                            [](const BlockHandle& a, const BlockHandle& b) {
+                              return a.offset() == b.offset();
+                            }),
+                handles.end());
+  if (handles.empty()) {
+    return;
+  }
+
+  std::vector<BlockContents> contents(handles.size());
+  std::vector<Status> statuses(handles.size());
+  ReadBlocks(rep_->file, options, rep_->checksum_type, handles.data(),
+             handles.size(), contents.data(), statuses.data());
+
+  // Errors are ignored here: a later read of the same block reports them.
+  for (size_t i = 0; i < handles.size(); i++) {
+    if (!statuses[i].ok()) {
+      continue;
+    }
+    Block* block = new Block(contents[i]);
+    if (contents[i].cachable) {
+      Slice key = BlockCacheKey(rep_->cache_id, handles[i].offset(),
+                                cache_key_buffer);
+      block_cache->Release(
+          block_cache->Insert(key, block, block->size(), &DeleteCachedBlock));
+    } else {
+      delete block;
+    }
+  }
+}
+
+Iterator* Table::NewRangeTombstoneIterator() const {
+  if (rep_->range_del_block == nullptr) {
+    return NewEmptyIterator();
+  }
+  return rep_->range_del_block->NewIterator(rep_->options.comparator);
+}
+
+std::string Table::ComparatorName() const { return rep_->comparator_name; }
+
+bool Table::KeyMayMatch(const Slice& key) const {
+  FilterBlockReader* filter = rep_->filter;
+  if (filter == nullptr) {
+    return true;
+  }
+  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  iiter->Seek(key);
+  bool result = true;
+  if (iiter->Valid()) {
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    if (handle.DecodeFrom(&handle_value).ok()) {
+      result = filter->KeyMayMatch(handle.offset(), key);
+    }
+  }
+  delete iiter;
+  return result;
+}
+
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
   Iterator* index_iter =
       rep_->index_block->NewIterator(rep_->options.comparator);
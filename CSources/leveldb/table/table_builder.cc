@@ -14,7 +14,6 @@
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "util/coding.h"
-#include "util/crc32c.h"
 
 namespace leveldb {
 
@@ -26,7 +25,9 @@ struct TableBuilder::Rep {
         offset(0),
         data_block(&options),
         index_block(&index_block_options),
+        range_del_block(&options),
         num_entries(0),
+        num_range_tombstones(0),
         closed(false),
         filter_block(opt.filter_policy == nullptr
                          ? nullptr
@@ -42,10 +43,13 @@ struct TableBuilder::Rep {
   Status status;
   BlockBuilder data_block;
   BlockBuilder index_block;
+  BlockBuilder range_del_block;
   std::string last_key;
   int64_t num_entries;
+  int64_t num_range_tombstones;
   bool closed;  // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
+  std::string comparator_name;  // Recorded in the metaindex if not empty
 
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
@@ -82,6 +86,10 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   if (options.comparator != rep_->options.comparator) {
     return Status::InvalidArgument("changing comparator while building table");
   }
+  if (options.checksum_type != rep_->options.checksum_type) {
+    return Status::InvalidArgument(
+        "changing checksum type while building table");
+  }
 
   // Note that any live BlockBuilders point to rep_->options and therefore
   // will automatically pick up the updated options.
@@ -122,6 +130,20 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   }
 }
 
+void TableBuilder::AddRangeTombstone(const Slice& key, const Slice& value) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  r->num_range_tombstones++;
+  r->range_del_block.Add(key, value);
+}
+
+void TableBuilder::SetComparatorName(const Slice& name) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  r->comparator_name = name.ToString();
+}
+
 void TableBuilder::Flush() {
   Rep* r = rep_;
   assert(!r->closed);
@@ -142,14 +164,13 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
   // File format contains a sequence of blocks where each block has:
   //    block_data: uint8[n]
   //    type: uint8
-  //    crc: uint32
+  //    checksum: uint32 (see BlockChecksum())
   assert(ok());
   Rep* r = rep_;
   Slice raw = block->Finish();
 
   Slice block_contents;
   CompressionType type = r->options.compression;
-  // TODO(postrelease): Support more compression options: zlib?
   switch (type) {
     case kNoCompression:
       block_contents = raw;
@@ -168,6 +189,18 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
       }
       break;
     }
+
+    case kZlibCompression: {
+      std::string* compressed = &r->compressed_output;
+      if (port::Zlib_Compress(raw.data(), raw.size(), compressed) &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        block_contents = *compressed;
+      } else {
+        block_contents = raw;
+        type = kNoCompression;
+      }
+      break;
+    }
   }
   WriteRawBlock(block_contents, type, handle);
   r->compressed_output.clear();
@@ -183,9 +216,9 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents,
   if (r->status.ok()) {
     char trailer[kBlockTrailerSize];
     trailer[0] = type;
-    uint32_t crc = crc32c::Value(block_contents.data(), block_contents.size());
-    crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
-    EncodeFixed32(trailer + 1, crc32c::Mask(crc));
+    EncodeFixed32(trailer + 1,
+                  BlockChecksum(r->options.checksum_type, block_contents.data(),
+                                block_contents.size(), trailer[0]));
     r->status = r->file->Append(Slice(trailer, kBlockTrailerSize));
     if (r->status.ok()) {
       r->offset += block_contents.size() + kBlockTrailerSize;
@@ -201,7 +234,8 @@ Status TableBuilder::Finish() {
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle filter_block_handle, range_del_block_handle,
+      metaindex_block_handle, index_block_handle;
 
   // Write filter block
   if (ok() && r->filter_block != nullptr) {
@@ -209,6 +243,11 @@ Status TableBuilder::Finish() {
                   &filter_block_handle);
   }
 
+  // Write range deletion block
+  if (ok() && r->num_range_tombstones > 0) {
+    WriteBlock(&r->range_del_block, &range_del_block_handle);
+  }
+
   // Write metaindex block
   if (ok()) {
     BlockBuilder meta_index_block(&r->options);
@@ -220,6 +259,14 @@ Status TableBuilder::Finish() {
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    if (!r->comparator_name.empty()) {
+      meta_index_block.Add(kComparatorNameKey, r->comparator_name);
+    }
+    if (r->num_range_tombstones > 0) {
+      std::string handle_encoding;
+      range_del_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(kRangeDelBlockName, handle_encoding);
+    }
 
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -242,6 +289,7 @@ Status TableBuilder::Finish() {
     Footer footer;
     footer.set_metaindex_handle(metaindex_block_handle);
     footer.set_index_handle(index_block_handle);
+    footer.set_checksum_type(r->options.checksum_type);
     std::string footer_encoding;
     footer.EncodeTo(&footer_encoding);
     r->status = r->file->Append(footer_encoding);
@@ -260,6 +308,10 @@ void TableBuilder::Abandon() {
 
 uint64_t TableBuilder::NumEntries() const { return rep_->num_entries; }
 
+uint64_t TableBuilder::NumRangeTombstones() const {
+  return rep_->num_range_tombstones;
+}
+
 uint64_t TableBuilder::FileSize() const { return rep_->offset; }
 
 }  // namespace leveldb
@@ -22,6 +22,31 @@ Status Env::NewAppendableFile(const std::string& fname, WritableFile** result) {
   return Status::NotSupported("NewAppendableFile", fname);
 }
 
+Status Env::ReuseWritableFile(const std::string& fname,
+                              const std::string& old_fname,
+                              WritableFile** result) {
+  Status s = RenameFile(old_fname, fname);
+  if (!s.ok()) {
+    *result = nullptr;
+    return s;
+  }
+  return NewWritableFile(fname, result);
+}
+
+Status Env::LinkFile(const std::string& src, const std::string& target) {
+  return Status::NotSupported("LinkFile", src);
+}
+
+Status Env::NewDirectRandomAccessFile(const std::string& fname,
+                                      RandomAccessFile** result) {
+  return NewRandomAccessFile(fname, result);
+}
+
+Status Env::NewDirectWritableFile(const std::string& fname,
+                                  WritableFile** result) {
+  return NewWritableFile(fname, result);
+}
+
 Status Env::RemoveDir(const std::string& dirname) { return DeleteDir(dirname); }
 Status Env::DeleteDir(const std::string& dirname) { return RemoveDir(dirname); }
 
@@ -32,8 +57,27 @@ SequentialFile::~SequentialFile() = default;
 
 RandomAccessFile::~RandomAccessFile() = default;
 
+Status RandomAccessFile::MultiRead(ReadRequest* requests, size_t n) const {
+  Status result;
+  for (size_t i = 0; i < n; i++) {
+    ReadRequest* request = &requests[i];
+    request->status = Read(request->offset, request->n, &request->result,
+                           request->scratch);
+    if (result.ok()) {
+      result = request->status;
+    }
+  }
+  return result;
+}
+
 WritableFile::~WritableFile() = default;
 
+Status WritableFile::RangeSync(uint64_t offset, uint64_t nbytes) {
+  return Status::OK();
+}
+
+Status WritableFile::Preallocate(uint64_t size) { return Status::OK(); }
+
 Logger::~Logger() = default;
 
 FileLock::~FileLock() = default;
@@ -12,6 +12,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <cstddef>
@@ -20,6 +21,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <memory>
 #include <queue>
 #include <set>
 #include <string>
@@ -32,6 +34,7 @@
 #include "leveldb/status.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
+#include "util/env_posix_test_helper.h"
 #include "util/posix_logger.h"
 
 namespace leveldb {
@@ -56,6 +59,21 @@ constexpr const int kOpenBaseFlags = 0;
 
 constexpr const size_t kWritableFileBufferSize = 65536;
 
+// PosixRandomAccessFile::MultiRead() merges requests separated by at most
+// this many bytes into a single pread() call.
+constexpr const size_t kMultiReadMaxGap = 4096;
+
+// Upper bound for the byte range covered by a single merged read.
+constexpr const size_t kMultiReadMaxSize = 1024 * 1024;
+
+// File offsets, transfer sizes and memory buffers used with direct I/O are
+// multiples of this value, which covers the logical block size of common
+// storage devices.
+constexpr const size_t kDirectIOAlignment = 4096;
+
+static_assert(kWritableFileBufferSize % kDirectIOAlignment == 0,
+              "The write buffer must hold a whole number of aligned blocks");
+
 Status PosixError(const std::string& context, int error_number) {
   if (error_number == ENOENT) {
     return Status::NotFound(context, std::strerror(error_number));
@@ -64,6 +82,41 @@ Status PosixError(const std::string& context, int error_number) {
   }
 }
 
+uint64_t AlignDown(uint64_t value) {
+  return value & ~static_cast<uint64_t>(kDirectIOAlignment - 1);
+}
+
+uint64_t AlignUp(uint64_t value) {
+  return AlignDown(value + kDirectIOAlignment - 1);
+}
+
+// Returns the first address in |base| that is suitably aligned for direct I/O.
+// |base| must have room for kDirectIOAlignment - 1 bytes of slack.
+char* AlignPointer(char* base) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(base);
+  return base + (AlignUp(address) - address);
+}
+
+// Opens a file whose reads and writes bypass the operating system's page
+// cache: O_DIRECT where available, F_NOCACHE on macOS and iOS. Filesystems that
+// reject O_DIRECT (e.g. tmpfs) get a regular file descriptor instead.
+int OpenDirect(const std::string& filename, int flags, mode_t mode = 0) {
+  int fd;
+#if defined(O_DIRECT)
+  fd = ::open(filename.c_str(), flags | O_DIRECT, mode);
+  if (fd >= 0 || errno != EINVAL) {
+    return fd;
+  }
+#endif  // defined(O_DIRECT)
+  fd = ::open(filename.c_str(), flags, mode);
+#if defined(F_NOCACHE)
+  if (fd >= 0) {
+    ::fcntl(fd, F_NOCACHE, 1);  // Only a hint, so errors are ignored.
+  }
+#endif  // defined(F_NOCACHE)
+  return fd;
+}
+
 // Helper class to limit resource usage to avoid exhaustion.
 // Currently used to limit read-only file descriptors and mmap file usage
 // so that we do not run out of file descriptors or virtual memory, or run into
@@ -148,9 +201,14 @@ class PosixRandomAccessFile final : public RandomAccessFile {
  public:
   // The new instance takes ownership of |fd|. |fd_limiter| must outlive this
   // instance, and will be used to determine if .
-  PosixRandomAccessFile(std::string filename, int fd, Limiter* fd_limiter)
+  //
+  // If |direct_io| is true, |fd| must have been opened with OpenDirect(). Reads
+  // are then widened to aligned boundaries and staged in an aligned buffer.
+  PosixRandomAccessFile(std::string filename, int fd, Limiter* fd_limiter,
+                        bool direct_io = false)
       : has_permanent_fd_(fd_limiter->Acquire()),
         fd_(has_permanent_fd_ ? fd : -1),
+        direct_io_(direct_io),
         fd_limiter_(fd_limiter),
         filename_(std::move(filename)) {
     if (!has_permanent_fd_) {
@@ -171,7 +229,7 @@ class PosixRandomAccessFile final : public RandomAccessFile {
               char* scratch) const override {
     int fd = fd_;
     if (!has_permanent_fd_) {
-      fd = ::open(filename_.c_str(), O_RDONLY | kOpenBaseFlags);
+      fd = OpenTemporaryFd();
       if (fd < 0) {
         return PosixError(filename_, errno);
       }
@@ -180,7 +238,7 @@ class PosixRandomAccessFile final : public RandomAccessFile {
     assert(fd != -1);
 
     Status status;
-    ssize_t read_size = ::pread(fd, scratch, n, static_cast<off_t>(offset));
+    ssize_t read_size = PRead(fd, offset, n, scratch);
     *result = Slice(scratch, (read_size < 0) ? 0 : read_size);
     if (read_size < 0) {
       // An error: return a non-ok status.
@@ -194,9 +252,142 @@ class PosixRandomAccessFile final : public RandomAccessFile {
     return status;
   }
 
+  // Requests are sorted by offset and runs of requests that are adjacent
+  // (or nearly so) in the file are served by a single pread() into a
+  // temporary buffer.  Data blocks of a table are stored back to back, so
+  // a batch of neighbouring blocks costs one system call instead of one
+  // per block.
+  Status MultiRead(ReadRequest* requests, size_t n) const override {
+    if (n == 0) {
+      return Status::OK();
+    }
+
+    int fd = fd_;
+    if (!has_permanent_fd_) {
+      fd = OpenTemporaryFd();
+      if (fd < 0) {
+        Status status = PosixError(filename_, errno);
+        for (size_t i = 0; i < n; i++) {
+          requests[i].result = Slice();
+          requests[i].status = status;
+        }
+        return status;
+      }
+    }
+
+    assert(fd != -1);
+
+    std::vector<ReadRequest*> sorted(n);
+    for (size_t i = 0; i < n; i++) {
+      sorted[i] = &requests[i];
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const ReadRequest* a, const ReadRequest* b) {
+                return a->offset < b->offset;
+              });
+
+    Status status;
+    std::string merged;
+    size_t first = 0;
+    while (first < n) {
+      // Find the run of requests [first, last) that is read in one go.
+      const uint64_t start = sorted[first]->offset;
+      uint64_t limit = start + sorted[first]->n;
+      size_t last = first + 1;
+      while (last < n) {
+        const ReadRequest* next = sorted[last];
+        const uint64_t next_limit = std::max(limit, next->offset + next->n);
+        if (next->offset > limit + kMultiReadMaxGap ||
+            next_limit - start > kMultiReadMaxSize) {
+          break;
+        }
+        limit = next_limit;
+        ++last;
+      }
+
+      Status run_status;
+      if (last == first + 1) {
+        ReadRequest* request = sorted[first];
+        ssize_t read_size =
+            PRead(fd, request->offset, request->n, request->scratch);
+        request->result =
+            Slice(request->scratch, (read_size < 0) ? 0 : read_size);
+        if (read_size < 0) {
+          run_status = PosixError(filename_, errno);
+        }
+        request->status = run_status;
+      } else {
+        merged.resize(limit - start);
+        ssize_t read_size = PRead(fd, start, merged.size(), &merged[0]);
+        if (read_size < 0) {
+          run_status = PosixError(filename_, errno);
+          read_size = 0;
+        }
+        for (size_t i = first; i < last; i++) {
+          ReadRequest* request = sorted[i];
+          const uint64_t skip = request->offset - start;
+          size_t available = 0;
+          if (static_cast<uint64_t>(read_size) > skip) {
+            available = std::min<uint64_t>(request->n, read_size - skip);
+          }
+          std::memcpy(request->scratch, merged.data() + skip, available);
+          request->result = Slice(request->scratch, available);
+          request->status = run_status;
+        }
+      }
+      if (status.ok()) {
+        status = run_status;
+      }
+      first = last;
+    }
+
+    if (!has_permanent_fd_) {
+      // Close the temporary file descriptor opened earlier.
+      assert(fd != fd_);
+      ::close(fd);
+    }
+    return status;
+  }
+
  private:
+  int OpenTemporaryFd() const {
+    if (direct_io_) {
+      return OpenDirect(filename_, O_RDONLY | kOpenBaseFlags);
+    }
+    return ::open(filename_.c_str(), O_RDONLY | kOpenBaseFlags);
+  }
+
+  // Reads up to |n| bytes at |offset| into |scratch|. Returns the number of
+  // bytes read, or -1 and sets errno on failure.
+  ssize_t PRead(int fd, uint64_t offset, size_t n, char* scratch) const {
+    if (!direct_io_) {
+      return ::pread(fd, scratch, n, static_cast<off_t>(offset));
+    }
+
+    // Direct I/O transfers whole aligned blocks into aligned memory.
+    const uint64_t aligned_offset = AlignDown(offset);
+    const size_t aligned_size = AlignUp(offset + n) - aligned_offset;
+    std::unique_ptr<char[]> buffer(
+        new char[aligned_size + kDirectIOAlignment - 1]);
+    char* aligned_buffer = AlignPointer(buffer.get());
+    ssize_t read_size = ::pread(fd, aligned_buffer, aligned_size,
+                                static_cast<off_t>(aligned_offset));
+    if (read_size < 0) {
+      return read_size;
+    }
+
+    const uint64_t skip = offset - aligned_offset;
+    size_t available = 0;
+    if (static_cast<uint64_t>(read_size) > skip) {
+      available = std::min<uint64_t>(n, read_size - skip);
+    }
+    std::memcpy(scratch, aligned_buffer + skip, available);
+    return available;
+  }
+
   const bool has_permanent_fd_;  // If false, the file is opened on every read.
   const int fd_;                 // -1 if has_permanent_fd_ is false.
+  const bool direct_io_;         // True if fd_ bypasses the page cache.
   Limiter* const fd_limiter_;
   const std::string filename_;
 };
@@ -247,9 +438,15 @@ class PosixMmapReadableFile final : public RandomAccessFile {
 
 class PosixWritableFile final : public WritableFile {
  public:
-  PosixWritableFile(std::string filename, int fd)
-      : pos_(0),
+  // If |direct_io| is true, |fd| must have been opened with OpenDirect(). Data
+  // is then written in aligned blocks from the aligned buf_, and the partial
+  // block at the end of the file is zero-padded when it is written out.
+  PosixWritableFile(std::string filename, int fd, bool direct_io = false)
+      : buf_(direct_io ? AlignPointer(storage_) : storage_),
+        pos_(0),
         fd_(fd),
+        direct_io_(direct_io),
+        file_offset_(0),
         is_manifest_(IsManifest(filename)),
         filename_(std::move(filename)),
         dirname_(Dirname(filename_)) {}
@@ -281,17 +478,35 @@ class PosixWritableFile final : public WritableFile {
       return status;
     }
 
-    // Small writes go to buffer, large writes are written directly.
-    if (write_size < kWritableFileBufferSize) {
-      std::memcpy(buf_, write_data, write_size);
-      pos_ = write_size;
-      return Status::OK();
+    if (direct_io_) {
+      // Direct I/O needs aligned memory, so everything goes through buf_.
+      assert(pos_ == 0);
+      while (write_size >= kWritableFileBufferSize) {
+        std::memcpy(buf_, write_data, kWritableFileBufferSize);
+        pos_ = kWritableFileBufferSize;
+        status = FlushBuffer();
+        if (!status.ok()) {
+          return status;
+        }
+        write_data += kWritableFileBufferSize;
+        write_size -= kWritableFileBufferSize;
+      }
+    } else if (write_size >= kWritableFileBufferSize) {
+      // Large writes are written directly.
+      return WriteUnbuffered(write_data, write_size);
     }
-    return WriteUnbuffered(write_data, write_size);
+
+    // Small writes go to buffer.
+    std::memcpy(buf_, write_data, write_size);
+    pos_ = write_size;
+    return Status::OK();
   }
 
   Status Close() override {
     Status status = FlushBuffer();
+    if (status.ok() && direct_io_) {
+      status = WritePaddedTail();
+    }
     const int close_result = ::close(fd_);
     if (close_result < 0 && status.ok()) {
       status = PosixError(filename_, errno);
@@ -314,6 +529,9 @@ class PosixWritableFile final : public WritableFile {
     }
 
     status = FlushBuffer();
+    if (status.ok() && direct_io_) {
+      status = WritePaddedTail();
+    }
     if (!status.ok()) {
       return status;
     }
@@ -321,13 +539,106 @@ class PosixWritableFile final : public WritableFile {
     return SyncFd(fd_, filename_);
   }
 
+  Status RangeSync(uint64_t offset, uint64_t nbytes) override {
+#if defined(SYNC_FILE_RANGE_WRITE)
+    // Only initiates write-back; it completes in the background.
+    if (::sync_file_range(fd_, static_cast<off_t>(offset),
+                          static_cast<off_t>(nbytes),
+                          SYNC_FILE_RANGE_WRITE) != 0) {
+      return PosixError(filename_, errno);
+    }
+#elif HAVE_FDATASYNC
+    if (::fdatasync(fd_) != 0) {
+      return PosixError(filename_, errno);
+    }
+#else
+    // Unlike SyncFd(), no F_FULLFSYNC: this only needs to get the data out
+    // of the page cache, not past the drive's cache.
+    if (::fsync(fd_) != 0) {
+      return PosixError(filename_, errno);
+    }
+#endif  // defined(SYNC_FILE_RANGE_WRITE)
+    return Status::OK();
+  }
+
+  Status Preallocate(uint64_t size) override {
+#if defined(F_PREALLOCATE)
+    // Try for contiguous space first.
+    fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0,
+                      static_cast<off_t>(size), 0};
+    if (::fcntl(fd_, F_PREALLOCATE, &store) == -1) {
+      store.fst_flags = F_ALLOCATEALL;
+      if (::fcntl(fd_, F_PREALLOCATE, &store) == -1) {
+        return PosixError(filename_, errno);
+      }
+    }
+#elif defined(FALLOC_FL_KEEP_SIZE)
+    if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) !=
+        0) {
+      return PosixError(filename_, errno);
+    }
+#endif  // defined(F_PREALLOCATE)
+    return Status::OK();
+  }
+
  private:
   Status FlushBuffer() {
+    if (direct_io_) {
+      return FlushAlignedBlocks();
+    }
     Status status = WriteUnbuffered(buf_, pos_);
     pos_ = 0;
     return status;
   }
 
+  // Writes the whole aligned blocks in buf_ at file_offset_ and moves the
+  // trailing partial block, if any, to the front of buf_.
+  Status FlushAlignedBlocks() {
+    const size_t aligned_size = AlignDown(pos_);
+    Status status = WriteAt(buf_, aligned_size, file_offset_);
+    if (!status.ok()) {
+      return status;
+    }
+    file_offset_ += aligned_size;
+    pos_ -= aligned_size;
+    std::memmove(buf_, buf_ + aligned_size, pos_);
+    return Status::OK();
+  }
+
+  // Writes the partial block in buf_ zero-padded to the alignment, then
+  // truncates the padding off the file. The block stays in buf_, so later
+  // appends rewrite it in place.
+  Status WritePaddedTail() {
+    if (pos_ == 0) {
+      return Status::OK();
+    }
+    const size_t padded_size = AlignUp(pos_);
+    std::memset(buf_ + pos_, 0, padded_size - pos_);
+    Status status = WriteAt(buf_, padded_size, file_offset_);
+    if (status.ok() &&
+        ::ftruncate(fd_, static_cast<off_t>(file_offset_ + pos_)) != 0) {
+      status = PosixError(filename_, errno);
+    }
+    return status;
+  }
+
+  Status WriteAt(const char* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+      ssize_t write_result =
+          ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+      if (write_result < 0) {
+        if (errno == EINTR) {
+          continue;  // Retry
+        }
+        return PosixError(filename_, errno);
+      }
+      data += write_result;
+      size -= write_result;
+      offset += write_result;
+    }
+    return Status::OK();
+  }
+
   Status WriteUnbuffered(const char* data, size_t size) {
     while (size > 0) {
       ssize_t write_result = ::write(fd_, data, size);
@@ -425,11 +736,17 @@ class PosixWritableFile final : public WritableFile {
     return Basename(filename).starts_with("MANIFEST");
   }
 
+  // Backing storage for buf_, with slack for aligning it for direct I/O.
+  char storage_[kWritableFileBufferSize + kDirectIOAlignment - 1];
+
   // buf_[0, pos_ - 1] contains data to be written to fd_.
-  char buf_[kWritableFileBufferSize];
+  char* const buf_;
   size_t pos_;
   int fd_;
 
+  const bool direct_io_;  // True if fd_ bypasses the page cache.
+  uint64_t file_offset_;  // With direct I/O, the file offset of buf_[0].
+
   const bool is_manifest_;  // True if the file's name starts with MANIFEST.
   const std::string filename_;
   const std::string dirname_;  // The directory of filename_.
@@ -554,6 +871,52 @@ class PosixEnv : public Env {
     return Status::OK();
   }
 
+  Status NewDirectRandomAccessFile(const std::string& filename,
+                                   RandomAccessFile** result) override {
+    int fd = OpenDirect(filename, O_RDONLY | kOpenBaseFlags);
+    if (fd < 0) {
+      *result = nullptr;
+      return PosixError(filename, errno);
+    }
+
+    // Memory-mapped reads always go through the page cache, so direct files
+    // are read with pread().
+    *result = new PosixRandomAccessFile(filename, fd, &fd_limiter_,
+                                        /*direct_io=*/true);
+    return Status::OK();
+  }
+
+  Status NewDirectWritableFile(const std::string& filename,
+                               WritableFile** result) override {
+    int fd = OpenDirect(filename, O_TRUNC | O_WRONLY | O_CREAT | kOpenBaseFlags,
+                        0644);
+    if (fd < 0) {
+      *result = nullptr;
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixWritableFile(filename, fd, /*direct_io=*/true);
+    return Status::OK();
+  }
+
+  Status ReuseWritableFile(const std::string& filename,
+                           const std::string& old_filename,
+                           WritableFile** result) override {
+    if (std::rename(old_filename.c_str(), filename.c_str()) != 0) {
+      *result = nullptr;
+      return PosixError(old_filename, errno);
+    }
+    // Not truncated: writes overwrite the old contents in place.
+    int fd = ::open(filename.c_str(), O_WRONLY | kOpenBaseFlags, 0644);
+    if (fd < 0) {
+      *result = nullptr;
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixWritableFile(filename, fd);
+    return Status::OK();
+  }
+
   Status NewAppendableFile(const std::string& filename,
                            WritableFile** result) override {
     int fd = ::open(filename.c_str(),
@@ -624,6 +987,13 @@ class PosixEnv : public Env {
     return Status::OK();
   }
 
+  Status LinkFile(const std::string& from, const std::string& to) override {
+    if (::link(from.c_str(), to.c_str()) != 0) {
+      return PosixError(from, errno);
+    }
+    return Status::OK();
+  }
+
   Status LockFile(const std::string& filename, FileLock** lock) override {
     *lock = nullptr;
 
@@ -874,6 +1244,16 @@ using PosixDefaultEnv = SingletonEnv<PosixEnv>;
 
 }  // namespace
 
+void EnvPosixTestHelper::SetReadOnlyFDLimit(int limit) {
+  PosixDefaultEnv::AssertEnvNotInitialized();
+  g_open_read_only_file_limit = limit;
+}
+
+void EnvPosixTestHelper::SetReadOnlyMMapLimit(int limit) {
+  PosixDefaultEnv::AssertEnvNotInitialized();
+  g_mmap_limit = limit;
+}
+
 Env* Env::Default() {
   static PosixDefaultEnv env_container;
   return env_container.env();
@@ -0,0 +1,152 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "leveldb/env.h"
+#include "util/env_posix_test_helper.h"
+#include "util/random.h"
+#include "util/testutil.h"
+
+namespace {
+
+// Only one read-only file keeps its descriptor open, so that the reads of
+// any further file go through temporary descriptors.
+constexpr int kReadOnlyFileLimit = 1;
+
+// No file is mapped into memory, so that random access files are read
+// with pread().
+constexpr int kMMapLimit = 0;
+
+}  // namespace
+
+namespace leveldb {
+
+class EnvPosixTest : public testing::Test {
+ public:
+  static void SetFileLimits(int read_only_file_limit, int mmap_limit) {
+    EnvPosixTestHelper::SetReadOnlyFDLimit(read_only_file_limit);
+    EnvPosixTestHelper::SetReadOnlyMMapLimit(mmap_limit);
+  }
+
+  EnvPosixTest() : env_(Env::Default()) {}
+
+  // Write "size" random bytes to a new file named "name" and return them.
+  std::string WriteTestFile(const std::string& name, size_t size) {
+    Random rnd(301);
+    std::string contents;
+    test::RandomString(&rnd, static_cast<int>(size), &contents);
+    EXPECT_LEVELDB_OK(WriteStringToFile(env_, contents, name));
+    return contents;
+  }
+
+  // Serve "requests" with a single MultiRead() and check each result
+  // against the file contents.
+  static void CheckMultiRead(const RandomAccessFile* file,
+                             const std::string& contents,
+                             const std::vector<std::pair<uint64_t, size_t>>&
+                                 requests) {
+    std::vector<ReadRequest> batch(requests.size());
+    std::vector<std::unique_ptr<char[]>> scratch(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+      scratch[i].reset(new char[requests[i].second]);
+      batch[i].offset = requests[i].first;
+      batch[i].n = requests[i].second;
+      batch[i].scratch = scratch[i].get();
+    }
+    ASSERT_LEVELDB_OK(file->MultiRead(batch.data(), batch.size()));
+    for (size_t i = 0; i < batch.size(); i++) {
+      ASSERT_LEVELDB_OK(batch[i].status);
+      std::string expected;
+      if (batch[i].offset < contents.size()) {
+        expected = contents.substr(batch[i].offset, batch[i].n);
+      }
+      ASSERT_EQ(expected, batch[i].result.ToString())
+          << "offset " << batch[i].offset << " size " << batch[i].n;
+    }
+  }
+
+  Env* env_;
+};
+
+TEST_F(EnvPosixTest, MultiReadMergesNearbyRequests) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  const std::string fname = test_dir + "/multi_read_merge.txt";
+  const std::string contents = WriteTestFile(fname, 64 * 1024);
+
+  RandomAccessFile* file;
+  ASSERT_LEVELDB_OK(env_->NewRandomAccessFile(fname, &file));
+  std::unique_ptr<RandomAccessFile> file_guard(file);
+
+  // No requests at all.
+  CheckMultiRead(file, contents, {});
+  // A single request, which is not merged with anything.
+  CheckMultiRead(file, contents, {{100, 200}});
+  // Adjacent, overlapping and nearby requests out of order, which are
+  // merged into a single read.
+  CheckMultiRead(file, contents,
+                 {{5000, 100}, {0, 1000}, {1000, 1000}, {1500, 1000},
+                  {2500 + 4096, 10}});
+  // Requests further apart than the merge gap.
+  CheckMultiRead(file, contents, {{0, 10}, {10 + 4097, 10}, {30000, 500}});
+  // A merged read that ends past the end of the file, and a request that
+  // starts past it.
+  CheckMultiRead(file, contents,
+                 {{contents.size() - 300, 200},
+                  {contents.size() - 100, 400},
+                  {contents.size() + 100, 10}});
+
+  ASSERT_LEVELDB_OK(env_->RemoveFile(fname));
+}
+
+TEST_F(EnvPosixTest, MultiReadMatchesRead) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+
+  // The first file keeps its descriptor open and the second one is read
+  // through temporary descriptors.
+  std::vector<std::string> fnames;
+  std::vector<std::unique_ptr<RandomAccessFile>> files;
+  std::vector<std::string> contents;
+  for (int i = 0; i < kReadOnlyFileLimit + 1; i++) {
+    fnames.push_back(test_dir + "/multi_read_" + std::to_string(i) + ".txt");
+    contents.push_back(WriteTestFile(fnames.back(), 3 * 1024 * 1024));
+    RandomAccessFile* file;
+    ASSERT_LEVELDB_OK(env_->NewRandomAccessFile(fnames.back(), &file));
+    files.emplace_back(file);
+  }
+
+  // Batches of requests of all sizes, some of them spanning more than the
+  // largest merged read.
+  Random rnd(301);
+  for (int round = 0; round < 200; round++) {
+    const size_t f = round % files.size();
+    std::vector<std::pair<uint64_t, size_t>> requests;
+    const int n = 1 + rnd.Uniform(50);
+    for (int i = 0; i < n; i++) {
+      const size_t size = rnd.OneIn(10) ? rnd.Uniform(256 * 1024)
+                                        : 1 + rnd.Uniform(8 * 1024);
+      requests.emplace_back(rnd.Uniform(contents[f].size() + 1024), size);
+    }
+    CheckMultiRead(files[f].get(), contents[f], requests);
+  }
+
+  files.clear();
+  for (const std::string& fname : fnames) {
+    ASSERT_LEVELDB_OK(env_->RemoveFile(fname));
+  }
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  // All tests currently run with the same read-only file limits.
+  leveldb::EnvPosixTest::SetFileLimits(kReadOnlyFileLimit, kMMapLimit);
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
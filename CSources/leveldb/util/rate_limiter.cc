@@ -0,0 +1,176 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/rate_limiter.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+RateLimiter::~RateLimiter() = default;
+
+namespace {
+
+// Tokens are handed out in refills of one period's worth of bytes.
+constexpr const uint64_t kRefillPeriodMicros = 100 * 1000;
+
+// With auto-tuning, the rate is reconsidered after this many refill periods.
+constexpr const uint64_t kRefillsPerTune = 100;
+
+// The auto-tuned rate never drops below 1/kMinRateDivisor of the maximum.
+constexpr const int64_t kMinRateDivisor = 20;
+
+// Auto-tuning lowers the rate if fewer than kLowWatermarkPercent of the
+// refill periods drained the bucket, and raises it if more than
+// kHighWatermarkPercent did.  Each adjustment is by kAdjustPercent.
+constexpr const int64_t kLowWatermarkPercent = 50;
+constexpr const int64_t kHighWatermarkPercent = 90;
+constexpr const int64_t kAdjustPercent = 5;
+
+class GenericRateLimiter : public RateLimiter {
+ public:
+  GenericRateLimiter(int64_t bytes_per_second, bool auto_tuned, Env* env)
+      : env_(env),
+        auto_tuned_(auto_tuned),
+        max_bytes_per_second_(bytes_per_second),
+        bytes_per_second_(bytes_per_second),
+        available_bytes_(0),
+        next_refill_micros_(0),
+        tune_start_micros_(env->NowMicros()),
+        num_drains_(0),
+        total_bytes_through_(0),
+        total_throttled_micros_(0) {
+    assert(bytes_per_second > 0);
+  }
+
+  ~GenericRateLimiter() override = default;
+
+  void Request(size_t bytes) override {
+    MutexLock l(&mu_);
+    total_bytes_through_ += bytes;
+
+    uint64_t remaining = bytes;
+    while (true) {
+      const uint64_t now = env_->NowMicros();
+      if (auto_tuned_) {
+        Tune(now);
+      }
+      Refill(now);
+
+      const uint64_t granted = std::min<uint64_t>(remaining, available_bytes_);
+      available_bytes_ -= granted;
+      remaining -= granted;
+      if (remaining == 0) {
+        return;
+      }
+
+      // The bucket is drained; wait for the next refill.  Requests larger
+      // than a refill are granted piecewise over several periods.
+      num_drains_++;
+      const uint64_t wait_micros = next_refill_micros_ - now;
+      total_throttled_micros_ += wait_micros;
+      mu_.Unlock();
+      env_->SleepForMicroseconds(static_cast<int>(wait_micros));
+      mu_.Lock();
+    }
+  }
+
+  void SetBytesPerSecond(int64_t bytes_per_second) override {
+    assert(bytes_per_second > 0);
+    MutexLock l(&mu_);
+    max_bytes_per_second_ = bytes_per_second;
+    bytes_per_second_ = bytes_per_second;
+  }
+
+  int64_t GetBytesPerSecond() const override {
+    MutexLock l(&mu_);
+    return bytes_per_second_;
+  }
+
+  uint64_t GetTotalBytesThrough() const override {
+    MutexLock l(&mu_);
+    return total_bytes_through_;
+  }
+
+  uint64_t GetTotalThrottledMicros() const override {
+    MutexLock l(&mu_);
+    return total_throttled_micros_;
+  }
+
+ private:
+  // Starts a new refill period if the current one has ended.  Unused tokens
+  // do not carry over, which bounds bursts to one period's worth of bytes.
+  void Refill(uint64_t now) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (now < next_refill_micros_) {
+      return;
+    }
+    const int64_t refill_bytes =
+        bytes_per_second_ * static_cast<int64_t>(kRefillPeriodMicros) /
+        1000000;
+    available_bytes_ = std::max<int64_t>(refill_bytes, 1);
+    next_refill_micros_ = now + kRefillPeriodMicros;
+  }
+
+  // Adjusts bytes_per_second_ to the fraction of recent refill periods that
+  // drained the bucket.
+  void Tune(uint64_t now) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const uint64_t elapsed_micros = now - tune_start_micros_;
+    if (elapsed_micros < kRefillsPerTune * kRefillPeriodMicros) {
+      return;
+    }
+    const int64_t elapsed_refills =
+        static_cast<int64_t>(elapsed_micros / kRefillPeriodMicros);
+    const int64_t drained_percent =
+        std::min<int64_t>(num_drains_, elapsed_refills) * 100 /
+        elapsed_refills;
+
+    const int64_t min_rate =
+        std::max<int64_t>(max_bytes_per_second_ / kMinRateDivisor, 1);
+    if (drained_percent < kLowWatermarkPercent) {
+      bytes_per_second_ = std::max(
+          min_rate, bytes_per_second_ * 100 / (100 + kAdjustPercent));
+    } else if (drained_percent > kHighWatermarkPercent) {
+      bytes_per_second_ = std::min(
+          max_bytes_per_second_,
+          std::max(bytes_per_second_ + 1,
+                   bytes_per_second_ * (100 + kAdjustPercent) / 100));
+    }
+
+    tune_start_micros_ = now;
+    num_drains_ = 0;
+  }
+
+  Env* const env_;
+  const bool auto_tuned_;
+
+  mutable port::Mutex mu_;
+  int64_t max_bytes_per_second_ GUARDED_BY(mu_);
+  int64_t bytes_per_second_ GUARDED_BY(mu_);  // The enforced rate.
+
+  // Bytes that may still be granted before next_refill_micros_.
+  int64_t available_bytes_ GUARDED_BY(mu_);
+  uint64_t next_refill_micros_ GUARDED_BY(mu_);
+
+  // Auto-tuning state: number of times the bucket was drained since
+  // tune_start_micros_.
+  uint64_t tune_start_micros_ GUARDED_BY(mu_);
+  int64_t num_drains_ GUARDED_BY(mu_);
+
+  uint64_t total_bytes_through_ GUARDED_BY(mu_);
+  uint64_t total_throttled_micros_ GUARDED_BY(mu_);
+};
+
+}  // namespace
+
+RateLimiter* NewGenericRateLimiter(int64_t bytes_per_second, bool auto_tuned) {
+  return new GenericRateLimiter(bytes_per_second, auto_tuned, Env::Default());
+}
+
+}  // namespace leveldb
@@ -0,0 +1,264 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A portable (scalar) implementation of XXH3-64 following the reference
+// implementation in xxHash 0.8.  Only the seedless variant with the
+// default secret is provided since that is all leveldb needs.
+
+#include "util/xxh3.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "util/coding.h"
+
+namespace leveldb {
+namespace xxh3 {
+
+namespace {
+
+const uint32_t kPrime32_1 = 0x9E3779B1U;
+const uint32_t kPrime32_2 = 0x85EBCA77U;
+const uint32_t kPrime32_3 = 0xC2B2AE3DU;
+
+const uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+const uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+const size_t kStripeLen = 64;
+const size_t kSecretConsumeRate = 8;
+const size_t kAccumulators = kStripeLen / sizeof(uint64_t);
+const size_t kSecretMergeAccsStart = 11;
+const size_t kSecretLastAccStart = 7;
+const size_t kMidSizeMax = 240;
+const size_t kSecretSizeMin = 136;
+const size_t kSecretSize = 192;
+
+const uint8_t kSecret[kSecretSize] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c,
+    0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e,
+    0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6,
+    0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97,
+    0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7,
+    0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83,
+    0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26,
+    0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f,
+    0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+inline uint64_t Read64(const uint8_t* p) {
+  return DecodeFixed64(reinterpret_cast<const char*>(p));
+}
+
+inline uint32_t Read32(const uint8_t* p) {
+  return DecodeFixed32(reinterpret_cast<const char*>(p));
+}
+
+inline uint64_t Rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint32_t Swap32(uint32_t x) {
+  return ((x << 24) & 0xff000000) | ((x << 8) & 0x00ff0000) |
+         ((x >> 8) & 0x0000ff00) | ((x >> 24) & 0x000000ff);
+}
+
+inline uint64_t Swap64(uint64_t x) {
+  return (static_cast<uint64_t>(Swap32(static_cast<uint32_t>(x))) << 32) |
+         Swap32(static_cast<uint32_t>(x >> 32));
+}
+
+// Multiply two 64-bit values and fold the 128-bit product into 64 bits.
+inline uint64_t Mul128Fold64(uint64_t lhs, uint64_t rhs) {
+#if defined(__SIZEOF_INT128__)
+  const unsigned __int128 product =
+      static_cast<unsigned __int128>(lhs) * static_cast<unsigned __int128>(rhs);
+  return static_cast<uint64_t>(product) ^
+         static_cast<uint64_t>(product >> 64);
+#else
+  const uint64_t lo_lo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+  const uint64_t hi_lo = (lhs >> 32) * (rhs & 0xFFFFFFFF);
+  const uint64_t lo_hi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+  const uint64_t hi_hi = (lhs >> 32) * (rhs >> 32);
+  const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+  const uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+  const uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+  return lower ^ upper;
+#endif
+}
+
+inline uint64_t XXH64Avalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= kPrime64_2;
+  h ^= h >> 29;
+  h *= kPrime64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+inline uint64_t Avalanche(uint64_t h) {
+  h ^= h >> 37;
+  h *= 0x165667919E3779F9ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+inline uint64_t StrongAvalanche(uint64_t h, uint64_t len) {
+  h ^= Rotl64(h, 49) ^ Rotl64(h, 24);
+  h *= 0x9FB21C651E98DF25ULL;
+  h ^= (h >> 35) + len;
+  h *= 0x9FB21C651E98DF25ULL;
+  h ^= h >> 28;
+  return h;
+}
+
+inline uint64_t Mix16(const uint8_t* input, const uint8_t* secret) {
+  return Mul128Fold64(Read64(input) ^ Read64(secret),
+                      Read64(input + 8) ^ Read64(secret + 8));
+}
+
+uint64_t Hash0To16(const uint8_t* input, size_t len) {
+  if (len > 8) {
+    const uint64_t flip1 = Read64(kSecret + 24) ^ Read64(kSecret + 32);
+    const uint64_t flip2 = Read64(kSecret + 40) ^ Read64(kSecret + 48);
+    const uint64_t lo = Read64(input) ^ flip1;
+    const uint64_t hi = Read64(input + len - 8) ^ flip2;
+    return Avalanche(len + Swap64(lo) + hi + Mul128Fold64(lo, hi));
+  }
+  if (len >= 4) {
+    const uint64_t input1 = Read32(input);
+    const uint64_t input2 = Read32(input + len - 4);
+    const uint64_t flip = Read64(kSecret + 8) ^ Read64(kSecret + 16);
+    return StrongAvalanche((input2 + (input1 << 32)) ^ flip, len);
+  }
+  if (len > 0) {
+    const uint32_t c1 = input[0];
+    const uint32_t c2 = input[len >> 1];
+    const uint32_t c3 = input[len - 1];
+    const uint32_t combined = (c1 << 16) | (c2 << 24) | c3 |
+                              (static_cast<uint32_t>(len) << 8);
+    const uint64_t flip = Read32(kSecret) ^ Read32(kSecret + 4);
+    return XXH64Avalanche(combined ^ flip);
+  }
+  return XXH64Avalanche(Read64(kSecret + 56) ^ Read64(kSecret + 64));
+}
+
+uint64_t Hash17To128(const uint8_t* input, size_t len) {
+  uint64_t acc = len * kPrime64_1;
+  if (len > 32) {
+    if (len > 64) {
+      if (len > 96) {
+        acc += Mix16(input + 48, kSecret + 96);
+        acc += Mix16(input + len - 64, kSecret + 112);
+      }
+      acc += Mix16(input + 32, kSecret + 64);
+      acc += Mix16(input + len - 48, kSecret + 80);
+    }
+    acc += Mix16(input + 16, kSecret + 32);
+    acc += Mix16(input + len - 32, kSecret + 48);
+  }
+  acc += Mix16(input, kSecret);
+  acc += Mix16(input + len - 16, kSecret + 16);
+  return Avalanche(acc);
+}
+
+uint64_t Hash129To240(const uint8_t* input, size_t len) {
+  const size_t kStartOffset = 3;
+  const size_t kLastOffset = 17;
+  const size_t rounds = len / 16;
+
+  uint64_t acc = len * kPrime64_1;
+  for (size_t i = 0; i < 8; i++) {
+    acc += Mix16(input + 16 * i, kSecret + 16 * i);
+  }
+  acc = Avalanche(acc);
+  for (size_t i = 8; i < rounds; i++) {
+    acc += Mix16(input + 16 * i, kSecret + 16 * (i - 8) + kStartOffset);
+  }
+  acc += Mix16(input + len - 16, kSecret + kSecretSizeMin - kLastOffset);
+  return Avalanche(acc);
+}
+
+inline void Accumulate512(uint64_t* acc, const uint8_t* input,
+                          const uint8_t* secret) {
+  for (size_t i = 0; i < kAccumulators; i++) {
+    const uint64_t data_val = Read64(input + 8 * i);
+    const uint64_t data_key = data_val ^ Read64(secret + 8 * i);
+    acc[i ^ 1] += data_val;
+    acc[i] += (data_key & 0xFFFFFFFF) * (data_key >> 32);
+  }
+}
+
+inline void ScrambleAcc(uint64_t* acc, const uint8_t* secret) {
+  for (size_t i = 0; i < kAccumulators; i++) {
+    uint64_t a = acc[i];
+    a ^= a >> 47;
+    a ^= Read64(secret + 8 * i);
+    acc[i] = a * kPrime32_1;
+  }
+}
+
+uint64_t HashLong(const uint8_t* input, size_t len) {
+  uint64_t acc[kAccumulators] = {kPrime32_3, kPrime64_1, kPrime64_2,
+                                 kPrime64_3, kPrime64_4, kPrime32_2,
+                                 kPrime64_5, kPrime32_1};
+
+  const size_t stripes_per_block =
+      (kSecretSize - kStripeLen) / kSecretConsumeRate;
+  const size_t block_len = kStripeLen * stripes_per_block;
+  const size_t blocks = (len - 1) / block_len;
+
+  for (size_t b = 0; b < blocks; b++) {
+    const uint8_t* block = input + b * block_len;
+    for (size_t s = 0; s < stripes_per_block; s++) {
+      Accumulate512(acc, block + s * kStripeLen,
+                    kSecret + s * kSecretConsumeRate);
+    }
+    ScrambleAcc(acc, kSecret + kSecretSize - kStripeLen);
+  }
+
+  // Last partial block
+  const size_t stripes = ((len - 1) - block_len * blocks) / kStripeLen;
+  const uint8_t* block = input + blocks * block_len;
+  for (size_t s = 0; s < stripes; s++) {
+    Accumulate512(acc, block + s * kStripeLen,
+                  kSecret + s * kSecretConsumeRate);
+  }
+
+  // Last stripe
+  Accumulate512(acc, input + len - kStripeLen,
+                kSecret + kSecretSize - kStripeLen - kSecretLastAccStart);
+
+  uint64_t result = len * kPrime64_1;
+  for (size_t i = 0; i < kAccumulators / 2; i++) {
+    const uint8_t* secret = kSecret + kSecretMergeAccsStart + 16 * i;
+    result += Mul128Fold64(acc[2 * i] ^ Read64(secret),
+                           acc[2 * i + 1] ^ Read64(secret + 8));
+  }
+  return Avalanche(result);
+}
+
+}  // namespace
+
+uint64_t Value(const char* data, size_t n) {
+  const uint8_t* input = reinterpret_cast<const uint8_t*>(data);
+  if (n <= 16) {
+    return Hash0To16(input, n);
+  } else if (n <= 128) {
+    return Hash17To128(input, n);
+  } else if (n <= kMidSizeMax) {
+    return Hash129To240(input, n);
+  }
+  return HashLong(input, n);
+}
+
+}  // namespace xxh3
+}  // namespace leveldb
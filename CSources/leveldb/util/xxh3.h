@@ -0,0 +1,23 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A portable implementation of the 64-bit XXH3 hash (xxHash 0.8, seed 0,
+// default secret).  The result is bit-compatible with XXH3_64bits().
+
+#ifndef STORAGE_LEVELDB_UTIL_XXH3_H_
+#define STORAGE_LEVELDB_UTIL_XXH3_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace leveldb {
+namespace xxh3 {
+
+// Return the 64-bit XXH3 hash of data[0,n-1]
+uint64_t Value(const char* data, size_t n);
+
+}  // namespace xxh3
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_XXH3_H_
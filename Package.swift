@@ -27,11 +27,25 @@ let package = Package(
             name: "DVELevelDB_ObjC",
             dependencies: [],
             path: "CSources",
-            exclude: [],
+            exclude: [
+                // Unit tests of the bundled LevelDB sources, built with GoogleTest
+                // by leveldb/CMakeLists.txt.
+                "leveldb/CMakeLists.txt",
+                "leveldb/db/db_test.cc",
+                "leveldb/db/log_test.cc",
+                "leveldb/db/version_edit_test.cc",
+                "leveldb/db/version_set_test.cc",
+                "leveldb/db/write_batch_test.cc",
+                "leveldb/util/env_posix_test.cc",
+                "leveldb/util/testutil.cc",
+            ],
             publicHeadersPath: "include",
             cxxSettings: [
                 .headerSearchPath("leveldb"),
                 .define("LEVELDB_PLATFORM_POSIX=1"),
+            ],
+            linkerSettings: [
+                .linkedLibrary("z"),
             ]
         ),
         .testTarget(
@@ -37,6 +37,15 @@ public extension LevelDB where KeyComparator: LevelDBKeyEncoder {
         let keyData = try keyComparator.encodeKey(key)
         try removeValue(forKey: keyData, options: options)
     }
+
+    func removeValues<Key>(
+        in keyRange: Range<Key>,
+        options: WriteOptions = .default
+    ) throws where Key: StringProtocol {
+        let startKeyData = try keyComparator.encodeKey(keyRange.lowerBound)
+        let limitKeyData = try keyComparator.encodeKey(keyRange.upperBound)
+        try removeValues(startKey: startKeyData, limitKey: limitKeyData, options: options)
+    }
 }
 
 public extension LevelDB where KeyComparator: LevelDBKeyEncoder {
@@ -131,6 +131,24 @@ open class LevelDB<KeyComparator> where KeyComparator: LevelDBKeyComparator {
         }
     }
 
+    /// Removes the values stored in the DB for all keys in a key range.
+    ///
+    /// The removal is recorded as a single range deletion, regardless of the number of keys in the range.
+    ///
+    /// - Parameters:
+    ///   - startKey: The key defining the start of the range. The key itself is included.
+    ///   - limitKey: The key defining the end of the range. The key itself is not included.
+    ///   - options: The LevelDB write options for the operation.
+    public func removeValues<Key>(
+        startKey: Key,
+        limitKey: Key,
+        options: WriteOptions = .default
+    ) throws where Key: ContiguousBytes {
+        try withUnsafeData(startKey, limitKey) { startKeyData, limitKeyData in
+            try cLevelDB.removeValues(fromKey: startKeyData, toKey: limitKeyData, options: options)
+        }
+    }
+
     /// Gets the approximate sizes for the given key ranges.
     ///
     /// The results may not include the sizes of recently written data.
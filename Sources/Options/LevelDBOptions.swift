@@ -6,6 +6,7 @@ import Foundation
 
 public extension CLevelDB.Options {
     typealias Compression = CLevelDB.CompressionOption
+    typealias Checksum = CLevelDB.ChecksumOption
 
     static let `default` = CLevelDB.Options()
 }
@@ -2,6 +2,7 @@
 // Licensed under the MIT License.
 
 import DVELevelDB
+import DVELevelDB_ObjC
 import XCTest
 
 final class LevelDBTests: XCTestCase {
@@ -257,6 +258,34 @@ final class LevelDBTests: XCTestCase {
         XCTAssertNil(value4)
     }
 
+    func testRemoveValuesInRange() throws {
+        let levelDB = try LevelDB(directoryURL: directoryUrl)
+
+        try levelDB.setValue("Value1", forKey: "A1")
+        try levelDB.setValue("Value2", forKey: "B1")
+        try levelDB.setValue("Value3", forKey: "B2")
+        try levelDB.setValue("Value4", forKey: "C1")
+
+        let snapshot = levelDB.createSnapshot()
+        try levelDB.removeValues(in: "B1"..<"C1")
+
+        let value1: String? = try levelDB.value(forKey: "A1")
+        XCTAssertEqual(value1, "Value1")
+        let value2: String? = try levelDB.value(forKey: "B1")
+        XCTAssertNil(value2)
+        let value3: String? = try levelDB.value(forKey: "B2")
+        XCTAssertNil(value3)
+        let value4: String? = try levelDB.value(forKey: "C1")
+        XCTAssertEqual(value4, "Value4")
+        let snapshotValue: String? = try levelDB.value(forKey: "B2", options: .usingSnapshot(snapshot))
+        XCTAssertEqual(snapshotValue, "Value3")
+
+        levelDB.compact()
+
+        let compactedValue: String? = try levelDB.value(forKey: "B2")
+        XCTAssertNil(compactedValue)
+    }
+
     func testGetApproximateSizes() throws {
         let options: LevelDB.Options = .default
         options.compression = .none
@@ -287,6 +316,107 @@ final class LevelDBTests: XCTestCase {
         XCTAssertGreaterThan(sizes3.first!, sizes1.first!)
     }
 
+    func testXXH3Checksum() throws {
+        let options: LevelDB.Options = .init()
+        options.checksum = .xxh3
+        options.compression = .none
+        options.useParanoidChecks = true
+        var levelDB: LevelDB<BytewiseKeyComparator>? = try LevelDB(directoryURL: directoryUrl, options: options)
+
+        try levelDB?.setValue("Value1", forKey: "A1")
+        try levelDB?.setValue("Value2", forKey: "B1")
+        levelDB?.compact()
+        levelDB = nil
+
+        // Tables written with XXH3 checksums stay readable regardless of the checksum option used for opening.
+        levelDB = try LevelDB(directoryURL: directoryUrl)
+        let value1: String? = try levelDB?.value(forKey: "A1")
+        XCTAssertEqual(value1, "Value1")
+        levelDB = nil
+
+        let tableUrls = try Self.fileManager.contentsOfDirectory(at: directoryUrl, includingPropertiesForKeys: nil)
+            .filter { $0.pathExtension == "ldb" }
+        XCTAssertFalse(tableUrls.isEmpty)
+        for tableUrl in tableUrls {
+            var data = try Data(contentsOf: tableUrl)
+            // The footer stores the checksum type in the byte in front of the magic number.
+            XCTAssertEqual(data[data.count - 9], 1)
+            // Flip a byte of the first key in the first data block.
+            data[4] ^= 0xFF
+            try data.write(to: tableUrl)
+        }
+
+        levelDB = try LevelDB(directoryURL: directoryUrl, options: options)
+        let readOptions: LevelDB.ReadOptions = .options(verifyChecksums: true, fillCache: false)
+        XCTAssertThrowsError(try { let _: String? = try levelDB?.value(forKey: "A1", options: readOptions) }()) { error in
+            XCTAssertEqual((error as? CLevelDB.Error)?.code, .corruptedData)
+        }
+    }
+
+    func testRecoveryWithoutFlush() throws {
+        var levelDB: LevelDB<BytewiseKeyComparator>? = try LevelDB(directoryURL: directoryUrl)
+        try levelDB?.setValue("Value1", forKey: "A1")
+        try levelDB?.setValue("Value2", forKey: "B1")
+        levelDB = nil
+
+        // Recovered records are served from memory and survive a second reopen before they are flushed.
+        // DBTest.AvoidFlushDuringRecovery in the LevelDB unit tests checks that no table is written during
+        // the open and that the log is kept until the flush, which needs control over the background work.
+        let options: LevelDB.Options = .init()
+        options.avoidFlushDuringRecovery = true
+        levelDB = try LevelDB(directoryURL: directoryUrl, options: options)
+        let value1: String? = try levelDB?.value(forKey: "A1")
+        XCTAssertEqual(value1, "Value1")
+        levelDB = nil
+
+        levelDB = try LevelDB(directoryURL: directoryUrl, options: options)
+        let value2: String? = try levelDB?.value(forKey: "B1")
+        XCTAssertEqual(value2, "Value2")
+    }
+
+    func testRecycledLogFiles() throws {
+        let options: LevelDB.Options = .init()
+        options.writeBufferSize = 64 * 1024
+        options.recycleLogFileCount = 2
+        var levelDB: LevelDB<BytewiseKeyComparator>? = try LevelDB(directoryURL: directoryUrl, options: options)
+
+        // Enough data for several memtable switches, so that log files get recycled.
+        let value = String(repeating: "x", count: 1000)
+        for index in 0 ..< 500 {
+            try levelDB?.setValue(value, forKey: String(format: "Key%04d", index))
+        }
+        try levelDB?.setValue("Value1", forKey: "A1")
+        levelDB = nil
+
+        // Stale records in recycled log files must not be replayed. DBTest.RecycleLogFiles and the
+        // LogTest.RecycledLog* tests in the LevelDB unit tests check that log files are actually reused,
+        // which cannot be observed from here.
+        levelDB = try LevelDB(directoryURL: directoryUrl, options: options)
+        let value1: String? = try levelDB?.value(forKey: "A1")
+        XCTAssertEqual(value1, "Value1")
+        let value2: String? = try levelDB?.value(forKey: "Key0499")
+        XCTAssertEqual(value2, value)
+    }
+
+    func testWALCompression() throws {
+        let options: LevelDB.Options = .init()
+        options.walCompression = .zlib
+        var levelDB: LevelDB<BytewiseKeyComparator>? = try LevelDB(directoryURL: directoryUrl, options: options)
+
+        let value = String(repeating: "x", count: 100_000)
+        try levelDB?.setValue(value, forKey: "A1")
+        try levelDB?.setValue("Value2", forKey: "B1")
+        levelDB = nil
+
+        // Both records are recovered from the log, the first one of which is compressed. DBTest.WALCompression
+        // and the compressed record tests in LogTest check the log contents.
+        levelDB = try LevelDB(directoryURL: directoryUrl, options: options)
+        let value1: String? = try levelDB?.value(forKey: "A1")
+        XCTAssertEqual(value1, value)
+        let value2: String? = try levelDB?.value(forKey: "B1")
+        XCTAssertEqual(value2, "Value2")
+    }
+
     func testCompact() throws {
         let levelDB = try LevelDB(directoryURL: directoryUrl)
 